@@ -0,0 +1,143 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/**
+ * Top level BVH benchmark.
+ *
+ * Builds the instance BVH over 1k, 10k and 100k synthetic instance boxes and reports
+ * build time, tree size and traversal throughput (camera-like rays through the
+ * structure-of-arrays path used by the tracers).
+ *
+ * usage: gvtBVHBench [-rays N] [-threads N] [-seed N]
+*/
+
+#include <gvt/core/Math.h>
+#include <gvt/render/actor/RayStream.h>
+#include <gvt/render/data/accel/BVH.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../timer.h"
+
+using namespace gvt::render::actor;
+using namespace gvt::render::data::accel;
+using namespace gvt::render::data::primitives;
+
+static gvt::core::Vector<Box3D> makeInstances(size_t n, unsigned seed) {
+  // instances scattered in a cube whose side grows with the instance count so density stays constant
+  std::mt19937 gen(seed);
+  const float side = 10.f * std::cbrt(float(n));
+  std::uniform_real_distribution<float> pos(0.f, side);
+  std::uniform_real_distribution<float> size(0.5f, 4.f);
+  gvt::core::Vector<Box3D> boxes;
+  boxes.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    glm::vec3 c(pos(gen), pos(gen), pos(gen));
+    glm::vec3 h(size(gen), size(gen), size(gen));
+    boxes.push_back(Box3D(c - h, c + h));
+  }
+  return boxes;
+}
+
+static void makeRays(RayStream &rays, size_t n, const glm::vec3 &lo, const glm::vec3 &hi, unsigned seed) {
+  // rays from a point in front of the scene towards random points inside it
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  const glm::vec3 extent = hi - lo;
+  const glm::vec3 eye = glm::vec3(lo.x + extent.x * 0.5f, lo.y + extent.y * 0.5f, lo.z - extent.z);
+  rays.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    glm::vec3 target = lo + glm::vec3(u(gen), u(gen), u(gen)) * extent;
+    rays.setOrigin(i, eye);
+    rays.setDirection(i, glm::normalize(target - eye));
+    rays.t_min[i] = Ray::RAY_EPSILON;
+    rays.t_max[i] = FLT_MAX;
+    rays.id[i] = i;
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t nrays = 1 << 20;
+  unsigned threads = std::thread::hardware_concurrency();
+  unsigned seed = 7;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-rays") && i + 1 < argc)
+      nrays = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+      seed = atoi(argv[++i]);
+    else {
+      std::cerr << "usage: " << argv[0] << " [-rays N] [-threads N] [-seed N]" << std::endl;
+      return 1;
+    }
+  }
+
+  tbb::task_arena arena(threads);
+  const size_t sizes[] = { 1000, 10000, 100000 };
+
+  std::cout << "instances,nodes,depth,build_ms,rays,hits,trace_ms,mrays_per_s" << std::endl;
+  for (size_t n : sizes) {
+    gvt::core::Vector<Box3D> boxes = makeInstances(n, seed);
+    Box3D scene;
+    for (auto &b : boxes) scene.merge(b);
+
+    RayStream rays;
+    makeRays(rays, nrays, scene.bounds_min, scene.bounds_max, seed + 1);
+
+    my_timer_t t0, t1, t2;
+    std::shared_ptr<BVH> bvh;
+    timeCurrent(&t0);
+    arena.execute([&]() { bvh = std::make_shared<BVH>(boxes); });
+    timeCurrent(&t1);
+
+    std::vector<size_t> hitcount(nrays / 4096 + 1, 0);
+    arena.execute([&]() {
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, nrays, 4096), [&](const tbb::blocked_range<size_t> &r) {
+        gvt::core::Vector<BVH::hit> hits = bvh->intersect<GVT_SIMD_WIDTH>(rays, r.begin(), r.end(), -1);
+        size_t h = 0;
+        for (auto &hit : hits) h += (hit.next != -1);
+        hitcount[r.begin() / 4096] = h;
+      });
+    });
+    timeCurrent(&t2);
+
+    size_t hits = 0;
+    for (size_t h : hitcount) hits += h;
+    const double build_ms = timeDifferenceMS(&t0, &t1);
+    const double trace_ms = timeDifferenceMS(&t1, &t2);
+    std::cout << n << "," << bvh->numNodes() << "," << bvh->depth() << "," << build_ms << "," << nrays << "," << hits
+              << "," << trace_ms << "," << (nrays / (trace_ms * 1e-3)) * 1e-6 << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,163 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * accum: concurrent framebuffer accumulation.
+ *
+ * 64 threads add contributions to an HDR AccumulationBuffer concurrently (the way the
+ * tracers call ImageComposite::localAdd from tbb::parallel_for) and the reduced buffer is
+ * compared against a serial reference. Contributions are multiples of 1/256 so every sum
+ * is exact and any lost update shows up as an energy difference. Also checks that values
+ * above 1 survive (no clamping during accumulation) and that reset() clears a frame.
+ * Finally every thread adds to every tile of a 2048x1024 frame, and the tile memory has to
+ * stay within one shared framebuffer plus LOCAL_TILES tiles per thread.
+*/
+
+#include <gvt/render/composite/AccumulationBuffer.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using gvt::render::composite::AccumulationBuffer;
+
+static const size_t width = 500;
+static const size_t height = 300; // not a multiple of the tile size
+
+static size_t pixelOf(size_t thread, size_t i) {
+  size_t h = (thread + 1) * 2654435761u ^ (i * 40503u + 977u);
+  // every 16th add goes to a shared hot pixel so threads collide on the same tile
+  return (i % 16 == 0) ? (width * height) / 2 : h % (width * height);
+}
+
+static glm::vec3 colorOf(size_t thread, size_t i) {
+  return glm::vec3(float((thread + i) % 8 + 1), float((thread * 3 + i) % 5), float(i % 3)) / 256.f;
+}
+
+int accumCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  size_t nthreads = 64, nadds = 200000, nframes = 2;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-threads")) nthreads = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-adds")) nadds = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-frames")) nframes = std::atoi(argv[++i]);
+  }
+
+  // serial reference
+  std::vector<double> ref(width * height * 4, 0.0);
+  for (size_t t = 0; t < nthreads; ++t)
+    for (size_t i = 0; i < nadds; ++i) {
+      const size_t p = pixelOf(t, i);
+      const glm::vec3 c = colorOf(t, i);
+      for (int k = 0; k < 3; ++k) ref[p * 4 + k] += c[k];
+      ref[p * 4 + 3] += 1.0;
+    }
+  double refEnergy = 0.0;
+  for (size_t i = 0; i < ref.size(); ++i) refEnergy += ref[i];
+
+  AccumulationBuffer accum(width, height);
+  std::vector<float> out(width * height * 4);
+
+  for (size_t frame = 0; frame < nframes; ++frame) {
+    accum.reset();
+
+    std::atomic<size_t> ready(0);
+    my_timer_t t0, t1;
+    timeCurrent(&t0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nthreads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        ready++;
+        while (ready < nthreads) std::this_thread::yield();
+        for (size_t i = 0; i < nadds; ++i) accum.add(pixelOf(t, i), colorOf(t, i), 1.f);
+      }));
+    for (std::thread &th : threads) th.join();
+    timeCurrent(&t1);
+    const double addMS = timeDifferenceMS(&t0, &t1);
+
+    timeCurrent(&t0);
+    accum.reduce(out.data());
+    timeCurrent(&t1);
+    const double reduceMS = timeDifferenceMS(&t0, &t1);
+
+    double energy = 0.0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < out.size(); ++i) {
+      energy += out[i];
+      if (out[i] != ref[i]) mismatches++;
+    }
+
+    const size_t hot = (width * height) / 2;
+    const bool hdr = out[hot * 4 + 3] > 1.f && out[hot * 4 + 0] > 1.f;
+
+    std::cout << "frame " << frame << ": " << nthreads << " threads x " << nadds << " adds, add " << addMS
+              << " ms, reduce " << reduceMS << " ms, energy " << energy << " (expected " << refEnergy << "), "
+              << mismatches << " mismatched channels, hot pixel rgba (" << out[hot * 4 + 0] << ", "
+              << out[hot * 4 + 1] << ", " << out[hot * 4 + 2] << ", " << out[hot * 4 + 3] << ")" << std::endl;
+
+    check(!mismatches && energy == refEnergy, "accumulated energy does not match the serial reference");
+    check(hdr, "hot pixel was clamped during accumulation");
+  }
+
+  // private tiles for every tile a thread touches would be a framebuffer per thread
+  const size_t wideWidth = 2048, wideHeight = 1024, rounds = 4;
+  AccumulationBuffer wide(wideWidth, wideHeight);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nthreads; ++t)
+    threads.push_back(std::thread([&, t]() {
+      for (size_t r = 0; r < rounds; ++r)
+        for (size_t i = 0; i < wide.tiles(); ++i) {
+          const size_t tile = (i + t * 97) % wide.tiles(); // threads start on different tiles
+          const size_t x = wide.tileX(tile) + (t + r) % AccumulationBuffer::TILE, y = wide.tileY(tile) + t % 7;
+          wide.add(y * wideWidth + x, glm::vec3(1.f / 256.f), 1.f);
+        }
+    }));
+  for (std::thread &th : threads) th.join();
+
+  const size_t tileBytes = AccumulationBuffer::TILE * AccumulationBuffer::TILE * 4 * sizeof(float);
+  const size_t bound = wide.tiles() * (tileBytes + 64) + nthreads * AccumulationBuffer::LOCAL_TILES * tileBytes;
+  std::vector<float> wideOut(wideWidth * wideHeight * 4);
+  wide.reduce(wideOut.data());
+  double wideEnergy = 0.0;
+  for (size_t i = 0; i < wideOut.size(); ++i) wideEnergy += wideOut[i];
+  const double wideExpected = double(nthreads * rounds * wide.tiles()) * (1.0 + 3.0 / 256.0);
+
+  std::cout << "all tiles: " << nthreads << " threads x " << wide.tiles() << " tiles, " << wide.bytes() / (1 << 20)
+            << " MB of tiles (bound " << bound / (1 << 20) << " MB), energy " << wideEnergy << " (expected "
+            << wideExpected << ")" << std::endl;
+
+  check(wide.bytes() <= bound, "tile memory grows with the thread count");
+  check(wideEnergy == wideExpected, "accumulated energy of the all tiles frame does not match");
+
+  return check.status();
+}
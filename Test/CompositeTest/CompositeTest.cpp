@@ -0,0 +1,44 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * Image accumulation and compositing: the thread safe accumulation buffer, sparse tile
+ * compositing against IceT and progressive pass accumulation. See checks.h.
+ *
+ * usage: gvtCompositeTest <case> [options], sparse under mpirun
+*/
+
+#include "../checks.h"
+
+int accumCase(int argc, char **argv);
+int sparseCase(int argc, char **argv);
+int progressiveCase(int argc, char **argv);
+
+int main(int argc, char **argv) {
+  static const gvttest::Case cases[] = {
+    { "accum", accumCase, "[-threads N] [-adds N] [-frames N]" },
+    { "sparse", sparseCase, "[-width W] [-height H] [-frames N] [-overlap F] [-skip-icet]" },
+    { "progressive", progressiveCase, "[-width N] [-height N] [-passes N]" },
+  };
+  return gvttest::run(argc, argv, cases);
+}
@@ -0,0 +1,141 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * progressive: progressive pass accumulation.
+ *
+ * Checks the ProgressiveBuffer running mean (sample weighted passes, reset) and that the
+ * per pass Halton pixel jitter of the camera converges: a slanted edge is "rendered" one
+ * sample per pixel per pass from the directions of the primary ray stream, the passes are
+ * accumulated and the error against a 32x32 supersampled reference must fall well below
+ * the error of a single pass. Pass 0 must be the unjittered pixel grid, so a single
+ * progressive pass matches a plain render.
+*/
+
+#include <gvt/render/composite/ProgressiveBuffer.h>
+#include <gvt/render/data/scene/gvtCamera.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+
+using namespace gvt::render::data::scene;
+using gvt::render::composite::ProgressiveBuffer;
+
+// coverage of the slanted edge u * 0.8 + v * 0.6 > 0.05 on the image plane
+static float edge(const gvt::render::actor::RayStream &rs, size_t r) {
+  const float u = rs.dx[r] / -rs.dz[r], v = rs.dy[r] / -rs.dz[r];
+  return (u * 0.8f + v * 0.6f > 0.05f) ? 1.f : 0.f;
+}
+
+// one sample per pixel of the current jitter into rgba (stream ids are pixel indices)
+static void shade(gvtPerspectiveCamera &cam, std::vector<float> &rgba) {
+  cam.generateRayStream();
+  const gvt::render::actor::RayStream &rs = cam.stream;
+  for (size_t r = 0; r < rs.size(); ++r) {
+    const float c = edge(rs, r);
+    for (int k = 0; k < 3; ++k) rgba[rs.id[r] * 4 + k] = c;
+    rgba[rs.id[r] * 4 + 3] = 1.f;
+  }
+}
+
+static double rms(const float *a, const std::vector<float> &b) {
+  double e = 0.0;
+  for (size_t i = 0; i < b.size(); i += 4) e += (a[i] - b[i]) * (a[i] - b[i]);
+  return std::sqrt(e / (b.size() / 4));
+}
+
+int progressiveCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  int width = 64, height = 48, passes = 64;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-width")) width = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-height")) height = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-passes")) passes = std::atoi(argv[++i]);
+  }
+  const size_t pixels = size_t(width) * height;
+
+  // running mean
+  {
+    ProgressiveBuffer buf(2, 1);
+    std::vector<float> a(8, 1.f), b(8, 4.f);
+    check(buf.image() == nullptr, "image before the first pass");
+    buf.add(a.data(), 1.f);
+    buf.add(b.data(), 3.f);
+    const float *m = buf.image();
+    check(m && m[0] == 3.25f && m[7] == 3.25f && buf.samples(1) == 4.f && buf.passes() == 2,
+          "weighted mean of two passes");
+    buf.reset();
+    check(buf.passes() == 0 && buf.image() == nullptr, "reset keeps passes");
+  }
+
+  gvtPerspectiveCamera cam;
+  cam.setFilmsize(width, height);
+  cam.setSamples(1);
+  cam.setFOV(0.5f);
+  cam.lookAt(glm::vec3(0.f, 0.f, 4.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+  cam.AllocateCameraRayStream();
+
+  // pass 0 is the plain pixel grid
+  std::vector<float> plain(pixels * 4), first(pixels * 4);
+  cam.setPixelJitter(0.f, 0.f);
+  shade(cam, plain);
+  cam.setPassJitter(0);
+  shade(cam, first);
+  check(plain == first, "pass 0 is jittered");
+
+  // supersampled reference over the pixel footprint [-0.5, 0.5)^2
+  const int grid = 32;
+  std::vector<float> ref(pixels * 4, 0.f), pass(pixels * 4);
+  for (int sy = 0; sy < grid; ++sy)
+    for (int sx = 0; sx < grid; ++sx) {
+      cam.setPixelJitter((sx + 0.5f) / grid - 0.5f, (sy + 0.5f) / grid - 0.5f);
+      shade(cam, pass);
+      for (size_t i = 0; i < ref.size(); ++i) ref[i] += pass[i] / (grid * grid);
+    }
+
+  ProgressiveBuffer accumulation(width, height);
+  double err1 = 0.0, errN = 0.0;
+  for (int p = 0; p < passes; ++p) {
+    cam.setPassJitter(p);
+    shade(cam, pass);
+    accumulation.add(pass.data(), 1.f);
+    if (p == 0) err1 = rms(accumulation.image(), ref);
+  }
+  errN = rms(accumulation.image(), ref);
+
+  std::cout << width << "x" << height << ", rms error against the reference: 1 pass " << err1 << ", " << passes
+            << " passes " << errN << ", " << accumulation.samples(0) << " samples per pixel" << std::endl;
+
+  check(accumulation.samples(pixels - 1) == float(passes), "accumulated sample count");
+  check(errN < err1 * 0.25, "accumulated passes do not converge to the reference");
+
+  return check.status();
+}
@@ -0,0 +1,163 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * sparse: image compositing, sparse tile exchange vs IceT.
+ *
+ * Every rank accumulates contributions over the screen footprint of its domain (a cell of
+ * a near-square grid of ranks, grown by -overlap of its size on each side), then the frame
+ * is composited with IceTComposite and with SparseComposite. Prints the composite time
+ * (max over ranks) and the bytes sent (sum over ranks) per frame, and checks the sparse
+ * result on rank 0 against the sum of every rank's contributions. Simulate 64-1024 ranks on
+ * one node with mpirun --oversubscribe -np 64 ...
+*/
+
+#include <gvt/render/composite/IceTComposite.h>
+#include <gvt/render/composite/SparseComposite.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include <tbb/parallel_for.h>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using namespace gvt::render::composite;
+
+struct Footprint {
+  size_t x0, y0, x1, y1;
+};
+
+static Footprint footprint(int rank, int size, size_t width, size_t height, float overlap) {
+  int gx = std::max(1, (int)std::sqrt((float)size));
+  while (size % gx) gx--;
+  const int gy = size / gx;
+  const float cw = float(width) / gx, ch = float(height) / gy;
+  const int cx = rank % gx, cy = rank / gx;
+  Footprint f;
+  f.x0 = std::max(0.f, (cx - overlap) * cw);
+  f.y0 = std::max(0.f, (cy - overlap) * ch);
+  f.x1 = std::min(float(width), (cx + 1 + overlap) * cw);
+  f.y1 = std::min(float(height), (cy + 1 + overlap) * ch);
+  return f;
+}
+
+// exactly representable so the sparse result can be compared bit for bit
+static glm::vec3 contribution(int rank, size_t x, size_t y) {
+  return glm::vec3(float((rank + x) % 7 + 1), float((rank + y) % 5), float(rank % 3 + 1)) / 256.f;
+}
+
+static void fill(ImageComposite &img, const Footprint &f, int rank) {
+  tbb::parallel_for(f.y0, f.y1, [&](size_t y) {
+    for (size_t x = f.x0; x < f.x1; ++x) img.localAdd(x, y, contribution(rank, x, y), 1.f / 256.f);
+  });
+}
+
+static void run(const std::string &label, ImageComposite &img, const Footprint &f, int rank, int frames) {
+  double total = 0, bytes = 0;
+  for (int frame = 0; frame < frames; ++frame) {
+    img.reset();
+    fill(img, f, rank);
+    MPI_Barrier(MPI_COMM_WORLD);
+    my_timer_t t0, t1;
+    timeCurrent(&t0);
+    img.composite();
+    timeCurrent(&t1);
+    double ms = timeDifferenceMS(&t0, &t1), maxms = 0;
+    double sent = img.bytesSent(), allsent = 0;
+    MPI_Reduce(&ms, &maxms, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&sent, &allsent, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    total += maxms;
+    bytes += allsent;
+  }
+  if (rank == 0)
+    std::cout << label << ": " << total / frames << " ms/frame, " << bytes / frames / (1024 * 1024)
+              << " MB sent/frame" << std::endl;
+}
+
+int sparseCase(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  gvttest::Checks check(argv[0], rank == 0);
+
+  size_t width = 1920, height = 1080;
+  int frames = 5;
+  float overlap = 0.1f;
+  bool icet = true;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-width") && i + 1 < argc) width = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-height") && i + 1 < argc) height = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-frames") && i + 1 < argc) frames = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-overlap") && i + 1 < argc) overlap = std::atof(argv[++i]);
+    else if (!strcmp(argv[i], "-skip-icet")) icet = false;
+  }
+
+  const Footprint f = footprint(rank, size, width, height, overlap);
+  if (rank == 0)
+    std::cout << size << " ranks, " << width << " x " << height << ", full RGBA buffer "
+              << double(width * height * 4 * sizeof(float)) / (1024 * 1024) << " MB" << std::endl;
+
+  if (icet) {
+    IceTComposite img(width, height);
+    run("IceT  ", img, f, rank, frames);
+  }
+
+  unsigned long mismatches = 0;
+  {
+    SparseComposite img(width, height);
+    run("Sparse", img, f, rank, frames);
+
+    if (rank == 0) {
+      std::vector<float> ref(width * height * 4, 0.f);
+      for (int r = 0; r < size; ++r) {
+        const Footprint fr = footprint(r, size, width, height, overlap);
+        for (size_t y = fr.y0; y < fr.y1; ++y)
+          for (size_t x = fr.x0; x < fr.x1; ++x) {
+            const glm::vec3 c = contribution(r, x, y);
+            for (int k = 0; k < 3; ++k) ref[(y * width + x) * 4 + k] += c[k];
+            ref[(y * width + x) * 4 + 3] += 1.f / 256.f;
+          }
+      }
+      const float *rgba = img.colorbf();
+      for (size_t i = 0; i < ref.size(); ++i)
+        if (rgba[i] != ref[i]) mismatches++;
+    }
+  }
+
+  MPI_Bcast(&mismatches, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+  check(!mismatches, "sparse composite differs from the reference in " + std::to_string(mismatches) + " channels");
+  MPI_Finalize();
+  return check.status();
+}
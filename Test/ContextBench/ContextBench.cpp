@@ -0,0 +1,108 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/**
+ * Scene database setup benchmark.
+ *
+ * Builds a scene of N instances of a single mesh through api::addInstance and reports
+ * the setup time in blocks of instances (a flat per-block time means linear setup cost),
+ * followed by the time to read back every instance field the BVH and tracers consume.
+ *
+ * usage: gvtContextBench [-instances N] [-block N]
+*/
+
+#include <gvt/render/api/api.h>
+#include <gvt/render/cntx/rcontext.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "../timer.h"
+
+int main(int argc, char **argv) {
+  size_t ninstances = 100000;
+  size_t block = 10000;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-instances") && i + 1 < argc)
+      ninstances = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-block") && i + 1 < argc)
+      block = atol(argv[++i]);
+    else {
+      std::cerr << "usage: " << argv[0] << " [-instances N] [-block N]" << std::endl;
+      return 1;
+    }
+  }
+  if (block == 0) block = ninstances;
+
+  api::gvtInit(argc, argv);
+
+  // unit cube, two triangles per face
+  const float vertices[] = { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1 };
+  const unsigned triangles[] = { 1, 2, 3, 1, 3, 4, 5, 7, 6, 5, 8, 7, 1, 5, 6, 1, 6, 2,
+                                 2, 6, 7, 2, 7, 3, 3, 7, 8, 3, 8, 4, 4, 8, 5, 4, 5, 1 };
+  api::createMesh("cube");
+  api::addMeshVertices("cube", 8, vertices);
+  api::addMeshTriangles("cube", 12, triangles);
+  api::finishMesh("cube");
+
+  my_timer_t t0, t1, tb;
+  timeCurrent(&t0);
+  tb = t0;
+
+  std::cout << "instances,block_ms,total_ms" << std::endl;
+  for (size_t i = 0; i < ninstances; ++i) {
+    glm::mat4 m = glm::translate(glm::mat4(1.f), glm::vec3(2.f * (i % 100), 2.f * ((i / 100) % 100), 2.f * (i / 10000)));
+    api::addInstance("inst" + std::to_string(i), "cube", glm::value_ptr(m));
+    if ((i + 1) % block == 0 || i + 1 == ninstances) {
+      timeCurrent(&t1);
+      std::cout << (i + 1) << "," << timeDifferenceMS(&tb, &t1) << "," << timeDifferenceMS(&t0, &t1) << std::endl;
+      tb = t1;
+    }
+  }
+  const double setup_ms = timeDifferenceMS(&t0, &tb);
+
+  // what the BVH builder and the tracers do for every instance once the scene is set up
+  cntx::rcontext &db = cntx::rcontext::instance();
+  timeCurrent(&t0);
+  size_t found = 0;
+  for (auto &rn : db.getChildren(db.getUnique("Instances"))) {
+    cntx::node &inst = rn.get();
+    std::shared_ptr<gvt::render::data::primitives::Box3D> bbox = db.getChild(inst, "bbox");
+    std::shared_ptr<glm::mat4> mat = db.getChild(inst, "mat");
+    found += (bbox != nullptr && mat != nullptr);
+  }
+  timeCurrent(&t1);
+
+  std::cout << "setup_ms," << setup_ms << std::endl;
+  std::cout << "lookup_ms," << timeDifferenceMS(&t0, &t1) << "," << found << std::endl;
+
+  MPI_Finalize();
+  return 0;
+}
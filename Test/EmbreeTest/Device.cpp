@@ -0,0 +1,98 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * device: the Embree device shared by the adapters.
+ *
+ * Builds a packet adapter, a stream adapter and a node scene over a one triangle mesh and
+ * checks that they all trace on the same device, that it is created once for all of them and
+ * deleted exactly once, with the last adapter. An adapter built after that gets a new device.
+*/
+
+#include <gvt/render/adapter/embree/EmbreeDevice.h>
+#include <gvt/render/adapter/embree/EmbreeMeshAdapter.h>
+#include <gvt/render/adapter/embree/EmbreeStreamMeshAdapter.h>
+#include <gvt/render/api/api.h>
+#include <gvt/render/data/primitives/Mesh.h>
+
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+
+using gvt::render::adapter::embree::EmbreeDevice;
+using gvt::render::adapter::embree::data::EmbreeMeshAdapter;
+using gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter;
+using gvt::render::data::primitives::Mesh;
+
+int deviceCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  api::gvtInit(argc, argv, 2);
+
+  std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+  mesh->addVertex(glm::vec3(0.f, 0.f, 0.f));
+  mesh->addVertex(glm::vec3(1.f, 0.f, 0.f));
+  mesh->addVertex(glm::vec3(0.f, 1.f, 0.f));
+  mesh->addFace(1, 2, 3);
+
+  check(EmbreeDevice::references() == 0 && EmbreeDevice::created() == 0, "device exists before the first adapter");
+  {
+    std::shared_ptr<EmbreeMeshAdapter> packet = std::make_shared<EmbreeMeshAdapter>(mesh);
+    std::shared_ptr<EmbreeStreamMeshAdapter> stream = std::make_shared<EmbreeStreamMeshAdapter>(mesh);
+    check(packet->getDevice() != nullptr && packet->getDevice() == stream->getDevice(),
+          "packet and stream adapters trace on different devices");
+    check(EmbreeDevice::references() == 2 && EmbreeDevice::created() == 1, "adapters did not share one device");
+
+    const glm::mat4 m(1.f);
+    const glm::mat3 normi(1.f);
+    {
+      // the node scene holds a reference of its own on top of the mesh adapter it instances
+      std::vector<EmbreeMeshAdapter::NodeInstance> instances(1);
+      instances[0].adapter = packet;
+      instances[0].m = &m;
+      instances[0].normi = &normi;
+      EmbreeMeshAdapter node(instances);
+      check(node.getDevice() == packet->getDevice() && EmbreeDevice::references() == 3,
+            "node scene did not share the device");
+    }
+
+    packet.reset();
+    check(EmbreeDevice::references() == 1 && EmbreeDevice::deleted() == 0, "device released while an adapter holds it");
+  }
+  check(EmbreeDevice::references() == 0 && EmbreeDevice::created() == 1 && EmbreeDevice::deleted() == 1,
+        "device not deleted exactly once with the last adapter");
+
+  {
+    EmbreeMeshAdapter again(mesh);
+    check(again.getDevice() != nullptr && EmbreeDevice::created() == 2 && EmbreeDevice::references() == 1,
+          "adapter built after the last release has no new device");
+  }
+  check(EmbreeDevice::references() == 0 && EmbreeDevice::deleted() == 2, "second device not deleted");
+
+  MPI_Finalize();
+  return check.status();
+}
@@ -0,0 +1,110 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * lanes: SIMD lane counters of the Embree adapters.
+ *
+ * Traces known workloads through the packet and the stream adapter, in packet and in wavefront
+ * mode, and checks LaneCounters against them: rays that miss a one triangle mesh and shadow rays
+ * that hit it both finish in one bounce, so N rays have to show up as ceil(N / width) packets,
+ * width lanes issued per packet, N active lanes and no occlusion queries. The width is taken
+ * from the counters and has to be the same for every packet of a run. Queues stay under the
+ * 4096 ray chunk size, so each run is one chunk.
+*/
+
+#include <gvt/render/adapter/embree/EmbreeMeshAdapter.h>
+#include <gvt/render/adapter/embree/EmbreeStreamMeshAdapter.h>
+#include <gvt/render/adapter/embree/LaneCounters.h>
+#include <gvt/render/api/api.h>
+#include <gvt/render/data/primitives/Mesh.h>
+
+#include <memory>
+#include <mpi.h>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+
+using gvt::render::Adapter;
+using gvt::render::actor::Ray;
+using gvt::render::actor::RayVector;
+using gvt::render::adapter::embree::LaneCounters;
+using gvt::render::adapter::embree::data::EmbreeMeshAdapter;
+using gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter;
+using gvt::render::data::primitives::Mesh;
+
+// trace n rays that all finish in their first bounce, and check the counters of that trace
+static void run(gvttest::Checks &check, Adapter &adapter, const std::string &name, size_t n, bool shadow) {
+  RayVector rays, moved;
+  for (size_t i = 0; i < n; ++i) {
+    // shadow rays hit the triangle and are dropped, primary rays pass beside it and leave the mesh
+    const float x = shadow ? 0.25f : 5.f;
+    rays.push_back(Ray(glm::vec3(x, 0.25f, -1.f), glm::vec3(0.f, 0.f, 1.f), 1.f, shadow ? Ray::SHADOW : Ray::PRIMARY, 1));
+  }
+
+  glm::mat4 m(1.f), minv(1.f);
+  glm::mat3 normi(1.f);
+  gvt::core::Vector<std::shared_ptr<gvt::render::data::scene::Light> > lights;
+
+  LaneCounters &lanes = LaneCounters::instance();
+  lanes.reset();
+  adapter.trace(rays, moved, &m, &minv, &normi, lights);
+
+  const std::string what = name + (shadow ? " shadow" : " miss") + " x" + std::to_string(n) + ": ";
+  const size_t packets = lanes.intersect.packets, issued = lanes.intersect.issued, active = lanes.intersect.active;
+  const size_t width = packets ? issued / packets : 0;
+  check(moved.size() == (shadow ? 0 : n), what + std::to_string(moved.size()) + " rays left the mesh");
+  check(width > 0 && issued == packets * width, what + "packets of different widths");
+  check(width > 0 && packets == (n + width - 1) / width, what + std::to_string(packets) + " packets");
+  check(active == n, what + std::to_string(active) + " active lanes");
+  check(lanes.occlude.packets == 0 && lanes.occlude.issued == 0, what + "occlusion queries without lights");
+}
+
+int lanesCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  api::gvtInit(argc, argv, 2);
+
+  std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+  mesh->addVertex(glm::vec3(0.f, 0.f, 0.f));
+  mesh->addVertex(glm::vec3(1.f, 0.f, 0.f));
+  mesh->addVertex(glm::vec3(0.f, 1.f, 0.f));
+  mesh->addFace(1, 2, 3);
+
+  for (bool wavefront : { false, true }) {
+    const std::string mode = wavefront ? " wavefront" : "";
+    EmbreeMeshAdapter packet(mesh, wavefront);
+    EmbreeStreamMeshAdapter stream(mesh, wavefront);
+    // a partial last packet and a whole number of packets
+    for (size_t n : { 1001, 4096 }) {
+      for (bool shadow : { false, true }) {
+        run(check, packet, "packet" + mode, n, shadow);
+        run(check, stream, "stream" + mode, n, shadow);
+      }
+    }
+  }
+
+  MPI_Finalize();
+  return check.status();
+}
@@ -0,0 +1,96 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * shadow: shadow rays stop at their light.
+ *
+ * Traces shadow rays at a one triangle mesh through the packet and the stream adapter, in packet
+ * and in wavefront mode. With the light in front of the triangle (t_max short of it) the triangle
+ * is behind the light and must not shadow the point, so every ray has to leave the mesh. With the
+ * light behind the triangle every ray has to be dropped.
+*/
+
+#include <gvt/render/adapter/embree/EmbreeMeshAdapter.h>
+#include <gvt/render/adapter/embree/EmbreeStreamMeshAdapter.h>
+#include <gvt/render/api/api.h>
+#include <gvt/render/data/primitives/Mesh.h>
+
+#include <memory>
+#include <mpi.h>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+
+using gvt::render::Adapter;
+using gvt::render::actor::Ray;
+using gvt::render::actor::RayVector;
+using gvt::render::adapter::embree::data::EmbreeMeshAdapter;
+using gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter;
+using gvt::render::data::primitives::Mesh;
+
+// trace n shadow rays from z = -1 towards a light at distance t_max, the triangle is at distance 1
+static void run(gvttest::Checks &check, Adapter &adapter, const std::string &name, size_t n, float t_max) {
+  RayVector rays, moved;
+  for (size_t i = 0; i < n; ++i) {
+    Ray r(glm::vec3(0.25f, 0.25f, -1.f), glm::vec3(0.f, 0.f, 1.f), 1.f, Ray::SHADOW, 1);
+    r.mice.t_max = t_max;
+    rays.push_back(r);
+  }
+
+  glm::mat4 m(1.f), minv(1.f);
+  glm::mat3 normi(1.f);
+  gvt::core::Vector<std::shared_ptr<gvt::render::data::scene::Light> > lights;
+  adapter.trace(rays, moved, &m, &minv, &normi, lights);
+
+  const bool lit = t_max < 1.f;
+  const std::string what = name + " light at " + std::to_string(t_max) + " x" + std::to_string(n) + ": ";
+  check(moved.size() == (lit ? n : 0), what + std::to_string(moved.size()) + " rays reached the light");
+}
+
+int shadowCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  api::gvtInit(argc, argv, 2);
+
+  std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+  mesh->addVertex(glm::vec3(0.f, 0.f, 0.f));
+  mesh->addVertex(glm::vec3(1.f, 0.f, 0.f));
+  mesh->addVertex(glm::vec3(0.f, 1.f, 0.f));
+  mesh->addFace(1, 2, 3);
+
+  for (bool wavefront : { false, true }) {
+    const std::string mode = wavefront ? " wavefront" : "";
+    EmbreeMeshAdapter packet(mesh, wavefront);
+    EmbreeStreamMeshAdapter stream(mesh, wavefront);
+    // a partial last packet, the light in front of and behind the triangle
+    for (float t_max : { 0.5f, 2.f }) {
+      run(check, packet, "packet" + mode, 1001, t_max);
+      run(check, stream, "stream" + mode, 1001, t_max);
+    }
+  }
+
+  MPI_Finalize();
+  return check.status();
+}
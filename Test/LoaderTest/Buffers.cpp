@@ -0,0 +1,139 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * buffers: packed mesh storage.
+ *
+ * Builds the same triangulated sphere twice, once through the per vertex / per face Mesh
+ * calls (1 based faces, as api::addMeshTriangles) and once from shared 16 byte stride vertex
+ * and uint32 index arrays (as api::addMeshBuffers), and checks that the packed mesh reads
+ * the caller's arrays in place and yields the same vertices, triangles, bounding box and
+ * vertex normals. Reports the bytes each storage mode keeps besides the caller's arrays.
+*/
+
+#include <gvt/render/data/primitives/Mesh.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using gvt::render::data::primitives::Mesh;
+
+int buffersCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  int slices = 512;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-slices")) slices = std::atoi(argv[++i]);
+  }
+  const int stacks = slices / 2;
+
+  // sphere as a (stacks + 1) x slices vertex grid, the pole rows are left out of the triangles
+  const size_t nverts = size_t(stacks + 1) * slices;
+  std::shared_ptr<float> xyzw(new float[nverts * 4], std::default_delete<float[]>());
+  for (int j = 0; j <= stacks; ++j)
+    for (int i = 0; i < slices; ++i) {
+      const float theta = float(M_PI) * j / stacks, phi = 2.f * float(M_PI) * i / slices;
+      float *v = xyzw.get() + 4 * (size_t(j) * slices + i);
+      v[0] = std::sin(theta) * std::cos(phi);
+      v[1] = std::cos(theta);
+      v[2] = std::sin(theta) * std::sin(phi);
+      v[3] = 0.f;
+    }
+  std::vector<uint32_t> tris;
+  for (int j = 1; j < stacks - 1; ++j)
+    for (int i = 0; i < slices; ++i) {
+      const uint32_t a = j * slices + i, b = j * slices + (i + 1) % slices, c = a + slices, d = b + slices;
+      tris.insert(tris.end(), { a, c, b, b, c, d });
+    }
+  const size_t ntris = tris.size() / 3;
+  std::shared_ptr<uint32_t> indices(new uint32_t[tris.size()], std::default_delete<uint32_t[]>());
+  std::copy(tris.begin(), tris.end(), indices.get());
+
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  Mesh copied;
+  copied.vertices.reserve(nverts);
+  copied.faces.reserve(ntris);
+  for (size_t i = 0; i < nverts; ++i) {
+    const float *v = xyzw.get() + 4 * i;
+    copied.addVertex(glm::vec3(v[0], v[1], v[2]));
+  }
+  for (size_t i = 0; i < ntris; ++i) copied.addFace(tris[3 * i] + 1, tris[3 * i + 1] + 1, tris[3 * i + 2] + 1);
+  copied.computeBoundingBox();
+  copied.generateNormals();
+  timeCurrent(&t1);
+  const double copiedMS = timeDifferenceMS(&t0, &t1);
+
+  timeCurrent(&t0);
+  Mesh shared;
+  shared.setPackedVertices(xyzw, nverts);
+  shared.setPackedTriangles(indices, ntris);
+  shared.computeBoundingBox();
+  shared.generateNormals();
+  timeCurrent(&t1);
+  const double sharedMS = timeDifferenceMS(&t0, &t1);
+
+  check(shared.packed() && shared.packedVertices() == xyzw.get() && shared.packedTriangles() == indices.get() &&
+            shared.vertices.empty() && shared.faces.empty(),
+        "packed mesh copied the caller's arrays");
+  const bool sameSize = check(shared.numVertices() == copied.numVertices() && shared.numFaces() == copied.numFaces(),
+                              "packed mesh has " + std::to_string(shared.numVertices()) + " vertices / " +
+                                  std::to_string(shared.numFaces()) + " triangles, expected " +
+                                  std::to_string(copied.numVertices()) + " / " + std::to_string(copied.numFaces()));
+  size_t mismatches = 0;
+  for (size_t i = 0; sameSize && i < shared.numFaces(); ++i) {
+    if (shared.face(i) != copied.face(i) || shared.faceNormals(i) != copied.faceNormals(i)) mismatches++;
+  }
+  for (size_t i = 0; sameSize && i < shared.numVertices(); ++i) {
+    if (shared.vertex(i) != copied.vertex(i)) mismatches++;
+    // pole vertices belong to no triangle, their normals are undefined in both modes
+    else if (glm::length(copied.normals[i]) == glm::length(copied.normals[i]) &&
+             glm::length(shared.normals[i] - copied.normals[i]) > 1e-6f)
+      mismatches++;
+  }
+  check(!mismatches, std::to_string(mismatches) + " triangles or vertices differ between the storage modes");
+  check(shared.getBoundingBox()->bounds_min == copied.getBoundingBox()->bounds_min &&
+            shared.getBoundingBox()->bounds_max == copied.getBoundingBox()->bounds_max,
+        "bounding boxes differ");
+
+  const auto bytes = [](const Mesh &m) {
+    return m.vertices.capacity() * sizeof(glm::vec3) + m.faces.capacity() * sizeof(Mesh::Face) +
+           m.faces_to_normals.capacity() * sizeof(Mesh::FaceToNormals) +
+           m.face_normals.capacity() * sizeof(glm::vec3) + m.normals.capacity() * sizeof(glm::vec3);
+  };
+  std::cout << nverts << " vertices, " << ntris << " triangles, caller arrays "
+            << (nverts * 4 * sizeof(float) + ntris * 3 * sizeof(uint32_t)) / 1024 << " KB" << std::endl;
+  std::cout << "copied: " << bytes(copied) / 1024 << " KB in the mesh, " << copiedMS << " ms" << std::endl;
+  std::cout << "shared: " << bytes(shared) / 1024 << " KB in the mesh, " << sharedMS << " ms" << std::endl;
+
+  return check.status();
+}
@@ -0,0 +1,233 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * gvtm: .gvtm mesh files.
+ *
+ * Writes a triangulated sphere with vertex normals, vertex colors, a mesh material and per
+ * face materials as .gvtm, maps it back (GvtmReader and ObjReader) and checks the mapped mesh
+ * reads the file in place and has the same vertices, triangles, normals, colors, materials and
+ * bounding box. Does the same for an ascii PLY quad mesh parsed by PlyReader::readMesh, and
+ * checks that truncated or corrupted files are rejected. Reports the PLY parse time against
+ * the .gvtm map time.
+*/
+
+#include <gvt/render/data/reader/GvtmFile.h>
+#include <gvt/render/data/reader/ObjReader.h>
+#include <gvt/render/data/reader/PlyReader.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using namespace gvt::render::data::domain::reader;
+using namespace gvt::render::data::primitives;
+
+static bool sameMaterial(const Material *a, const Material *b) {
+  if (!a || !b) return a == b;
+  return a->type == b->type && a->ka == b->ka && a->ks == b->ks && a->kd == b->kd && a->alpha == b->alpha &&
+         a->eta == b->eta && a->k == b->k && a->roughness == b->roughness;
+}
+
+// number of differences between a mesh and its mapped copy
+static size_t compare(Mesh &orig, Mesh &mapped) {
+  size_t diff = 0;
+  if (orig.numVertices() != mapped.numVertices() || orig.numFaces() != mapped.numFaces()) return 1;
+  for (size_t i = 0; i < orig.numVertices(); ++i) {
+    if (orig.vertex(i) != mapped.vertex(i)) diff++;
+    if (orig.normals.size() && orig.normals[i] != mapped.normals[i] && orig.normals[i] == orig.normals[i]) diff++;
+    if (orig.vertex_colors.size() && orig.vertex_colors[i] != mapped.vertex_colors[i]) diff++;
+  }
+  if (orig.normals.size() != mapped.normals.size() || orig.vertex_colors.size() != mapped.vertex_colors.size()) diff++;
+  for (size_t i = 0; i < orig.numFaces(); ++i) {
+    if (orig.face(i) != mapped.face(i)) diff++;
+    if (orig.faces_to_materials.size() && !sameMaterial(orig.faces_to_materials[i], mapped.faces_to_materials[i]))
+      diff++;
+  }
+  if (orig.faces_to_materials.size() != mapped.faces_to_materials.size()) diff++;
+  if (!sameMaterial(orig.mat, mapped.mat)) diff++;
+  const Box3D box = orig.computeBoundingBox();
+  if (box.bounds_min != mapped.getBoundingBox()->bounds_min || box.bounds_max != mapped.getBoundingBox()->bounds_max)
+    diff++;
+  return diff;
+}
+
+static bool rejects(const std::string &filename) {
+  try {
+    GvtmReader reader(filename);
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+int gvtmCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  int slices = 512;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-slices")) slices = std::atoi(argv[++i]);
+  }
+  const int stacks = slices / 2;
+  const std::string base = std::string(P_tmpdir) + "/gvtLoaderTest-gvtm" + std::to_string(getpid());
+
+  // sphere as a (stacks + 1) x slices vertex grid, the pole rows are left out of the faces
+  std::vector<glm::vec3> grid;
+  for (int j = 0; j <= stacks; ++j)
+    for (int i = 0; i < slices; ++i) {
+      const float theta = float(M_PI) * j / stacks, phi = 2.f * float(M_PI) * i / slices;
+      grid.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+    }
+  const auto quad = [&](int j, int i, int k) {
+    const int a = j * slices + i, b = j * slices + (i + 1) % slices, c = a + slices, d = b + slices;
+    const int q[4] = { a, c, d, b };
+    return q[k];
+  };
+
+  // default storage mesh with everything the format carries
+  Material *red = new Material, *blue = new Material;
+  red->kd = glm::vec3(1.f, 0.f, 0.f);
+  blue->kd = glm::vec3(0.f, 0.f, 1.f);
+  blue->type = PHONG;
+  blue->alpha = 20.f;
+  Mesh sphere(new Material);
+  sphere.mat->type = BLINN;
+  sphere.materials = { red, blue };
+  for (const glm::vec3 &v : grid) {
+    sphere.vertices.push_back(v);
+    sphere.vertex_colors.push_back(glm::abs(v));
+  }
+  for (int j = 1; j < stacks - 1; ++j)
+    for (int i = 0; i < slices; ++i) {
+      sphere.faces.push_back(Mesh::Face(quad(j, i, 0), quad(j, i, 1), quad(j, i, 3)));
+      sphere.faces.push_back(Mesh::Face(quad(j, i, 3), quad(j, i, 1), quad(j, i, 2)));
+      sphere.faces_to_materials.push_back(i % 2 ? red : blue);
+      sphere.faces_to_materials.push_back(i % 3 ? nullptr : red);
+    }
+  sphere.generateNormals();
+
+  const std::string sphereFile = base + "_sphere.gvtm";
+  GvtmWriter::write(sphereFile, sphere);
+  {
+    GvtmReader reader(sphereFile);
+    std::shared_ptr<Mesh> mapped = reader.getMesh();
+    check(mapped->packed() && mapped->haveNormals && mapped->materials.size() == 2 && mapped->mat,
+          "mapped mesh is not packed or lost its normals or materials");
+    const size_t diff = compare(sphere, *mapped);
+    check(!diff, std::to_string(diff) + " differences between the sphere and its .gvtm file");
+    ObjReader obj(sphereFile);
+    std::unique_ptr<Mesh> viaObj(obj.getMesh());
+    check(viaObj->packed() && !compare(sphere, *viaObj), "ObjReader does not map .gvtm files");
+  }
+
+  // ascii PLY of the sphere as colored quads, readMesh fan triangulates them
+  const std::string plyFile = base + ".ply";
+  {
+    std::ofstream ply(plyFile.c_str());
+    const size_t nquads = size_t(stacks - 2) * slices;
+    ply << "ply\nformat ascii 1.0\nelement vertex " << grid.size()
+        << "\nproperty float x\nproperty float y\nproperty float z\n"
+        << "property uchar red\nproperty uchar green\nproperty uchar blue\nelement face " << nquads
+        << "\nproperty list uchar int vertex_indices\nend_header\n";
+    for (const glm::vec3 &v : grid)
+      ply << v.x << " " << v.y << " " << v.z << " 255 128 0\n";
+    for (int j = 1; j < stacks - 1; ++j)
+      for (int i = 0; i < slices; ++i)
+        ply << "4 " << quad(j, i, 0) << " " << quad(j, i, 1) << " " << quad(j, i, 2) << " " << quad(j, i, 3) << "\n";
+  }
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  std::shared_ptr<Mesh> parsed = PlyReader::readMesh(plyFile);
+  parsed->generateNormals();
+  parsed->computeBoundingBox();
+  timeCurrent(&t1);
+  const double parseMS = timeDifferenceMS(&t0, &t1);
+
+  size_t plyDiff = parsed->numVertices() != grid.size() || parsed->numFaces() != sphere.numFaces();
+  for (size_t i = 0; !plyDiff && i < grid.size(); ++i)
+    if (glm::length(parsed->vertex(i) - grid[i]) > 1e-5f ||
+        glm::length(parsed->vertex_colors[i] - glm::vec3(1.f, 128.f / 255.f, 0.f)) > 1e-6f)
+      plyDiff++;
+  for (size_t q = 0; !plyDiff && q < parsed->numFaces() / 2; ++q) {
+    const int j = 1 + q / slices, i = q % slices;
+    if (parsed->face(2 * q) != Mesh::Face(quad(j, i, 0), quad(j, i, 1), quad(j, i, 2)) ||
+        parsed->face(2 * q + 1) != Mesh::Face(quad(j, i, 0), quad(j, i, 2), quad(j, i, 3)))
+      plyDiff++;
+  }
+  check(!plyDiff, "PlyReader::readMesh vertices, colors or triangles differ from the PLY file");
+
+  const std::string plyGvtm = base + "_ply.gvtm";
+  GvtmWriter::write(plyGvtm, *parsed);
+  timeCurrent(&t0);
+  GvtmReader mappedPly(plyGvtm);
+  timeCurrent(&t1);
+  const double mapMS = timeDifferenceMS(&t0, &t1);
+  check(!compare(*parsed, *mappedPly.getMesh()), "PLY mesh differs from its .gvtm file");
+
+  // malformed files
+  std::string bytes;
+  {
+    std::ifstream in(sphereFile.c_str(), std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  const std::string bad = base + "_bad.gvtm";
+  const auto writeBad = [&](const std::string &content) {
+    std::ofstream out(bad.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(content.data(), content.size());
+  };
+  GvtmHeader header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  writeBad(bytes.substr(0, bytes.size() / 2));
+  const bool truncated = rejects(bad);
+  std::string corrupt = bytes;
+  const uint32_t outOfRange = uint32_t(header.nvertices);
+  std::memcpy(&corrupt[header.triangles + 4 * sizeof(uint32_t)], &outOfRange, sizeof(outOfRange));
+  writeBad(corrupt);
+  const bool badIndex = rejects(bad);
+  corrupt = bytes;
+  corrupt[0] = 'X';
+  writeBad(corrupt);
+  const bool badMagic = rejects(bad);
+  check(truncated && badIndex && badMagic, "malformed .gvtm file accepted");
+
+  std::cout << sphere.numVertices() << " vertices, " << sphere.numFaces() << " triangles, .gvtm file "
+            << bytes.size() / 1024 << " KB" << std::endl;
+  std::cout << "ply parse: " << parseMS << " ms, gvtm map: " << mapMS << " ms" << std::endl;
+
+  for (const std::string &f : { sphereFile, plyFile, plyGvtm, bad }) std::remove(f.c_str());
+  return check.status();
+}
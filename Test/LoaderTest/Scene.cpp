@@ -0,0 +1,229 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * scene: parallel multi-file scene loading.
+ *
+ * Checks the size balanced file to rank assignment on a skewed set of file sizes against the
+ * longest processing time bound and reports its imbalance next to round robin. Then rank 0
+ * writes a directory of sphere meshes of very different sizes (PLY and .gvtm) and every rank
+ * loads it with SceneLoader: each rank must hold exactly the meshes assigned to it, and after
+ * the batched sync every rank must see every mesh with its bounding box and owner and one
+ * instance per mesh. Reports the stage timings and the parse time of the same files read one
+ * after the other.
+*/
+
+#include <gvt/render/cntx/rcontext.h>
+#include <gvt/render/data/reader/GvtmFile.h>
+#include <gvt/render/data/reader/SceneLoader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using namespace gvt::render::data::domain::reader;
+using namespace gvt::render::data::primitives;
+
+// sphere of radius r around c as a packed mesh, the vertex grid holds the poles
+static std::shared_ptr<Mesh> sphere(int slices, const glm::vec3 &c, float r) {
+  const int stacks = slices / 2;
+  const size_t nverts = size_t(stacks + 1) * slices;
+  std::shared_ptr<float> xyzw(new float[nverts * 4], std::default_delete<float[]>());
+  for (int j = 0; j <= stacks; ++j)
+    for (int i = 0; i < slices; ++i) {
+      const float theta = float(M_PI) * j / stacks, phi = 2.f * float(M_PI) * i / slices;
+      float *v = xyzw.get() + 4 * (size_t(j) * slices + i);
+      v[0] = c.x + r * std::sin(theta) * std::cos(phi);
+      v[1] = c.y + r * std::cos(theta);
+      v[2] = c.z + r * std::sin(theta) * std::sin(phi);
+      v[3] = 0.f;
+    }
+  std::vector<uint32_t> tris;
+  for (int j = 0; j < stacks; ++j)
+    for (int i = 0; i < slices; ++i) {
+      const uint32_t a = j * slices + i, b = j * slices + (i + 1) % slices, cc = a + slices, d = b + slices;
+      if (j > 0) tris.insert(tris.end(), { a, cc, b });
+      if (j < stacks - 1) tris.insert(tris.end(), { b, cc, d });
+    }
+  std::shared_ptr<uint32_t> idx(new uint32_t[tris.size()], std::default_delete<uint32_t[]>());
+  std::copy(tris.begin(), tris.end(), idx.get());
+  std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(new Material);
+  mesh->setPackedVertices(xyzw, nverts);
+  mesh->setPackedTriangles(idx, tris.size() / 3);
+  return mesh;
+}
+
+static void writePly(const std::string &filename, const Mesh &mesh) {
+  std::ofstream ply(filename.c_str());
+  ply.precision(9);
+  ply << "ply\nformat ascii 1.0\nelement vertex " << mesh.numVertices()
+      << "\nproperty float x\nproperty float y\nproperty float z\nelement face " << mesh.numFaces()
+      << "\nproperty list uchar int vertex_indices\nend_header\n";
+  for (size_t i = 0; i < mesh.numVertices(); ++i) {
+    const glm::vec3 v = mesh.vertex(i);
+    ply << v.x << " " << v.y << " " << v.z << "\n";
+  }
+  for (size_t i = 0; i < mesh.numFaces(); ++i) {
+    const Mesh::Face f = mesh.face(i);
+    ply << "3 " << std::get<0>(f) << " " << std::get<1>(f) << " " << std::get<2>(f) << "\n";
+  }
+}
+
+static void checkAssign(gvttest::Checks &check) {
+  // heavy tailed sizes, a few files dominate as in isosurface sets
+  std::mt19937 gen(3);
+  std::lognormal_distribution<double> dist(14.0, 1.5);
+  const int nranks = 64;
+  std::vector<uint64_t> sizes(2000);
+  for (auto &s : sizes) s = uint64_t(dist(gen));
+
+  const std::vector<int> owners = SceneLoader::assign(sizes, nranks);
+  std::vector<uint64_t> lpt(nranks, 0), rr(nranks, 0);
+  bool ok = owners.size() == sizes.size();
+  for (size_t i = 0; ok && i < sizes.size(); ++i) {
+    ok = owners[i] >= 0 && owners[i] < nranks;
+    if (ok) lpt[owners[i]] += sizes[i] + 1;
+    rr[i % nranks] += sizes[i] + 1;
+  }
+  if (!check(ok, "file assigned to an invalid rank")) return;
+  uint64_t total = 0, largest = 0;
+  for (uint64_t s : sizes) {
+    total += s + 1;
+    largest = std::max(largest, s + 1);
+  }
+  const double avg = double(total) / nranks, bound = std::max(avg, double(largest));
+  const double lptMax = *std::max_element(lpt.begin(), lpt.end()), rrMax = *std::max_element(rr.begin(), rr.end());
+  std::cout << sizes.size() << " files on " << nranks << " ranks, max / mean bytes per rank: size balanced "
+            << lptMax / avg << ", round robin " << rrMax / avg << std::endl;
+  check(lptMax <= 4.0 / 3.0 * bound, "size balanced assignment exceeds the LPT bound");
+  check(SceneLoader::assign(sizes, nranks) == owners, "assignment is not deterministic");
+}
+
+int sceneCase(int argc, char **argv) {
+  int nfiles = 24, slices = 256;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-files")) nfiles = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-slices")) slices = std::atoi(argv[++i]);
+  }
+
+  MPI_Init(&argc, &argv);
+  cntx::rcontext &db = cntx::rcontext::instance();
+  const int rank = db.cntx_comm.rank;
+  gvttest::Checks check(argv[0]);
+
+  if (rank == 0) checkAssign(check);
+
+  // the dataset: sizes from slices / 8 up to slices, every third one converted to .gvtm
+  int pid = getpid();
+  MPI_Bcast(&pid, 1, MPI_INT, 0, db.cntx_comm.comm);
+  const std::string dir = std::string(P_tmpdir) + "/gvtLoaderTest-scene" + std::to_string(pid);
+  std::vector<std::string> files;
+  std::vector<Box3D> boxes;
+  for (int i = 0; i < nfiles; ++i) {
+    const int s = std::max(8, slices / 8 + (slices - slices / 8) * ((i * 7) % nfiles) / nfiles);
+    const glm::vec3 c(3.f * i, 0.f, 0.f);
+    const float r = 1.f + i % 3;
+    files.push_back(dir + "/part" + std::to_string(i) + (i % 3 ? ".ply" : ".gvtm"));
+    std::shared_ptr<Mesh> mesh = sphere(s, c, r);
+    boxes.push_back(mesh->computeBoundingBox());
+    if (rank != 0) continue;
+    if (i == 0) mkdir(dir.c_str(), 0755);
+    if (i % 3)
+      writePly(files.back(), *mesh);
+    else
+      GvtmWriter::write(files.back(), *mesh);
+  }
+  MPI_Barrier(db.cntx_comm.comm);
+
+  SceneLoader loader(files, true, "part");
+  loader.load(true);
+  const std::vector<int> &owners = loader.getOwners();
+
+  // this rank holds exactly its files
+  size_t mine = 0;
+  for (int i = 0; i < nfiles; ++i) mine += owners[i] == rank;
+  bool local = mine == loader.getMeshes().size() && mine == loader.getMeshNames().size();
+  for (size_t i = 0; local && i < loader.getMeshNames().size(); ++i) {
+    const int f = std::atoi(loader.getMeshNames()[i].c_str() + 4);
+    local = owners[f] == rank && loader.getMeshes()[i]->haveNormals && loader.getMeshes()[i]->packed();
+  }
+  check(local, "rank " + std::to_string(rank) + " does not hold exactly its assigned meshes");
+
+  // after the sync every rank sees every mesh, its owner and its instance
+  size_t bad = 0;
+  for (int i = 0; i < nfiles; ++i) {
+    const std::string name = "part" + std::to_string(i);
+    cntx::node &meshnode = db.getUnique(name);
+    cntx::node &inode = db.getUnique(name + "_inst");
+    if (&meshnode == &cntx::node::error_node || &inode == &cntx::node::error_node) {
+      bad++;
+      continue;
+    }
+    std::shared_ptr<Box3D> box = db.getChild(meshnode, "bbox");
+    std::shared_ptr<std::vector<int> > loc = db.getChild(meshnode, "Locations");
+    const gvt::render::data::primitives::Box3D &e = boxes[i];
+    if (glm::length(box->bounds_min - e.bounds_min) > 1e-4f || glm::length(box->bounds_max - e.bounds_max) > 1e-4f ||
+        loc->size() != 1 || (*loc)[0] != owners[i] || !(db.getChild(inode, "meshRef").to<cntx::identifier>() == meshnode.getid()))
+      bad++;
+  }
+  check(!bad, "rank " + std::to_string(rank) + " sees " + std::to_string(bad) + " missing or wrong meshes or instances");
+
+  // the same files read one after the other
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  for (int i = 0; i < nfiles; ++i)
+    if (owners[i] == rank) SceneLoader::read(files[i])->generateNormals();
+  timeCurrent(&t1);
+  double serial = timeDifferenceMS(&t0, &t1), slowest = 0;
+  MPI_Reduce(&serial, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, db.cntx_comm.comm);
+  if (rank == 0)
+    std::cout << "parse + finish: " << loader.getTimings().parse + loader.getTimings().finish
+              << " ms on the TBB workers, " << slowest << " ms one file at a time" << std::endl;
+
+  MPI_Barrier(db.cntx_comm.comm);
+  if (rank == 0) {
+    for (const std::string &f : files) std::remove(f.c_str());
+    rmdir(dir.c_str());
+  }
+
+  int lok = check.ok(), gok = 0;
+  MPI_Allreduce(&lok, &gok, 1, MPI_INT, MPI_MIN, db.cntx_comm.comm);
+  MPI_Finalize();
+  return gok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,196 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * Node scene routing test.
+ *
+ * Scatters small instance boxes in a cube and marks the half with the lower x as resident
+ * on the node (BVH::setLocal), as a domain run would before tracing them in one node scene.
+ * Rays that leave the node scene are routed from BVH::LOCAL: they must reach the nearest
+ * instance that is not local and never a local one, while camera rays (from -1) still see
+ * every instance. Both are checked against a brute force box test. Reports the instance
+ * boxes a ray that misses all geometry enters, i.e. the scheduler round trips it costs
+ * when the local instances are traced one queue at a time instead of in one node scene.
+ * Also checks that a node scene does not return a local hit behind a remote instance.
+ * See checks.h.
+ *
+ * usage: gvtNodeSceneTest [-instances N] [-rays N]
+*/
+
+#include <gvt/render/actor/RayStream.h>
+#include <gvt/render/data/accel/BVH.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using namespace gvt::render::actor;
+using namespace gvt::render::data::accel;
+using namespace gvt::render::data::primitives;
+
+// Three instances along x, the middle one remote. Each holds a wall across the middle of its box, the wall of
+// the first one only reaches up to y = 0.25. The node scene trace (the nearest local wall short of BVH::clip)
+// must not return the wall of the last instance to a ray that passes above the first wall: the remote wall is
+// in front of it. The ray has to come back and be routed to the remote instance instead.
+static void closestHit(gvttest::Checks &check) {
+  gvt::core::Vector<Box3D> boxes;
+  for (int i = 0; i < 3; ++i) boxes.push_back(Box3D(glm::vec3(2.f * i, 0.f, 0.f), glm::vec3(2.f * i + 1.f, 1.f, 1.f)));
+  const float top[] = { 0.25f, 1.f, 1.f };
+  BVH bvh(boxes);
+  bvh.setLocal({ 0, 2 });
+
+  for (float y : { 0.1f, 0.5f }) {
+    Ray ray(glm::vec3(-1.f, y, 0.5f), glm::vec3(1.f, 0.f, 0.f));
+    const auto wall = [&](int i) { return y <= top[i] ? 2.f * i + 0.5f - ray.mice.origin.x : FLT_MAX; };
+    const int closest = (y <= top[0]) ? 0 : 1;
+
+    float tfar;
+    bvh.clip<GVT_SIMD_WIDTH>(&ray, &ray + 1, &tfar);
+    float t = FLT_MAX;
+    int hit = -1;
+    for (int i : { 0, 2 })
+      if (wall(i) < std::min(t, tfar)) {
+        t = wall(i);
+        hit = i;
+      }
+    if (hit == -1) {
+      // no local hit before the remote box, the scheduler routes the ray from BVH::LOCAL
+      gvt::core::Vector<BVH::hit> next = bvh.intersect<GVT_SIMD_WIDTH>(&ray, &ray + 1, BVH::LOCAL);
+      hit = next[0].next;
+    }
+
+    const std::string what = "ray at y = " + std::to_string(y) + ": ";
+    check(tfar == 3.f, what + "clipped at " + std::to_string(tfar) + " instead of the remote box");
+    check(hit == closest, what + "hit instance " + std::to_string(hit) + " instead of " + std::to_string(closest));
+  }
+}
+
+int main(int argc, char **argv) {
+  gvttest::Checks check("gvtNodeSceneTest");
+  closestHit(check);
+
+  size_t ninstances = 2000;
+  size_t nrays = 20000;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-instances")) ninstances = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-rays")) nrays = std::atoi(argv[++i]);
+  }
+
+  std::mt19937 gen(11);
+  const float side = 10.f * std::cbrt(float(ninstances));
+  std::uniform_real_distribution<float> pos(0.f, side);
+  std::uniform_real_distribution<float> size(0.5f, 4.f);
+  gvt::core::Vector<Box3D> boxes;
+  Box3D scene;
+  for (size_t i = 0; i < ninstances; ++i) {
+    const glm::vec3 c(pos(gen), pos(gen), pos(gen)), h(size(gen), size(gen), size(gen));
+    boxes.push_back(Box3D(c - h, c + h));
+    if (i == 0) scene = boxes.back();
+    scene.merge(boxes.back());
+  }
+
+  gvt::core::Vector<int> local;
+  std::vector<char> isLocal(ninstances, 0);
+  for (size_t i = 0; i < ninstances; ++i)
+    if (boxes[i].centroid().x < side * 0.5f) {
+      local.push_back(i);
+      isLocal[i] = 1;
+    }
+
+  BVH bvh(boxes);
+  bvh.setLocal(local);
+
+  // rays from a sphere around the scene towards points inside it, every origin is outside every box
+  std::uniform_real_distribution<float> uni(-1.f, 1.f), in(0.f, 1.f);
+  const glm::vec3 center = scene.centroid(), extent = scene.bounds_max - scene.bounds_min;
+  const float radius = glm::length(extent);
+  RayStream rays;
+  rays.resize(nrays);
+  for (size_t i = 0; i < nrays; ++i) {
+    const glm::vec3 eye = center + radius * glm::normalize(glm::vec3(uni(gen), uni(gen), uni(gen)));
+    const glm::vec3 target = scene.bounds_min + glm::vec3(in(gen), in(gen), in(gen)) * extent;
+    rays.setOrigin(i, eye);
+    rays.setDirection(i, glm::normalize(target - eye));
+    rays.t_min[i] = Ray::RAY_EPSILON;
+    rays.t_max[i] = FLT_MAX;
+    rays.id[i] = i;
+  }
+
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  gvt::core::Vector<BVH::hit> leaving = bvh.intersect<GVT_SIMD_WIDTH>(rays, 0, nrays, BVH::LOCAL);
+  timeCurrent(&t1);
+  gvt::core::Vector<BVH::hit> camera = bvh.intersect<GVT_SIMD_WIDTH>(rays, 0, nrays, -1);
+
+  size_t localHits = 0, mismatches = 0, routed = 0, entered = 0, crossing = 0;
+  for (size_t r = 0; r < nrays; ++r) {
+    Ray ray;
+    rays.get(r, ray);
+    const glm::vec3 inv = 1.f / ray.mice.direction;
+    float nearest = FLT_MAX, nearestRemote = FLT_MAX;
+    size_t enters = 0;
+    for (size_t i = 0; i < ninstances; ++i) {
+      float t;
+      if (!boxes[i].intersectDistance(ray.mice.origin, inv, t)) continue;
+      nearest = std::min(nearest, t);
+      if (isLocal[i])
+        enters++;
+      else
+        nearestRemote = std::min(nearestRemote, t);
+    }
+    if (enters) {
+      entered += enters;
+      crossing++;
+    }
+
+    // overlapping boxes may tie, compare the entry distances
+    const auto same = [](const BVH::hit &h, float t) {
+      if (t == FLT_MAX) return h.next == -1;
+      return h.next != -1 && std::fabs(h.t - t) <= 1e-4f * std::max(1.f, t);
+    };
+    if (leaving[r].next != -1 && isLocal[leaving[r].next]) localHits++;
+    if (!same(leaving[r], nearestRemote) || !same(camera[r], nearest)) mismatches++;
+    routed += (leaving[r].next != -1);
+  }
+
+  std::cout << ninstances << " instances, " << local.size() << " local, " << nrays << " rays, " << routed
+            << " leave the node scene towards a remote instance, " << mismatches << " mismatches" << std::endl;
+  std::cout << "rays crossing local instances: " << crossing << ", local boxes entered per ray: "
+            << (crossing ? double(entered) / crossing : 0.0) << " (round trips per instance, 1 with the node scene)"
+            << std::endl;
+  std::cout << "routing from the node scene: " << (nrays / (timeDifferenceMS(&t0, &t1) * 1e-3)) * 1e-6 << " Mrays/s"
+            << std::endl;
+  check(!localHits, std::to_string(localHits) + " rays leaving the node scene were routed to a local instance");
+  check(!mismatches, "BVH routing differs from the brute force box test");
+  check(!local.empty() && local.size() != ninstances && routed != 0, "degenerate test scene");
+
+  return check.status();
+}
@@ -0,0 +1,168 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * Object space ray transform test.
+ *
+ * Moves structure-of-arrays rays into the object space of a translated, rotated and non
+ * uniformly scaled instance with the Embree adapters' ObjectSpace pre-pass and checks it
+ * against glm (out of place, in place and the identity copy). Then intersects every ray
+ * with an instanced triangle both ways, the world space ray against the transformed
+ * triangle and the object space ray against the mesh triangle, as the adapters now do
+ * instead of building Embree instances: hits, hit distances and normals (object space
+ * normal through normi) must agree. Reports the transform throughput. See checks.h.
+ *
+ * usage: gvtObjectSpaceTest [-rays N] [-rounds N]
+*/
+
+#include <gvt/render/adapter/embree/ObjectSpace.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using gvt::render::adapter::embree::ObjectSpace;
+
+// Moller-Trumbore, returns the hit distance along d (not normalized) or -1
+static float intersect(const glm::vec3 &o, const glm::vec3 &d, const glm::vec3 &a, const glm::vec3 &b,
+                       const glm::vec3 &c, glm::vec3 &Ng) {
+  const glm::vec3 e1 = b - a, e2 = c - a, p = glm::cross(d, e2);
+  const float det = glm::dot(e1, p);
+  if (std::fabs(det) < 1e-12f) return -1.f;
+  const glm::vec3 s = o - a, q = glm::cross(s, e1);
+  const float u = glm::dot(s, p) / det, v = glm::dot(d, q) / det;
+  if (u < 0.f || v < 0.f || u + v > 1.f) return -1.f;
+  Ng = glm::cross(e1, e2);
+  return glm::dot(e2, q) / det;
+}
+
+static bool close(float a, float b, float tol) { return std::fabs(a - b) <= tol * std::max(1.f, std::fabs(b)); }
+
+int main(int argc, char **argv) {
+  gvttest::Checks check("gvtObjectSpaceTest");
+  size_t nrays = 100003; // not a multiple of the SIMD width
+  int rounds = 100;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-rays")) nrays = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-rounds")) rounds = std::atoi(argv[++i]);
+  }
+
+  glm::mat4 m = glm::translate(glm::mat4(1.f), glm::vec3(3.f, -1.f, 2.f));
+  m = glm::rotate(m, 0.7f, glm::normalize(glm::vec3(1.f, 2.f, 0.5f)));
+  m = glm::scale(m, glm::vec3(2.f, 0.5f, 1.5f));
+  const glm::mat4 minv = glm::inverse(m);
+  const glm::mat3 normi = glm::transpose(glm::inverse(glm::mat3(m)));
+
+  // object space triangle and its world space instance
+  const glm::vec3 a(-1.f, -1.f, 0.f), b(1.f, -1.f, 0.2f), c(0.f, 1.f, -0.2f);
+  const glm::vec3 wa(m * glm::vec4(a, 1.f)), wb(m * glm::vec4(b, 1.f)), wc(m * glm::vec4(c, 1.f));
+  const glm::vec3 center = (wa + wb + wc) / 3.f;
+
+  // rays from a shell around the instance towards jittered points near it
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> uni(-1.f, 1.f);
+  std::vector<float> w[6], o[6];
+  for (int k = 0; k < 6; ++k) {
+    w[k].resize(nrays);
+    o[k].resize(nrays);
+  }
+  for (size_t i = 0; i < nrays; ++i) {
+    const glm::vec3 from = center + 8.f * glm::normalize(glm::vec3(uni(rng), uni(rng), uni(rng)));
+    const glm::vec3 to = center + 1.5f * glm::vec3(uni(rng), uni(rng), uni(rng));
+    const glm::vec3 dir = glm::normalize(to - from);
+    for (int k = 0; k < 3; ++k) {
+      w[k][i] = from[k];
+      w[3 + k][i] = dir[k];
+    }
+  }
+
+  const ObjectSpace toObject(minv);
+  toObject(w[0].data(), w[1].data(), w[2].data(), w[3].data(), w[4].data(), w[5].data(), o[0].data(), o[1].data(),
+           o[2].data(), o[3].data(), o[4].data(), o[5].data(), nrays);
+
+  size_t mismatches = 0, hits = 0, disagree = 0;
+  double maxdt = 0.0;
+  for (size_t i = 0; i < nrays; ++i) {
+    const glm::vec3 wo(w[0][i], w[1][i], w[2][i]), wd(w[3][i], w[4][i], w[5][i]);
+    const glm::vec3 eo(minv * glm::vec4(wo, 1.f)), ed(minv * glm::vec4(wd, 0.f));
+    const glm::vec3 oo(o[0][i], o[1][i], o[2][i]), od(o[3][i], o[4][i], o[5][i]);
+    for (int k = 0; k < 3; ++k)
+      if (!close(oo[k], eo[k], 1e-5f) || !close(od[k], ed[k], 1e-5f)) mismatches++;
+
+    glm::vec3 Nw, No;
+    const float tw = intersect(wo, wd, wa, wb, wc, Nw);
+    const float to = intersect(oo, od, a, b, c, No);
+    if ((tw > 0.f) != (to > 0.f)) {
+      // rays grazing an edge may fall on either side
+      disagree++;
+      continue;
+    }
+    if (tw <= 0.f) continue;
+    hits++;
+    maxdt = std::max(maxdt, double(std::fabs(tw - to)));
+    const glm::vec3 nw = glm::normalize(Nw), no = glm::normalize(normi * No);
+    if (!close(tw, to, 1e-4f) || glm::dot(nw, no) < 0.9999f) mismatches++;
+  }
+
+  std::cout << nrays << " rays, " << hits << " hit the instance, max hit distance difference " << maxdt << ", "
+            << disagree << " edge disagreements, " << mismatches << " mismatches" << std::endl;
+  check(!mismatches, "object space rays differ from glm or from the world space intersection");
+  check(hits >= nrays / 10 && disagree <= nrays / 1000, "the world and object space intersections do not agree");
+
+  // in place gives the same result
+  std::vector<float> p[6];
+  for (int k = 0; k < 6; ++k) p[k] = w[k];
+  toObject(p[0].data(), p[1].data(), p[2].data(), p[3].data(), p[4].data(), p[5].data(), nrays);
+  bool same = true;
+  for (int k = 0; k < 6; ++k) same = same && p[k] == o[k];
+  check(same, "in place transform differs");
+
+  // identity instances are copied untouched
+  const ObjectSpace identity(glm::mat4(1.f));
+  identity(w[0].data(), w[1].data(), w[2].data(), w[3].data(), w[4].data(), w[5].data(), p[0].data(), p[1].data(),
+           p[2].data(), p[3].data(), p[4].data(), p[5].data(), nrays);
+  same = identity.isIdentity();
+  for (int k = 0; k < 6; ++k) same = same && p[k] == w[k];
+  check(same, "identity transform changed the rays");
+
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  for (int r = 0; r < rounds; ++r)
+    toObject(w[0].data(), w[1].data(), w[2].data(), w[3].data(), w[4].data(), w[5].data(), o[0].data(), o[1].data(),
+             o[2].data(), o[3].data(), o[4].data(), o[5].data(), nrays);
+  timeCurrent(&t1);
+  const double ms = timeDifferenceMS(&t0, &t1);
+  std::cout << "transform: " << (double(nrays) * rounds) / (ms * 1e3) << " Mrays/s" << std::endl;
+
+  return check.status();
+}
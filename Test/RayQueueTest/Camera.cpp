@@ -0,0 +1,290 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * camera: primary ray generation.
+ *
+ * Fills the camera ray stream (or the ray vector with -rays) for a width x height film at samples x samples
+ * per pixel, once with the row by row scalar generator the camera used before and once with the tiled
+ * generator. Reports the time of both and checks that the tiled output holds every pixel's samples
+ * exactly once, back to back, with tiles in Morton order and directions matching the row generator.
+ * The stream is then generated again in waves of at most -wave rays (whole tiles), which must add up to the
+ * same frame while only ever holding one wave. The defaults are a 4K film at 16 spp, about 8.5GB of rays
+ * for the full frame and 256MB per wave.
+*/
+
+#include <gvt/render/actor/Ray.h>
+#include <gvt/render/actor/RayStream.h>
+#include <gvt/render/data/scene/gvtCamera.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using namespace gvt::render::actor;
+using namespace gvt::render::data::scene;
+
+static const float FOV = 25.f * M_PI / 180.f;
+
+/** World space direction of sample (k, w) of pixel (i, j), as both generators compute it */
+struct SampleDirection {
+  const gvtPerspectiveCamera &cam;
+  float vert, horz, offset, half_sample, wmult, hmult;
+
+  SampleDirection(const gvtPerspectiveCamera &cam) : cam(cam) {
+    const int width = cam.filmsize[0], height = cam.filmsize[1];
+    vert = tanf(FOV * 0.5);
+    horz = tanf(FOV * 0.5) * float(width) / float(height);
+    offset = (1.0 / float(cam.samples)) * cam.jitterWindowSize;
+    half_sample = cam.samples * 0.5f;
+    wmult = 2.f / float(width - 1);
+    hmult = 2.f / float(height - 1);
+  }
+
+  glm::vec3 operator()(int i, int j, int k, int w) const {
+    const float x = ((float(i) * wmult - 1.0) + (w - half_sample) * offset) * horz;
+    const float y = ((float(j) * hmult - 1.0) + (k - half_sample) * offset) * vert;
+    const glm::mat4 &m = cam.cam2wrld;
+    return glm::normalize(glm::vec3(m[0][0] * x + m[0][1] * y + m[0][2], m[1][0] * x + m[1][1] * y + m[1][2],
+                                    m[2][0] * x + m[2][1] * y + m[2][2]));
+  }
+};
+
+/** The generator before tiling: rows in chunks of at least 4096, scalar normalize per sample, pixel order */
+static void generateRows(gvtPerspectiveCamera &cam, size_t threads, bool aos) {
+  const int width = cam.filmsize[0], height = cam.filmsize[1];
+  const size_t samples2 = cam.samples * cam.samples;
+  const size_t nrays = size_t(width) * height * samples2;
+  const size_t chunksize = std::max<size_t>(4096, nrays / (threads * 4));
+  const SampleDirection sampleDirection(cam);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, height, chunksize), [&](const tbb::blocked_range<size_t> &chunk) {
+    for (size_t j = chunk.begin(); j < chunk.end(); j++) {
+      for (int i = 0; i < width; i++) {
+        const int idx = j * width + i;
+        for (int k = 0; k < cam.samples; k++)
+          for (int w = 0; w < cam.samples; w++) {
+            const size_t ridx = idx * samples2 + k * cam.samples + w;
+            const glm::vec3 d = sampleDirection(i, j, k, w);
+            if (aos) {
+              Ray &ray = cam.rays[ridx];
+              ray.mice.id = idx;
+              ray.mice.origin = cam.eye_point;
+              ray.mice.direction = d;
+              ray.mice.t_min = Ray::RAY_EPSILON;
+              ray.mice.t = ray.mice.t_max = FLT_MAX;
+              ray.mice.color = glm::vec3(0.f);
+              ray.mice.w = 1.f / samples2;
+              ray.mice.type = Ray::PRIMARY;
+              ray.mice.depth = cam.depth;
+            } else {
+              cam.stream.setDirection(ridx, d);
+              cam.stream.id[ridx] = idx;
+            }
+          }
+      }
+      if (!aos) {
+        RayStream &rs = cam.stream;
+        const size_t row = j * width * samples2, row_end = row + width * samples2;
+        std::fill(rs.ox + row, rs.ox + row_end, cam.eye_point[0]);
+        std::fill(rs.oy + row, rs.oy + row_end, cam.eye_point[1]);
+        std::fill(rs.oz + row, rs.oz + row_end, cam.eye_point[2]);
+        std::fill(rs.t_min + row, rs.t_min + row_end, Ray::RAY_EPSILON);
+        std::fill(rs.t_max + row, rs.t_max + row_end, FLT_MAX);
+        std::fill(rs.t + row, rs.t + row_end, FLT_MAX);
+        std::fill(rs.cr + row, rs.cr + row_end, 0.f);
+        std::fill(rs.cg + row, rs.cg + row_end, 0.f);
+        std::fill(rs.cb + row, rs.cb + row_end, 0.f);
+        std::fill(rs.w + row, rs.w + row_end, 1.f / samples2);
+        std::fill(rs.type + row, rs.type + row_end, int(Ray::PRIMARY));
+        std::fill(rs.depth + row, rs.depth + row_end, cam.depth);
+      }
+    }
+  });
+}
+
+static unsigned morton(unsigned x, unsigned y) {
+  unsigned key = 0;
+  for (int b = 0; b < 16; b++) key |= (((x >> b) & 1) << (2 * b)) | (((y >> b) & 1) << (2 * b + 1));
+  return key;
+}
+
+/** Checks tiled output handed over in one or more consecutive pieces */
+struct FrameCheck {
+  const gvtPerspectiveCamera &cam;
+  const SampleDirection sampleDirection;
+  std::vector<char> seen;
+  size_t rays;
+  long last_key;
+
+  FrameCheck(const gvtPerspectiveCamera &cam)
+      : cam(cam), sampleDirection(cam), seen(size_t(cam.filmsize[0]) * cam.filmsize[1], 0), rays(0), last_key(-1) {}
+
+  /** Next n rays, ray r having pixel id(r) and direction dir(r) */
+  template <typename Id, typename Dir> bool add(size_t n, Id id, Dir dir) {
+    const int width = cam.filmsize[0], samples2 = cam.samples * cam.samples;
+    if (n % samples2 != 0) return false;
+    for (size_t r = 0; r < n; r += samples2) {
+      const int pixel = id(r);
+      if (pixel < 0 || size_t(pixel) >= seen.size() || seen[pixel]) return false;
+      seen[pixel] = 1;
+      const int i = pixel % width, j = pixel / width;
+      // tiles are contiguous and come in increasing Morton order
+      const long key = morton(i / 16, j / 16);
+      if (key < last_key) return false;
+      last_key = key;
+      for (int s = 0; s < samples2; s++) {
+        if (id(r + s) != pixel) return false;
+        const glm::vec3 d = dir(r + s), e = sampleDirection(i, j, s / cam.samples, s % cam.samples);
+        if (std::fabs(d[0] - e[0]) > 1e-5f || std::fabs(d[1] - e[1]) > 1e-5f || std::fabs(d[2] - e[2]) > 1e-5f)
+          return false;
+      }
+    }
+    rays += n;
+    return true;
+  }
+
+  /** Every pixel seen, with all its samples */
+  bool complete() const { return rays == seen.size() * cam.samples * cam.samples; }
+};
+
+int cameraCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  int width = 3840, height = 2160, samples = 4;
+  unsigned rounds = 3;
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t wave = 1 << 22;
+  bool aos = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-width") && i + 1 < argc)
+      width = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-height") && i + 1 < argc)
+      height = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-samples") && i + 1 < argc)
+      samples = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-rounds") && i + 1 < argc)
+      rounds = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-wave") && i + 1 < argc)
+      wave = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-rays"))
+      aos = true;
+    else {
+      std::cerr << "usage: " << argv[0] << " [-width N] [-height N] [-samples N] [-rounds N] [-threads N] [-wave N] [-rays]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  tbb::task_arena arena(threads);
+
+  gvtPerspectiveCamera cam;
+  cam.setFilmsize(width, height);
+  cam.setSamples(samples);
+  cam.setJitterWindowSize(1);
+  cam.setFOV(FOV);
+  cam.lookAt(glm::vec3(1.f, 2.f, 8.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+  if (aos)
+    cam.AllocateCameraRays();
+  else
+    cam.AllocateCameraRayStream();
+  // first touch of the buffers, outside the timings
+  arena.execute([&]() { generateRows(cam, threads, aos); });
+
+  double rows_ms = 0, tiles_ms = 0;
+  for (unsigned round = 0; round < rounds; ++round) {
+    my_timer_t t0, t1;
+    timeCurrent(&t0);
+    arena.execute([&]() { generateRows(cam, threads, aos); });
+    timeCurrent(&t1);
+    rows_ms += timeDifferenceMS(&t0, &t1);
+
+    timeCurrent(&t0);
+    arena.execute([&]() {
+      if (aos)
+        cam.generateRays();
+      else
+        cam.generateRayStream();
+    });
+    timeCurrent(&t1);
+    tiles_ms += timeDifferenceMS(&t0, &t1);
+  }
+
+  const size_t nrays = size_t(width) * height * samples * samples;
+  auto streamId = [&](size_t r) { return cam.stream.id[r]; };
+  auto streamDir = [&](size_t r) { return glm::vec3(cam.stream.dx[r], cam.stream.dy[r], cam.stream.dz[r]); };
+  FrameCheck frame(cam);
+  if (aos)
+    frame.add(nrays, [&](size_t r) { return cam.rays[r].mice.id; },
+              [&](size_t r) { return cam.rays[r].mice.direction; });
+  else
+    frame.add(nrays, streamId, streamDir);
+  bool ok = frame.complete();
+
+  // the same frame in waves of at most -wave rays (whole tiles), only one wave is ever held
+  cam.rays = RayVector();
+  cam.stream = RayStream();
+  FrameCheck waves(cam);
+  const size_t tile_rays = 16 * 16 * size_t(samples) * samples;
+  size_t nwaves = 0, largest = 0;
+  double waves_ms = 0;
+  cam.beginWaves(wave);
+  for (;;) {
+    my_timer_t t0, t1;
+    bool more;
+    timeCurrent(&t0);
+    arena.execute([&]() { more = cam.nextWave(); });
+    timeCurrent(&t1);
+    if (!more) break;
+    waves_ms += timeDifferenceMS(&t0, &t1);
+    nwaves++;
+    largest = std::max(largest, cam.stream.size());
+    ok = ok && cam.stream.size() <= std::max(wave, tile_rays) && waves.add(cam.stream.size(), streamId, streamDir);
+  }
+  ok = ok && waves.complete() && !cam.wavesPending();
+
+  std::cout << "width,height,spp,rays,layout,generator,ms,mrays_per_s" << std::endl;
+  std::cout << width << "," << height << "," << samples * samples << "," << nrays << "," << (aos ? "rays" : "stream")
+            << ",rows," << rows_ms / rounds << "," << nrays * rounds / rows_ms / 1000. << std::endl;
+  std::cout << width << "," << height << "," << samples * samples << "," << nrays << "," << (aos ? "rays" : "stream")
+            << ",tiles," << tiles_ms / rounds << "," << nrays * rounds / tiles_ms / 1000. << std::endl;
+  std::cout << width << "," << height << "," << samples * samples << "," << nrays << ",stream,waves(" << nwaves
+            << "x<=" << largest << ")," << waves_ms << "," << nrays / waves_ms / 1000. << std::endl;
+
+  check(ok, "tiled camera rays are missing, duplicated, out of tile order, pointing the wrong way or over the wave size");
+  return check.status();
+}
@@ -0,0 +1,228 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * queues: instance ray queue shuffle.
+ *
+ * Moves a batch of rays with random target instances into the instance queues the way the schedulers did before
+ * (a std::map of local queues per chunk, merged under a per instance mutex into a std::map of queues, largest queue
+ * found by a linear scan) and with RayQueues (radix partition into dense queues, indexed max heap). Reports the
+ * shuffle time of both and the time to pick and empty the largest queue -selects times, and checks that the dense
+ * queues hold every queued ray exactly once, in input order, and that the heap hands out the queues largest first.
+*/
+
+#include <gvt/core/Types.h>
+#include <gvt/render/actor/RayQueues.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using namespace gvt::render::actor;
+
+static const size_t CHUNK = 4096;
+
+static double shuffleMap(tbb::task_arena &arena, RayVector &rays, const std::vector<int> &target,
+                         gvt::core::Map<int, RayVector> &queue, std::mutex *queue_mutex) {
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  arena.execute([&]() {
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, rays.size(), CHUNK), [&](const tbb::blocked_range<size_t> &r) {
+      gvt::core::Map<int, RayVector> local_queue;
+      for (size_t i = r.begin(); i < r.end(); ++i)
+        if (target[i] != -1) local_queue[target[i]].push_back(rays[i]);
+      for (auto &q : local_queue) {
+        queue_mutex[q.first].lock();
+        queue[q.first].insert(queue[q.first].end(), std::make_move_iterator(q.second.begin()),
+                              std::make_move_iterator(q.second.end()));
+        queue_mutex[q.first].unlock();
+      }
+    });
+  });
+  timeCurrent(&t1);
+  return timeDifferenceMS(&t0, &t1);
+}
+
+static double shuffleDense(tbb::task_arena &arena, RayVector &rays, const std::vector<int> &target,
+                           RayQueues &queue) {
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  arena.execute([&]() {
+    queue.partition(rays.size(), CHUNK,
+                    [&](size_t begin, size_t end, int *t) {
+                      for (size_t i = begin; i < end; ++i) t[i - begin] = target[i];
+                    },
+                    [&](size_t i, Ray &r) { r = rays[i]; });
+  });
+  timeCurrent(&t1);
+  return timeDifferenceMS(&t0, &t1);
+}
+
+int queuesCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  size_t nrays = 1 << 21;
+  size_t ninstances = 10000;
+  unsigned rounds = 4;
+  size_t selects = 1000;
+  unsigned threads = std::thread::hardware_concurrency();
+  unsigned seed = 7;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-rays") && i + 1 < argc)
+      nrays = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-instances") && i + 1 < argc)
+      ninstances = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-rounds") && i + 1 < argc)
+      rounds = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-selects") && i + 1 < argc)
+      selects = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+      seed = atoi(argv[++i]);
+    else {
+      std::cerr << "usage: " << argv[0] << " [-rays N] [-instances N] [-rounds N] [-selects N] [-threads N] [-seed N]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  tbb::task_arena arena(threads);
+
+  // skewed targets, a few instances get most of the rays, about a tenth of the rays leave the scene
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  RayVector rays(nrays);
+  std::vector<int> target(nrays);
+  for (size_t i = 0; i < nrays; ++i) {
+    rays[i].mice.id = i;
+    const float x = u(gen);
+    target[i] = (x < 0.1f) ? -1 : int(std::min<size_t>(ninstances - 1, size_t(ninstances * std::pow(u(gen), 3.f))));
+  }
+
+  gvt::core::Map<int, RayVector> map_queue;
+  std::mutex *queue_mutex = new std::mutex[ninstances];
+  for (size_t i = 0; i < ninstances; ++i) map_queue[i] = RayVector();
+  RayQueues dense;
+  dense.reset(ninstances);
+
+  double map_ms = 0, dense_ms = 0, map_select_ms = 0, dense_select_ms = 0;
+  bool ok = true;
+  for (unsigned round = 0; round < rounds; ++round) {
+    for (auto &q : map_queue) q.second.clear();
+    dense.clear();
+    map_ms += shuffleMap(arena, rays, target, map_queue, queue_mutex);
+    dense_ms += shuffleDense(arena, rays, target, dense);
+
+    // pick and empty the largest queue, as the schedulers do once per adapter call
+    my_timer_t t0, t1;
+    timeCurrent(&t0);
+    for (size_t k = 0; k < selects; ++k) {
+      int best = -1;
+      size_t amount = 0;
+      for (auto &q : map_queue)
+        if (q.second.size() > amount) {
+          amount = q.second.size();
+          best = q.first;
+        }
+      if (best == -1) break;
+      map_queue[best].clear();
+    }
+    timeCurrent(&t1);
+    map_select_ms += timeDifferenceMS(&t0, &t1);
+
+    std::vector<RayVector> taken;
+    std::vector<int> order;
+    RayVector tmp;
+    timeCurrent(&t0);
+    for (int best = dense.top(); best != -1; best = dense.top()) {
+      if (order.size() == selects) {
+        timeCurrent(&t1);
+        dense_select_ms += timeDifferenceMS(&t0, &t1);
+      }
+      dense.take(best, tmp);
+      order.push_back(best);
+      taken.emplace_back();
+      std::swap(taken.back(), tmp);
+    }
+    if (order.size() <= selects) {
+      timeCurrent(&t1);
+      dense_select_ms += timeDifferenceMS(&t0, &t1);
+    }
+
+    // every queued ray exactly once, in its target queue, in input order; queues handed out largest first
+    std::vector<size_t> expected(ninstances, 0);
+    for (size_t i = 0; i < nrays; ++i)
+      if (target[i] != -1) expected[target[i]]++;
+    size_t nonempty = 0;
+    for (size_t c : expected) nonempty += (c != 0);
+    ok = ok && dense.empty() && order.size() == nonempty;
+    for (size_t k = 0; ok && k < order.size(); ++k) {
+      const RayVector &q = taken[k];
+      ok = q.size() == expected[order[k]] && (k == 0 || q.size() <= taken[k - 1].size());
+      for (size_t j = 0; ok && j < q.size(); ++j) {
+        const int id = q[j].mice.id;
+        ok = id >= 0 && size_t(id) < nrays && target[id] == order[k] && (j == 0 || id > q[j - 1].mice.id);
+      }
+    }
+  }
+
+  // remote queues are drained, never scheduled
+  dense.clear();
+  for (size_t i = 0; i < ninstances; i += 2) dense.setLocal(i, false);
+  shuffleDense(arena, rays, target, dense);
+  size_t local = 0, remote = 0;
+  for (int best = dense.top(); best != -1; best = dense.top()) {
+    RayVector tmp;
+    ok = ok && (best % 2 == 1);
+    local += dense.take(best, tmp);
+  }
+  dense.drainRemote([&](int id, RayVector &&q) {
+    ok = ok && (id % 2 == 0);
+    remote += q.size();
+  });
+  size_t queued = 0;
+  for (size_t i = 0; i < nrays; ++i) queued += (target[i] != -1);
+  ok = ok && dense.empty() && local + remote == queued;
+
+  std::cout << "rays,instances,rounds,selects,queues,shuffle_ms,select_ms" << std::endl;
+  std::cout << nrays << "," << ninstances << "," << rounds << "," << selects << ",map," << map_ms << "," << map_select_ms << std::endl;
+  std::cout << nrays << "," << ninstances << "," << rounds << "," << selects << ",dense," << dense_ms << "," << dense_select_ms
+            << std::endl;
+
+  delete[] queue_mutex;
+  check(ok, "dense queues lost, duplicated, misplaced or reordered rays");
+  return check.status();
+}
@@ -0,0 +1,169 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * sort: ray queue coherence sort.
+ *
+ * Builds the instance BVH over synthetic instance boxes and traces a queue of diffuse-like rays
+ * (origins scattered through the scene, uniformly random directions) through it twice: as generated
+ * and after RaySort. Reports the sort time and the traversal throughput of both orders, and checks
+ * that the sorted queue is a permutation of the input in key order.
+*/
+
+#include <gvt/core/Math.h>
+#include <gvt/render/actor/RaySort.h>
+#include <gvt/render/data/accel/BVH.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using namespace gvt::render::actor;
+using namespace gvt::render::data::accel;
+using namespace gvt::render::data::primitives;
+
+static gvt::core::Vector<Box3D> makeInstances(size_t n, unsigned seed) {
+  std::mt19937 gen(seed);
+  const float side = 10.f * std::cbrt(float(n));
+  std::uniform_real_distribution<float> pos(0.f, side);
+  std::uniform_real_distribution<float> size(0.5f, 4.f);
+  gvt::core::Vector<Box3D> boxes;
+  boxes.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    glm::vec3 c(pos(gen), pos(gen), pos(gen));
+    glm::vec3 h(size(gen), size(gen), size(gen));
+    boxes.push_back(Box3D(c - h, c + h));
+  }
+  return boxes;
+}
+
+static void makeRays(RayVector &rays, size_t n, const glm::vec3 &lo, const glm::vec3 &hi, unsigned seed) {
+  // what a queue looks like after a diffuse bounce: scattered origins, directions all over the sphere
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  std::normal_distribution<float> g(0.f, 1.f);
+  rays.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    glm::vec3 origin = lo + glm::vec3(u(gen), u(gen), u(gen)) * (hi - lo);
+    rays[i] = Ray(origin, glm::vec3(g(gen), g(gen), g(gen)) + glm::vec3(1e-6f), 1.f, Ray::SECONDARY, 1);
+    rays[i].mice.id = i;
+  }
+}
+
+static double trace(tbb::task_arena &arena, BVH &bvh, RayVector &rays, size_t &hits) {
+  const size_t n = rays.size();
+  std::vector<size_t> hitcount(n / 4096 + 1, 0);
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  arena.execute([&]() {
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, 4096), [&](const tbb::blocked_range<size_t> &r) {
+      gvt::core::Vector<BVH::hit> h = bvh.intersect<GVT_SIMD_WIDTH>(rays.begin() + r.begin(), rays.begin() + r.end(), -1);
+      size_t c = 0;
+      for (auto &hit : h) c += (hit.next != -1);
+      hitcount[r.begin() / 4096] = c;
+    });
+  });
+  timeCurrent(&t1);
+  hits = 0;
+  for (size_t c : hitcount) hits += c;
+  return timeDifferenceMS(&t0, &t1);
+}
+
+int sortCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  size_t nrays = 1 << 20;
+  size_t ninstances = 10000;
+  unsigned threads = std::thread::hardware_concurrency();
+  unsigned seed = 7;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-rays") && i + 1 < argc)
+      nrays = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-instances") && i + 1 < argc)
+      ninstances = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+      seed = atoi(argv[++i]);
+    else {
+      std::cerr << "usage: " << argv[0] << " [-rays N] [-instances N] [-threads N] [-seed N]" << std::endl;
+      return 1;
+    }
+  }
+
+  tbb::task_arena arena(threads);
+
+  gvt::core::Vector<Box3D> boxes = makeInstances(ninstances, seed);
+  Box3D scene;
+  for (auto &b : boxes) scene.merge(b);
+  std::shared_ptr<BVH> bvh;
+  arena.execute([&]() { bvh = std::make_shared<BVH>(boxes); });
+
+  RayVector rays;
+  makeRays(rays, nrays, scene.bounds_min, scene.bounds_max, seed + 1);
+
+  size_t hits_unsorted, hits_sorted;
+  const double unsorted_ms = trace(arena, *bvh, rays, hits_unsorted);
+
+  my_timer_t t0, t1;
+  timeCurrent(&t0);
+  // no threshold, so the order check below holds for any -rays
+  arena.execute([&]() { RaySort::sort(rays, scene.bounds_min, scene.bounds_max, 0); });
+  timeCurrent(&t1);
+  const double sort_ms = timeDifferenceMS(&t0, &t1);
+
+  const double sorted_ms = trace(arena, *bvh, rays, hits_sorted);
+
+  // the sorted queue has to hold every ray exactly once, in key order. Hit counts are only reported: the packet
+  // traversal culls nodes per packet, so the instance picked for a ray can depend on its packet neighbours.
+  bool ok = (rays.size() == nrays);
+  std::vector<char> seen(nrays, 0);
+  const glm::vec3 scale = RaySort::scale(scene.bounds_min, scene.bounds_max);
+  unsigned last = 0;
+  for (size_t i = 0; ok && i < rays.size(); ++i) {
+    const int id = rays[i].mice.id;
+    const unsigned k = RaySort::key(rays[i], scene.bounds_min, scale);
+    ok = id >= 0 && size_t(id) < nrays && !seen[id] && k >= last;
+    if (ok) seen[id] = 1;
+    last = k;
+  }
+
+  std::cout << "rays,instances,order,sort_ms,trace_ms,mrays_per_s,hits" << std::endl;
+  std::cout << nrays << "," << ninstances << ",unsorted,0," << unsorted_ms << ","
+            << (nrays / (unsorted_ms * 1e-3)) * 1e-6 << "," << hits_unsorted << std::endl;
+  std::cout << nrays << "," << ninstances << ",sorted," << sort_ms << "," << sorted_ms << ","
+            << (nrays / (sorted_ms * 1e-3)) * 1e-6 << "," << hits_sorted << std::endl;
+
+  check(ok, "sorted queue is not an ordered permutation of the input");
+  return check.status();
+}
@@ -0,0 +1,145 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * coalesce: outbound ray message coalescing.
+ *
+ * Instance queues of random sizes bound for a few fake compute nodes are handed to a
+ * RayCoalescer the way the async DomainTracer does, with the messages captured instead
+ * of sent. Every message is decoded and checked: it goes to the node owning its
+ * instances, it is not larger than the maximum message size, it carries the advertised
+ * queue depth and every ray arrives exactly once under the instance it was queued for.
+ * Also checks the byte threshold, deadline and idle flushes, and reports messages and mean
+ * message size against one message per queue.
+*/
+
+#include <gvt/core/comm/communicator.h>
+#include <gvt/render/tracer/Domain/Messages/SendRayBatch.h>
+#include <gvt/render/tracer/Domain/RayCoalescer.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../checks.h"
+
+using gvt::comm::SendRayBatch;
+using gvt::render::RayCoalescer;
+using gvt::render::actor::Ray;
+using gvt::render::actor::RayCodec;
+using gvt::render::actor::RayVector;
+
+int coalesceCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  int nodes = 4, ninstances = 64, nqueues = 2000;
+  unsigned seed = 7;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-nodes")) nodes = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-instances")) ninstances = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-queues")) nqueues = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-seed")) seed = std::atoi(argv[++i]);
+  }
+
+  gvt::comm::communicator::RegisterMessageType<SendRayBatch>();
+
+  const size_t flush_bytes = 64 << 10, max_bytes = 256 << 10;
+  std::vector<std::pair<int, std::shared_ptr<gvt::comm::Message> > > sent;
+  RayCoalescer coalescer(0, flush_bytes, max_bytes, 0.5, RayCodec::COMPACT,
+                         [&](std::shared_ptr<gvt::comm::Message> msg, int dst) { sent.push_back({ dst, msg }); });
+
+  // queues are mostly small with the odd large one, the ray id is unique and depth holds the instance
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> pick(0, ninstances - 1);
+  std::uniform_int_distribution<int> small(1, 64);
+  std::uniform_int_distribution<int> large(2048, 8192);
+  int nrays = 0;
+  const size_t depth = 123456;
+  coalescer.advertise(depth);
+  for (int q = 0; q < nqueues; ++q) {
+    const int instance = pick(rng);
+    RayVector rays((q % 50 == 0) ? large(rng) : small(rng));
+    for (auto &r : rays) {
+      r.mice.id = nrays++;
+      r.mice.depth = instance;
+    }
+    coalescer.add(instance % nodes, instance, std::move(rays));
+    if (!check(rays.empty(), "queue storage not taken over")) return check.status();
+  }
+  const size_t threshold_messages = sent.size();
+
+  check(coalescer.counters().threshold > 0 && !coalescer.empty(), "no threshold flush");
+
+  // whatever is left expires
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  coalescer.flushExpired();
+  check(coalescer.empty() && coalescer.counters().deadline > 0, "deadline flush left rays behind");
+
+  // idle flush
+  RayVector tail(100);
+  for (auto &r : tail) {
+    r.mice.id = nrays++;
+    r.mice.depth = 1;
+  }
+  coalescer.add(1 % nodes, 1, std::move(tail));
+  coalescer.flushAll();
+  check(coalescer.empty() && coalescer.counters().idle == 1, "idle flush left rays behind");
+
+  std::vector<char> seen(nrays, 0);
+  int received = 0, misrouted = 0;
+  for (auto &s : sent) {
+    std::shared_ptr<SendRayBatch> batch = gvt::comm::communicator::SAFE_DOWN_CAST<SendRayBatch>(s.second);
+    if (!check(batch && batch->size() <= max_bytes && batch->load() == depth, "bad message")) break;
+    const unsigned char *wire = batch->payload();
+    SendRayBatch::Entry *table = batch->table();
+    for (size_t i = 0; i < batch->entries(); ++i) {
+      RayVector rays(table[i].count);
+      RayCodec::decode(batch->format(), wire, rays.size(), rays.data());
+      wire += RayCodec::encodedSize(batch->format(), rays.size());
+      for (size_t r = 0; r < table[i].count; ++r) {
+        const Ray &ray = rays[r];
+        if (ray.mice.id < 0 || ray.mice.id >= nrays || seen[ray.mice.id] || ray.mice.depth != table[i].instance ||
+            table[i].instance % nodes != s.first) {
+          misrouted++;
+          continue;
+        }
+        seen[ray.mice.id] = 1;
+        received++;
+      }
+    }
+  }
+  check(!misrouted, std::to_string(misrouted) + " rays duplicated or sent to the wrong node");
+  check(received == nrays, "received " + std::to_string(received) + " of " + std::to_string(nrays) + " rays");
+
+  const RayCoalescer::Counters &c = coalescer.counters();
+  std::cout << "queues,rays,messages,threshold_messages,mean_bytes,max_bytes,segments" << std::endl;
+  std::cout << nqueues + 1 << "," << nrays << "," << c.messages << "," << threshold_messages << ","
+            << (c.messages ? c.bytes / c.messages : 0) << "," << max_bytes << "," << c.segments << std::endl;
+
+  check(c.messages == sent.size() && c.rays == size_t(nrays), "counters do not match the messages sent");
+  return check.status();
+}
@@ -0,0 +1,133 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * codec: ray wire codec round trips.
+ *
+ * Encodes and decodes a random ray set in the RAW and COMPACT formats and reports bytes
+ * per ray and throughput. Checks the COMPACT error bounds (exact origin, id, depth, type
+ * and t_max, direction within 2e-4 rad, weight within half precision, color within 1/256
+ * of its brightest channel), that RAW round trips bit exact and that the block (SIMD) path
+ * encodes the same bytes as the per ray path.
+*/
+
+#include <gvt/render/actor/RayCodec.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using gvt::render::actor::Ray;
+using gvt::render::actor::RayCodec;
+using gvt::render::actor::RayVector;
+
+static bool close(float a, float b) {
+  // half keeps 11 significant bits, below 2^-14 the spacing is 2^-24
+  return std::fabs(a - b) <= std::max(std::fabs(b) * (1.f / 2048.f), 1.f / (1 << 24));
+}
+
+static bool closeColor(const glm::vec3 &a, const glm::vec3 &b) {
+  // rgb9e5 rounds every channel to half a step of the shared exponent, at most 2^-8 of the brightest one
+  const float step = std::max(std::max(b.x, b.y), b.z) * (1.f / 256.f);
+  return std::fabs(a.x - b.x) <= step && std::fabs(a.y - b.y) <= step && std::fabs(a.z - b.z) <= step;
+}
+
+int codecCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  size_t nrays = 1000003; // not a multiple of the block size
+  unsigned seed = 11;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-rays")) nrays = std::atol(argv[++i]);
+    else if (!strcmp(argv[i], "-seed")) seed = std::atoi(argv[++i]);
+  }
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(-1.f, 1.f);
+  std::uniform_real_distribution<float> pos(-1000.f, 1000.f);
+  std::uniform_real_distribution<float> radiance(0.f, 4.f);
+  std::uniform_int_distribution<int> depth(0, 16);
+
+  RayVector rays(nrays);
+  for (size_t i = 0; i < nrays; ++i) {
+    glm::vec3 d(unit(rng), unit(rng), unit(rng));
+    if (i % 97 == 0) d = glm::vec3(0.f, 0.f, (i % 2) ? 1.f : -1.f); // poles and folds
+    Ray &r = rays[i];
+    r = Ray(glm::vec3(pos(rng), pos(rng), pos(rng)), d, radiance(rng) * 0.25f, Ray::RayType(i % 3));
+    r.mice.color = glm::vec3(radiance(rng), radiance(rng), (i % 5) ? radiance(rng) : 1e-6f);
+    r.mice.t_max = (i % 4) ? FLT_MAX : radiance(rng) * ((i % 8) ? 100.f : 1e5f); // also past the half range
+    r.mice.depth = depth(rng) | ((i % 7) ? 0 : 0x14);
+    r.mice.id = int(i);
+  }
+
+  std::cout << "format,bytes_per_ray,encode_ms,decode_ms,encode_mrays_per_s,decode_mrays_per_s" << std::endl;
+
+  for (RayCodec::Format f : { RayCodec::RAW, RayCodec::COMPACT }) {
+    std::vector<unsigned char> wire(RayCodec::encodedSize(f, nrays));
+    // copying a ray into every slot keeps first touch page faults out of the timings
+    RayVector back(nrays, Ray(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f)));
+
+    my_timer_t t0, t1, t2;
+    timeCurrent(&t0);
+    RayCodec::encode(f, rays.data(), nrays, wire.data());
+    timeCurrent(&t1);
+    RayCodec::decode(f, wire.data(), nrays, back.data());
+    timeCurrent(&t2);
+    const double enc = timeDifferenceMS(&t0, &t1), dec = timeDifferenceMS(&t1, &t2);
+
+    std::cout << ((f == RayCodec::RAW) ? "raw" : "compact") << "," << RayCodec::rayBytes(f) << "," << enc << ","
+              << dec << "," << nrays / (enc * 1e3) << "," << nrays / (dec * 1e3) << std::endl;
+
+    size_t bad = 0;
+    for (size_t i = 0; i < nrays; ++i) {
+      const Ray::rats &a = rays[i].mice, &b = back[i].mice;
+      if (f == RayCodec::RAW) {
+        bad += std::memcmp(rays[i].data, back[i].data, sizeof(rays[i].data)) != 0;
+        continue;
+      }
+      // chord based, acos of a float dot product cannot resolve angles this small
+      const float angle = 2.f * std::asin(std::min(1.f, glm::length(a.direction - b.direction) * 0.5f));
+      if (a.origin != b.origin || a.id != b.id || a.depth != b.depth || a.type != b.type || !(angle < 2e-4f) ||
+          std::fabs(glm::length(b.direction) - 1.f) > 1e-5f || !closeColor(b.color, a.color) || !close(b.w, a.w) ||
+          b.t_max != a.t_max || b.t_min != Ray::RAY_EPSILON)
+        bad++;
+    }
+    check(!bad, std::to_string(bad) + " rays out of bounds after a " + ((f == RayCodec::RAW) ? "raw" : "compact") +
+                    " round trip");
+
+    // one ray at a time never takes the block path
+    std::vector<unsigned char> single(wire.size());
+    for (size_t i = 0; i < nrays; ++i)
+      RayCodec::encode(f, &rays[i], 1, single.data() + i * RayCodec::rayBytes(f));
+    check(single == wire, "block and per ray encoding differ");
+  }
+
+  return check.status();
+}
@@ -0,0 +1,137 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * comm: asynchronous communicator ray ping-pong.
+ *
+ * Ranks are paired (0-1, 2-3, ...). The even rank keeps -inflight SendRayList messages of
+ * -rays rays each in flight to its partner, which echoes every message back, until
+ * -messages round trips completed. Reports messages/s and GB/s over all ranks and the
+ * per-peer counters of the progress engine. Fails if an echoed message comes back corrupted.
+*/
+
+#include <gvt/core/comm/communicator/acomm.h>
+#include <gvt/render/tracer/Domain/Messages/SendRayList.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mpi.h>
+#include <thread>
+#include <vector>
+
+#include "../checks.h"
+#include "../timer.h"
+
+using gvt::render::actor::Ray;
+
+int commCase(int argc, char **argv) {
+  gvt::comm::acomm::init(argc, argv);
+  gvt::comm::acomm &comm = static_cast<gvt::comm::acomm &>(gvt::comm::communicator::instance());
+  gvt::comm::communicator::RegisterMessageType<gvt::comm::SendRayList>();
+
+  size_t nrays = 4096, nmessages = 2000, inflight = 8;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-rays")) nrays = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-messages")) nmessages = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-inflight")) inflight = std::atoi(argv[++i]);
+  }
+
+  const int rank = comm.id(), size = comm.lastid();
+  const int partner = rank ^ 1;
+  const bool active = partner < size;
+  const bool pinger = active && !(rank & 1);
+
+  int ok = 1;
+  size_t received = 0;
+  my_timer_t t0, t1;
+  MPI_Barrier(MPI_COMM_WORLD);
+  timeCurrent(&t0);
+
+  if (pinger) {
+    size_t sent = 0;
+    for (size_t m = 0; m < inflight && sent < nmessages; ++m, ++sent) {
+      gvt::render::actor::RayVector rays(nrays);
+      for (size_t i = 0; i < nrays; ++i) rays[i].mice.id = m * nrays + i;
+      comm.send(std::make_shared<gvt::comm::SendRayList>(rank, partner, std::move(rays)), partner);
+    }
+    while (received < nmessages) {
+      std::shared_ptr<gvt::comm::Message> msg;
+      if (!comm.poll(msg)) {
+        std::this_thread::yield();
+        continue;
+      }
+      received++;
+      Ray *r = msg->getMessage<Ray>();
+      if (msg->sizehas<Ray>() != nrays || r[nrays - 1].mice.id != r[0].mice.id + int(nrays) - 1) ok = 0;
+      if (sent < nmessages) {
+        comm.send(msg, partner);
+        sent++;
+      }
+    }
+  } else if (active) {
+    while (received < nmessages) {
+      std::shared_ptr<gvt::comm::Message> msg;
+      if (!comm.poll(msg)) {
+        std::this_thread::yield();
+        continue;
+      }
+      received++;
+      comm.send(msg, partner);
+    }
+  }
+
+  timeCurrent(&t1);
+  const double seconds = timeDifferenceMS(&t0, &t1) / 1000.0;
+
+  // every message crosses the wire twice (ping + pong)
+  double messages = pinger ? 2.0 * nmessages : 0, bytes = 0, maxseconds = 0, allmessages = 0, allbytes = 0;
+  if (pinger) bytes = messages * (nrays * sizeof(Ray) + sizeof(gvt::comm::Message::header));
+  MPI_Reduce(&messages, &allmessages, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&bytes, &allbytes, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Reduce((void *)&seconds, &maxseconds, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  if (rank == 0)
+    std::cout << size << " ranks, " << nrays << " rays (" << nrays * sizeof(Ray) / 1024.0 << " KB) per message, "
+              << inflight << " in flight: " << allmessages / maxseconds << " messages/s, "
+              << allbytes / maxseconds / 1e9 << " GB/s" << std::endl;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  comm.terminate();
+
+  if (active) {
+    const gvt::comm::acomm::PeerCounters &p = comm.peer(partner);
+    std::cout << "rank " << rank << " <-> " << partner << ": sent " << p.sent_messages << " msgs / " << p.sent_bytes
+              << " bytes, received " << p.received_messages << " msgs / " << p.received_bytes << " bytes"
+              << std::endl;
+  }
+
+  int allok = 0;
+  MPI_Allreduce(&ok, &allok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  gvttest::Checks check(argv[0], rank == 0);
+  check(allok, "echoed message corrupted");
+  MPI_Finalize();
+  return check.status();
+}
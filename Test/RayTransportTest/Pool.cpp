@@ -0,0 +1,72 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * pool: message buffer pool.
+ *
+ * Checks that a released buffer is handed out again for the next request of its size class,
+ * and that releasing more large buffers than the pool may keep leaves at most
+ * BufferPool::MAX_RETAINED bytes on its free lists. A message is left alive until static
+ * destruction at exit, as messages still queued in the communicator are, and has to release its
+ * buffer into the pool without crashing.
+*/
+
+#include <gvt/core/comm/bufferpool.h>
+#include <gvt/core/comm/message.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../checks.h"
+
+using gvt::comm::BufferPool;
+
+// destroyed after main returns, by then every function local static is gone
+static std::unique_ptr<gvt::comm::Message> lateMessage;
+
+int poolCase(int argc, char **argv) {
+  gvttest::Checks check(argv[0]);
+  BufferPool &pool = BufferPool::instance();
+
+  std::size_t capacity = 0, again = 0;
+  BufferPool::Byte *b = pool.acquire(1000, capacity);
+  pool.release(b, capacity);
+  check(pool.acquire(700, again) == b && again == capacity, "released buffer was not reused");
+  pool.release(b, again);
+
+  // more 64MB buffers than MAX_RETAINED holds, the pages are never touched
+  const std::size_t large = std::size_t(64) << 20, count = BufferPool::MAX_RETAINED / large + 2;
+  std::vector<BufferPool::Byte *> buffers(count);
+  for (auto &lb : buffers) lb = pool.acquire(large, capacity);
+  for (auto lb : buffers) pool.release(lb, capacity);
+  std::cout << "retained " << (pool.retained() >> 20) << "MB of " << ((count * large) >> 20) << "MB released, "
+            << pool.allocations() << " allocations, " << pool.reuses() << " reuses" << std::endl;
+  check(pool.retained() <= BufferPool::MAX_RETAINED, std::to_string(pool.retained()) + " bytes retained");
+  check(pool.retained() >= large, "no large buffer retained");
+
+  lateMessage.reset(new gvt::comm::Message(4096));
+  return check.status();
+}
@@ -0,0 +1,205 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+/*
+ * termination: distributed termination detection under message delays.
+ *
+ * Every rank starts a frame with a random number of work tokens. Processing a token takes
+ * a little time and may spawn tokens for random ranks, up to a maximum generation. Sends
+ * are held back by a random delay after they are counted as sent, and received tokens
+ * are held back by another random delay before they are processed, so messages are in
+ * flight while their sender and receiver both look idle. Once the TerminationDetector
+ * reports the end of the frame every rank checks that nothing is left: no local or delayed
+ * work, no stray message and as many tokens processed as created over all ranks.
+*/
+
+#include <gvt/core/comm/termination.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <mpi.h>
+#include <random>
+#include <vector>
+
+#include "../checks.h"
+
+typedef std::chrono::steady_clock clock_type;
+
+struct Token {
+  int generation;
+  int origin;
+};
+
+struct Delayed {
+  clock_type::time_point release;
+  int rank;
+  Token token;
+};
+
+static const int TOKEN_TAG = 77;
+
+int terminationCase(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int frames = 5, tokens = 64, generations = 6, delay_us = 2000;
+  unsigned seed = 3;
+  for (int i = 1; i < argc - 1; ++i) {
+    if (!strcmp(argv[i], "-frames")) frames = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-tokens")) tokens = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-generations")) generations = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-delay")) delay_us = std::atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-seed")) seed = std::atoi(argv[++i]);
+  }
+
+  std::mt19937 rng(seed * 7919 + rank);
+  std::uniform_int_distribution<int> delay(0, delay_us);
+  std::uniform_int_distribution<int> work_us(0, 20);
+  std::uniform_int_distribution<int> children(0, 2);
+  std::uniform_int_distribution<int> target(0, size - 1);
+
+  gvt::comm::TerminationDetector detector;
+  gvttest::Checks check(argv[0], rank == 0);
+
+  if (rank == 0) std::cout << "frame,ranks,tokens,waves,ms" << std::endl;
+
+  for (int frame = 0; frame < frames; ++frame) {
+    detector.reset();
+    MPI_Barrier(MPI_COMM_WORLD);
+    const clock_type::time_point t0 = clock_type::now();
+
+    std::deque<Token> work;
+    std::list<Delayed> outgoing, incoming;
+    std::list<std::pair<MPI_Request, Token *> > sends;
+    long created = 0, processed = 0;
+
+    // a few ranks start without work
+    const int initial = (rank % 3 == 2) ? 0 : std::uniform_int_distribution<int>(1, tokens)(rng);
+    for (int i = 0; i < initial; ++i) work.push_back({ 0, rank });
+    created += initial;
+
+    while (true) {
+      const clock_type::time_point now = clock_type::now();
+
+      // network: post the sends whose delay expired
+      for (auto it = outgoing.begin(); it != outgoing.end();) {
+        if (it->release > now) {
+          ++it;
+          continue;
+        }
+        Token *buf = new Token(it->token);
+        MPI_Request req;
+        MPI_Isend(buf, sizeof(Token), MPI_BYTE, it->rank, TOKEN_TAG, MPI_COMM_WORLD, &req);
+        sends.push_back({ req, buf });
+        it = outgoing.erase(it);
+      }
+      for (auto it = sends.begin(); it != sends.end();) {
+        int done = 0;
+        MPI_Test(&it->first, &done, MPI_STATUS_IGNORE);
+        if (!done) {
+          ++it;
+          continue;
+        }
+        delete it->second;
+        it = sends.erase(it);
+      }
+
+      // network: receive, and hold the token back before it becomes work
+      int flag = 0;
+      MPI_Status status;
+      MPI_Iprobe(MPI_ANY_SOURCE, TOKEN_TAG, MPI_COMM_WORLD, &flag, &status);
+      while (flag) {
+        Token t;
+        MPI_Recv(&t, sizeof(Token), MPI_BYTE, status.MPI_SOURCE, TOKEN_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        incoming.push_back({ now + std::chrono::microseconds(delay(rng)), rank, t });
+        MPI_Iprobe(MPI_ANY_SOURCE, TOKEN_TAG, MPI_COMM_WORLD, &flag, &status);
+      }
+      for (auto it = incoming.begin(); it != incoming.end();) {
+        if (it->release > now) {
+          ++it;
+          continue;
+        }
+        work.push_back(it->token);
+        detector.received();
+        it = incoming.erase(it);
+      }
+
+      // scheduler: process one token
+      if (!work.empty()) {
+        Token t = work.front();
+        work.pop_front();
+        const clock_type::time_point busy = clock_type::now() + std::chrono::microseconds(work_us(rng));
+        while (clock_type::now() < busy) {
+        }
+        processed++;
+        if (t.generation < generations) {
+          for (int c = children(rng); c > 0; --c) {
+            created++;
+            detector.sent();
+            outgoing.push_back({ clock_type::now() + std::chrono::microseconds(delay(rng)), target(rng),
+                                 { t.generation + 1, rank } });
+          }
+        }
+      }
+
+      // delayed sends and receives are in the network, the scheduler only knows about its work queue
+      if (detector.poll(work.empty())) break;
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(clock_type::now() - t0).count();
+
+    // nothing may be left anywhere
+    bool clean = work.empty() && outgoing.empty() && incoming.empty();
+    for (auto &s : sends) {
+      MPI_Wait(&s.first, MPI_STATUS_IGNORE);
+      delete s.second;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    int stray = 0;
+    MPI_Iprobe(MPI_ANY_SOURCE, TOKEN_TAG, MPI_COMM_WORLD, &stray, MPI_STATUS_IGNORE);
+    clean = clean && !stray;
+
+    long local[2] = { created, processed }, global[2];
+    MPI_Allreduce(local, global, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    int all_clean = 0, my_clean = clean ? 1 : 0;
+    MPI_Allreduce(&my_clean, &all_clean, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+    if (rank == 0)
+      std::cout << frame << "," << size << "," << global[0] << "," << detector.waves() << "," << ms << std::endl;
+    // whatever is left would leak into the next frame
+    if (!check(all_clean && global[0] == global[1], "frame " + std::to_string(frame) + " terminated early: " +
+                                                        std::to_string(global[1]) + " of " +
+                                                        std::to_string(global[0]) + " tokens processed"))
+      break;
+  }
+
+  MPI_Finalize();
+  return check.status();
+}
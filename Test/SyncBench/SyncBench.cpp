@@ -0,0 +1,159 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/**
+ * Scene database synchronization test and benchmark.
+ *
+ * Every rank adds the same mesh (as api::finishMesh does on each rank that owns a copy)
+ * and its own set of instances, then the database is synchronized with the per-node
+ * broadcast path (blindsync) and with the batched allgather path (batchsync). Prints the
+ * time of each and checks that all ranks end with identical databases and that the mesh
+ * "Locations" hold every rank. See checks.h.
+ *
+ * usage: mpirun -np P gvtSyncBench [-instances N] [-skip-legacy]
+*/
+
+#include <gvt/render/cntx/rcontext.h>
+#include <gvt/render/data/primitives/BBox.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../checks.h"
+#include "../timer.h"
+
+static void addScene(const std::string &prefix, size_t ninstances) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  const int rank = db.cntx_comm.rank;
+
+  const std::string meshname = prefix + "mesh";
+  db.createnode("Mesh", meshname, true, db.getUnique("Data").getid());
+  db.getChild(db.getUnique(meshname), "file") = meshname;
+  db.getChild(db.getUnique(meshname), "bbox") =
+      std::make_shared<gvt::render::data::primitives::Box3D>(glm::vec3(0.f), glm::vec3(1.f));
+  std::shared_ptr<std::vector<int> > v = std::make_shared<std::vector<int> >();
+  v->push_back(rank);
+  db.getChild(db.getUnique(meshname), "Locations") = v;
+
+  cntx::node &meshnode = db.getUnique(meshname);
+  for (size_t i = 0; i < ninstances; ++i) {
+    const std::string name = prefix + std::to_string(rank) + "_" + std::to_string(i);
+    cntx::node &inode = db.createnode("Instance", name, true, db.getUnique("Instances").getid());
+    std::shared_ptr<glm::mat4> m = std::make_shared<glm::mat4>(glm::translate(glm::mat4(1.f), glm::vec3(i, rank, 0)));
+    db.getChild(inode, "id") = inode.name;
+    db.getChild(inode, "meshRef") = meshnode.getid();
+    db.getChild(inode, "mat") = m;
+    db.getChild(inode, "matinv") = std::make_shared<glm::mat4>(glm::inverse(*m));
+    db.getChild(inode, "normi") = std::make_shared<glm::mat3>(1.f);
+    db.getChild(inode, "bbox") =
+        std::make_shared<gvt::render::data::primitives::Box3D>(glm::vec3(i, rank, 0), glm::vec3(i + 1, rank + 1, 1));
+    db.getChild(inode, "centroid") = glm::vec3(i + .5f, rank + .5f, .5f);
+  }
+}
+
+// order independent digest of the database structure (ids, parents and names)
+static size_t digest() {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  size_t h = db._map.size();
+  for (auto &kv : db._map) {
+    const cntx::node &n = kv.second;
+    h ^= std::hash<size_t>()(n.getid().getid()) + 0x9e3779b97f4a7c15ul + (h << 6) + (h >> 2);
+    h ^= std::hash<size_t>()(n.getparent().getid()) + 0x9e3779b97f4a7c15ul + (h << 6) + (h >> 2);
+    h ^= std::hash<std::string>()(n.name) + 0x9e3779b97f4a7c15ul + (h << 6) + (h >> 2);
+  }
+  return h;
+}
+
+static bool consistent(const std::string &prefix) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  bool ok = true;
+
+  unsigned long h = digest(), hmin = 0, hmax = 0;
+  MPI_Allreduce(&h, &hmin, 1, MPI_UNSIGNED_LONG, MPI_MIN, db.cntx_comm.comm);
+  MPI_Allreduce(&h, &hmax, 1, MPI_UNSIGNED_LONG, MPI_MAX, db.cntx_comm.comm);
+  ok = ok && (hmin == hmax);
+
+  std::shared_ptr<std::vector<int> > loc = db.getChild(db.getUnique(prefix + "mesh"), "Locations");
+  ok = ok && (loc->size() == db.cntx_comm.size);
+
+  int lok = ok, gok = 0;
+  MPI_Allreduce(&lok, &gok, 1, MPI_INT, MPI_MIN, db.cntx_comm.comm);
+  return gok;
+}
+
+int main(int argc, char **argv) {
+  size_t ninstances = 1000;
+  bool legacy = true;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-instances") && i + 1 < argc)
+      ninstances = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-skip-legacy"))
+      legacy = false;
+    else {
+      std::cerr << "usage: " << argv[0] << " [-instances N] [-skip-legacy]" << std::endl;
+      return 1;
+    }
+  }
+
+  MPI_Init(&argc, &argv);
+  cntx::rcontext &db = cntx::rcontext::instance();
+  const bool root = (db.cntx_comm.rank == 0);
+  gvttest::Checks check("gvtSyncBench", root);
+
+  if (root) std::cout << "mode,ranks,instances_per_rank,dirty_nodes,sync_ms,consistent" << std::endl;
+
+  const char *modes[] = { "blindsync", "batchsync" };
+  for (int batched = legacy ? 0 : 1; batched < 2; ++batched) {
+    const std::string prefix = batched ? "b" : "a";
+
+    // blindsync leaves the nodes it received dirty, clean them so both modes ship the same scene
+    for (auto &rn : db.getDirty(-1)) rn.get().id.resetDirty();
+    addScene(prefix, ninstances);
+
+    unsigned long dirty = db.getDirty(-1).size(), total = 0;
+    MPI_Allreduce(&dirty, &total, 1, MPI_UNSIGNED_LONG, MPI_SUM, db.cntx_comm.comm);
+
+    my_timer_t t0, t1;
+    MPI_Barrier(db.cntx_comm.comm);
+    timeCurrent(&t0);
+    db.sync(batched);
+    MPI_Barrier(db.cntx_comm.comm);
+    timeCurrent(&t1);
+
+    const bool same = consistent(prefix);
+    if (root)
+      std::cout << modes[batched] << "," << db.cntx_comm.size << "," << ninstances << "," << total << ","
+                << timeDifferenceMS(&t0, &t1) << "," << (same ? "yes" : "no") << std::endl;
+    check(same, std::string(modes[batched]) + " left the ranks with different databases or mesh locations");
+  }
+
+  MPI_Finalize();
+  return check.status();
+}
@@ -0,0 +1,91 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * Shared by the grouped test programs. A program holds related cases and runs the one named
+ * on its command line with the options that follow it:
+ *
+ *   gvtRayTransportTest codec -rays 1000
+ *
+ * Without a case it lists the cases and their options. A case reports each failed check on
+ * stderr as "FAIL: <case>: <what>" and exits non-zero if any check failed.
+*/
+
+#ifndef GVT_TEST_CHECKS_H
+#define GVT_TEST_CHECKS_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace gvttest {
+
+/// failed checks of a test case
+class Checks {
+public:
+  /**
+   * \param name case name, argv[0] of the case
+   * \param report print failures; MPI cases report their collective checks on rank 0 only
+   */
+  explicit Checks(const std::string &name, bool report = true) : name(name), report(report), failed(0) {}
+
+  /// count \p what as failed unless \p cond holds, returns cond
+  bool operator()(bool cond, const std::string &what) {
+    if (!cond) {
+      if (report) std::cerr << "FAIL: " << name << ": " << what << std::endl;
+      failed++;
+    }
+    return cond;
+  }
+
+  bool ok() const { return failed == 0; }
+  int status() const { return ok() ? EXIT_SUCCESS : EXIT_FAILURE; }
+
+private:
+  std::string name;
+  bool report;
+  int failed;
+};
+
+/// case of a test program
+struct Case {
+  const char *name;
+  int (*run)(int argc, char **argv); /**< argv[0] is the case name */
+  const char *options;
+};
+
+/// run the case named by argv[1] with the remaining arguments
+template <std::size_t N> int run(int argc, char **argv, const Case (&cases)[N]) {
+  if (argc > 1)
+    for (std::size_t i = 0; i < N; ++i)
+      if (!strcmp(argv[1], cases[i].name)) return cases[i].run(argc - 1, argv + 1);
+
+  std::cerr << "usage: " << argv[0] << " <case> [options]" << std::endl;
+  for (std::size_t i = 0; i < N; ++i) std::cerr << "  " << cases[i].name << " " << cases[i].options << std::endl;
+  return EXIT_FAILURE;
+}
+}
+
+#endif /* GVT_TEST_CHECKS_H */
@@ -0,0 +1,131 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/**
+ * Converts OBJ and PLY meshes to the .gvtm binary mesh format.
+ *
+ * Every input file becomes <out>/<name>.gvtm with vertex normals and bounding box computed, so
+ * api::createMeshFromFile, ObjReader and PlyReader map it instead of parsing the text. Files are
+ * assigned to MPI ranks by size (SceneLoader::assign) and converted by the rank's TBB threads.
+ *
+ * usage: gvtConvert -in <file or directory> [-out <directory>] [-threads N]
+ */
+#include <gvt/render/data/reader/GvtmFile.h>
+#include <gvt/render/data/reader/SceneLoader.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glob.h>
+#include <mpi.h>
+#include <sys/stat.h>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#include "ParseCommandLine.h"
+
+using namespace gvt::render::data::domain::reader;
+using namespace gvt::render::data::primitives;
+
+static std::vector<std::string> findMeshes(const std::string &dirname) {
+  std::vector<std::string> ret;
+  for (const std::string ext : { "obj", "ply" }) {
+    glob_t result;
+    const std::string exp = dirname + "/*." + ext;
+    if (glob(exp.c_str(), GLOB_TILDE, NULL, &result) == 0)
+      for (size_t i = 0; i < result.gl_pathc; i++) ret.push_back(std::string(result.gl_pathv[i]));
+    globfree(&result);
+  }
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  ParseCommandLine cmd("gvtConvert");
+  cmd.addoption("in", ParseCommandLine::PATH | ParseCommandLine::REQUIRED, "OBJ / PLY file or directory");
+  cmd.addoption("out", ParseCommandLine::PATH, "Output directory (default: the input directory)");
+  cmd.addoption("threads", ParseCommandLine::INT, "Number of threads to use (default number cores + ht)", 1);
+  cmd.parse(argc, argv);
+
+  const std::string in = cmd.get<std::string>("in");
+  struct stat buf;
+  if (stat(in.c_str(), &buf) != 0) {
+    if (rank == 0) std::cerr << "File \"" << in << "\" does not exist" << std::endl;
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  const bool isdir = S_ISDIR(buf.st_mode);
+  const std::vector<std::string> files = isdir ? findMeshes(in) : std::vector<std::string>(1, in);
+  std::string out = cmd.isSet("out") ? cmd.get<std::string>("out") : (isdir ? in : in.substr(0, in.find_last_of('/') + 1));
+  if (out.empty()) out = ".";
+
+  tbb::task_scheduler_init init(cmd.isSet("threads") ? cmd.get<int>("threads")
+                                                     : int(std::thread::hardware_concurrency()));
+
+  std::vector<uint64_t> sizes(files.size(), 0);
+  for (size_t i = 0; i < files.size(); ++i)
+    if (stat(files[i].c_str(), &buf) == 0) sizes[i] = buf.st_size;
+  const std::vector<int> owners = SceneLoader::assign(sizes, size);
+  std::vector<std::string> mine;
+  for (size_t i = 0; i < files.size(); ++i)
+    if (owners[i] == rank) mine.push_back(files[i]);
+
+  const auto t0 = std::chrono::high_resolution_clock::now();
+  std::atomic<long> failed(0), triangles(0);
+  tbb::parallel_for(size_t(0), mine.size(), [&](size_t i) {
+    const std::string &file = mine[i];
+    const size_t slash = file.find_last_of('/') + 1;
+    const std::string name = file.substr(slash, file.find_last_of('.') - slash);
+    try {
+      std::shared_ptr<Mesh> mesh = SceneLoader::read(file);
+      mesh->generateNormals();
+      GvtmWriter::write(out + "/" + name + ".gvtm", *mesh);
+      triangles += mesh->numFaces();
+    } catch (const std::exception &e) {
+      std::cerr << "gvtConvert: " << e.what() << std::endl;
+      failed++;
+    }
+  });
+  const double ms =
+      std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+
+  long local[3] = { long(mine.size()), failed, triangles }, total[3];
+  MPI_Reduce(local, total, 3, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (rank == 0)
+    std::cout << "gvtConvert: " << total[0] - total[1] << " of " << files.size() << " files, " << total[2]
+              << " triangles written to " << out << " in " << ms << " ms" << std::endl;
+
+  MPI_Finalize();
+  return (rank == 0 && total[1]) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
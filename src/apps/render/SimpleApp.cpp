@@ -125,6 +125,9 @@ int main(int argc, char **argv) {
   cmd.addoption("domain", ParseCommandLine::NONE, "Use embeded scene", 0);
   cmd.addoption("threads", ParseCommandLine::INT, "Number of threads to use (default number cores + ht)", 1);
   cmd.addoption("output", ParseCommandLine::PATH, "Output Image Path", 1);
+  cmd.addoption("depth", ParseCommandLine::INT, "Maximum ray depth (default 1)", 1);
+  cmd.addoption("wavefront", ParseCommandLine::NONE, "Trace a bounce at a time with ray compaction (Embree)", 0);
+  cmd.addoption("raysort", ParseCommandLine::NONE, "Coherence sort instance queues before tracing", 0);
   cmd.addconflict("image", "domain");
 
   cmd.addoption("embree", ParseCommandLine::NONE, "Embree Adapter Type", 0);
@@ -220,6 +223,7 @@ int main(int argc, char **argv) {
   float fov = (float)(45.0 * M_PI / 180.0);
 
   int rayMaxDepth = (int)1;
+  if (cmd.isSet("depth")) rayMaxDepth = cmd.get<int>("depth");
   int raySamples = (int)1;
   float jitterWindowSize = (float)0.5;
   string camname = "conecam";
@@ -290,6 +294,8 @@ int main(int argc, char **argv) {
   }
 
   api::addRenderer(rendername, adaptertype, schedtype, camname, filmname);
+  api::setWavefront(rendername, cmd.isSet("wavefront"));
+  api::setRaySort(rendername, cmd.isSet("raysort"));
   db.sync();
 //  db.printtreebyrank(std::cout);
   api::render(rendername);
@@ -299,6 +305,15 @@ int main(int argc, char **argv) {
   api::render(rendername);
   api::writeimage(rendername,outputpath+"0");
 
+#ifdef GVT_RENDER_ADAPTER_EMBREE
+  if (adaptertype == gvt::render::adapter::Embree) {
+    gvt::render::adapter::embree::LaneCounters &lanes = gvt::render::adapter::embree::LaneCounters::instance();
+    std::cout << "embree lane utilization: intersect " << lanes.intersect.utilization() << " ("
+              << lanes.intersect.packets << " packets), occlude " << lanes.occlude.utilization() << " ("
+              << lanes.occlude.packets << " packets)" << std::endl;
+  }
+#endif
+
 #if 0
   writeimage(rendername);
   // gvt::render::gvtRenderer *ren = gvt::render::gvtRenderer::instance();
@@ -21,6 +21,7 @@
 #include <set>
 #include <stdio.h>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 
@@ -43,6 +44,12 @@ template <typename Variant, typename Derived> struct context {
   std::map<identifier, anode<Variant>, idCompare> _map;
   std::map<std::string, identifier> _unique;
 
+  // Parent -> children index (ordered by id, same order as a _map scan) and
+  // parent -> name -> children with that name (getChild returns the first). Kept in sync
+  // by insertnode, erasenode and replaceNodeID; structural changes to _map must go through them.
+  std::unordered_map<std::size_t, std::set<std::size_t> > _children;
+  std::unordered_map<std::size_t, std::unordered_map<std::string, std::set<std::size_t> > > _named;
+
   std::atomic<unsigned> _identifier_counter;
 
   anode<Variant> _root;
@@ -86,8 +93,9 @@ template <typename Variant, typename Derived> struct context {
   static anode<Variant> &root() { return instance()._root; }
 
   static anode<Variant> &deRef(const identifier &id) {
-    if(instance()._map.find(id) == instance()._map.end()) throw std::runtime_error("[Error] : identifier  does not exist in database");
-    return instance()._map[id];
+    auto it = instance()._map.find(id);
+    if (it == instance()._map.end()) throw std::runtime_error("[Error] : identifier  does not exist in database");
+    return it->second;
   }
 
   anode<Variant> &createnode(const std::string type = "node", const std::string name = "", bool const &unique = false,
@@ -107,13 +115,13 @@ template <typename Variant, typename Derived> struct context {
     }
 
     n.unique = unique;
-    _map[n.getid()] = n;
+    insertnode(n);
 
     if (unique) _unique[name] = n.getid();
 
     create_children(n, type);
 
-    return _map[n.getid()];
+    return _map.find(n.getid())->second;
   }
 
   anode<Variant> &createnode_allranks(const std::string type, const std::string name = "", bool const &unique = false,
@@ -134,13 +142,13 @@ template <typename Variant, typename Derived> struct context {
     }
 
     n.unique = unique;
-    _map[n.getid()] = n;
+    insertnode(n);
 
     if (unique) _unique[name] = n.getid();
 
     create_children(n, type);
 
-    return _map[n.getid()];
+    return _map.find(n.getid())->second;
   }
 
   friend std::ostream &operator<<(std::ostream &os, const context &other) {
@@ -204,16 +212,43 @@ template <typename Variant, typename Derived> struct context {
   inline std::vector<std::reference_wrapper<anode<Variant> > > getChildren(const anode<Variant> &n) {
     std::vector<std::reference_wrapper<anode<Variant> > > c;
 
-    for (auto &kv : _map) {
+    auto it = _children.find(n.getid().getid());
+    if (it == _children.end()) return c;
 
-      if (kv.second.getparent() == n.getid()) {
-        c.push_back(std::ref(kv.second));
-      }
+    c.reserve(it->second.size());
+    for (auto &cid : it->second) {
+      c.push_back(std::ref(_map.find(nodeid(cid))->second));
     }
 
     return c;
   }
 
+  /**
+   * Insert (or overwrite) a node and keep the children indexes up to date.
+   * \return the node stored in the database
+   */
+  anode<Variant> &insertnode(anode<Variant> const &n) {
+    auto it = _map.find(n.getid());
+    if (it != _map.end()) {
+      unindexnode(it->second);
+      it->second = n;
+    } else {
+      it = _map.insert(std::make_pair(identifier(n.getid()), n)).first;
+    }
+    indexnode(it->second);
+    return it->second;
+  }
+
+  /**
+   * Remove a node and its index entries. The node's own children are left untouched.
+   */
+  void erasenode(const identifier &id) {
+    auto it = _map.find(id);
+    if (it == _map.end()) return;
+    unindexnode(it->second);
+    _map.erase(it);
+  }
+
   inline unsigned getUniqueIdentifier() {
     unsigned nid = 0;
     MPI_Allreduce(&_identifier_counter, &nid, 1, MPI_UNSIGNED, MPI_MAX, cntx_comm.comm);
@@ -225,8 +260,10 @@ template <typename Variant, typename Derived> struct context {
 
   inline anode<Variant> &getUnique(const std::string name) {
 
-    if (_unique.find(name) != _unique.end()) {
-      return _map[_unique[name]];
+    auto u = _unique.find(name);
+    if (u != _unique.end()) {
+      auto it = _map.find(u->second);
+      if (it != _map.end()) return it->second;
     }
 
     return anode<Variant>::error_node;
@@ -234,9 +271,11 @@ template <typename Variant, typename Derived> struct context {
 
   static inline anode<Variant> &getChild(const anode<Variant> &n, const std::string name) {
 
-    context::children_vector children = context::instance().getChildren(n);
-    for (auto &c : children) {
-      if (c.get().name == name) return c.get();
+    context &db = context::instance();
+    auto it = db._named.find(n.getid().getid());
+    if (it != db._named.end()) {
+      auto c = it->second.find(name);
+      if (c != it->second.end()) return db._map.find(nodeid(*c->second.begin()))->second;
     }
     throw std::runtime_error("Child " + name + " does not exist for " + n.name);
   }
@@ -247,7 +286,7 @@ template <typename Variant, typename Derived> struct context {
     for (auto &kv : context::instance()._map) {
       if (kv.second.id.isDirty() && (all == -1 || kv.second.id.getrank() == all) &&
           !(kv.first == context::instance().rootid())) {
-        _d.push_back(kv.second);
+        _d.push_back(std::ref(kv.second));
       }
     }
 
@@ -257,15 +296,33 @@ template <typename Variant, typename Derived> struct context {
   static inline void replaceNodeID(identifier oid,  identifier nid) {
 
     context &db = context::instance();
-    auto n = db._map[oid];
+    auto it = db._map.find(oid);
+    if (it == db._map.end()) return;
+    auto n = it->second;
     for (auto &v : db.getChildren(n)) {
       v.get().setparent(nid);
     }
 
+    // the children keep their ids, only the parent key of their index entries moves
+    auto ch = db._children.find(oid.getid());
+    if (ch != db._children.end()) {
+      std::set<std::size_t> c;
+      c.swap(ch->second);
+      db._children.erase(ch);
+      db._children[nid.getid()].swap(c);
+    }
+    auto nm = db._named.find(oid.getid());
+    if (nm != db._named.end()) {
+      std::unordered_map<std::string, std::set<std::size_t> > c;
+      c.swap(nm->second);
+      db._named.erase(nm);
+      db._named[nid.getid()].swap(c);
+    }
+
     n.setid(nid);
     n.getid().setDirty();
-    db._map.erase(db._map.find(oid));
-    db._map[n.getid()] = n;
+    db.erasenode(oid);
+    db.insertnode(n);
     db._unique[n.name] = n.getid();
 
   }
@@ -298,7 +355,7 @@ template <typename Variant, typename Derived> struct context {
       context::children_vector r = gatherChildrenRecursively(rn.get());
       c.insert(c.end(), r.begin(), r.end());
     }
-    c.push_back(v);
+    c.push_back(std::ref(v));
     return c;
   }
 
@@ -353,7 +410,7 @@ template <typename Variant, typename Derived> struct context {
           unsigned id = db.getUniqueIdentifier();
           sendString(s, i);
           if (visited.find(s) == visited.end()) {
-            recursiveChildReplace(db._map[db._unique[s]], id);
+            recursiveChildReplace(db.deRef(db._unique[s]), id);
           } else {
           }
 
@@ -366,7 +423,7 @@ template <typename Variant, typename Derived> struct context {
           unsigned id = db.getUniqueIdentifier();
           std::string s = receiveString(i);
           if (db._unique.find(s) != db._unique.end() && visited.find(s) == visited.end()) {
-            recursiveChildReplace(db._map[db._unique[s]], id);
+            recursiveChildReplace(db.deRef(db._unique[s]), id);
           } else {
           }
           db.getUniqueIdentifier();
@@ -378,9 +435,105 @@ template <typename Variant, typename Derived> struct context {
     return;
   }
 
-  static inline void sync() {
-    garantyUnique();
-    blindsync();
+  /**
+   * Make unique names and dirty nodes consistent across ranks.
+   * \param batched exchange everything with a constant number of collectives
+   *        (batchUnique/batchsync) instead of one broadcast per name and per node
+   */
+  static inline void sync(const bool batched = true) {
+    if (batched) {
+      batchUnique();
+      batchsync();
+    } else {
+      garantyUnique();
+      blindsync();
+    }
+  }
+
+  /**
+   * Gather every rank's encoded buffer on every rank with a single MPI_Allgatherv.
+   * \return one decoder per rank, all sharing the receive buffer
+   */
+  static inline std::vector<cntx::mpi::decode> allgather(const cntx::mpi::encode &enc) {
+    context &db = context::instance();
+    const int size = db.cntx_comm.size;
+
+    unsigned long s = enc.size();
+    std::vector<unsigned long> counts(size);
+    MPI_Allgather(&s, 1, MPI_UNSIGNED_LONG, &counts[0], 1, MPI_UNSIGNED_LONG, db.cntx_comm.comm);
+
+    std::vector<unsigned long> displs(size + 1, 0);
+    for (int i = 0; i < size; ++i) displs[i + 1] = displs[i] + counts[i];
+
+    std::shared_ptr<cntx::mpi::decode::BYTE> buff(
+        (cntx::mpi::decode::BYTE *)malloc(std::max<unsigned long>(displs[size], 1)), free);
+
+    if (displs[size] <= INT_MAX) {
+      std::vector<int> c(counts.begin(), counts.end());
+      std::vector<int> d(displs.begin(), displs.end() - 1);
+      MPI_Allgatherv(enc.getBuffer(), s, MPI_BYTE, buff.get(), &c[0], &d[0], MPI_BYTE, db.cntx_comm.comm);
+    } else {
+      // displacements overflow an int, fall back to one broadcast per rank
+      if (s > 0) memcpy(buff.get() + displs[db.cntx_comm.rank], enc.getBuffer(), s);
+      for (int i = 0; i < size; ++i) {
+        MPI_Bcast(buff.get() + displs[i], counts[i], MPI_BYTE, i, db.cntx_comm.comm);
+      }
+    }
+
+    std::vector<cntx::mpi::decode> r;
+    for (int i = 0; i < size; ++i) {
+      r.push_back(cntx::mpi::decode(std::shared_ptr<cntx::mpi::decode::BYTE>(buff, buff.get() + displs[i]), counts[i]));
+    }
+    return r;
+  }
+
+  /**
+   * Batched version of garantyUnique. Every rank learns all new unique names with one
+   * allgather, then each name gets a block of global ids as large as its largest subtree
+   * on any rank, so all ranks relabel the same subtrees identically without further
+   * communication. Names are processed in the same order as garantyUnique.
+   */
+  static inline void batchUnique() {
+    context &db = context::instance();
+
+    if (db.cntx_comm.size <= 1) return;
+
+    cntx::mpi::encode enc;
+    for (auto &v : db._unique) {
+      auto n = v.second;
+      if (n.isDirty() && !n.isGlobal()) enc.pack<std::string>(v.first);
+    }
+
+    std::vector<cntx::mpi::decode> recv = allgather(enc);
+
+    std::vector<std::string> names;
+    std::set<std::string> visited;
+    for (auto &dec : recv) {
+      while (dec.remaining() > 0) {
+        std::string s = dec.unpack<std::string>();
+        if (visited.insert(s).second) names.push_back(s);
+      }
+    }
+
+    // last entry carries the identifier counter so a single reduction syncs both
+    std::vector<unsigned long> stride(names.size() + 1, 0);
+    for (size_t k = 0; k < names.size(); ++k) {
+      auto it = db._unique.find(names[k]);
+      if (it != db._unique.end()) stride[k] = gatherChildrenRecursively(db.deRef(it->second)).size();
+    }
+    stride[names.size()] = db._identifier_counter;
+    MPI_Allreduce(MPI_IN_PLACE, &stride[0], stride.size(), MPI_UNSIGNED_LONG, MPI_MAX, db.cntx_comm.comm);
+
+    unsigned long next = stride[names.size()] + 1;
+    for (size_t k = 0; k < names.size(); ++k) {
+      auto it = db._unique.find(names[k]);
+      if (it != db._unique.end()) {
+        db._identifier_counter = next + 1;
+        recursiveChildReplace(db.deRef(it->second), next);
+      }
+      next += stride[k];
+    }
+    db._identifier_counter = next;
   }
 
   static inline void blindsync() {
@@ -426,24 +579,8 @@ template <typename Variant, typename Derived> struct context {
 
           n.id.resetDirty();
 
-          if (db._map.find(n.getid()) != db._map.end()) {
-
-             if(n.name == std::string("Locations")) {
-              std::shared_ptr<std::vector<int>> vec = n;
-              std::vector<int>& cv = *vec;
-              std::shared_ptr<std::vector<int>> lvec = db._map[n.getid()];
-              std::vector<int>& lcv = *lvec;
-
-              cv.insert(cv.end(),lcv.begin(), lcv.end());
-              std::sort(cv.begin(),cv.end());
-              cv.erase(std::unique(cv.begin(),cv.end()),cv.end());
-
-              if(db.cntx_comm.rank > i) n.id.setDirty();
-            } else if (n.name == std::string("ptr")) {
-              n.v = db._map[n.getid()].v;
-            }
-          }
-          db._map[n.getid()] = n;
+          if (mergereceived(n) && n.name == std::string("Locations") && db.cntx_comm.rank > i) n.id.setDirty();
+          db.insertnode(n);
           if (n.unique) db._unique[n.name] = n.getid();
           MPI_Barrier(db.cntx_comm.comm);
         }
@@ -451,9 +588,113 @@ template <typename Variant, typename Derived> struct context {
     }
   }
 
+  /**
+   * Batched version of blindsync. Each rank serializes all its dirty nodes into one
+   * buffer, the buffers are exchanged with a single allgather and every rank applies
+   * them in rank order (its own included), so all ranks end in the same state.
+   * Received nodes are stored clean.
+   */
+  static inline void batchsync() {
+
+    context &db = context::instance();
+
+    if (db.cntx_comm.size <= 1) return;
+
+    cntx::mpi::encode enc;
+    for (auto rn : getDirty(-1)) {
+      auto &n = rn.get();
+      n.id.resetDirty();
+      cntx::mpi::encode nenc;
+      n.pack(nenc);
+      // length prefixed, some variant types do not unpack everything they pack
+      enc.pack<std::size_t>(nenc.size());
+      enc.pack<cntx::mpi::BYTE>(nenc.getBuffer(), nenc.size());
+    }
+
+    std::vector<cntx::mpi::decode> recv = allgather(enc);
+
+    for (auto &dec : recv) {
+      while (dec.remaining() > 0) {
+        size_t s = dec.unpack<std::size_t>();
+        cntx::mpi::decode ndec(
+            std::shared_ptr<cntx::mpi::decode::BYTE>(dec.buffer, dec.buffer.get() + dec.current_buffer_offset), s);
+        dec.current_buffer_offset += s;
+
+        anode<Variant> n;
+        n.unpack(ndec);
+        mergereceived(n);
+        db.insertnode(n).id.resetDirty();
+        if (n.unique) db._unique[n.name] = n.getid();
+      }
+    }
+  }
+
+  /**
+   * Merge rules for a node received from another rank: "Locations" become the union of
+   * the local and remote lists and "ptr" keeps the local object.
+   * \return true if the node already existed locally
+   */
+  static inline bool mergereceived(anode<Variant> &n) {
+    context &db = context::instance();
+    auto it = db._map.find(n.getid());
+    if (it == db._map.end()) return false;
+
+    typedef std::shared_ptr<std::vector<int> > locations;
+    if (n.name == std::string("Locations")) {
+      if (!n.v.template is<locations>()) {
+        n.v = it->second.v;
+      } else if (it->second.v.template is<locations>()) {
+        std::vector<int> &cv = *n.v.template to<locations>();
+        locations lvec = it->second.v.template to<locations>();
+        cv.insert(cv.end(), lvec->begin(), lvec->end());
+        std::sort(cv.begin(), cv.end());
+        cv.erase(std::unique(cv.begin(), cv.end()), cv.end());
+      }
+    } else if (n.name == std::string("ptr")) {
+      n.v = it->second.v;
+    }
+    return true;
+  }
+
   anode<Variant> &create_children(anode<Variant> const &n, const std::string &type) {
     return (*reinterpret_cast<Derived *>(this)).create_children(n, type);
   }
+
+protected:
+  static inline identifier nodeid(const std::size_t id) {
+    identifier i;
+    i.id = id;
+    return i;
+  }
+
+  void indexnode(anode<Variant> const &n) {
+    const std::size_t id = n.getid().getid();
+    const std::size_t p = n.getparent().getid();
+    _children[p].insert(id);
+    _named[p][n.name].insert(id);
+  }
+
+  void unindexnode(anode<Variant> const &n) {
+    const std::size_t id = n.getid().getid();
+    const std::size_t p = n.getparent().getid();
+    auto ch = _children.find(p);
+    if (ch == _children.end()) return;
+    ch->second.erase(id);
+
+    auto nm = _named.find(p);
+    if (nm != _named.end()) {
+      auto it = nm->second.find(n.name);
+      if (it != nm->second.end()) {
+        it->second.erase(id);
+        if (it->second.empty()) nm->second.erase(it);
+      }
+    }
+
+    if (ch->second.empty()) {
+      _children.erase(ch);
+      if (nm != _named.end()) _named.erase(nm);
+    }
+  }
 };
 
 template <typename V, typename D> cntx::context<V, D> *cntx::context<V, D>::_singleton = nullptr;
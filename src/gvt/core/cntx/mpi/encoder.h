@@ -5,6 +5,7 @@
 #ifndef CONTEXT_ENCDEC_H
 #define CONTEXT_ENCDEC_H
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <cstdint>
@@ -50,8 +51,9 @@ struct encode {
 
     increase(size);
 
-    T* dst = offset<T*>(size);
+    T* dst = offset<T*>(current_buffer_offset);
     std::memcpy(dst,v,size);
+    current_buffer_offset += size;
 
 //    throw std::runtime_error("Buffer packing of " +
 //                             std::string(typeid(T).name()) + " node defined. ");
@@ -60,7 +62,7 @@ struct encode {
 
   BYTE *getBuffer() const { return buffer.get(); }
 
-  std::size_t size() { return current_buffer_size; }
+  std::size_t size() const { return current_buffer_offset; }
 
 private:
   template <typename T,
@@ -81,11 +83,12 @@ private:
       buffer = std::shared_ptr<BYTE>((BYTE *)malloc(size), free);
       current_buffer_size = size;
     } else if ((current_buffer_size - current_buffer_offset) < size) {
-      BYTE *tmpbuf =
-          reinterpret_cast<BYTE *>(malloc(current_buffer_size + size));
+      // grow geometrically, batched encoders pack thousands of nodes
+      std::size_t nsize = std::max(current_buffer_offset + size, 2 * current_buffer_size);
+      BYTE *tmpbuf = reinterpret_cast<BYTE *>(malloc(nsize));
       std::memcpy(tmpbuf, buffer.get(), current_buffer_offset);
       buffer = std::shared_ptr<BYTE>(tmpbuf, free);
-      current_buffer_size += size;
+      current_buffer_size = nsize;
     }
   }
 };
@@ -0,0 +1,84 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#include <gvt/core/comm/bufferpool.h>
+
+#include <tbb/cache_aligned_allocator.h>
+
+namespace gvt {
+namespace comm {
+
+const std::size_t BufferPool::MIN_CLASS;
+const std::size_t BufferPool::MAX_CLASS;
+const std::size_t BufferPool::MAX_FREE;
+const std::size_t BufferPool::MAX_RETAINED;
+
+BufferPool &BufferPool::instance() {
+  // leaked on purpose, see BufferPool
+  static BufferPool *pool = new BufferPool;
+  return *pool;
+}
+
+std::size_t BufferPool::sizeclass(std::size_t size) {
+  std::size_t c = MIN_CLASS;
+  while ((std::size_t(1) << c) < size) ++c;
+  return c;
+}
+
+BufferPool::Byte *BufferPool::acquire(std::size_t size, std::size_t &capacity) {
+  const std::size_t c = sizeclass(size);
+  capacity = std::size_t(1) << c;
+  if (c < MAX_CLASS) {
+    FreeList &fl = _free[c];
+    std::lock_guard<std::mutex> l(fl.m);
+    if (!fl.buffers.empty()) {
+      Byte *b = fl.buffers.back();
+      fl.buffers.pop_back();
+      _retained -= capacity;
+      _reuses++;
+      return b;
+    }
+  }
+  _allocations++;
+  return tbb::cache_aligned_allocator<Byte>().allocate(capacity);
+}
+
+void BufferPool::release(Byte *buffer, std::size_t capacity) {
+  if (!buffer) return;
+  const std::size_t c = sizeclass(capacity);
+  if (c < MAX_CLASS) {
+    FreeList &fl = _free[c];
+    std::lock_guard<std::mutex> l(fl.m);
+    if (fl.buffers.size() < MAX_FREE) {
+      if (_retained.fetch_add(capacity) + capacity <= MAX_RETAINED) {
+        fl.buffers.push_back(buffer);
+        return;
+      }
+      _retained -= capacity;
+    }
+  }
+  tbb::cache_aligned_allocator<Byte>().deallocate(buffer, capacity);
+}
+}
+}
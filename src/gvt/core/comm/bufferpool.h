@@ -0,0 +1,89 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#ifndef GVT_CORE_BUFFER_POOL_H
+#define GVT_CORE_BUFFER_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace gvt {
+namespace comm {
+
+/**
+ * \brief Recycles message buffers
+ *
+ * Buffers are handed out in power of two size classes and kept on a free list when released, so steady state
+ * messaging does not malloc/realloc per message. Reused buffers also stay registered with the network layer
+ * (MPI registration caches pin pages by address). Buffers are cache line aligned.
+ *
+ * The free lists hold at most MAX_RETAINED bytes in total, so a burst of large messages does not stay
+ * pinned once it is over. The pool is never destroyed: messages still queued in the communicator when
+ * static objects are torn down at exit release their buffers into it.
+ */
+struct BufferPool {
+  typedef unsigned char Byte;
+
+  static const std::size_t MIN_CLASS = 8;  /**< Smallest buffer 2^8 bytes */
+  static const std::size_t MAX_CLASS = 40; /**< Largest pooled buffer 2^39 bytes */
+  static const std::size_t MAX_FREE = 32;  /**< Buffers kept per size class */
+  static const std::size_t MAX_RETAINED = std::size_t(256) << 20; /**< Bytes kept on all free lists */
+
+  static BufferPool &instance();
+
+  /**
+   * Get a buffer of at least \p size bytes
+   * @param size     requested size in bytes
+   * @param capacity (out) actual buffer size, to be passed back to release
+   */
+  Byte *acquire(std::size_t size, std::size_t &capacity);
+
+  /**
+   * Return a buffer obtained with acquire
+   */
+  void release(Byte *buffer, std::size_t capacity);
+
+  std::size_t allocations() const { return _allocations; } /**< Buffers allocated from the system */
+  std::size_t reuses() const { return _reuses; }           /**< Buffers served from a free list */
+  std::size_t retained() const { return _retained; }       /**< Bytes held on the free lists */
+
+private:
+  BufferPool() {}
+  static std::size_t sizeclass(std::size_t size);
+
+  struct FreeList {
+    std::mutex m;
+    std::vector<Byte *> buffers;
+  };
+  FreeList _free[MAX_CLASS];
+  std::atomic<std::size_t> _allocations{ 0 };
+  std::atomic<std::size_t> _reuses{ 0 };
+  std::atomic<std::size_t> _retained{ 0 };
+};
+}
+}
+
+#endif /* GVT_CORE_BUFFER_POOL_H */
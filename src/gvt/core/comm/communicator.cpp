@@ -96,7 +96,7 @@ void communicator::send(std::shared_ptr<comm::Message> msg, std::size_t to) {
   //  std::cout << "Send : " << msg->buffer_size() << " on " << id() << " to " << to
   //            << std::flush << std::endl;
   aquireComm();
-  MPI_Send(msg->getMessage<void>(), msg->buffer_size(), MPI_BYTE, to, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD);
+  transmit(msg, to);
   releaseComm();
 };
 void communicator::broadcast(std::shared_ptr<comm::Message> msg) {
@@ -112,9 +112,44 @@ void communicator::broadcast(std::shared_ptr<comm::Message> msg) {
     new_msg->dst(i);
 
     aquireComm();
-    MPI_Send(msg->getMessage<void>(), msg->buffer_size(), MPI_BYTE, i, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD);
+    transmit(new_msg, i);
     releaseComm();
   }
 };
+
+// content + header of a zero copy message, they arrive as one contiguous buffer same as a regular message
+static MPI_Datatype wiretype(std::shared_ptr<comm::Message> &msg) {
+  int lengths[2] = { static_cast<int>(msg->size()), static_cast<int>(sizeof(Message::header)) };
+  MPI_Aint displacements[2];
+  MPI_Datatype types[2] = { MPI_BYTE, MPI_BYTE };
+  MPI_Get_address(msg->getMessage<void>(), &displacements[0]);
+  MPI_Get_address(msg->buffer(), &displacements[1]);
+  MPI_Datatype wire;
+  MPI_Type_create_struct(2, lengths, displacements, types, &wire);
+  MPI_Type_commit(&wire);
+  return wire;
+}
+
+void communicator::transmit(std::shared_ptr<comm::Message> msg, int to) {
+  if (!msg->zerocopy()) {
+    MPI_Send(msg->buffer(), msg->buffer_size(), MPI_BYTE, to, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD);
+    return;
+  }
+  MPI_Datatype wire = wiretype(msg);
+  MPI_Send(MPI_BOTTOM, 1, wire, to, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD);
+  MPI_Type_free(&wire);
+}
+
+MPI_Request communicator::itransmit(std::shared_ptr<comm::Message> msg, int to) {
+  MPI_Request request;
+  if (!msg->zerocopy()) {
+    MPI_Isend(msg->buffer(), msg->buffer_size(), MPI_BYTE, to, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD, &request);
+    return request;
+  }
+  MPI_Datatype wire = wiretype(msg);
+  MPI_Isend(MPI_BOTTOM, 1, wire, to, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD, &request);
+  MPI_Type_free(&wire); // freed once the pending send completes
+  return request;
+}
 }
 }
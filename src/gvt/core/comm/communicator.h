@@ -31,6 +31,8 @@
 #include <mutex>
 
 #include <map>
+#include <mpi.h>
+#include <tbb/concurrent_queue.h>
 #include <tbb/task_group.h>
 #include <vector>
 
@@ -60,8 +62,8 @@ struct communicator {
   int _id = 0;    /**< MPI rank */
   int _size = -1; /**< MPI world size */
 
-  std::vector<std::shared_ptr<Message> > _inbox; /**< Queue of messages received from other nodes waiting to be
-                                                    processed by the scheduler*/
+  tbb::concurrent_queue<std::shared_ptr<Message> > _inbox; /**< Queue of messages received from other nodes waiting
+                                                              to be processed by the scheduler*/
   std::shared_ptr<comm::vote::vote> voting;      /**< Voting state pointer for process agreement */
   std::mutex minbox;                             /**< Inbox mutex */
   std::mutex mvotebooth;
@@ -113,6 +115,13 @@ struct communicator {
   */
   virtual void broadcast(std::shared_ptr<comm::Message> msg);
 
+  /*!
+     \brief Take the next message from the inbox
+     \param msg Set to the oldest received message
+     \return false if the inbox is empty
+  */
+  virtual bool poll(std::shared_ptr<comm::Message> &msg) { return _inbox.try_pop(msg); }
+
   /*!
      \brief Terminate communicator
   */
@@ -149,9 +158,7 @@ struct communicator {
 
   template <class M> static std::shared_ptr<M> SAFE_DOWN_CAST(const std::shared_ptr<comm::Message> &msg) {
     if (msg->tag() >= registry_names.size()) return nullptr;
-    std::string classname = registry_names[msg->tag()];
-    if (registry_ids.find(classname) == registry_ids.end()) return nullptr;
-    if (registry_ids[classname] == msg->tag()) return std::static_pointer_cast<M>(msg);
+    if (msg->tag() == M::COMMUNICATOR_MESSAGE_TAG) return std::static_pointer_cast<M>(msg);
     return nullptr;
   }
 
@@ -166,6 +173,15 @@ protected:
   virtual ~communicator();
   virtual void aquireComm();
   virtual void releaseComm();
+  /*!
+     \brief Blocking MPI send of msg to compute node dst (caller holds the comm lock). Zero copy messages are sent
+     straight from their content and header buffers.
+  */
+  void transmit(std::shared_ptr<comm::Message> msg, int dst);
+  /*!
+     \brief Non-blocking version of @see transmit, msg must stay alive until the request completes
+  */
+  MPI_Request itransmit(std::shared_ptr<comm::Message> msg, int dst);
   virtual void run() = 0;
 };
 }
@@ -22,14 +22,17 @@
    ACI-1339881 and ACI-1339840
    ======================================================================================= */
 #include "acomm.h"
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <memory>
 #include <mpi.h>
+#include <thread>
 
 #include <iostream>
 namespace gvt {
 namespace comm {
-acomm::acomm() {}
+acomm::acomm() : _peers(new PeerCounters[_size]) {}
 
 void acomm::init(int argc, char *argv[], bool start_thread) {
   assert(!communicator::_instance);
@@ -68,48 +71,101 @@ void acomm::init(int argc, char *argv[], bool start_thread) {
   communicator::init(argc, argv, start_thread);
 }
 
+// spin while messages are likely to show up soon, then sleep 1us doubling up to 128us
+static void backoff(std::size_t idle) {
+  if (idle < 64) return std::this_thread::yield();
+  std::this_thread::sleep_for(std::chrono::microseconds(std::size_t(1) << std::min<std::size_t>((idle - 64) / 16, 7)));
+}
+
 void acomm::run() {
   std::cout << id() << " Communicator thread started" << std::endl;
+
+  // request slots [0, send_window) are sends, [send_window, window) receives
+  const std::size_t window = send_window + recv_window;
+  std::vector<MPI_Request> requests(window, MPI_REQUEST_NULL);
+  std::vector<std::shared_ptr<Message> > inflight(window);
+  std::vector<int> peers(window), bytes(window), completed(window);
+  std::vector<int> free_send, free_recv;
+  for (std::size_t i = 0; i < send_window; ++i) free_send.push_back(i);
+  for (std::size_t i = send_window; i < window; ++i) free_recv.push_back(i);
+
+  auto deliver = [&](std::shared_ptr<Message> &msg) {
+    if (msg->system_tag() == CONTROL_USER_TAG) _inbox.push(msg);
+    if (msg->system_tag() == CONTROL_VOTE_TAG) voting->processMessage(msg);
+  };
+
+  auto complete = [&](int slot) {
+    std::shared_ptr<Message> msg;
+    std::swap(msg, inflight[slot]);
+    if (slot < (int)send_window) {
+      _peers[peers[slot]].sent_messages++;
+      _peers[peers[slot]].sent_bytes += bytes[slot];
+      free_send.push_back(slot);
+    } else {
+      _peers[peers[slot]].received_messages++;
+      _peers[peers[slot]].received_bytes += bytes[slot];
+      free_recv.push_back(slot);
+      deliver(msg);
+    }
+  };
+
+  std::size_t idle = 0;
   while (!_terminate) {
-    {
-
-      if (!_outbox.empty()) {
-        std::lock_guard<std::mutex> l(moutbox);
-        std::shared_ptr<Message> msg = _outbox.front();
-        _outbox.erase(_outbox.begin());
-        aquireComm();
-        MPI_Send(msg->getMessage<void>(), msg->buffer_size(), MPI::BYTE, msg->dst(), CONTROL_SYSTEM_TAG,
-                 MPI_COMM_WORLD);
-        releaseComm();
-      }
+    bool progress = false;
+
+    std::shared_ptr<Message> msg;
+    while (!free_send.empty() && _outbox.try_pop(msg)) {
+      const int slot = free_send.back();
+      free_send.pop_back();
+      aquireComm();
+      requests[slot] = itransmit(msg, msg->dst());
+      releaseComm();
+      peers[slot] = msg->dst();
+      bytes[slot] = msg->buffer_size();
+      inflight[slot] = msg;
+      progress = true;
+    }
 
+    while (!free_recv.empty()) {
+      int flag = 0;
+      MPI_Message handle;
       MPI_Status status;
-      memset(&status, 0, sizeof(MPI_Status));
-      int flag;
       aquireComm();
-      MPI_Iprobe(MPI_ANY_SOURCE, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD, &flag, &status);
+      MPI_Improbe(MPI_ANY_SOURCE, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD, &flag, &handle, &status);
       releaseComm();
+      if (!flag) break;
       int n_bytes = 0;
       MPI_Get_count(&status, MPI_BYTE, &n_bytes);
+      const int slot = free_recv.back();
+      free_recv.pop_back();
+      inflight[slot] = std::make_shared<Message>(n_bytes - sizeof(Message::header));
+      peers[slot] = status.MPI_SOURCE;
+      bytes[slot] = n_bytes;
+      aquireComm();
+      MPI_Imrecv(inflight[slot]->buffer(), n_bytes, MPI_BYTE, &handle, &requests[slot]);
+      releaseComm();
+      progress = true;
+    }
 
-      if (n_bytes > 0) {
-        int sender = status.MPI_SOURCE;
-        const auto data_size = n_bytes - sizeof(Message::header);
-        std::shared_ptr<Message> msg = std::make_shared<Message>(data_size);
-
-        //        std::cout << "Recv : " << n_bytes << " on " << id() << " from " << sender
-        //                  << std::flush << std::endl;
-        aquireComm();
-        MPI_Recv(msg->getMessage<void>(), n_bytes, MPI_BYTE, sender, CONTROL_SYSTEM_TAG, MPI_COMM_WORLD,
-                 MPI_STATUS_IGNORE);
-        releaseComm();
-        msg->size(data_size);
-        std::lock_guard<std::mutex> l(minbox);
-        if (msg->system_tag() == CONTROL_USER_TAG) _inbox.push_back(msg);
-        if (msg->system_tag() == CONTROL_VOTE_TAG) voting->processMessage(msg);
-      }
+    int outcount = 0;
+    aquireComm();
+    MPI_Testsome(window, &requests[0], &outcount, &completed[0], MPI_STATUSES_IGNORE);
+    releaseComm();
+    if (outcount != MPI_UNDEFINED) {
+      for (int i = 0; i < outcount; ++i) complete(completed[i]);
+      progress = progress || outcount > 0;
     }
+
+    idle = progress ? 0 : idle + 1;
+    if (!progress) backoff(idle);
   }
+
+  // let the requests in flight finish, receives were already matched
+  aquireComm();
+  MPI_Waitall(window, &requests[0], MPI_STATUSES_IGNORE);
+  releaseComm();
+  for (std::size_t slot = 0; slot < window; ++slot)
+    if (inflight[slot]) complete(slot);
 }
 
 void acomm::send(std::shared_ptr<comm::Message> msg, std::size_t to) {
@@ -118,8 +174,7 @@ void acomm::send(std::shared_ptr<comm::Message> msg, std::size_t to) {
   assert(registry_ids.find(classname) != registry_ids.end());
   msg->src(id());
   msg->dst(to);
-  std::lock_guard<std::mutex> l(moutbox);
-  _outbox.push_back(msg);
+  _outbox.push(msg);
 };
 
 void acomm::broadcast(std::shared_ptr<comm::Message> msg) {
@@ -132,8 +187,7 @@ void acomm::broadcast(std::shared_ptr<comm::Message> msg) {
     std::shared_ptr<gvt::comm::Message> new_msg = std::make_shared<gvt::comm::Message>(*msg);
 
     new_msg->dst(i);
-    std::lock_guard<std::mutex> l(moutbox);
-    _outbox.push_back(new_msg);
+    _outbox.push(new_msg);
   }
 };
 }
@@ -26,6 +26,10 @@
 
 #include <gvt/core/comm/communicator.h>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
 namespace gvt {
 namespace comm {
     /**
@@ -37,6 +41,16 @@ namespace comm {
      *
      */
 struct acomm : public communicator {
+  /**
+   * @brief Messages and bytes exchanged with one compute node (completed requests only)
+   */
+  struct PeerCounters {
+    std::atomic<std::uint64_t> sent_messages{ 0 };
+    std::atomic<std::uint64_t> sent_bytes{ 0 };
+    std::atomic<std::uint64_t> received_messages{ 0 };
+    std::atomic<std::uint64_t> received_bytes{ 0 };
+  };
+
   acomm();
   /**
    * Communicator singleton initialization
@@ -58,11 +72,24 @@ struct acomm : public communicator {
   virtual void broadcast(std::shared_ptr<comm::Message> msg);
   /**
    * Method execute by the resident communication thread
+   *
+   * Progress engine: posts up to send_window MPI_Isend and recv_window MPI_Imrecv at a time and completes them with
+   * MPI_Testsome, so a large transfer never blocks the others. Backs off (yield, then sleeps up to 128us) while idle.
    */
   virtual void run();
 
-  std::vector<std::shared_ptr<Message> > _outbox; /**< Outbox message queue */
-  std::mutex moutbox; /** Outbox protection mutex */
+  /**
+   * Counters for the messages exchanged with compute node id
+   */
+  const PeerCounters &peer(std::size_t id) const { return _peers[id]; }
+
+  std::size_t send_window = 32; /**< Maximum in flight sends */
+  std::size_t recv_window = 32; /**< Maximum in flight receives */
+
+  tbb::concurrent_queue<std::shared_ptr<Message> > _outbox; /**< Outbox message queue */
+
+protected:
+  std::unique_ptr<PeerCounters[]> _peers; /**< Per compute node counters */
 };
 }
 }
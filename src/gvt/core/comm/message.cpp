@@ -39,30 +39,41 @@ namespace comm {
 
 Message::Message(const std::size_t &s) {
   _buffer_size = s + sizeof(header);
-  content = static_cast<Byte *>(std::malloc(_buffer_size));
+  content = BufferPool::instance().acquire(_buffer_size, _capacity);
   tag(COMMUNICATOR_MESSAGE_TAG);
   system_tag(CONTROL_USER_TAG);
   size(s);
 }
 
 Message::Message(const Message &msg) {
-  if (_buffer_size > 0) {
-    content = static_cast<Byte *>(std::realloc(content, msg.buffer_size()));
-  } else {
-    content = static_cast<Byte *>(std::malloc(msg.buffer_size()));
-  }
+  // external content is immutable and shared, only the header is copied
+  const std::size_t bytes = msg._payload ? sizeof(header) : msg.buffer_size();
+  content = BufferPool::instance().acquire(bytes, _capacity);
   _buffer_size = msg.buffer_size();
-  std::memcpy(content, msg.content, msg.buffer_size());
+  _payload = msg._payload;
+  _payload_owner = msg._payload_owner;
+  std::memcpy(content, msg.content, bytes);
 }
 
 Message::Message(Message &&msg) {
   std::swap(content, msg.content);
   std::swap(_buffer_size, msg._buffer_size);
+  std::swap(_capacity, msg._capacity);
+  std::swap(_payload, msg._payload);
+  std::swap(_payload_owner, msg._payload_owner);
 }
 
-Message::~Message() { std::free(content); }
+Message::~Message() { BufferPool::instance().release(content, _capacity); }
 
-Message::header &Message::getHeader() { return *reinterpret_cast<header *>(content + (_buffer_size - sizeof(header))); }
+void Message::reserve(std::size_t bytes) {
+  if (bytes <= _capacity) return;
+  BufferPool::instance().release(content, _capacity);
+  content = BufferPool::instance().acquire(bytes, _capacity);
+}
+
+Message::header &Message::getHeader() {
+  return *reinterpret_cast<header *>(content + (_payload ? 0 : _buffer_size - sizeof(header)));
+}
 std::size_t Message::tag() { return getHeader().USER_TAG; };
 void Message::tag(const std::size_t tag) { getHeader().USER_TAG = tag; };
 
@@ -29,6 +29,9 @@
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <vector>
+
+#include <gvt/core/comm/bufferpool.h>
 
 /**
  *  \brief Communication message definiton
@@ -180,29 +183,62 @@ struct Message {
    * Returns the message content as a buffer of type T
    * @return pointer to buffer of type T
    */
-  template <typename T> T *getMessage() { return reinterpret_cast<T *>(content); }
+  template <typename T> T *getMessage() { return reinterpret_cast<T *>(_payload ? _payload : content); }
+
+  /**
+   * True if the content is held outside the message buffer (@see setMessage(std::shared_ptr<std::vector<T> >)), the
+   * header then lives alone in the message buffer
+   */
+  bool zerocopy() const { return _payload != nullptr; }
+
+  /**
+   * Message buffer (content followed by the header, or only the header if zerocopy)
+   */
+  Byte *buffer() { return content; }
   /**
    * Set message content
    * @param orig Original buffer of type T
    * @param os   Number of elements of type T in the buffer
    */
   template <typename T> void setMessage(T *orig, const std::size_t &os) {
-    header &mhi = getHeader();
+    header mhi = getHeader();
     std::size_t bs = sizeof(T) * os;
-    if (_buffer_size > 0) {
-      content = static_cast<Byte *>(std::realloc(content, bs + sizeof(header)));
-    } else {
-      content = static_cast<Byte *>(std::malloc(bs + sizeof(header)));
-    }
+    reserve(bs + sizeof(header));
+    _payload = nullptr;
+    _payload_owner.reset();
     _buffer_size = bs + sizeof(header);
     std::memcpy(content, orig, bs);
     std::memcpy(content + bs, &mhi, sizeof(header));
     size(bs);
   }
+  /**
+   * Set message content without copying it. The message keeps \p payload alive and the communicator sends it
+   * straight from the vector storage.
+   * @param payload Buffer of type T (must not be modified while the message is alive)
+   */
+  template <typename T> void setMessage(std::shared_ptr<std::vector<T> > payload) {
+    if (payload->empty()) return setMessage(static_cast<T *>(nullptr), 0);
+    header mhi = getHeader();
+    std::size_t bs = sizeof(T) * payload->size();
+    reserve(sizeof(header));
+    _payload = reinterpret_cast<Byte *>(payload->data());
+    _payload_owner = payload;
+    _buffer_size = bs + sizeof(header);
+    std::memcpy(content, &mhi, sizeof(header));
+    size(bs);
+  }
 
 protected:
-  std::size_t _buffer_size = 0;
-  Byte *content = nullptr;
+  /**
+   * Make sure the message buffer holds at least \p bytes (contents are not preserved)
+   */
+  void reserve(std::size_t bytes);
+
+  std::size_t _buffer_size = 0;           /**< Bytes on the wire, content + header */
+  std::size_t _capacity = 0;              /**< Size of the pooled message buffer */
+  Byte *content = nullptr;                /**< Pooled message buffer */
+  Byte *_payload = nullptr;               /**< External content (zerocopy), nullptr if the content is in the buffer */
+  std::shared_ptr<void> _payload_owner;   /**< Keeps the external content alive */
 };
 
 /**
@@ -0,0 +1,87 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#include <gvt/core/comm/termination.h>
+
+namespace gvt {
+namespace comm {
+
+TerminationDetector::TerminationDetector(MPI_Comm comm) { MPI_Comm_dup(comm, &_comm); }
+
+TerminationDetector::~TerminationDetector() {
+  int finalized = 0;
+  MPI_Finalized(&finalized);
+  if (finalized) return;
+  if (_inflight) MPI_Wait(&_request, MPI_STATUS_IGNORE);
+  MPI_Comm_free(&_comm);
+}
+
+void TerminationDetector::start(const bool idle) {
+  if (_inflight || _terminated) return;
+  _local[0] = _sent;
+  _local[1] = _received;
+  _local[2] = idle ? 0 : 1;
+  MPI_Iallreduce(_local, _global, 3, MPI_UINT64_T, MPI_SUM, _comm, &_request);
+  _inflight = true;
+}
+
+bool TerminationDetector::test() {
+  if (_inflight) {
+    int done = 0;
+    MPI_Test(&_request, &done, MPI_STATUS_IGNORE);
+    if (done) complete();
+  }
+  return _terminated;
+}
+
+bool TerminationDetector::wait() {
+  if (_inflight) {
+    MPI_Wait(&_request, MPI_STATUS_IGNORE);
+    complete();
+  }
+  return _terminated;
+}
+
+void TerminationDetector::complete() {
+  _inflight = false;
+  _waves++;
+  Wave w;
+  w.sent = _global[0];
+  w.received = _global[1];
+  w.active = _global[2];
+  const bool clean = (w.active == 0) && (w.sent == w.received);
+  _terminated = clean && _last_clean && (w.sent == _last.sent) && (w.received == _last.received);
+  _last_clean = clean;
+  _last = w;
+}
+
+void TerminationDetector::reset() {
+  if (_inflight) wait();
+  _terminated = false;
+  _last_clean = false;
+  _waves = 0;
+  _last = Wave();
+}
+}
+}
@@ -0,0 +1,122 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+#ifndef GVT_CORE_TERMINATION_H
+#define GVT_CORE_TERMINATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <mpi.h>
+
+namespace gvt {
+namespace comm {
+
+/**
+ * \brief Distributed termination detection by message counting waves
+ *
+ * Every rank counts the messages it sent and the messages it finished processing. A wave sums (sent, received,
+ * active) over all ranks with a non-blocking MPI_Iallreduce, so it runs while the ranks keep tracing. The work is
+ * over once two consecutive waves found every rank idle and the same sent and received totals, i.e. nothing was in
+ * flight and nothing moved between the two (four counter method). A rank starts a wave only after its previous wave
+ * completed, so every read of the second wave happens after every read of the first.
+ *
+ * Waves are collective: all ranks have to start the same number of waves, in the same order. Counting is thread
+ * safe, start/test/wait are meant to be called from one thread.
+ */
+struct TerminationDetector {
+  /**
+   * \brief Global sums of one wave
+   */
+  struct Wave {
+    std::uint64_t sent = 0;     /**< Messages sent */
+    std::uint64_t received = 0; /**< Messages processed */
+    std::uint64_t active = 0;   /**< Ranks that still had work */
+  };
+
+  /**
+   * \brief Create the detector on a private duplicate of comm (collective)
+   */
+  TerminationDetector(MPI_Comm comm = MPI_COMM_WORLD);
+  ~TerminationDetector();
+
+  /**
+   * \brief Count n messages handed to the network
+   */
+  void sent(std::uint64_t n = 1) { _sent += n; }
+  /**
+   * \brief Count n received messages whose work is now visible to the idle check
+   */
+  void received(std::uint64_t n = 1) { _received += n; }
+
+  /**
+   * \brief Start a wave if none is in flight
+   * @param idle True if the rank has no local work (queued, outgoing or unprocessed incoming)
+   */
+  void start(const bool idle);
+  /**
+   * \brief Progress the wave in flight without blocking
+   * @return true once termination was detected
+   */
+  bool test();
+  /**
+   * \brief Complete the wave in flight
+   * @return true once termination was detected
+   */
+  bool wait();
+  /**
+   * \brief start + test, for schedulers that poll from their main loop
+   */
+  bool poll(const bool idle) {
+    if (!_inflight) start(idle);
+    return test();
+  }
+
+  /**
+   * \brief Start over for a new frame (completes a wave left in flight)
+   */
+  void reset();
+
+  bool terminated() const { return _terminated; }
+  bool pending() const { return _inflight; }
+  std::uint64_t waves() const { return _waves; } /**< Waves completed since reset */
+  const Wave &last() const { return _last; }     /**< Sums of the last completed wave */
+
+protected:
+  void complete();
+
+  MPI_Comm _comm = MPI_COMM_NULL;
+  MPI_Request _request = MPI_REQUEST_NULL;
+  std::atomic<std::uint64_t> _sent{ 0 };
+  std::atomic<std::uint64_t> _received{ 0 };
+  std::uint64_t _local[3];
+  std::uint64_t _global[3];
+  bool _inflight = false;
+  bool _terminated = false;
+  bool _last_clean = false;
+  std::uint64_t _waves = 0;
+  Wave _last;
+};
+}
+}
+
+#endif /* GVT_CORE_TERMINATION_H */
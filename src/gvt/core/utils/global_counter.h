@@ -51,6 +51,17 @@ struct global_counter {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     if (rank == 0) std::cout << text << "" << global << std::endl;
   }
+
+  /**
+   * Print the global sum divided by the global sum of count (e.g. mean size per message)
+   */
+  void print_mean(const global_counter &count) {
+    unsigned long local[2] = { local_value, count.local_value }, global[2];
+    MPI_Reduce(local, global, 2, MPI_UNSIGNED_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) std::cout << text << "" << (global[1] ? double(global[0]) / global[1] : 0.0) << std::endl;
+  }
 };
 }
 }
@@ -67,6 +78,7 @@ struct global_counter {
   void add(std::size_t amount) {}
 
   void print() {}
+  void print_mean(const global_counter &count) {}
 };
 }
 }
@@ -23,12 +23,15 @@
  *    ======================================================================================= */
 #include <gvt/render/Renderer.h>
 
+#include <algorithm>
+#include <mpi.h>
+
 using namespace gvt::render;
 
 gvtRenderer *gvtRenderer::__singleton = nullptr;
 
 gvtRenderer::~gvtRenderer() {}
-gvtRenderer::gvtRenderer() {
+gvtRenderer::gvtRenderer() : volume(false), accumulated_scene(0), accumulated_passes(0), accumulated_samples(0.f) {
 
   cntx::rcontext &db = cntx::rcontext::instance();
 
@@ -60,7 +63,10 @@ void gvtRenderer::reload(std::string const &name) {
   camera->setFilmsize(db.getChild(fil, "width"), db.getChild(fil, "height"));
 
   // image plane setup.
-  myimage = std::make_shared<composite::IceTComposite>(camera->getFilmSizeWidth(), camera->getFilmSizeHeight());
+  if (db.getChild(fil, "sparseComposite").to<bool>())
+    myimage = std::make_shared<composite::SparseComposite>(camera->getFilmSizeWidth(), camera->getFilmSizeHeight());
+  else
+    myimage = std::make_shared<composite::IceTComposite>(camera->getFilmSizeWidth(), camera->getFilmSizeHeight());
   // allocate rays (needed by tracer constructor)
 //  camera->AllocateCameraRays();
 //  camera->generateRays();
@@ -104,16 +110,99 @@ void gvtRenderer::reload(std::string const &name) {
 }
 
 void gvtRenderer::render(std::string const &name) {
-  reload(name);
-  camera->AllocateCameraRays();
-  camera->generateRays(volume);
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &ren = db.getUnique(name);
+  GVT_ASSERT(!ren.getid().isInvalid(), "Suplied renderer " << name << " is not valid");
+
+  if (!db.getChild(ren, "progressive").to<bool>()) {
+    // every call rebuilds camera, image and tracer from the context
+    resetAccumulation();
+    reload(name);
+    trace();
+    return;
+  }
+
+  const std::vector<float> view = viewState(name);
+  const std::string targets =
+      db.getChild(ren, "camera").to<std::string>() + "/" + db.getChild(ren, "film").to<std::string>();
+  int changed = (name != current_scheduler || targets != accumulated_targets || view != accumulated_view ||
+                 db.sceneVersion() != accumulated_scene);
+  // ranks restart together, a rank that missed an edit must not keep compositing its old passes
+  MPI_Allreduce(MPI_IN_PLACE, &changed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  if (changed) {
+    current_scheduler.clear();
+    reload(name);
+    current_scheduler = name;
+    accumulated_targets = targets;
+    accumulated_view = view;
+    accumulated_scene = db.sceneVersion();
+    accumulated_passes = 0;
+    accumulated_samples = 0.f;
+    accumulation.resize(camera->getFilmSizeWidth(), camera->getFilmSizeHeight());
+  }
+
+  // every rank generates camera rays, so the pass (and its jitter) is counted everywhere
+  const int samples = std::max(1, db.getChild(ren, "passSamples").to<int>());
+  camera->setSamples(samples);
+  camera->setPassJitter(accumulated_passes);
+  trace();
+  accumulated_passes++;
+  accumulated_samples += float(samples * samples);
+  // only rank 0 holds the composited image
+  if (MPI::COMM_WORLD.Get_rank() == 0 && myimage->colorbf())
+    accumulation.add(myimage->colorbf(), float(samples * samples));
+}
+
+void gvtRenderer::trace() {
   if (tracersync) {
+    camera->AllocateCameraRays();
+    camera->generateRays(volume);
     (*tracersync.get())();
   } else if (tracerasync) {
+    // async tracers generate the camera ray stream themselves, in waves bounded by the scheduler's rayBudget
     (*tracerasync.get())();
   }
 }
-void gvtRenderer::WriteImage(std::string const &name) { myimage->write(name); }
+
+std::vector<float> gvtRenderer::viewState(std::string const &name) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &ren = db.getUnique(name);
+  auto &cam = db.getUnique(db.getChild(ren, "camera"));
+  auto &fil = db.getUnique(db.getChild(ren, "film"));
+  const glm::vec3 eye = db.getChild(cam, "eyePoint");
+  const glm::vec3 focus = db.getChild(cam, "focus");
+  const glm::vec3 up = db.getChild(cam, "upVector");
+  const float fov = db.getChild(cam, "fov");
+  return { eye[0], eye[1], eye[2], focus[0], focus[1], focus[2], up[0], up[1], up[2], fov,
+           float(db.getChild(cam, "rayMaxDepth").to<int>()), float(db.getChild(cam, "jitterWindowSize").to<int>()),
+           float(db.getChild(fil, "width").to<int>()), float(db.getChild(fil, "height").to<int>()),
+           float(db.getChild(fil, "sparseComposite").to<bool>()), float(db.getChild(ren, "type").to<int>()),
+           float(db.getChild(ren, "adapter").to<int>()), float(db.getChild(ren, "volume").to<bool>()),
+           float(db.getChild(ren, "passSamples").to<int>()), float(db.getChild(ren, "nodeScene").to<bool>()) };
+}
+
+const float *gvtRenderer::image() {
+  if (MPI::COMM_WORLD.Get_rank() != 0) return nullptr;
+  if (accumulation.passes() > 0) return accumulation.image();
+  return myimage ? myimage->colorbf() : nullptr;
+}
+
+void gvtRenderer::resetAccumulation() {
+  accumulation.reset();
+  accumulated_passes = 0;
+  accumulated_samples = 0.f;
+  // forces a reload, the caller may have edited the context directly
+  current_scheduler.clear();
+}
+
+float gvtRenderer::accumulatedSamples() { return accumulated_samples; }
+
+void gvtRenderer::WriteImage(std::string const &name) {
+  if (accumulation.passes() > 0)
+    myimage->write(name, accumulation.image());
+  else
+    myimage->write(name);
+}
 
 gvtRenderer *gvtRenderer::instance() {
   if (__singleton == nullptr) {
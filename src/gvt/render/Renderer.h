@@ -25,6 +25,9 @@
 #define GVT_RENDER_RENDERER_H
 
 #include <gvt/render/cntx/rcontext.h>
+#include <gvt/render/composite/IceTComposite.h>
+#include <gvt/render/composite/ProgressiveBuffer.h>
+#include <gvt/render/composite/SparseComposite.h>
 #include <gvt/render/Schedulers.h>
 #include <gvt/render/data/scene/Image.h>
 #include <gvt/render/data/scene/gvtCamera.h>
@@ -35,6 +38,7 @@
 
 
 #include <memory>
+#include <vector>
 
 namespace gvt {
 namespace render {
@@ -48,8 +52,20 @@ public:
   ~gvtRenderer();
   static gvtRenderer *instance();
   void reload(std::string const &name = "Scheduler");
+  /**
+   * Render a frame. With the scheduler's "progressive" flag set, camera, image and tracer are kept between calls
+   * and every call adds a pass of passSamples x passSamples samples per pixel, at a new sub-pixel offset, to the
+   * accumulated image. Any change to the renderer, camera or film settings or to the scene (see
+   * cntx::rcontext::sceneChanged) starts a new image.
+   */
   void render(std::string const &name = "Scheduler");
   void WriteImage(std::string const &name = "Film");
+  /** Final RGBA image of the last render (the progressive mean in progressive mode), rank 0 only */
+  const float *image();
+  /** Drop the progressive passes, the next render starts a new image */
+  void resetAccumulation();
+  /** Samples per pixel in the progressive image (0 outside progressive mode) */
+  float accumulatedSamples();
 
 protected:
   gvtRenderer(); // constructor
@@ -60,8 +76,20 @@ protected:
   std::shared_ptr<algorithm::AbstractTrace> tracersync;
   std::shared_ptr<gvt::render::RayTracer> tracerasync;
 
+  /** Generate the camera rays and run the current tracer */
+  void trace();
+  /** Renderer, camera and film settings a progressive image depends on */
+  std::vector<float> viewState(std::string const &name);
+
   std::string current_scheduler;
   bool volume;
+
+  composite::ProgressiveBuffer accumulation; /**< Progressive passes of the current image */
+  std::string accumulated_targets;           /**< Camera and film names the passes were rendered with */
+  std::vector<float> accumulated_view;       /**< viewState the passes were rendered with */
+  unsigned accumulated_scene;                /**< Scene version the passes were rendered with */
+  std::size_t accumulated_passes;            /**< Passes rendered into the current image, on every rank */
+  float accumulated_samples;                 /**< Samples per pixel rendered into the current image */
 };
 }
 }
@@ -0,0 +1,243 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RayCodec.cpp
+ */
+
+#include <gvt/render/actor/RayCodec.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__) && defined(__F16C__)
+#include <immintrin.h>
+#define GVT_RAYCODEC_SIMD
+#endif
+
+using namespace gvt::render::actor;
+
+const unsigned RayCodec::VERSION;
+
+namespace {
+
+typedef RayCodec::CompactRay CompactRay;
+
+static_assert(sizeof(CompactRay) == 32, "compact ray must be 32 bytes");
+static_assert(sizeof(Ray::data) >= sizeof(Ray::rats), "raw rays are sent as Ray::data");
+
+inline float sign(const float v) { return std::signbit(v) ? -1.f : 1.f; }
+
+inline std::uint16_t snorm16(const float v) {
+  return std::uint16_t(std::int16_t(std::lrint(std::min(std::max(v, -1.f), 1.f) * 32767.f)));
+}
+
+inline std::uint16_t packBits(const Ray &r) {
+  const int depth = std::min(std::max(r.mice.depth, 0), RayCodec::MAX_DEPTH);
+  return std::uint16_t((depth << 3) | (r.mice.type & 0x7));
+}
+
+inline void unpackBits(const std::uint16_t bits, Ray &r) {
+  r.mice.depth = bits >> 3;
+  r.mice.type = bits & 0x7;
+}
+
+void encode1(const Ray &r, CompactRay &o) {
+  o.origin[0] = r.mice.origin.x;
+  o.origin[1] = r.mice.origin.y;
+  o.origin[2] = r.mice.origin.z;
+
+  // project onto the octahedron and fold the lower hemisphere over the upper one
+  const glm::vec3 &d = r.mice.direction;
+  const float l1 = std::fabs(d.x) + std::fabs(d.y) + std::fabs(d.z);
+  const float inv = (l1 > 0.f) ? 1.f / l1 : 0.f;
+  float x = d.x * inv, y = d.y * inv;
+  if (d.z < 0.f) {
+    const float ox = x;
+    x = (1.f - std::fabs(y)) * sign(ox);
+    y = (1.f - std::fabs(ox)) * sign(y);
+  }
+  o.direction[0] = snorm16(x);
+  o.direction[1] = snorm16(y);
+
+  o.color = RayCodec::toRGB9E5(r.mice.color);
+  o.w = RayCodec::toHalf(r.mice.w);
+  o.bits = packBits(r);
+  o.id = r.mice.id;
+  o.t_max = r.mice.t_max;
+}
+
+void decode1(const CompactRay &c, Ray &r) {
+  r.mice.origin = glm::vec3(c.origin[0], c.origin[1], c.origin[2]);
+
+  float x = std::int16_t(c.direction[0]) / 32767.f, y = std::int16_t(c.direction[1]) / 32767.f;
+  const float z = 1.f - std::fabs(x) - std::fabs(y);
+  if (z < 0.f) {
+    const float ox = x;
+    x = (1.f - std::fabs(y)) * sign(ox);
+    y = (1.f - std::fabs(ox)) * sign(y);
+  }
+  r.mice.direction = glm::normalize(glm::vec3(x, y, z));
+
+  r.mice.color = RayCodec::fromRGB9E5(c.color);
+  r.mice.w = RayCodec::fromHalf(c.w);
+  r.mice.id = c.id;
+  r.mice.t_min = Ray::RAY_EPSILON;
+  r.mice.t_max = c.t_max;
+  r.mice.t = r.mice.t_max;
+  unpackBits(c.bits, r);
+}
+
+#ifdef GVT_RAYCODEC_SIMD
+inline __m256 abs8(const __m256 v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v); }
+
+// +1 or -1 with the sign bit of v
+inline __m256 sign8(const __m256 v) {
+  return _mm256_or_ps(_mm256_and_ps(v, _mm256_set1_ps(-0.f)), _mm256_set1_ps(1.f));
+}
+
+inline void halves8(const float *in, std::uint16_t *out) {
+  _mm_storeu_si128((__m128i *)out, _mm256_cvtps_ph(_mm256_loadu_ps(in), _MM_FROUND_TO_NEAREST_INT));
+}
+
+inline __m256 floats8(const std::uint16_t *in) { return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)in)); }
+
+void encode8(const Ray *in, CompactRay *out) {
+  alignas(32) float dx[8], dy[8], dz[8], w[8];
+  alignas(32) std::int32_t ox[8], oy[8];
+  alignas(16) std::uint16_t hw[8];
+
+  for (int i = 0; i < 8; ++i) {
+    const Ray::rats &r = in[i].mice;
+    dx[i] = r.direction.x;
+    dy[i] = r.direction.y;
+    dz[i] = r.direction.z;
+    w[i] = r.w;
+  }
+
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), minus = _mm256_set1_ps(-1.f);
+  const __m256 x = _mm256_load_ps(dx), y = _mm256_load_ps(dy), z = _mm256_load_ps(dz);
+  const __m256 l1 = _mm256_add_ps(_mm256_add_ps(abs8(x), abs8(y)), abs8(z));
+  const __m256 inv = _mm256_and_ps(_mm256_div_ps(one, l1), _mm256_cmp_ps(l1, zero, _CMP_GT_OQ));
+  __m256 px = _mm256_mul_ps(x, inv), py = _mm256_mul_ps(y, inv);
+  const __m256 fx = _mm256_mul_ps(_mm256_sub_ps(one, abs8(py)), sign8(px));
+  const __m256 fy = _mm256_mul_ps(_mm256_sub_ps(one, abs8(px)), sign8(py));
+  const __m256 lower = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+  px = _mm256_blendv_ps(px, fx, lower);
+  py = _mm256_blendv_ps(py, fy, lower);
+  const __m256 scale = _mm256_set1_ps(32767.f);
+  px = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(px, minus), one), scale);
+  py = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(py, minus), one), scale);
+  _mm256_store_si256((__m256i *)ox, _mm256_cvtps_epi32(px));
+  _mm256_store_si256((__m256i *)oy, _mm256_cvtps_epi32(py));
+
+  halves8(w, hw);
+
+  for (int i = 0; i < 8; ++i) {
+    const Ray::rats &r = in[i].mice;
+    CompactRay &o = out[i];
+    o.origin[0] = r.origin.x;
+    o.origin[1] = r.origin.y;
+    o.origin[2] = r.origin.z;
+    o.direction[0] = std::uint16_t(std::int16_t(ox[i]));
+    o.direction[1] = std::uint16_t(std::int16_t(oy[i]));
+    o.color = RayCodec::toRGB9E5(r.color);
+    o.w = hw[i];
+    o.bits = packBits(in[i]);
+    o.id = r.id;
+    o.t_max = r.t_max;
+  }
+}
+
+void decode8(const CompactRay *in, Ray *out) {
+  alignas(32) float dx[8], dy[8], dz[8], w[8];
+  alignas(32) std::int32_t ox[8], oy[8];
+  alignas(16) std::uint16_t hw[8];
+
+  for (int i = 0; i < 8; ++i) {
+    const CompactRay &c = in[i];
+    ox[i] = std::int16_t(c.direction[0]);
+    oy[i] = std::int16_t(c.direction[1]);
+    hw[i] = c.w;
+  }
+
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f);
+  const __m256 scale = _mm256_set1_ps(1.f / 32767.f);
+  __m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_load_si256((const __m256i *)ox)), scale);
+  __m256 y = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_load_si256((const __m256i *)oy)), scale);
+  const __m256 z = _mm256_sub_ps(_mm256_sub_ps(one, abs8(x)), abs8(y));
+  const __m256 fx = _mm256_mul_ps(_mm256_sub_ps(one, abs8(y)), sign8(x));
+  const __m256 fy = _mm256_mul_ps(_mm256_sub_ps(one, abs8(x)), sign8(y));
+  const __m256 lower = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+  x = _mm256_blendv_ps(x, fx, lower);
+  y = _mm256_blendv_ps(y, fy, lower);
+  const __m256 len =
+      _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+  _mm256_store_ps(dx, _mm256_div_ps(x, len));
+  _mm256_store_ps(dy, _mm256_div_ps(y, len));
+  _mm256_store_ps(dz, _mm256_div_ps(z, len));
+
+  _mm256_store_ps(w, floats8(hw));
+
+  for (int i = 0; i < 8; ++i) {
+    const CompactRay &c = in[i];
+    Ray::rats &r = out[i].mice;
+    r.origin = glm::vec3(c.origin[0], c.origin[1], c.origin[2]);
+    r.direction = glm::vec3(dx[i], dy[i], dz[i]);
+    r.color = RayCodec::fromRGB9E5(c.color);
+    r.w = w[i];
+    r.id = c.id;
+    r.t_min = Ray::RAY_EPSILON;
+    r.t_max = c.t_max;
+    r.t = r.t_max;
+    unpackBits(c.bits, out[i]);
+  }
+}
+#endif
+}
+
+void RayCodec::encode(const Format f, const Ray *in, const std::size_t n, unsigned char *out) {
+  if (f == RAW) {
+    for (std::size_t i = 0; i < n; ++i) std::memcpy(out + i * sizeof(Ray::data), in[i].data, sizeof(Ray::data));
+    return;
+  }
+  CompactRay *o = reinterpret_cast<CompactRay *>(out);
+  std::size_t i = 0;
+#ifdef GVT_RAYCODEC_SIMD
+  for (; i + 8 <= n; i += 8) encode8(in + i, o + i);
+#endif
+  for (; i < n; ++i) encode1(in[i], o[i]);
+}
+
+void RayCodec::decode(const Format f, const unsigned char *in, const std::size_t n, Ray *out) {
+  if (f == RAW) {
+    for (std::size_t i = 0; i < n; ++i) std::memcpy(out[i].data, in + i * sizeof(Ray::data), sizeof(Ray::data));
+    return;
+  }
+  const CompactRay *c = reinterpret_cast<const CompactRay *>(in);
+  std::size_t i = 0;
+#ifdef GVT_RAYCODEC_SIMD
+  for (; i + 8 <= n; i += 8) decode8(c + i, out + i);
+#endif
+  for (; i < n; ++i) decode1(c[i], out[i]);
+}
@@ -0,0 +1,202 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RayCodec.h
+ *
+ * Wire encoding for rays sent between compute nodes.
+ */
+
+#ifndef GVT_RENDER_ACTOR_RAYCODEC_H
+#define GVT_RENDER_ACTOR_RAYCODEC_H
+
+#include <gvt/render/actor/Ray.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace gvt {
+namespace render {
+namespace actor {
+
+/**
+ * \brief Wire encoding for rays sent between compute nodes
+ *
+ * RAW sends the ray fields (Ray::data) and is lossless, meant for debugging. COMPACT packs a ray in 32 bytes:
+ *  - origin as three floats (exact)
+ *  - direction octahedral encoded in two 16 bit snorms (~1e-4 rad), renormalized on decode
+ *  - color as RGB9E5, three 9 bit mantissas sharing a 5 bit exponent; channels are clamped to [0, 65408] and
+ *    rounded to within 1/256 of the brightest channel
+ *  - weight as a half float
+ *  - depth (13 bits, clamped to [0, 8191]) and type (3 bits) in 16 bits
+ *  - id as a 32 bit integer
+ *  - t_max as a float (exact, the adapters clip every trace at t_max, so a shadow ray stops at its light)
+ * t_min is not sent (it is always Ray::RAY_EPSILON) and neither is t, which is reset to t_max; the adapters
+ * overwrite t on the next hit.
+ *
+ * encode / decode use AVX + F16C for blocks of 8 rays when the target supports it.
+ */
+class RayCodec {
+public:
+  /**
+   * \brief Encoding of a ray block
+   */
+  enum Format { RAW = 0, COMPACT = 1 };
+
+  /**
+   * \brief Wire format version, bumped whenever the COMPACT layout changes
+   */
+  static const unsigned VERSION = 2;
+
+  /**
+   * \brief COMPACT ray layout
+   */
+  struct CompactRay {
+    float origin[3];
+    std::uint16_t direction[2]; /**< octahedral snorm16 */
+    std::uint32_t color;        /**< rgb9e5 */
+    std::uint16_t w;            /**< half */
+    std::uint16_t bits;         /**< depth << 3 | type */
+    std::int32_t id;
+    float t_max;
+  };
+
+  static const unsigned DEPTH_BITS = 13;
+  static const int MAX_DEPTH = (1 << DEPTH_BITS) - 1;
+
+  /**
+   * \brief Bytes per ray in format f
+   */
+  static inline std::size_t rayBytes(const Format f) { return (f == RAW) ? sizeof(Ray::data) : sizeof(CompactRay); }
+
+  /**
+   * \brief Bytes of n rays in format f
+   */
+  static inline std::size_t encodedSize(const Format f, const std::size_t n) { return n * rayBytes(f); }
+
+  /**
+   * \brief Encode rays [in, in + n) into out (encodedSize(f, n) bytes)
+   */
+  static void encode(const Format f, const Ray *in, const std::size_t n, unsigned char *out);
+
+  /**
+   * \brief Decode n rays from in into [out, out + n)
+   */
+  static void decode(const Format f, const unsigned char *in, const std::size_t n, Ray *out);
+
+  /**
+   * \brief Float to half, round to nearest even, overflow to infinity
+   */
+  static inline std::uint16_t toHalf(float value) {
+    std::uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    const std::uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+    std::uint16_t h;
+    if (f >= (127u + 16u) << 23) {
+      h = (f > 0x7f800000u) ? 0x7e00 : 0x7c00;
+    } else if (f < 113u << 23) {
+      // subnormal, let the float adder do the rounding
+      const std::uint32_t magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+      float magic, v;
+      std::memcpy(&magic, &magic_bits, sizeof(magic));
+      std::memcpy(&v, &f, sizeof(v));
+      v += magic;
+      std::memcpy(&f, &v, sizeof(f));
+      h = std::uint16_t(f - magic_bits);
+    } else {
+      const std::uint32_t odd = (f >> 13) & 1u;
+      f += (std::uint32_t(15 - 127) << 23) + 0xfffu + odd;
+      h = std::uint16_t(f >> 13);
+    }
+    return h | std::uint16_t(sign >> 16);
+  }
+
+  /**
+   * \brief Non negative color to RGB9E5, round to nearest
+   */
+  static inline std::uint32_t toRGB9E5(const glm::vec3 &c) {
+    const float max_value = 65408.f; // 511 / 512 * 2^16
+    float v[3] = { c.x, c.y, c.z };
+    for (int i = 0; i < 3; ++i) v[i] = (v[i] > 0.f) ? std::min(v[i], max_value) : 0.f; // also drops NaN
+    const float m = std::max(std::max(v[0], v[1]), v[2]);
+    if (m == 0.f) return 0;
+    int e;
+    std::frexp(m, &e); // m < 2^e
+    int exp = std::max(e, -15) + 15;
+    float scale = std::ldexp(1.f, 24 - exp); // 2^(mantissa bits + bias - exp)
+    if (std::uint32_t(m * scale + 0.5f) == 512u) {
+      ++exp;
+      scale *= 0.5f;
+    }
+    std::uint32_t o = std::uint32_t(exp) << 27;
+    for (int i = 0; i < 3; ++i) o |= std::uint32_t(v[i] * scale + 0.5f) << (9 * i);
+    return o;
+  }
+
+  /**
+   * \brief RGB9E5 to color
+   */
+  static inline glm::vec3 fromRGB9E5(const std::uint32_t c) {
+    const float scale = std::ldexp(1.f, int(c >> 27) - 24);
+    return glm::vec3(float(c & 0x1ffu) * scale, float((c >> 9) & 0x1ffu) * scale, float((c >> 18) & 0x1ffu) * scale);
+  }
+
+  /**
+   * \brief Half to float
+   */
+  static inline float fromHalf(const std::uint16_t h) {
+    const std::uint32_t shifted_exp = 0x7c00u << 13;
+    std::uint32_t o = (h & 0x7fffu) << 13;
+    const std::uint32_t exp = shifted_exp & o;
+    o += (127u - 15u) << 23;
+    float f;
+    if (exp == shifted_exp) {
+      o += (128u - 16u) << 23;
+      std::memcpy(&f, &o, sizeof(f));
+    } else if (exp == 0) {
+      const std::uint32_t magic_bits = 113u << 23;
+      float magic;
+      std::memcpy(&magic, &magic_bits, sizeof(magic));
+      o += 1u << 23;
+      std::memcpy(&f, &o, sizeof(f));
+      f -= magic;
+    } else {
+      std::memcpy(&f, &o, sizeof(f));
+    }
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    bits |= std::uint32_t(h & 0x8000u) << 16;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+};
+}
+}
+}
+
+#endif /* GVT_RENDER_ACTOR_RAYCODEC_H */
@@ -33,6 +33,7 @@
 #include <gvt/core/Debug.h>
 #include <gvt/core/Math.h>
 #include <gvt/render/actor/Ray.h>
+#include <gvt/render/actor/RayStream.h>
 #include <gvt/render/data/primitives/BBox.h>
 
 #include <climits>
@@ -77,12 +78,13 @@ template <size_t simd_width> struct RayPacketIntersection {
   /**
    * Creates ray packet of the first simd_width elements from list of rays starting at ray_begin.
    * @method RayPacketIntersection
-   * @param  ray_begin             Ray start iterator
+   * @param  ray_begin             Ray start iterator (RayVector::iterator or Ray *)
    * @param  ray_end               Ray list end iterator
    */
-  inline RayPacketIntersection(const RayVector::iterator &ray_begin, const RayVector::iterator &ray_end) {
+  template <typename RayIterator>
+  inline RayPacketIntersection(const RayIterator &ray_begin, const RayIterator &ray_end) {
     size_t i;
-    RayVector::iterator rayit = ray_begin;
+    RayIterator rayit = ray_begin;
     for (i = 0; rayit != ray_end && i < simd_width; ++i, ++rayit) {
       Ray &ray = (*rayit);
       ox[i] = ray.mice.origin[0];
@@ -100,6 +102,53 @@ template <size_t simd_width> struct RayPacketIntersection {
     }
   }
 
+  /**
+   * Creates ray packet of the first simd_width elements of a ray stream starting at index begin.
+   *
+   * The stream columns are contiguous so the packet is filled with straight loads.
+   * @method RayPacketIntersection
+   * @param  stream                Ray stream
+   * @param  begin                 Index of the first ray in the packet
+   * @param  end                   Ray stream end index
+   */
+  inline RayPacketIntersection(const RayStream &stream, const size_t begin, const size_t end) {
+    const size_t count = fastmin(simd_width, end - begin);
+    const float *sox = stream.ox + begin, *soy = stream.oy + begin, *soz = stream.oz + begin;
+    const float *sdx = stream.dx + begin, *sdy = stream.dy + begin, *sdz = stream.dz + begin;
+    const float *st = stream.t_max + begin;
+    if (count == simd_width) {
+#ifndef __clang__
+#pragma simd
+#endif
+      for (size_t i = 0; i < simd_width; ++i) {
+        ox[i] = sox[i];
+        oy[i] = soy[i];
+        oz[i] = soz[i];
+        dx[i] = 1.f / sdx[i];
+        dy[i] = 1.f / sdy[i];
+        dz[i] = 1.f / sdz[i];
+        t[i] = st[i];
+        mask[i] = 1;
+      }
+      return;
+    }
+    size_t i;
+    for (i = 0; i < count; ++i) {
+      ox[i] = sox[i];
+      oy[i] = soy[i];
+      oz[i] = soz[i];
+      dx[i] = 1.f / sdx[i];
+      dy[i] = 1.f / sdy[i];
+      dz[i] = 1.f / sdz[i];
+      t[i] = st[i];
+      mask[i] = 1;
+    }
+    for (; i < simd_width; ++i) {
+      t[i] = -1;
+      mask[i] = -1;
+    }
+  }
+
   /**
    * Computed the intersection of all rays in the packet with a AABB.
    * @method intersect
@@ -109,6 +158,19 @@ template <size_t simd_width> struct RayPacketIntersection {
    * @return           At least one ray hits the AABB
    */
   inline bool intersect(const gvt::render::data::primitives::Box3D &bb, int hit[], bool update = false) {
+    return intersect(bb.bounds_min, bb.bounds_max, hit, update);
+  }
+
+  /**
+   * Computed the intersection of all rays in the packet with a AABB given by its corners.
+   * @method intersect
+   * @param  lo        AABB lower corner
+   * @param  hi        AABB upper corner
+   * @param  hit       Array returns if the corresponding index ray hits the AABB (1) or not (-1)
+   * @param  update    Should update t or not.
+   * @return           At least one ray hits the AABB
+   */
+  inline bool intersect(const glm::vec3 &lo, const glm::vec3 &hi, int hit[], bool update = false) {
     float lx[simd_width];
     float ly[simd_width];
     float lz[simd_width];
@@ -127,8 +189,8 @@ template <size_t simd_width> struct RayPacketIntersection {
     float tnear[simd_width];
     float tfar[simd_width];
 
-    const float blx = bb.bounds_min[0], bly = bb.bounds_min[1], blz = bb.bounds_min[2];
-    const float bux = bb.bounds_max[0], buy = bb.bounds_max[1], buz = bb.bounds_max[2];
+    const float blx = lo[0], bly = lo[1], blz = lo[2];
+    const float bux = hi[0], buy = hi[1], buz = hi[2];
 #ifndef __clang__
 #pragma simd
 #endif
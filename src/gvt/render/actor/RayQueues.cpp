@@ -0,0 +1,152 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RayQueues.cpp
+ */
+
+#include <gvt/render/actor/RayQueues.h>
+
+using namespace gvt::render::actor;
+
+void RayQueues::reset(std::size_t n) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _queues.clear();
+  _queues.resize(n);
+  _local.assign(n, 1);
+  _heap.clear();
+  _position.assign(n, -1);
+  _remote.clear();
+  _listed.assign(n, 0);
+  _cursor.assign(n, 0);
+  _rays = 0;
+}
+
+void RayQueues::setLocal(int id, bool local) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (bool(_local[id]) == local) return;
+  // take the queue out of the structure it is in, update puts it in the other one
+  if (_position[id] >= 0) {
+    const std::size_t i = _position[id];
+    swapHeap(i, _heap.size() - 1);
+    _heap.pop_back();
+    _position[id] = -1;
+    if (i < _heap.size()) {
+      siftUp(i);
+      siftDown(i);
+    }
+  }
+  _local[id] = local;
+  update(id);
+}
+
+std::size_t RayQueues::rays() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _rays;
+}
+
+std::size_t RayQueues::count(int id) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _queues[id].size();
+}
+
+int RayQueues::top() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _heap.empty() ? -1 : _heap.front();
+}
+
+std::size_t RayQueues::take(int id, RayVector &out) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  out.clear();
+  std::swap(_queues[id], out);
+  _rays -= out.size();
+  update(id);
+  return out.size();
+}
+
+void RayQueues::clear() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto &q : _queues) q.clear();
+  for (int id : _heap) _position[id] = -1;
+  _heap.clear();
+  for (int id : _remote) _listed[id] = 0;
+  _remote.clear();
+  _rays = 0;
+}
+
+void RayQueues::update(int id) {
+  const std::size_t n = _queues[id].size();
+  if (!_local[id]) {
+    if (n && !_listed[id]) {
+      _listed[id] = 1;
+      _remote.push_back(id);
+    }
+    return;
+  }
+  long i = _position[id];
+  if (i < 0) {
+    if (!n) return;
+    _heap.push_back(id);
+    _position[id] = _heap.size() - 1;
+    siftUp(_heap.size() - 1);
+  } else if (!n) {
+    swapHeap(i, _heap.size() - 1);
+    _heap.pop_back();
+    _position[id] = -1;
+    if (std::size_t(i) < _heap.size()) {
+      siftUp(i);
+      siftDown(i);
+    }
+  } else {
+    siftUp(i);
+    siftDown(_position[id]);
+  }
+}
+
+void RayQueues::swapHeap(std::size_t a, std::size_t b) {
+  std::swap(_heap[a], _heap[b]);
+  _position[_heap[a]] = a;
+  _position[_heap[b]] = b;
+}
+
+void RayQueues::siftUp(std::size_t i) {
+  while (i > 0) {
+    const std::size_t parent = (i - 1) / 2;
+    if (_queues[_heap[parent]].size() >= _queues[_heap[i]].size()) break;
+    swapHeap(i, parent);
+    i = parent;
+  }
+}
+
+void RayQueues::siftDown(std::size_t i) {
+  const std::size_t n = _heap.size();
+  for (;;) {
+    std::size_t largest = i;
+    const std::size_t l = 2 * i + 1, r = 2 * i + 2;
+    if (l < n && _queues[_heap[l]].size() > _queues[_heap[largest]].size()) largest = l;
+    if (r < n && _queues[_heap[r]].size() > _queues[_heap[largest]].size()) largest = r;
+    if (largest == i) break;
+    swapHeap(i, largest);
+    i = largest;
+  }
+}
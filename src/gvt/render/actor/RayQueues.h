@@ -0,0 +1,274 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RayQueues.h
+ *
+ * Dense per instance ray queues filled by a parallel radix partition.
+ */
+
+#ifndef GVT_RENDER_ACTOR_RAYQUEUES_H
+#define GVT_RENDER_ACTOR_RAYQUEUES_H
+
+#include <gvt/render/actor/Ray.h>
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace gvt {
+namespace render {
+namespace actor {
+
+/**
+ * \brief Dense instance ray queues
+ *
+ * One queue per instance, indexed by the instance id. Rays are moved into the queues with a two pass partition:
+ * the blocks of the input are classified and counted per target queue in parallel, the counts become per block
+ * write offsets (queue major, block minor, so every queue keeps the input order), each target queue is grown once
+ * and the blocks scatter their rays in parallel straight into their final slots. Block histograms are sparse, a
+ * block only lists the queues it actually hits, so the cost does not grow with the number of instances.
+ *
+ * No per queue locks are involved. One table lock is held while queues are grown and written, it only serializes
+ * partitions issued from different threads (e.g. rays received by the communicator thread) against each other and
+ * against take.
+ *
+ * Non empty queues of local instances are kept in an indexed max heap keyed by their ray count, so the scheduler
+ * finds the largest one in O(1) instead of scanning every queue. Non empty queues of remote instances are listed
+ * for @see drainRemote.
+ */
+class RayQueues {
+public:
+  /**
+   * \brief Start over with n empty queues, all local
+   */
+  void reset(std::size_t n);
+
+  /**
+   * \brief Mark a queue local (schedulable with top) or remote (drained with drainRemote)
+   */
+  void setLocal(int id, bool local);
+
+  /**
+   * \brief Number of queues
+   */
+  std::size_t size() const { return _queues.size(); }
+
+  /**
+   * \brief Number of rays in all queues
+   */
+  std::size_t rays() const;
+
+  /**
+   * \brief True if every queue is empty
+   */
+  bool empty() const { return rays() == 0; }
+
+  /**
+   * \brief Number of rays in a queue
+   */
+  std::size_t count(int id) const;
+
+  /**
+   * \brief Local queue with the most rays, -1 if all local queues are empty
+   */
+  int top() const;
+
+  /**
+   * \brief Move a queue out
+   *
+   * The queue takes over the storage of out (cleared), which lets callers recycle a buffer between takes.
+   *
+   * @return number of rays moved
+   */
+  std::size_t take(int id, RayVector &out);
+
+  /**
+   * \brief Append n rays to a queue, fill(Ray *) writes them in place
+   */
+  template <typename Fill> void append(int id, std::size_t n, Fill fill) {
+    if (n == 0) return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    RayVector &q = _queues[id];
+    const std::size_t first = q.size();
+    q.resize(first + n);
+    fill(q.data() + first);
+    _rays += n;
+    update(id);
+  }
+
+  /**
+   * \brief Move every non empty remote queue out, drain(int id, RayVector &&rays) is called outside the lock
+   * @return number of rays drained
+   */
+  template <typename Drain> std::size_t drainRemote(Drain drain) {
+    std::vector<std::pair<int, RayVector> > out;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      out.reserve(_remote.size());
+      for (int id : _remote) {
+        _listed[id] = 0;
+        if (_local[id] || _queues[id].empty()) continue;
+        _rays -= _queues[id].size();
+        out.emplace_back(id, std::move(_queues[id]));
+        _queues[id].clear();
+      }
+      _remote.clear();
+    }
+    std::size_t drained = 0;
+    for (auto &q : out) {
+      drained += q.second.size();
+      drain(q.first, std::move(q.second));
+    }
+    return drained;
+  }
+
+  /**
+   * \brief Partition n rays into the queues
+   *
+   * @param n        number of input rays
+   * @param grain    rays per block
+   * @param classify classify(begin, end, target) fills target[0, end - begin) with the queue of each ray of the
+   *                 block [begin, end), -1 for rays that are not queued. It runs once per ray and may update rays
+   *                 or write to the framebuffer.
+   * @param fetch    fetch(i, Ray &out) writes input ray i into its queue slot
+   */
+  template <typename Classify, typename Fetch>
+  void partition(const std::size_t n, std::size_t grain, Classify classify, Fetch fetch) {
+    if (n == 0) return;
+    grain = grain ? grain : 1;
+    const std::size_t blocks = (n + grain - 1) / grain;
+    const std::size_t nq = _queues.size();
+    std::vector<int> target(n);
+    std::vector<Histogram> hist(blocks);
+
+    // pass 1: classify and count
+    tbb::parallel_for(std::size_t(0), blocks, [&](std::size_t b) {
+      const std::size_t begin = b * grain, end = std::min(n, begin + grain);
+      int *t = target.data() + begin;
+      classify(begin, end, t);
+      std::vector<std::size_t> &c = scratch(nq);
+      Histogram &h = hist[b];
+      for (std::size_t i = 0; i < end - begin; ++i) {
+        if (t[i] < 0) continue;
+        if (c[t[i]]++ == 0) h.emplace_back(t[i], 0);
+      }
+      for (auto &e : h) {
+        e.second = c[e.first];
+        c[e.first] = 0;
+      }
+    });
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // offsets: grow every target queue once, then hand out consecutive ranges in block order
+    std::vector<int> touched;
+    for (auto &h : hist)
+      for (auto &e : h) {
+        if (_cursor[e.first] == 0) touched.push_back(e.first);
+        _cursor[e.first] += e.second;
+      }
+    std::size_t total = 0;
+    for (int id : touched) total += _cursor[id];
+    tbb::parallel_for(std::size_t(0), touched.size(), [&](std::size_t i) {
+      RayVector &q = _queues[touched[i]];
+      const std::size_t first = q.size();
+      q.resize(first + _cursor[touched[i]]);
+      _cursor[touched[i]] = first;
+    });
+    for (auto &h : hist)
+      for (auto &e : h) {
+        const std::size_t c = e.second;
+        e.second = _cursor[e.first];
+        _cursor[e.first] += c;
+      }
+    for (int id : touched) _cursor[id] = 0;
+
+    // pass 2: scatter
+    tbb::parallel_for(std::size_t(0), blocks, [&](std::size_t b) {
+      const std::size_t begin = b * grain, end = std::min(n, begin + grain);
+      const int *t = target.data() + begin;
+      std::vector<std::size_t> &c = scratch(nq);
+      for (auto &e : hist[b]) c[e.first] = e.second;
+      for (std::size_t i = 0; i < end - begin; ++i) {
+        if (t[i] < 0) continue;
+        fetch(begin + i, _queues[t[i]][c[t[i]]++]);
+      }
+      for (auto &e : hist[b]) c[e.first] = 0;
+    });
+
+    _rays += total;
+    for (int id : touched) update(id);
+  }
+
+  /**
+   * \brief Empty every queue (keeps the local flags)
+   */
+  void clear();
+
+  /**
+   * \brief Direct access, not synchronized
+   */
+  RayVector &operator[](int id) { return _queues[id]; }
+
+protected:
+  typedef std::vector<std::pair<int, std::size_t> > Histogram; /**< (queue, count) of one block */
+
+  /**
+   * \brief Per thread queue counters, all zero between uses
+   */
+  std::vector<std::size_t> &scratch(std::size_t n) {
+    std::vector<std::size_t> &c = _scratch.local();
+    if (c.size() < n) c.resize(n, 0);
+    return c;
+  }
+
+  /**
+   * \brief Bring queue id back in line with its size (heap position or remote list), lock held
+   */
+  void update(int id);
+  void siftUp(std::size_t i);
+  void siftDown(std::size_t i);
+  void swapHeap(std::size_t a, std::size_t b);
+
+  std::vector<RayVector> _queues;
+  std::vector<char> _local;         /**< Queue belongs to an instance traced in this node */
+  std::vector<int> _heap;           /**< Max heap of non empty local queues by size */
+  std::vector<long> _position;      /**< Heap index of each queue, -1 if not in the heap */
+  std::vector<int> _remote;         /**< Remote queues that may hold rays */
+  std::vector<char> _listed;        /**< Queue is in _remote */
+  std::vector<std::size_t> _cursor; /**< Partition write offsets, all zero between partitions */
+  std::size_t _rays = 0;
+  mutable std::mutex _mutex;
+  tbb::enumerable_thread_specific<std::vector<std::size_t> > _scratch;
+};
+}
+}
+}
+
+#endif /* GVT_RENDER_ACTOR_RAYQUEUES_H */
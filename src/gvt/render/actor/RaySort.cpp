@@ -0,0 +1,125 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RaySort.cpp
+ */
+
+#include <gvt/render/actor/RaySort.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+using namespace gvt::render::actor;
+
+const size_t RaySort::THRESHOLD;
+const unsigned RaySort::MORTON_BITS;
+const unsigned RaySort::GRID;
+
+namespace {
+// items are (key << 32 | index), the radix passes only look at the key half
+const unsigned DIGIT_BITS = 8;
+const unsigned DIGITS = 1u << DIGIT_BITS;
+const unsigned KEY_BITS = 3 + 3 * RaySort::MORTON_BITS;
+const size_t MIN_BLOCK = 16384;
+const size_t MAX_BLOCKS = 256;
+
+/**
+ * Stable parallel LSD radix sort of items on bits [32, 32 + KEY_BITS).
+ *
+ * Each pass counts digits per block in parallel, turns the counts into per block scatter offsets
+ * (digit major, block minor, which keeps the pass stable) and scatters the blocks in parallel. Passes
+ * where every item has the same digit are skipped.
+ */
+void radixSort(std::vector<uint64_t> &items, std::vector<uint64_t> &scratch) {
+  const size_t n = items.size();
+  const size_t block = std::max(MIN_BLOCK, (n + MAX_BLOCKS - 1) / MAX_BLOCKS);
+  const size_t blocks = (n + block - 1) / block;
+  std::vector<size_t> offsets(blocks * DIGITS);
+
+  for (unsigned shift = 32; shift < 32 + KEY_BITS; shift += DIGIT_BITS) {
+    std::fill(offsets.begin(), offsets.end(), 0);
+
+    tbb::parallel_for(size_t(0), blocks, [&](size_t b) {
+      size_t *count = &offsets[b * DIGITS];
+      const size_t end = std::min(n, (b + 1) * block);
+      for (size_t i = b * block; i < end; ++i) count[(items[i] >> shift) & (DIGITS - 1)]++;
+    });
+
+    size_t offset = 0;
+    bool single = false;
+    for (unsigned d = 0; d < DIGITS && !single; ++d) {
+      size_t total = 0;
+      for (size_t b = 0; b < blocks; ++b) {
+        const size_t c = offsets[b * DIGITS + d];
+        offsets[b * DIGITS + d] = offset;
+        offset += c;
+        total += c;
+      }
+      single = (total == n);
+    }
+    if (single) continue;
+
+    tbb::parallel_for(size_t(0), blocks, [&](size_t b) {
+      size_t *next = &offsets[b * DIGITS];
+      const size_t end = std::min(n, (b + 1) * block);
+      for (size_t i = b * block; i < end; ++i) scratch[next[(items[i] >> shift) & (DIGITS - 1)]++] = items[i];
+    });
+    items.swap(scratch);
+  }
+}
+}
+
+glm::vec3 RaySort::scale(const glm::vec3 &lo, const glm::vec3 &hi) {
+  const glm::vec3 extent = glm::max(hi - lo, glm::vec3(std::numeric_limits<float>::min()));
+  return glm::vec3(float(GRID)) / extent;
+}
+
+bool RaySort::sort(RayVector &rays, const glm::vec3 &lo, const glm::vec3 &hi, size_t threshold) {
+  const size_t n = rays.size();
+  if (n < 2 || n < threshold || n > std::numeric_limits<uint32_t>::max()) return false;
+
+  // instance boxes come from transformed corners, so the corners may be swapped
+  const glm::vec3 blo = glm::min(lo, hi);
+  const glm::vec3 bhi = glm::max(lo, hi);
+  const glm::vec3 s = scale(blo, bhi);
+
+  std::vector<uint64_t> items(n), scratch(n);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, n, MIN_BLOCK), [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t i = r.begin(); i < r.end(); ++i) items[i] = (uint64_t(key(rays[i], blo, s)) << 32) | uint64_t(i);
+  });
+
+  radixSort(items, scratch);
+
+  RayVector sorted(n);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, n, MIN_BLOCK), [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t i = r.begin(); i < r.end(); ++i) sorted[i] = rays[items[i] & 0xffffffffu];
+  });
+  rays.swap(sorted);
+  return true;
+}
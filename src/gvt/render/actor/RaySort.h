@@ -0,0 +1,118 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RaySort.h
+ *
+ * Coherence sort for ray queues, applied before a queue is handed to an adapter.
+ */
+
+#ifndef GVT_RENDER_ACTOR_RAYSORT_H
+#define GVT_RENDER_ACTOR_RAYSORT_H
+
+#include <gvt/core/Math.h>
+#include <gvt/render/actor/Ray.h>
+
+#include <cstddef>
+
+namespace gvt {
+namespace render {
+namespace actor {
+
+/**
+ * \brief Coherence sort for ray queues
+ *
+ * After a few diffuse bounces a queue holds rays in the order their paths happened to reach it, with
+ * scattered origins and directions, so neighbouring rays share little of the BVH traversal. The sort
+ * groups rays by direction octant first and by the Morton order of their origin inside the instance
+ * box second, so rays that are adjacent in the queue start close to each other and go the same way.
+ *
+ * Keys are 30 bits (3 bits of octant above a 27 bit Morton code, 9 bits per axis) and are sorted with
+ * a parallel LSD radix sort over 8 bit digits, after which the rays are permuted once. Queues smaller
+ * than the threshold are left alone, the sort does not pay for itself there.
+ */
+class RaySort {
+public:
+  /**
+   * \brief Default minimum queue size to sort
+   */
+  static const size_t THRESHOLD = 4096;
+
+  /**
+   * \brief Bits per axis of the origin Morton code
+   */
+  static const unsigned MORTON_BITS = 9;
+
+  /**
+   * \brief Cells per axis of the origin grid
+   */
+  static const unsigned GRID = 1u << MORTON_BITS;
+
+  /**
+   * \brief Spread the low 9 bits of v so that two zero bits follow each one
+   */
+  static inline unsigned spread(unsigned v) {
+    v &= GRID - 1;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+  }
+
+  /**
+   * \brief Sort key of a ray
+   *
+   * @param r     ray
+   * @param lo    lower corner of the instance box
+   * @param scale GRID divided by the box extent, per axis
+   */
+  static inline unsigned key(const Ray &r, const glm::vec3 &lo, const glm::vec3 &scale) {
+    const glm::vec3 &d = r.mice.direction;
+    const unsigned octant = unsigned(d.x < 0.f) | (unsigned(d.y < 0.f) << 1) | (unsigned(d.z < 0.f) << 2);
+    const glm::vec3 q = glm::clamp((r.mice.origin - lo) * scale, glm::vec3(0.f), glm::vec3(float(GRID - 1)));
+    return (octant << (3 * MORTON_BITS)) | spread(unsigned(q.x)) | (spread(unsigned(q.y)) << 1) |
+           (spread(unsigned(q.z)) << 2);
+  }
+
+  /**
+   * \brief Grid scale for an instance box, see key
+   */
+  static glm::vec3 scale(const glm::vec3 &lo, const glm::vec3 &hi);
+
+  /**
+   * \brief Sort a ray queue in place
+   *
+   * @param rays      queue to sort
+   * @param lo        lower corner of the instance box the queue is headed for
+   * @param hi        upper corner of the instance box
+   * @param threshold queues with fewer rays are not sorted
+   * @return true if the queue was sorted
+   */
+  static bool sort(RayVector &rays, const glm::vec3 &lo, const glm::vec3 &hi, size_t threshold = THRESHOLD);
+};
+}
+}
+}
+
+#endif /* GVT_RENDER_ACTOR_RAYSORT_H */
@@ -0,0 +1,154 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RayStream.cpp
+ */
+
+#include <gvt/render/actor/RayStream.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+using namespace gvt::render::actor;
+
+const size_t RayStream::ALIGNMENT;
+const size_t RayStream::COLUMNS;
+
+RayStream::RayStream(size_t n) : _block(nullptr) {
+  hdr.count = 0;
+  hdr.capacity = 0;
+  bind(nullptr, 0);
+  resize(n);
+}
+
+RayStream::RayStream(const RayStream &other) : _block(nullptr) {
+  hdr.count = 0;
+  hdr.capacity = 0;
+  bind(nullptr, 0);
+  *this = other;
+}
+
+RayStream &RayStream::operator=(const RayStream &other) {
+  if (this == &other) return *this;
+  if (other.hdr.count > hdr.capacity) allocate(other.hdr.count, false);
+  hdr.count = other.hdr.count;
+  if (hdr.count == 0) return *this;
+  for (size_t c = 0; c < COLUMNS; ++c) {
+    std::memcpy(_block + c * hdr.capacity * sizeof(float), other._block + c * other.hdr.capacity * sizeof(float),
+                hdr.count * sizeof(float));
+  }
+  return *this;
+}
+
+RayStream::RayStream(RayStream &&other) : hdr(other.hdr), _block(other._block) {
+  bind(_block, hdr.capacity);
+  other._block = nullptr;
+  other.hdr.count = other.hdr.capacity = 0;
+  other.bind(nullptr, 0);
+}
+
+RayStream &RayStream::operator=(RayStream &&other) {
+  if (this == &other) return *this;
+  std::free(_block);
+  hdr = other.hdr;
+  _block = other._block;
+  bind(_block, hdr.capacity);
+  other._block = nullptr;
+  other.hdr.count = other.hdr.capacity = 0;
+  other.bind(nullptr, 0);
+  return *this;
+}
+
+RayStream::~RayStream() { std::free(_block); }
+
+void RayStream::bind(unsigned char *block, size_t capacity) {
+  // every column is 4 bytes per ray, capacity is a multiple of ALIGNMENT / 4 so all columns stay aligned
+  float *f = reinterpret_cast<float *>(block);
+  ox = f;
+  oy = f + capacity;
+  oz = f + capacity * 2;
+  dx = f + capacity * 3;
+  dy = f + capacity * 4;
+  dz = f + capacity * 5;
+  t_min = f + capacity * 6;
+  t_max = f + capacity * 7;
+  cr = f + capacity * 8;
+  cg = f + capacity * 9;
+  cb = f + capacity * 10;
+  t = f + capacity * 11;
+  w = f + capacity * 12;
+  int *i = reinterpret_cast<int *>(f + capacity * 13);
+  id = i;
+  depth = i + capacity;
+  type = i + capacity * 2;
+}
+
+void RayStream::allocate(size_t n, bool keep) {
+  const size_t lane = ALIGNMENT / sizeof(float);
+  const size_t capacity = ((n + lane - 1) / lane) * lane;
+  void *block = nullptr;
+  if (posix_memalign(&block, ALIGNMENT, capacity * COLUMNS * sizeof(float)) != 0) throw std::bad_alloc();
+
+  unsigned char *old = _block;
+  const size_t old_capacity = hdr.capacity;
+  bind(static_cast<unsigned char *>(block), capacity);
+
+  if (keep && old != nullptr && hdr.count > 0) {
+    for (size_t c = 0; c < COLUMNS; ++c) {
+      std::memcpy(static_cast<unsigned char *>(block) + c * capacity * sizeof(float),
+                  old + c * old_capacity * sizeof(float), hdr.count * sizeof(float));
+    }
+  }
+
+  std::free(old);
+  _block = static_cast<unsigned char *>(block);
+  hdr.capacity = capacity;
+}
+
+void RayStream::reserve(size_t n) {
+  if (n > hdr.capacity) allocate(n, true);
+}
+
+void RayStream::resize(size_t n) {
+  if (n > hdr.capacity) allocate(n, true);
+  hdr.count = n;
+}
+
+void RayStream::load(RayVector::const_iterator begin, RayVector::const_iterator end) {
+  const size_t n = end - begin;
+  if (n > hdr.capacity) allocate(n, false);
+  hdr.count = n;
+  size_t i = 0;
+  for (RayVector::const_iterator it = begin; it != end; ++it, ++i) set(i, *it);
+}
+
+void RayStream::store(RayVector &rays, size_t begin, size_t end) const {
+  if (end == 0) end = hdr.count;
+  if (end <= begin) return;
+  size_t offset = rays.size();
+  rays.resize(offset + (end - begin));
+  for (size_t i = begin; i < end; ++i, ++offset) get(i, rays[offset]);
+}
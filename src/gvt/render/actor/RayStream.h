@@ -0,0 +1,229 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+/*
+ * File:   RayStream.h
+ *
+ * Structure-of-arrays ray container used in the hot ray paths (camera ray
+ * generation, BVH filtering and Embree packet setup).
+ */
+
+#ifndef GVT_RENDER_ACTOR_RAYSTREAM_H
+#define GVT_RENDER_ACTOR_RAYSTREAM_H
+
+#include <gvt/core/Math.h>
+#include <gvt/render/actor/Ray.h>
+
+#include <cstddef>
+
+namespace gvt {
+namespace render {
+namespace actor {
+
+/**
+ * \brief Structure-of-arrays ray container
+ *
+ * Every ray field lives in its own contiguous column so that SIMD consumers (@see RayPacketIntersection,
+ * the Embree packet setup) can do straight vector loads instead of gathering from the 68 byte @see Ray.
+ * All columns are carved out of a single allocation and each column starts on a GVT_RAYSTREAM_ALIGN
+ * boundary.
+ *
+ * The stream is not a replacement for @see RayVector as a queue/wire format, rays are converted with
+ * @see get / @see set when they leave or enter the stream.
+ */
+class RayStream {
+public:
+  /**
+   * \brief Column alignment in bytes
+   */
+  static const size_t ALIGNMENT = 64;
+
+  /**
+   * \brief Number of per-ray columns
+   */
+  static const size_t COLUMNS = 16;
+
+  /**
+   * \brief Compact stream header
+   */
+  struct header {
+    size_t count;    /**< Number of valid rays */
+    size_t capacity; /**< Number of rays each column can hold (multiple of ALIGNMENT / 4) */
+  };
+
+  header hdr;
+
+  float *ox;    /**< Origin x */
+  float *oy;    /**< Origin y */
+  float *oz;    /**< Origin z */
+  float *dx;    /**< Direction x */
+  float *dy;    /**< Direction y */
+  float *dz;    /**< Direction z */
+  float *t_min; /**< Ray t_min */
+  float *t_max; /**< Ray t_max */
+  float *cr;    /**< Radiance red */
+  float *cg;    /**< Radiance green */
+  float *cb;    /**< Radiance blue */
+  float *t;     /**< Latest intersection distance */
+  float *w;     /**< Weight of image contribution */
+  int *id;      /**< Index into framebuffer */
+  int *depth;   /**< Ray depth */
+  int *type;    /**< Ray type */
+
+  /**
+   * Creates a stream with n rays
+   * @method RayStream
+   * @param  n Number of rays
+   */
+  RayStream(size_t n = 0);
+  RayStream(RayStream &&other);
+  RayStream &operator=(RayStream &&other);
+  RayStream(const RayStream &other);
+  RayStream &operator=(const RayStream &other);
+  ~RayStream();
+
+  inline size_t size() const { return hdr.count; }
+  inline size_t capacity() const { return hdr.capacity; }
+  inline bool empty() const { return hdr.count == 0; }
+  inline void clear() { hdr.count = 0; }
+
+  /**
+   * Grow the columns to hold at least n rays, keeps the current content
+   * @method reserve
+   * @param  n Number of rays
+   */
+  void reserve(size_t n);
+
+  /**
+   * Set the number of rays in the stream, new rays are left uninitialized
+   * @method resize
+   * @param  n Number of rays
+   */
+  void resize(size_t n);
+
+  /**
+   * Append an uninitialized ray and return its index
+   * @method emplace
+   * @return Index of the new ray
+   */
+  inline size_t emplace() {
+    if (hdr.count == hdr.capacity) reserve(hdr.capacity ? hdr.capacity * 2 : ALIGNMENT);
+    return hdr.count++;
+  }
+
+  inline glm::vec3 origin(size_t i) const { return glm::vec3(ox[i], oy[i], oz[i]); }
+  inline glm::vec3 direction(size_t i) const { return glm::vec3(dx[i], dy[i], dz[i]); }
+  inline glm::vec3 color(size_t i) const { return glm::vec3(cr[i], cg[i], cb[i]); }
+
+  inline void setOrigin(size_t i, const glm::vec3 &o) {
+    ox[i] = o[0];
+    oy[i] = o[1];
+    oz[i] = o[2];
+  }
+
+  inline void setDirection(size_t i, const glm::vec3 &d) {
+    dx[i] = d[0];
+    dy[i] = d[1];
+    dz[i] = d[2];
+  }
+
+  inline void setColor(size_t i, const glm::vec3 &c) {
+    cr[i] = c[0];
+    cg[i] = c[1];
+    cb[i] = c[2];
+  }
+
+  /**
+   * Scatter ray into the stream position i
+   * @method set
+   * @param  i Stream index
+   * @param  r Ray
+   */
+  inline void set(size_t i, const Ray &r) {
+    setOrigin(i, r.mice.origin);
+    setDirection(i, r.mice.direction);
+    setColor(i, r.mice.color);
+    t_min[i] = r.mice.t_min;
+    t_max[i] = r.mice.t_max;
+    t[i] = r.mice.t;
+    w[i] = r.mice.w;
+    id[i] = r.mice.id;
+    depth[i] = r.mice.depth;
+    type[i] = r.mice.type;
+  }
+
+  /**
+   * Gather the ray at stream position i
+   * @method get
+   * @param  i Stream index
+   * @param  r Ray to write to
+   */
+  inline void get(size_t i, Ray &r) const {
+    r.mice.origin = origin(i);
+    r.mice.direction = direction(i);
+    r.mice.color = color(i);
+    r.mice.t_min = t_min[i];
+    r.mice.t_max = t_max[i];
+    r.mice.t = t[i];
+    r.mice.w = w[i];
+    r.mice.id = id[i];
+    r.mice.depth = depth[i];
+    r.mice.type = type[i];
+  }
+
+  inline Ray get(size_t i) const {
+    Ray r;
+    get(i, r);
+    return r;
+  }
+
+  inline void push_back(const Ray &r) { set(emplace(), r); }
+
+  /**
+   * Replace the stream content with the rays in [begin, end)
+   * @method load
+   * @param  begin Ray list start iterator
+   * @param  end   Ray list end iterator
+   */
+  void load(RayVector::const_iterator begin, RayVector::const_iterator end);
+
+  /**
+   * Append rays [begin, end) of the stream to a ray list
+   * @method store
+   * @param  rays  Destination ray list
+   * @param  begin First stream index
+   * @param  end   Last stream index (0 means size())
+   */
+  void store(RayVector &rays, size_t begin = 0, size_t end = 0) const;
+
+private:
+  void allocate(size_t n, bool keep);
+  void bind(unsigned char *block, size_t capacity);
+
+  unsigned char *_block;
+};
+}
+}
+}
+
+#endif /* GVT_RENDER_ACTOR_RAYSTREAM_H */
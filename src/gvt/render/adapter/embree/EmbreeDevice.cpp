@@ -0,0 +1,120 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#include "gvt/render/adapter/embree/EmbreeDevice.h"
+
+#include <gvt/core/Debug.h>
+#include <gvt/render/cntx/rcontext.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace gvt::render::adapter::embree;
+
+void EmbreeDevice::error_handler(const RTCError code, const char *str) {
+  if (code == RTC_NO_ERROR) return;
+
+  printf("Embree: ");
+  switch (code) {
+  case RTC_UNKNOWN_ERROR:
+    printf("RTC_UNKNOWN_ERROR");
+    break;
+  case RTC_INVALID_ARGUMENT:
+    printf("RTC_INVALID_ARGUMENT");
+    break;
+  case RTC_INVALID_OPERATION:
+    printf("RTC_INVALID_OPERATION");
+    break;
+  case RTC_OUT_OF_MEMORY:
+    printf("RTC_OUT_OF_MEMORY");
+    break;
+  case RTC_UNSUPPORTED_CPU:
+    printf("RTC_UNSUPPORTED_CPU");
+    break;
+  case RTC_CANCELLED:
+    printf("RTC_CANCELLED");
+    break;
+  default:
+    printf("invalid error code");
+    break;
+  }
+  if (str) {
+    printf(" (");
+    while (*str) putchar(*str++);
+    printf(")\n");
+  }
+  exit(1);
+}
+
+namespace {
+std::mutex lock;
+RTCDevice device = nullptr;
+unsigned refs = 0;
+unsigned creates = 0;
+unsigned deletes = 0;
+}
+
+RTCDevice EmbreeDevice::acquire() {
+  std::lock_guard<std::mutex> guard(lock);
+  if (refs++ == 0) {
+    cntx::rcontext &db = cntx::rcontext::instance();
+    unsigned threads = std::thread::hardware_concurrency();
+    if (db._unique.find("threads") != db._unique.end()) threads = db.getUnique("threads").to<unsigned>();
+
+    const std::string cfg = "threads=" + std::to_string(threads);
+    device = rtcNewDevice(cfg.c_str());
+    error_handler(rtcDeviceGetError(device));
+    rtcDeviceSetErrorFunction(device, error_handler);
+    creates++;
+  }
+  return device;
+}
+
+void EmbreeDevice::release() {
+  std::lock_guard<std::mutex> guard(lock);
+  GVT_ASSERT(refs > 0, "EmbreeDevice: release without acquire");
+  if (--refs == 0) {
+    rtcDeleteDevice(device);
+    device = nullptr;
+    deletes++;
+  }
+}
+
+unsigned EmbreeDevice::references() {
+  std::lock_guard<std::mutex> guard(lock);
+  return refs;
+}
+
+unsigned EmbreeDevice::created() {
+  std::lock_guard<std::mutex> guard(lock);
+  return creates;
+}
+
+unsigned EmbreeDevice::deleted() {
+  std::lock_guard<std::mutex> guard(lock);
+  return deletes;
+}
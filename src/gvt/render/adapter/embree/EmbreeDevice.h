@@ -0,0 +1,76 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#ifndef GVT_RENDER_ADAPTER_EMBREE_EMBREE_DEVICE_H
+#define GVT_RENDER_ADAPTER_EMBREE_EMBREE_DEVICE_H
+
+#include <embree2/rtcore.h>
+
+namespace gvt {
+namespace render {
+namespace adapter {
+namespace embree {
+/// process wide Embree device
+/** All Embree mesh adapters create their scenes on this device. The device is sized to the
+GraviT thread count ("threads" in the context) and Embree, built on TBB, runs its scene builds
+as tasks in the caller's TBB arena, so several adapters can commit their scenes concurrently.
+
+Adapters hold a reference for their lifetime: the device is created with the first reference and
+deleted with the last one, so it does not outlive the adapters (and picks up a changed thread
+count the next time one is built).
+*/
+class EmbreeDevice {
+public:
+  /**
+   * Take a reference to the shared device, creating it if there is none.
+   */
+  static RTCDevice acquire();
+
+  /**
+   * Drop a reference taken with acquire(), deleting the device with the last one.
+   */
+  static void release();
+
+  /**
+   * Number of references currently held.
+   */
+  static unsigned references();
+
+  /**
+   * Number of times a device was created and deleted over the life of the process.
+   */
+  static unsigned created();
+  static unsigned deleted();
+
+  /**
+   * Report an Embree error code and abort, used as the device error callback.
+   */
+  static void error_handler(const RTCError code, const char *str = nullptr);
+};
+}
+}
+}
+}
+
+#endif // GVT_RENDER_ADAPTER_EMBREE_EMBREE_DEVICE_H
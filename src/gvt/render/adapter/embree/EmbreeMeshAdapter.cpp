@@ -25,9 +25,13 @@
 #define TBB_PREVIEW_STATIC_PARTITIONER 1
 
 #include "gvt/render/adapter/embree/EmbreeMeshAdapter.h"
+#include "gvt/render/adapter/embree/EmbreeDevice.h"
+#include "gvt/render/adapter/embree/LaneCounters.h"
+#include "gvt/render/adapter/embree/ObjectSpace.h"
 #include <gvt/core/Debug.h>
 #include <gvt/core/Math.h>
 #include <gvt/render/actor/Ray.h>
+#include <gvt/render/actor/RayStream.h>
 #include <gvt/render/data/DerivedTypes.h>
 #include <gvt/render/adapter/embree/EmbreeMaterial.h>
 #include <gvt/render/data/primitives/Material.h>
@@ -87,84 +91,78 @@ struct embTriangle {
   int v0, v1, v2;
 };
 
-static void error_handler(const RTCError code, const char *str = nullptr) {
-  if (code == RTC_NO_ERROR) return;
-
-  printf("Embree: ");
-  switch (code) {
-  case RTC_UNKNOWN_ERROR:
-    printf("RTC_UNKNOWN_ERROR");
-    break;
-  case RTC_INVALID_ARGUMENT:
-    printf("RTC_INVALID_ARGUMENT");
-    break;
-  case RTC_INVALID_OPERATION:
-    printf("RTC_INVALID_OPERATION");
-    break;
-  case RTC_OUT_OF_MEMORY:
-    printf("RTC_OUT_OF_MEMORY");
-    break;
-  case RTC_UNSUPPORTED_CPU:
-    printf("RTC_UNSUPPORTED_CPU");
-    break;
-  case RTC_CANCELLED:
-    printf("RTC_CANCELLED");
-    break;
-  default:
-    printf("invalid error code");
-    break;
-  }
-  if (str) {
-    printf(" (");
-    while (*str) putchar(*str++);
-    printf(")\n");
-  }
-  exit(1);
-}
-
-EmbreeMeshAdapter::EmbreeMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> m) : Adapter(m) {
+EmbreeMeshAdapter::EmbreeMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> m, bool wavefront)
+    : Adapter(m), wavefront(wavefront) {
   std::shared_ptr<gvt::render::data::primitives::Mesh> mesh = std::dynamic_pointer_cast<gvt::render::data::primitives::Mesh>(m);
 
   GVT_ASSERT(mesh, "EmbreeMeshAdapter: mesh pointer in the database is null");
   mesh->generateNormals();
 
-  device = rtcNewDevice("threads=1");
-  error_handler(rtcDeviceGetError(device));
-  /* set error handler */
-  rtcDeviceSetErrorFunction(device, error_handler);
+  device = gvt::render::adapter::embree::EmbreeDevice::acquire();
 
-  int numVerts = mesh->vertices.size();
-  int numTris = mesh->faces.size();
+  const std::size_t numVerts = mesh->numVertices();
+  const std::size_t numTris = mesh->numFaces();
 
   scene = rtcDeviceNewScene(device, RTC_SCENE_DYNAMIC, GVT_EMBREE_ALGORITHM);
   geomId = rtcNewTriangleMesh(scene, RTC_GEOMETRY_STATIC, numTris, numVerts);
 
-  embVertex *vertices = (embVertex *)rtcMapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
-  for (int i = 0; i < numVerts; i++) {
-    vertices[i].x = mesh->vertices[i][0];
-    vertices[i].y = mesh->vertices[i][1];
-    vertices[i].z = mesh->vertices[i][2];
-  }
-  rtcUnmapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
-
-  embTriangle *triangles = (embTriangle *)rtcMapBuffer(scene, geomId, RTC_INDEX_BUFFER);
-  for (int i = 0; i < numTris; i++) {
-    gvt::render::data::primitives::Mesh::Face f = mesh->faces[i];
-    triangles[i].v0 = std::get<0>(f);
-    triangles[i].v1 = std::get<1>(f);
-    triangles[i].v2 = std::get<2>(f);
+  if (mesh->packed()) {
+    // packed meshes already have embree's layout, share the arrays (the adapter holds the mesh)
+    rtcSetBuffer(scene, geomId, RTC_VERTEX_BUFFER, mesh->packedVertices(), 0, 4 * sizeof(float));
+    rtcSetBuffer(scene, geomId, RTC_INDEX_BUFFER, mesh->packedTriangles(), 0, 3 * sizeof(uint32_t));
+  } else {
+    embVertex *vertices = (embVertex *)rtcMapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
+    for (std::size_t i = 0; i < numVerts; i++) {
+      vertices[i].x = mesh->vertices[i][0];
+      vertices[i].y = mesh->vertices[i][1];
+      vertices[i].z = mesh->vertices[i][2];
+    }
+    rtcUnmapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
+
+    embTriangle *triangles = (embTriangle *)rtcMapBuffer(scene, geomId, RTC_INDEX_BUFFER);
+    for (std::size_t i = 0; i < numTris; i++) {
+      gvt::render::data::primitives::Mesh::Face f = mesh->faces[i];
+      triangles[i].v0 = std::get<0>(f);
+      triangles[i].v1 = std::get<1>(f);
+      triangles[i].v2 = std::get<2>(f);
+    }
+    rtcUnmapBuffer(scene, geomId, RTC_INDEX_BUFFER);
   }
-  rtcUnmapBuffer(scene, geomId, RTC_INDEX_BUFFER);
 
   // mesh->writeobj("mesh.obj");
 
   rtcCommit(scene);
 }
 
+EmbreeMeshAdapter::EmbreeMeshAdapter(const std::vector<NodeInstance> &nodeInstances, bool wavefront)
+    : Adapter(nullptr), wavefront(wavefront), instances(nodeInstances) {
+  device = gvt::render::adapter::embree::EmbreeDevice::acquire();
+
+  scene = rtcDeviceNewScene(device, RTC_SCENE_STATIC, GVT_EMBREE_ALGORITHM);
+  geomId = RTC_INVALID_GEOMETRY_ID;
+
+  for (std::size_t i = 0; i < instances.size(); i++) {
+    NodeInstance &ni = instances[i];
+    GVT_ASSERT(ni.adapter && ni.adapter->instances.empty(), "EmbreeMeshAdapter: node scene needs mesh adapters");
+    ni.mesh = static_cast<gvt::render::data::primitives::Mesh *>(ni.adapter->data.get());
+
+    // embree numbers the instances of a new scene in creation order, instID indexes `instances`
+    instID = rtcNewInstance(scene, ni.adapter->scene);
+    GVT_ASSERT(instID == i, "EmbreeMeshAdapter: unexpected node scene instance id");
+    glm::mat4 tt = glm::transpose(*ni.m);
+    const float *n = &tt[0][0];
+    float mm[] = { n[0], n[4], n[8], n[1], n[5], n[9], n[2], n[6], n[10], n[3], n[7], n[11] };
+    rtcSetTransform(scene, instID, RTC_MATRIX_COLUMN_MAJOR, mm);
+  }
+
+  rtcCommit(scene);
+}
+
 EmbreeMeshAdapter::~EmbreeMeshAdapter() {
-  rtcDeleteGeometry(scene, geomId);
+  // node scene instances go with the scene, the instanced mesh scenes belong to their adapters
+  if (instances.empty()) rtcDeleteGeometry(scene, geomId);
   rtcDeleteScene(scene);
-  rtcDeleteDevice(device);
+  gvt::render::adapter::embree::EmbreeDevice::release();
 }
 
 struct embreeParallelTrace {
@@ -203,6 +201,11 @@ struct embreeParallelTrace {
    */
   const glm::mat3 *normi;
 
+  /**
+   * Moves packets into the object space of the current instance (minv)
+   */
+  const gvt::render::adapter::embree::ObjectSpace toObject;
+
   /**
    * Stored transformation matrix in the current instance
    */
@@ -221,13 +224,19 @@ struct embreeParallelTrace {
   gvt::render::actor::RayVector localDispatch;
 
   /**
-   * List of shadow rays to be processed
+   * List of shadow rays to be processed, kept in structure-of-arrays layout so packet setup is a straight copy
    */
-  gvt::render::actor::RayVector shadowRays;
+  gvt::render::actor::RayStream shadowRays;
 
   const size_t begin, end;
 
   gvt::render::data::primitives::Mesh *mesh;
+
+  /**
+   * Lanes issued by this chunk for closest hit and occlusion queries
+   */
+  gvt::render::adapter::embree::LaneTally intersectLanes, occludeLanes;
+
   /**
    * Construct a embreeParallelTrace struct with information needed for the
    * thread
@@ -240,7 +249,7 @@ struct embreeParallelTrace {
                       std::shared_ptr<gvt::render::data::primitives::Mesh> mesh, std::atomic<size_t> &counter, const size_t begin,
                       const size_t end)
       : adapter(adapter), rayList(rayList), moved_rays(moved_rays), workSize(workSize), m(m), minv(minv), normi(normi),
-        lights(lights), counter(counter), begin(begin), end(end), mesh(mesh.get()) {}
+        toObject(*minv), lights(lights), counter(counter), begin(begin), end(end), mesh(mesh.get()) {}
   /**
    * Convert a set of rays from a vector into a GVT_EMBREE_PACKET_TYPE ray packet.
    *
@@ -260,7 +269,7 @@ struct embreeParallelTrace {
       for (int i = 0; i < localPacketSize; i++) {
         valid[i] = -1;
       }
-      for (int i = localPacketSize; i < localPacketSize; i++) {
+      for (int i = localPacketSize; i < GVT_EMBREE_PACKET_SIZE; i++) {
         valid[i] = 0;
       }
     }
@@ -276,7 +285,7 @@ struct embreeParallelTrace {
         ray4.diry[i] = r.mice.direction[1];
         ray4.dirz[i] = r.mice.direction[2];
         ray4.tnear[i] = gvt::render::actor::Ray::RAY_EPSILON;
-        ray4.tfar[i] = FLT_MAX;
+        ray4.tfar[i] = r.mice.t_max;
         ray4.geomID[i] = RTC_INVALID_GEOMETRY_ID;
         ray4.primID[i] = RTC_INVALID_GEOMETRY_ID;
         ray4.instID[i] = RTC_INVALID_GEOMETRY_ID;
@@ -284,6 +293,51 @@ struct embreeParallelTrace {
         ray4.time[i] = gvt::render::actor::Ray::RAY_EPSILON;
       }
     }
+    // node scenes stop the rays at the first remote box, see EmbreeMeshAdapter::clip
+    if (adapter->clip) {
+      float tfar[GVT_EMBREE_PACKET_SIZE];
+      adapter->clip(&rays[startIdx], &rays[startIdx] + localPacketSize, tfar);
+      for (int i = 0; i < localPacketSize; i++) ray4.tfar[i] = std::min(ray4.tfar[i], tfar[i]);
+    }
+    toObject(ray4.orgx, ray4.orgy, ray4.orgz, ray4.dirx, ray4.diry, ray4.dirz, localPacketSize);
+  }
+
+  /**
+   * Convert a set of rays from a ray stream into a GVT_EMBREE_PACKET_TYPE ray packet.
+   *
+   * Same as the ray vector version, but the stream columns are copied lane by lane without a gather.
+   *
+   * \param ray4          reference of GVT_EMBREE_PACKET_TYPE struct to write to
+   * \param valid         aligned array of ints to mark valid rays
+   * \param resetValid    if true, reset the valid bits, if false, re-use old
+   * valid to know which to convert
+   * \param localPacketSize    number of rays to convert
+   * \param rays          ray stream to read from
+   * \param startIdx      starting point to read from in `rays`
+   */
+  void prepGVT_EMBREE_PACKET_TYPE(GVT_EMBREE_PACKET_TYPE &ray4, int valid[GVT_EMBREE_PACKET_SIZE],
+                                  const bool resetValid, const int localPacketSize,
+                                  const gvt::render::actor::RayStream &rays, const size_t startIdx) {
+    if (resetValid) {
+      for (int i = 0; i < localPacketSize; i++) {
+        valid[i] = -1;
+      }
+      for (int i = localPacketSize; i < GVT_EMBREE_PACKET_SIZE; i++) {
+        valid[i] = 0;
+      }
+    }
+
+    toObject(rays.ox + startIdx, rays.oy + startIdx, rays.oz + startIdx, rays.dx + startIdx, rays.dy + startIdx,
+             rays.dz + startIdx, ray4.orgx, ray4.orgy, ray4.orgz, ray4.dirx, ray4.diry, ray4.dirz, localPacketSize);
+    for (int i = 0; i < localPacketSize; i++) {
+      ray4.tnear[i] = gvt::render::actor::Ray::RAY_EPSILON;
+      ray4.tfar[i] = rays.t_max[startIdx + i];
+      ray4.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+      ray4.primID[i] = RTC_INVALID_GEOMETRY_ID;
+      ray4.instID[i] = RTC_INVALID_GEOMETRY_ID;
+      ray4.mask[i] = -1;
+      ray4.time[i] = gvt::render::actor::Ray::RAY_EPSILON;
+    }
   }
 
   glm::vec3 CosWeightedRandomHemisphereDirection2(glm::vec3 n, gvt::core::math::RandEngine &randEngine) {
@@ -319,7 +373,7 @@ struct embreeParallelTrace {
 
   void generateShadowRays(const gvt::render::actor::Ray &r, const glm::vec3 &normal,
                           gvt::render::data::primitives::Material *material, unsigned int *randSeed,
-                          gvt::render::actor::RayVector &shadowRays) {
+                          gvt::render::actor::RayStream &shadowRays) {
 
     for (std::shared_ptr<gvt::render::data::scene::Light> light : lights) {
       GVT_ASSERT(light, "generateShadowRays: light is null for some reason");
@@ -344,16 +398,20 @@ struct embreeParallelTrace {
 
       const glm::vec3 origin = r.mice.origin + r.mice.direction * t_shadow;
       const glm::vec3 dir = lightPos - origin;
-      const float t_max = dir.length();
-
-      // note: ray copy constructor is too heavy, so going to build it manually
-      shadowRays.push_back(Ray(r.mice.origin + r.mice.direction * t_shadow, dir, r.mice.w, Ray::SHADOW, r.mice.depth));
-
-      Ray &shadow_ray = shadowRays.back();
-      shadow_ray.mice.t = r.mice.t;
-      shadow_ray.mice.id = r.mice.id;
-      shadow_ray.mice.t_max = t_max;
-      shadow_ray.mice.color = glm::vec3(c[0], c[1], c[2]);
+      const float t_max = glm::length(dir);
+
+      // write the shadow ray straight into the stream columns
+      const size_t si = shadowRays.emplace();
+      shadowRays.setOrigin(si, origin);
+      shadowRays.setDirection(si, glm::normalize(dir));
+      shadowRays.setColor(si, glm::vec3(c[0], c[1], c[2]));
+      shadowRays.t_min[si] = gvt::render::actor::Ray::RAY_EPSILON;
+      shadowRays.t_max[si] = t_max;
+      shadowRays.t[si] = r.mice.t;
+      shadowRays.w[si] = r.mice.w;
+      shadowRays.id[si] = r.mice.id;
+      shadowRays.depth[si] = r.mice.depth;
+      shadowRays.type[si] = Ray::SHADOW;
     }
   }
 
@@ -373,17 +431,150 @@ struct embreeParallelTrace {
       // create a shadow packet and trace with rtcOccluded
       prepGVT_EMBREE_PACKET_TYPE(ray4, valid, true, localPacketSize, shadowRays, idx);
       GVT_EMBREE_OCCULUSION(valid, scene, ray4);
+      occludeLanes.add(GVT_EMBREE_PACKET_SIZE, localPacketSize);
 
       for (size_t pi = 0; pi < localPacketSize; pi++) {
         if (valid[pi] && ray4.geomID[pi] == (int)RTC_INVALID_GEOMETRY_ID) {
           // ray is valid, but did not hit anything, so add to dispatch queue
-          localDispatch.push_back(shadowRays[idx + pi]);
+          localDispatch.push_back(shadowRays.get(idx + pi));
         }
       }
     }
     shadowRays.clear();
   }
 
+  /**
+   * Shade a primary or secondary ray that hit the mesh.
+   *
+   * Records the hit distance, queues the shadow rays of the hit point in `shadowRays` and, if the
+   * ray survives russian roulette, replaces it in place with its secondary ray.
+   *
+   * \param r             ray that hit the mesh
+   * \param t             hit distance
+   * \param Ng            geometric normal reported by Embree [object space, not normalized]
+   * \param primID        triangle that was hit
+   * \param instID        node scene instance that was hit, unused by mesh adapters
+   * \param u             barycentric u of the hit
+   * \param v             barycentric v of the hit
+   * \param randEngine    random engine of the tracing thread
+   * \return true if `r` is now a secondary ray that needs to be traced
+   */
+  bool shade(gvt::render::actor::Ray &r, float t, const glm::vec3 &Ng, const int primID, const int instID,
+             const float u, const float v, gvt::core::math::RandEngine &randEngine) {
+    r.mice.t = t;
+
+    // node scenes shade with the mesh and normal matrix of the instance that was hit
+    gvt::render::data::primitives::Mesh *mesh = this->mesh;
+    const glm::mat3 *normi = this->normi;
+    if (!adapter->instances.empty()) {
+      mesh = adapter->instances[instID].mesh;
+      normi = adapter->instances[instID].normi;
+    }
+
+    // FIXME: embree does not take vertex normal information, the
+    // examples have the application calculate the normal using
+    // math similar to the bottom.  this means we have to keep
+    // around a 'faces_to_normals' list along with a 'normals' list
+    // for the embree adapter
+    //
+    // old fixme: fix embree normal calculation to remove dependency
+    // from gvt mesh
+
+    glm::vec3 manualNormal;
+    glm::vec3 normalflat = glm::normalize((*normi) * -Ng);
+    {
+      const int triangle_id = primID;
+#ifndef FLAT_SHADING
+      const Mesh::FaceToNormals normals = mesh->faceNormals(triangle_id); // FIXME: need to
+                                                                          // figure out
+                                                                          // to store
+                                                                          // `faces_to_normals`
+                                                                          // list
+      const glm::vec3 &a = mesh->normals[std::get<1>(normals)];
+      const glm::vec3 &b = mesh->normals[std::get<2>(normals)];
+      const glm::vec3 &c = mesh->normals[std::get<0>(normals)];
+      manualNormal = a * u + b * v + c * (1.0f - u - v);
+      manualNormal = glm::normalize((*normi) * manualNormal);
+#else
+
+      manualNormal = normalflat;
+
+#endif
+    }
+
+    // backface check, requires flat normal
+    if (glm::dot(-r.mice.direction, normalflat) <= 0.f) {
+      manualNormal = -manualNormal;
+    }
+
+    const glm::vec3 &normal = manualNormal;
+
+    Material *mat;
+
+    if (!mesh->vertex_colors.empty()) { // per-vertex color available, create material here
+      // Get vertex indexes
+      gvt::render::data::primitives::Mesh::Face face = mesh->face(primID);
+
+      int v0 = std::get<0>(face);
+      int v1 = std::get<1>(face);
+      int v2 = std::get<2>(face);
+
+      // Get color at each vertex
+      glm::vec3 c0 = mesh->vertex_colors[v0];
+      glm::vec3 c1 = mesh->vertex_colors[v1];
+      glm::vec3 c2 = mesh->vertex_colors[v2];
+      
+      // Interpolate colors
+      // given vertices v0, v1, v2, u and v are defined as
+      // u: v1-v0
+      // v: v2-v0
+      glm::vec3 ci = (c0 * (1.f - u - v)) + (c1 * u) + (c2 * v);
+
+      // Create Material
+      mat = new gvt::render::data::primitives::Material;
+      mat->type = LAMBERT;
+      mat->kd = ci;
+
+    } else if (mesh->faces_to_materials.size() && mesh->faces_to_materials[primID]) {
+      mat = mesh->faces_to_materials[primID];
+    } else {
+      mat = mesh->getMaterial();
+    }
+
+    // reduce contribution of the color that the shadow rays get
+    if (r.mice.type == gvt::render::actor::Ray::SECONDARY) {
+      t = (t > 1) ? 1.f / t : t;
+      r.mice.w = r.mice.w * t;
+    }
+
+    generateShadowRays(r, normal, mat, randEngine.ReturnSeed(), shadowRays);
+
+    // In case we have per-vertex color information, destruct the material temporarily created
+    if (!mesh->vertex_colors.empty()) {
+      delete mat;
+    }
+
+    int ndepth = r.mice.depth - 1;
+
+    float p = 1.f - randEngine.fastrand(0, 1); //(float(rand()) / RAND_MAX);
+    // replace current ray with generated secondary ray
+    if (ndepth > 0 && r.mice.w > p) {
+      r.mice.type = gvt::render::actor::Ray::SECONDARY;
+      const float multiplier =
+          1.0f - 16.0f * std::numeric_limits<float>::epsilon(); // TODO: move out somewhere / make static
+      const float t_secondary = multiplier * r.mice.t;
+      r.mice.origin = r.mice.origin + r.mice.direction * t_secondary;
+      r.mice.direction = CosWeightedRandomHemisphereDirection2(normal, randEngine);
+
+      r.mice.w = r.mice.w * glm::dot(r.mice.direction, normal);
+      r.mice.depth = ndepth;
+      return true;
+    }
+
+    // secondary ray is terminated
+    return false;
+  }
+
   /**
    * Trace function.
    *
@@ -473,6 +664,10 @@ struct embreeParallelTrace {
         prepGVT_EMBREE_PACKET_TYPE(ray4, valid, resetValid, localPacketSize, rayList, localIdx);
         GVT_EMBREE_INTERSECTION(valid, scene, ray4);
 
+        size_t activeLanes = 0;
+        for (size_t pi = 0; pi < localPacketSize; pi++) activeLanes += (valid[pi] != 0);
+        intersectLanes.add(GVT_EMBREE_PACKET_SIZE, activeLanes);
+
         resetValid = false;
 
         for (size_t pi = 0; pi < localPacketSize; pi++) {
@@ -485,116 +680,12 @@ struct embreeParallelTrace {
               // ray has hit something
               // shadow ray hit something, so it should be dropped
               if (r.mice.type == gvt::render::actor::Ray::SHADOW) {
+                valid[pi] = 0;
                 continue;
               }
 
-              float t = ray4.tfar[pi];
-              r.mice.t = t;
-
-              // FIXME: embree does not take vertex normal information, the
-              // examples have the application calculate the normal using
-              // math similar to the bottom.  this means we have to keep
-              // around a 'faces_to_normals' list along with a 'normals' list
-              // for the embree adapter
-              //
-              // old fixme: fix embree normal calculation to remove dependency
-              // from gvt mesh
-
-              glm::vec3 manualNormal;
-              glm::vec3 normalflat = glm::normalize((*normi) * -glm::vec3(ray4.Ngx[pi], ray4.Ngy[pi], ray4.Ngz[pi]));
-              {
-                const int triangle_id = ray4.primID[pi];
-#ifndef FLAT_SHADING
-                const float u = ray4.u[pi];
-                const float v = ray4.v[pi];
-                const Mesh::FaceToNormals &normals = mesh->faces_to_normals[triangle_id]; // FIXME: need to
-                                                                                          // figure out
-                                                                                          // to store
-                                                                                          // `faces_to_normals`
-                                                                                          // list
-                const glm::vec3 &a = mesh->normals[std::get<1>(normals)];
-                const glm::vec3 &b = mesh->normals[std::get<2>(normals)];
-                const glm::vec3 &c = mesh->normals[std::get<0>(normals)];
-                manualNormal = a * u + b * v + c * (1.0f - u - v);
-                manualNormal = glm::normalize((*normi) * manualNormal);
-#else
-
-                manualNormal = normalflat;
-
-#endif
-              }
-
-              // backface check, requires flat normal
-              if (glm::dot(-r.mice.direction, normalflat) <= 0.f) {
-                manualNormal = -manualNormal;
-              }
-
-              const glm::vec3 &normal = manualNormal;
-
-              Material *mat;
-
-              if (!mesh->vertex_colors.empty()) { // per-vertex color available, create material here
-                // Get vertex indexes
-                gvt::render::data::primitives::Mesh::Face face = mesh->faces[ray4.primID[pi]];
-
-                int v0 = std::get<0>(face);
-                int v1 = std::get<1>(face);
-                int v2 = std::get<2>(face);
-
-                // Get U V Coordinates
-
-                float u = ray4.u[pi];
-                float v = ray4.v[pi];
-
-                // Get color at each vertex
-                glm::vec3 c0 = mesh->vertex_colors[v0];
-                glm::vec3 c1 = mesh->vertex_colors[v1];
-                glm::vec3 c2 = mesh->vertex_colors[v2];
-                
-                // Interpolate colors
-                // given vertices v0, v1, v2, u and v are defined as
-                // u: v1-v0
-                // v: v2-v0
-                glm::vec3 ci = (c0 * (1.f - u - v)) + (c1 * u) + (c2 * v);
-
-                // Create Material
-                mat = new gvt::render::data::primitives::Material;
-                mat->type = LAMBERT;
-                mat->kd = ci;
-
-              } else if (mesh->faces_to_materials.size() && mesh->faces_to_materials[ray4.primID[pi]]) {
-                mat = mesh->faces_to_materials[ray4.primID[pi]];
-              } else {
-                mat = mesh->getMaterial();
-              }
-
-              // reduce contribution of the color that the shadow rays get
-              if (r.mice.type == gvt::render::actor::Ray::SECONDARY) {
-                t = (t > 1) ? 1.f / t : t;
-                r.mice.w = r.mice.w * t;
-              }
-
-              generateShadowRays(r, normal, mat, randEngine.ReturnSeed(), shadowRays);
-
-              // In case we have per-vertex color information, destruct the material temporarily created
-              if (!mesh->vertex_colors.empty()) {
-                delete mat;
-              }
-
-              int ndepth = r.mice.depth - 1;
-
-              float p = 1.f - randEngine.fastrand(0, 1); //(float(rand()) / RAND_MAX);
-              // replace current ray with generated secondary ray
-              if (ndepth > 0 && r.mice.w > p) {
-                r.mice.type = gvt::render::actor::Ray::SECONDARY;
-                const float multiplier =
-                    1.0f - 16.0f * std::numeric_limits<float>::epsilon(); // TODO: move out somewhere / make static
-                const float t_secondary = multiplier * r.mice.t;
-                r.mice.origin = r.mice.origin + r.mice.direction * t_secondary;
-                r.mice.direction = CosWeightedRandomHemisphereDirection2(normal, randEngine);
-
-                r.mice.w = r.mice.w * glm::dot(r.mice.direction, normal);
-                r.mice.depth = ndepth;
+              if (shade(r, ray4.tfar[pi], glm::vec3(ray4.Ngx[pi], ray4.Ngy[pi], ray4.Ngz[pi]), ray4.primID[pi],
+                        ray4.instID[pi], ray4.u[pi], ray4.v[pi], randEngine)) {
                 validRayLeft = true; // we still have a valid ray in the packet to trace
               } else {
                 // secondary ray is terminated, so disable its valid bit
@@ -615,10 +706,85 @@ struct embreeParallelTrace {
       }
     }
 
-    // copy localDispatch rays to outgoing rays queue
+    dispatch();
+  }
+
+  /**
+   * Wavefront trace function.
+   *
+   * Same rays and shading as operator(), but the chunk advances one bounce at a time: every live
+   * ray is traced and shaded before any ray takes its next bounce. Rays that continue as secondary
+   * rays are compacted to the front of the chunk, so the next bounce traces full packets from a
+   * dense range instead of re-tracing packets whose lanes have terminated. The shadow rays of a
+   * bounce are traced together once the bounce is shaded.
+   *
+   * r0 r1 r2 r3 r4 r5 r6 r7   bounce 0, r1 r4 r5 r6 terminate
+   * r0 r2 r3 r7               bounce 1, r0 r3 terminate
+   * r2 r7                     bounce 2
+   */
+  void wavefront() {
+
+    RTCScene scene = adapter->global_scene;
+    localDispatch.reserve((end - begin) * 2);
+    shadowRays.reserve((end - begin) * lights.size());
+
+    gvt::core::math::RandEngine randEngine;
+    randEngine.SetSeed(begin);
+
+    GVT_EMBREE_PACKET_TYPE ray4 = {};
+    RTCORE_ALIGN(16) int valid[GVT_EMBREE_PACKET_SIZE] = { 0 };
+
+    // rays in [begin, liveEnd) still have to be traced
+    size_t liveEnd = end;
+    while (liveEnd > begin) {
+      size_t live = begin;
+
+      for (size_t localIdx = begin; localIdx < liveEnd; localIdx += GVT_EMBREE_PACKET_SIZE) {
+        const size_t localPacketSize =
+            (localIdx + GVT_EMBREE_PACKET_SIZE > liveEnd) ? (liveEnd - localIdx) : GVT_EMBREE_PACKET_SIZE;
+
+        prepGVT_EMBREE_PACKET_TYPE(ray4, valid, true, localPacketSize, rayList, localIdx);
+        GVT_EMBREE_INTERSECTION(valid, scene, ray4);
+        intersectLanes.add(GVT_EMBREE_PACKET_SIZE, localPacketSize);
+
+        for (size_t pi = 0; pi < localPacketSize; pi++) {
+          auto &r = rayList[localIdx + pi];
+          if (ray4.geomID[pi] != (int)RTC_INVALID_GEOMETRY_ID) {
+            // shadow ray hit something, so it should be dropped
+            if (r.mice.type == gvt::render::actor::Ray::SHADOW) continue;
+
+            if (shade(r, ray4.tfar[pi], glm::vec3(ray4.Ngx[pi], ray4.Ngy[pi], ray4.Ngz[pi]), ray4.primID[pi],
+                      ray4.instID[pi], ray4.u[pi], ray4.v[pi], randEngine)) {
+              // slots below localIdx + pi have been consumed, so the survivor can move down
+              if (live != localIdx + pi) rayList[live] = r;
+              live++;
+            }
+          } else {
+            // ray did not hit anything, pass it on
+            localDispatch.push_back(r);
+          }
+        }
+      }
+
+      // trace the shadow rays of the whole bounce
+      traceShadowRays();
+      liveEnd = live;
+    }
+
+    dispatch();
+  }
+
+  /**
+   * Copy the rays that left the mesh to the outgoing queue and publish the lane tallies.
+   */
+  void dispatch() {
     std::unique_lock<std::mutex> moved(adapter->_outqueue);
     moved_rays.insert(moved_rays.end(), localDispatch.begin(), localDispatch.end());
     moved.unlock();
+
+    gvt::render::adapter::embree::LaneCounters &lanes = gvt::render::adapter::embree::LaneCounters::instance();
+    intersectLanes.flush(lanes.intersect);
+    occludeLanes.flush(lanes.occlude);
   }
 };
 
@@ -630,15 +796,16 @@ void EmbreeMeshAdapter::trace(gvt::render::actor::RayVector &rayList, gvt::rende
 
   cntx::rcontext& db = cntx::rcontext::instance();
 
-  global_scene = rtcDeviceNewScene(device, RTC_SCENE_STATIC, GVT_EMBREE_ALGORITHM);
-  unsigned instID = rtcNewInstance(global_scene, scene);
-  glm::mat4 tt = glm::transpose(*m);
-  float *n = glm::value_ptr(tt);
-  float mm[] = { n[0], n[4], n[8], n[1], n[5], n[9], n[2], n[6], n[10], n[3], n[7], n[11] };
+  // rays are moved into the instance's object space instead, see ObjectSpace
+  global_scene = scene;
 
-  rtcSetTransform(global_scene, instID, RTC_MATRIX_COLUMN_MAJOR, mm);
-  rtcUpdate(global_scene, instID);
-  rtcCommit(global_scene);
+  // node scenes trace in world space, embree applies the instance transforms
+  glm::mat4 identity(1.f);
+  glm::mat3 identityN(1.f);
+  if (!instances.empty()) {
+    m = minv = &identity;
+    normi = &identityN;
+  }
   if (_end == 0) _end = rayList.size();
 
   this->begin = _begin;
@@ -651,10 +818,14 @@ void EmbreeMeshAdapter::trace(gvt::render::actor::RayVector &rayList, gvt::rende
 
   static tbb::auto_partitioner ap;
   tbb::parallel_for(tbb::blocked_range<size_t>(begin, end, workSize),
-     [&](tbb::blocked_range<size_t> chunk) { embreeParallelTrace(this, 
-     rayList, moved_rays, chunk.end()-chunk.begin(), m, minv, normi, lights, 
-     std::static_pointer_cast<gvt::render::data::primitives::Mesh>(data), counter, chunk.begin(), chunk.end())();
+     [&](tbb::blocked_range<size_t> chunk) {
+       embreeParallelTrace tracer(this, rayList, moved_rays, chunk.end() - chunk.begin(), m, minv, normi, lights,
+                                  std::static_pointer_cast<gvt::render::data::primitives::Mesh>(data), counter,
+                                  chunk.begin(), chunk.end());
+       if (wavefront)
+         tracer.wavefront();
+       else
+         tracer();
                     },
                     ap);
-  rtcDeleteScene(global_scene);
 }
@@ -26,10 +26,14 @@
 #define GVT_RENDER_ADAPTER_EMBREE_DATA_EMBREE_MESH_ADAPTER_H
 
 #include "gvt/render/Adapter.h"
+#include "gvt/render/adapter/embree/LaneCounters.h"
 
 #include <embree2/rtcore.h>
 #include <embree2/rtcore_ray.h>
 
+#include <functional>
+#include <vector>
+
 namespace gvt {
 namespace render {
 namespace adapter {
@@ -46,24 +50,75 @@ public:
    * at the given node to Embree's format.
    *
    * Initializes Embree the first time it is called.
+   *
+   * \param wavefront trace in wavefront mode, see `wavefront`
+   */
+  EmbreeMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> mesh, bool wavefront = false);
+
+  /**
+   * Instance of a node scene
+   */
+  struct NodeInstance {
+    std::shared_ptr<EmbreeMeshAdapter> adapter; /**< mesh adapter whose scene is instanced */
+    const glm::mat4 *m;                         /**< instance model matrix */
+    const glm::mat3 *normi;                     /**< instance normal matrix */
+    gvt::render::data::primitives::Mesh *mesh;  /**< set by the node scene constructor */
+  };
+
+  /**
+   * Construct a node scene adapter: one Embree scene with an instance (rtcNewInstance) of the mesh
+   * scene of every given adapter, so rays traverse all the instances resident on the node in a
+   * single trace() call and only leave it when they miss all of them. Mesh scenes are shared with
+   * the mesh adapters, not copied.
+   *
+   * trace() ignores its matrices, hits are shaded with the mesh and normal matrix of the instance
+   * they hit.
+   *
+   * \param instances instances resident on the node
+   * \param wavefront trace in wavefront mode, see `wavefront`
    */
-  EmbreeMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> mesh);
+  EmbreeMeshAdapter(const std::vector<NodeInstance> &instances, bool wavefront = false);
 
   /**
    * Release Embree copy of the mesh.
    */
   virtual ~EmbreeMeshAdapter();
 
+  RTCDevice getDevice() const { return device; }
+
   virtual void trace(gvt::render::actor::RayVector &rayList, gvt::render::actor::RayVector &moved_rays, glm::mat4 *m,
                      glm::mat4 *minv, glm::mat3 *normi, gvt::core::Vector<std::shared_ptr<gvt::render::data::scene::Light> > &lights,
                      size_t begin = 0, size_t end = 0);
 
   /**
-   * Handle to Embree scene.
+   * Handle to the Embree scene traced by trace(), the mesh scene itself. Rays are transformed
+   * into the object space of the instance, see ObjectSpace.
    */
   RTCScene global_scene;
 
+  /**
+   * Trace chunks a bounce at a time and compact the surviving rays between bounces instead of
+   * following each packet to completion. Lane utilization of either mode is reported in
+   * LaneCounters.
+   */
+  bool wavefront;
+
+  /**
+   * Node scene instances indexed by Embree instance id, empty for a mesh adapter
+   */
+  std::vector<NodeInstance> instances;
+
+  /**
+   * Node scenes only: writes for the rays [begin, end) the distance at which they enter the first
+   * box of data held by another node. Hits past it are not accepted, the ray is passed out instead
+   * and comes back once it went through that data. Unset when the node holds every instance.
+   */
+  std::function<void(gvt::render::actor::Ray *begin, gvt::render::actor::Ray *end, float *tfar)> clip;
+
 protected:
+  /**
+   * Process wide device shared by all Embree adapters, see EmbreeDevice.
+   */
   RTCDevice device;
 
   /**
@@ -25,9 +25,13 @@
 #define TBB_PREVIEW_STATIC_PARTITIONER 1
 
 #include "gvt/render/adapter/embree/EmbreeStreamMeshAdapter.h"
+#include "gvt/render/adapter/embree/EmbreeDevice.h"
+#include "gvt/render/adapter/embree/LaneCounters.h"
+#include "gvt/render/adapter/embree/ObjectSpace.h"
 #include <gvt/core/Debug.h>
 #include <gvt/core/Math.h>
 #include <gvt/render/actor/Ray.h>
+#include <gvt/render/actor/RayStream.h>
 #include <gvt/render/cntx/rcontext.h>
 #include <gvt/render/data/DerivedTypes.h>
 #include <gvt/render/adapter/embree/EmbreeMaterial.h>
@@ -88,75 +92,43 @@ struct embTriangle {
   int v0, v1, v2;
 };
 
-static void error_handler(const RTCError code, const char *str = nullptr) {
-  if (code == RTC_NO_ERROR) return;
-
-  printf("Embree: ");
-  switch (code) {
-  case RTC_UNKNOWN_ERROR:
-    printf("RTC_UNKNOWN_ERROR");
-    break;
-  case RTC_INVALID_ARGUMENT:
-    printf("RTC_INVALID_ARGUMENT");
-    break;
-  case RTC_INVALID_OPERATION:
-    printf("RTC_INVALID_OPERATION");
-    break;
-  case RTC_OUT_OF_MEMORY:
-    printf("RTC_OUT_OF_MEMORY");
-    break;
-  case RTC_UNSUPPORTED_CPU:
-    printf("RTC_UNSUPPORTED_CPU");
-    break;
-  case RTC_CANCELLED:
-    printf("RTC_CANCELLED");
-    break;
-  default:
-    printf("invalid error code");
-    break;
-  }
-  if (str) {
-    printf(" (");
-    while (*str) putchar(*str++);
-    printf(")\n");
-  }
-  exit(1);
-}
-
-EmbreeStreamMeshAdapter::EmbreeStreamMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> m) : Adapter(m) {
+EmbreeStreamMeshAdapter::EmbreeStreamMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> m, bool wavefront)
+    : Adapter(m), wavefront(wavefront) {
   std::shared_ptr<gvt::render::data::primitives::Mesh> mesh = std::dynamic_pointer_cast<gvt::render::data::primitives::Mesh>(m);
   GVT_ASSERT(mesh, "EmbreeStreamMeshAdapter: mesh pointer in the database is null");
   mesh->generateNormals();
 
-  // device = rtcNewDevice("threads=1");
-  device = rtcNewDevice();
-  error_handler(rtcDeviceGetError(device));
-  /* set error handler */
-  rtcDeviceSetErrorFunction(device, error_handler);
+  device = gvt::render::adapter::embree::EmbreeDevice::acquire();
 
-  int numVerts = mesh->vertices.size();
-  int numTris = mesh->faces.size();
+  const std::size_t numVerts = mesh->numVertices();
+  const std::size_t numTris = mesh->numFaces();
 
   // scene = rtcDeviceNewScene(device, RTC_SCENE_DYNAMIC, RTC_INTERSECT_STREAM);
   scene = rtcDeviceNewScene(device, RTC_SCENE_STATIC, RTC_INTERSECT_STREAM);
   geomId = rtcNewTriangleMesh(scene, RTC_GEOMETRY_STATIC, numTris, numVerts);
 
-  embVertex *vertices = (embVertex *)rtcMapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
-  for (int i = 0; i < numVerts; i++) {
-    vertices[i].x = mesh->vertices[i][0];
-    vertices[i].y = mesh->vertices[i][1];
-    vertices[i].z = mesh->vertices[i][2];
-  }
-  rtcUnmapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
-
-  embTriangle *triangles = (embTriangle *)rtcMapBuffer(scene, geomId, RTC_INDEX_BUFFER);
-  for (int i = 0; i < numTris; i++) {
-    gvt::render::data::primitives::Mesh::Face f = mesh->faces[i];
-    triangles[i].v0 = std::get<0>(f);
-    triangles[i].v1 = std::get<1>(f);
-    triangles[i].v2 = std::get<2>(f);
+  if (mesh->packed()) {
+    // packed meshes already have embree's layout, share the arrays (the adapter holds the mesh)
+    rtcSetBuffer(scene, geomId, RTC_VERTEX_BUFFER, mesh->packedVertices(), 0, 4 * sizeof(float));
+    rtcSetBuffer(scene, geomId, RTC_INDEX_BUFFER, mesh->packedTriangles(), 0, 3 * sizeof(uint32_t));
+  } else {
+    embVertex *vertices = (embVertex *)rtcMapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
+    for (std::size_t i = 0; i < numVerts; i++) {
+      vertices[i].x = mesh->vertices[i][0];
+      vertices[i].y = mesh->vertices[i][1];
+      vertices[i].z = mesh->vertices[i][2];
+    }
+    rtcUnmapBuffer(scene, geomId, RTC_VERTEX_BUFFER);
+
+    embTriangle *triangles = (embTriangle *)rtcMapBuffer(scene, geomId, RTC_INDEX_BUFFER);
+    for (std::size_t i = 0; i < numTris; i++) {
+      gvt::render::data::primitives::Mesh::Face f = mesh->faces[i];
+      triangles[i].v0 = std::get<0>(f);
+      triangles[i].v1 = std::get<1>(f);
+      triangles[i].v2 = std::get<2>(f);
+    }
+    rtcUnmapBuffer(scene, geomId, RTC_INDEX_BUFFER);
   }
-  rtcUnmapBuffer(scene, geomId, RTC_INDEX_BUFFER);
 
   // mesh->writeobj("mesh.obj");
 
@@ -166,7 +138,7 @@ EmbreeStreamMeshAdapter::EmbreeStreamMeshAdapter(std::shared_ptr<gvt::render::da
 EmbreeStreamMeshAdapter::~EmbreeStreamMeshAdapter() {
   rtcDeleteGeometry(scene, geomId);
   rtcDeleteScene(scene);
-  rtcDeleteDevice(device);
+  gvt::render::adapter::embree::EmbreeDevice::release();
 }
 
 struct embreeStreamParallelTrace {
@@ -205,6 +177,17 @@ struct embreeStreamParallelTrace {
    */
   const glm::mat3 *normi;
 
+  /**
+   * Moves streams into the object space of the current instance (minv)
+   */
+  const gvt::render::adapter::embree::ObjectSpace toObject;
+
+  /**
+   * Object space origins and directions of a 1M stream, transformed in one pass before they are
+   * written to the RTCRay structures
+   */
+  RTCORE_ALIGN(32) float local[6][GVT_EMBREE_STREAM_SIZE_M];
+
   /**
    * Stored transformation matrix in the current instance
    */
@@ -223,13 +206,19 @@ struct embreeStreamParallelTrace {
   gvt::render::actor::RayVector localDispatch;
 
   /**
-   * List of shadow rays to be processed
+   * List of shadow rays to be processed, kept in structure-of-arrays layout so packet setup is a straight copy
    */
-  gvt::render::actor::RayVector shadowRays;
+  gvt::render::actor::RayStream shadowRays;
 
   const size_t begin, end;
 
   gvt::render::data::primitives::Mesh *mesh;
+
+  /**
+   * Lanes issued by this chunk for closest hit and occlusion queries
+   */
+  gvt::render::adapter::embree::LaneTally intersectLanes, occludeLanes;
+
   /**
    * Construct a embreeStreamParallelTrace struct with information needed for the
    * thread
@@ -242,7 +231,7 @@ struct embreeStreamParallelTrace {
                             std::shared_ptr<gvt::render::data::primitives::Mesh> mesh, std::atomic<size_t> &counter, const size_t begin,
                             const size_t end)
       : adapter(adapter), rayList(rayList), moved_rays(moved_rays), workSize(workSize), m(m), minv(minv), normi(normi),
-        lights(lights), counter(counter), begin(begin), end(end), mesh(mesh.get()) {}
+        toObject(*minv), local(), lights(lights), counter(counter), begin(begin), end(end), mesh(mesh.get()) {}
   /**
    * Convert a set of rays from a vector into a GVT_EMBREE_PACKET_TYPE ray packet.
    *
@@ -262,7 +251,7 @@ struct embreeStreamParallelTrace {
       for (int i = 0; i < localPacketSize; i++) {
         valid[i] = -1;
       }
-      for (int i = localPacketSize; i < localPacketSize; i++) {
+      for (int i = localPacketSize; i < GVT_EMBREE_PACKET_SIZE; i++) {
         valid[i] = 0;
       }
     }
@@ -278,7 +267,7 @@ struct embreeStreamParallelTrace {
         ray4.diry[i] = r.mice.direction[1];
         ray4.dirz[i] = r.mice.direction[2];
         ray4.tnear[i] = gvt::render::actor::Ray::RAY_EPSILON;
-        ray4.tfar[i] = FLT_MAX;
+        ray4.tfar[i] = r.mice.t_max;
         ray4.geomID[i] = RTC_INVALID_GEOMETRY_ID;
         ray4.primID[i] = RTC_INVALID_GEOMETRY_ID;
         ray4.instID[i] = RTC_INVALID_GEOMETRY_ID;
@@ -301,21 +290,26 @@ struct embreeStreamParallelTrace {
       }
     }
 
-    // convert localStreamSize rays into embree's GVT_EMBREE_PACKET_TYPE struct
+    // gather the rays, move them to object space in one pass, then fill embree's RTCRay structs
     for (int i = 0; i < GVT_EMBREE_STREAM_SIZE_M; i++) {
       if (valid[i]) {
         const Ray &r = rays[startIdx + i];
-        const auto origin = (*minv) * glm::vec4(r.mice.origin, 1.f); // transform ray to local space
-        const auto direction = (*minv) * glm::vec4(r.mice.direction, 0.f);
-
-        ray[i].org[0] = origin[0];
-        ray[i].org[1] = origin[1];
-        ray[i].org[2] = origin[2];
-        ray[i].dir[0] = direction[0];
-        ray[i].dir[1] = direction[1];
-        ray[i].dir[2] = direction[2];
+        for (int k = 0; k < 3; ++k) {
+          local[k][i] = r.mice.origin[k];
+          local[3 + k][i] = r.mice.direction[k];
+        }
+      }
+    }
+    toObject(local[0], local[1], local[2], local[3], local[4], local[5], GVT_EMBREE_STREAM_SIZE_M);
+
+    for (int i = 0; i < GVT_EMBREE_STREAM_SIZE_M; i++) {
+      if (valid[i]) {
+        for (int k = 0; k < 3; ++k) {
+          ray[i].org[k] = local[k][i];
+          ray[i].dir[k] = local[3 + k][i];
+        }
         ray[i].tnear = gvt::render::actor::Ray::RAY_EPSILON;
-        ray[i].tfar = FLT_MAX;
+        ray[i].tfar = rays[startIdx + i].mice.t_max;
         ray[i].geomID = RTC_INVALID_GEOMETRY_ID;
         ray[i].primID = RTC_INVALID_GEOMETRY_ID;
         ray[i].instID = RTC_INVALID_GEOMETRY_ID;
@@ -346,19 +340,17 @@ struct embreeStreamParallelTrace {
       for (int n = 0; n < GVT_EMBREE_PACKET_SIZE_N; ++n) {
         if (valid[offset]) {
           const Ray &r = rays[startIdx + offset];
-          const auto origin = (*minv) * glm::vec4(r.mice.origin, 1.f);
-          const auto direction = (*minv) * glm::vec4(r.mice.direction, 0.f);
 
-          RTCRayN_org_x(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = origin[0];
-          RTCRayN_org_y(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = origin[1];
-          RTCRayN_org_z(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = origin[2];
+          RTCRayN_org_x(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = r.mice.origin[0];
+          RTCRayN_org_y(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = r.mice.origin[1];
+          RTCRayN_org_z(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = r.mice.origin[2];
 
-          RTCRayN_dir_x(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = direction[0];
-          RTCRayN_dir_y(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = direction[1];
-          RTCRayN_dir_z(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = direction[2];
+          RTCRayN_dir_x(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = r.mice.direction[0];
+          RTCRayN_dir_y(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = r.mice.direction[1];
+          RTCRayN_dir_z(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = r.mice.direction[2];
 
           RTCRayN_tnear(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = gvt::render::actor::Ray::RAY_EPSILON;
-          RTCRayN_tfar(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = FLT_MAX;
+          RTCRayN_tfar(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = r.mice.t_max;
 
           RTCRayN_geomID(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = RTC_INVALID_GEOMETRY_ID;
           RTCRayN_primID(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = RTC_INVALID_GEOMETRY_ID;
@@ -373,6 +365,137 @@ struct embreeStreamParallelTrace {
         }
         ++offset;
       }
+      // move the packet to object space in one pass
+      RTCRayN *packet = (RTCRayN *)&rayNM[m];
+      toObject(&RTCRayN_org_x(packet, GVT_EMBREE_PACKET_SIZE_N, 0), &RTCRayN_org_y(packet, GVT_EMBREE_PACKET_SIZE_N, 0),
+               &RTCRayN_org_z(packet, GVT_EMBREE_PACKET_SIZE_N, 0), &RTCRayN_dir_x(packet, GVT_EMBREE_PACKET_SIZE_N, 0),
+               &RTCRayN_dir_y(packet, GVT_EMBREE_PACKET_SIZE_N, 0), &RTCRayN_dir_z(packet, GVT_EMBREE_PACKET_SIZE_N, 0),
+               GVT_EMBREE_PACKET_SIZE_N);
+    }
+  }
+
+  void prepGVT_EMBREE_STREAM_1M(RTCRay ray[GVT_EMBREE_STREAM_SIZE_M], int valid[GVT_EMBREE_STREAM_SIZE_M],
+                                const bool resetValid, const int localStreamSize,
+                                const gvt::render::actor::RayStream &rays, const size_t startIdx) {
+    if (resetValid) {
+      for (int i = 0; i < localStreamSize; i++) {
+        valid[i] = -1;
+      }
+      for (int i = localStreamSize; i < GVT_EMBREE_STREAM_SIZE_M; i++) {
+        valid[i] = 0;
+      }
+    }
+
+    // move the stream columns to object space in one pass, then fill embree's RTCRay structs
+    toObject(rays.ox + startIdx, rays.oy + startIdx, rays.oz + startIdx, rays.dx + startIdx, rays.dy + startIdx,
+             rays.dz + startIdx, local[0], local[1], local[2], local[3], local[4], local[5], localStreamSize);
+    for (int i = 0; i < GVT_EMBREE_STREAM_SIZE_M; i++) {
+      if (valid[i]) {
+        for (int k = 0; k < 3; ++k) {
+          ray[i].org[k] = local[k][i];
+          ray[i].dir[k] = local[3 + k][i];
+        }
+        ray[i].tnear = gvt::render::actor::Ray::RAY_EPSILON;
+        ray[i].tfar = rays.t_max[startIdx + i];
+        ray[i].geomID = RTC_INVALID_GEOMETRY_ID;
+        ray[i].primID = RTC_INVALID_GEOMETRY_ID;
+        ray[i].instID = RTC_INVALID_GEOMETRY_ID;
+        ray[i].mask = -1;
+        ray[i].time = gvt::render::actor::Ray::RAY_EPSILON;
+      } else {
+        ray[i].tnear = (float)(FLT_MAX);
+        ray[i].tfar = (float)(-FLT_MAX);
+      }
+    }
+  }
+
+  void prepGVT_EMBREE_STREAM_NM(RTCRayNt<GVT_EMBREE_PACKET_SIZE_N> rayNM[GVT_EMBREE_STREAM_SIZE_M],
+                                int valid[GVT_EMBREE_STREAM_SIZE_NM], const bool resetValid, const int localRayCount,
+                                const gvt::render::actor::RayStream &rays, const size_t startIdx) {
+    if (resetValid) {
+      for (int i = 0; i < localRayCount; i++) {
+        valid[i] = -1;
+      }
+      for (int i = localRayCount; i < GVT_EMBREE_STREAM_SIZE_NM; i++) {
+        valid[i] = 0;
+      }
+    }
+
+    int offset = 0;
+    for (int m = 0; m < GVT_EMBREE_STREAM_SIZE_M; ++m) {
+      // move the stream columns of the packet to object space in one pass
+      const int lanes = std::min(std::max(localRayCount - m * GVT_EMBREE_PACKET_SIZE_N, 0), GVT_EMBREE_PACKET_SIZE_N);
+      if (lanes) {
+        const size_t ri = startIdx + m * GVT_EMBREE_PACKET_SIZE_N;
+        RTCRayN *packet = (RTCRayN *)&rayNM[m];
+        toObject(rays.ox + ri, rays.oy + ri, rays.oz + ri, rays.dx + ri, rays.dy + ri, rays.dz + ri,
+                 &RTCRayN_org_x(packet, GVT_EMBREE_PACKET_SIZE_N, 0), &RTCRayN_org_y(packet, GVT_EMBREE_PACKET_SIZE_N, 0),
+                 &RTCRayN_org_z(packet, GVT_EMBREE_PACKET_SIZE_N, 0), &RTCRayN_dir_x(packet, GVT_EMBREE_PACKET_SIZE_N, 0),
+                 &RTCRayN_dir_y(packet, GVT_EMBREE_PACKET_SIZE_N, 0), &RTCRayN_dir_z(packet, GVT_EMBREE_PACKET_SIZE_N, 0),
+                 lanes);
+      }
+      for (int n = 0; n < GVT_EMBREE_PACKET_SIZE_N; ++n) {
+        if (valid[offset]) {
+          RTCRayN_tnear(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = gvt::render::actor::Ray::RAY_EPSILON;
+          RTCRayN_tfar(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = rays.t_max[startIdx + offset];
+
+          RTCRayN_geomID(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = RTC_INVALID_GEOMETRY_ID;
+          RTCRayN_primID(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = RTC_INVALID_GEOMETRY_ID;
+          RTCRayN_instID(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = RTC_INVALID_GEOMETRY_ID;
+
+          RTCRayN_mask(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = -1;
+          RTCRayN_time(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = gvt::render::actor::Ray::RAY_EPSILON;
+
+        } else {
+          RTCRayN_tnear(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = (float)(FLT_MAX);
+          RTCRayN_tfar(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n) = (float)(-FLT_MAX);
+        }
+        ++offset;
+      }
+    }
+  }
+
+  /**
+   * Convert a set of rays from a ray stream into a GVT_EMBREE_PACKET_TYPE ray packet.
+   *
+   * Same as the ray vector version, but the stream columns are copied lane by lane without a gather.
+   *
+   * \param ray4          reference of GVT_EMBREE_PACKET_TYPE struct to write to
+   * \param valid         aligned array of ints to mark valid rays
+   * \param resetValid    if true, reset the valid bits, if false, re-use old
+   * valid to know which to convert
+   * \param localPacketSize    number of rays to convert
+   * \param rays          ray stream to read from
+   * \param startIdx      starting point to read from in `rays`
+   */
+  void prepGVT_EMBREE_PACKET_TYPE(GVT_EMBREE_PACKET_TYPE &ray4, int valid[GVT_EMBREE_PACKET_SIZE],
+                                  const bool resetValid, const int localPacketSize,
+                                  const gvt::render::actor::RayStream &rays, const size_t startIdx) {
+    if (resetValid) {
+      for (int i = 0; i < localPacketSize; i++) {
+        valid[i] = -1;
+      }
+      for (int i = localPacketSize; i < GVT_EMBREE_PACKET_SIZE; i++) {
+        valid[i] = 0;
+      }
+    }
+
+    const float *ox = rays.ox + startIdx, *oy = rays.oy + startIdx, *oz = rays.oz + startIdx;
+    const float *dx = rays.dx + startIdx, *dy = rays.dy + startIdx, *dz = rays.dz + startIdx;
+    for (int i = 0; i < localPacketSize; i++) {
+      ray4.orgx[i] = ox[i];
+      ray4.orgy[i] = oy[i];
+      ray4.orgz[i] = oz[i];
+      ray4.dirx[i] = dx[i];
+      ray4.diry[i] = dy[i];
+      ray4.dirz[i] = dz[i];
+      ray4.tnear[i] = gvt::render::actor::Ray::RAY_EPSILON;
+      ray4.tfar[i] = rays.t_max[startIdx + i];
+      ray4.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+      ray4.primID[i] = RTC_INVALID_GEOMETRY_ID;
+      ray4.instID[i] = RTC_INVALID_GEOMETRY_ID;
+      ray4.mask[i] = -1;
+      ray4.time[i] = gvt::render::actor::Ray::RAY_EPSILON;
     }
   }
 
@@ -409,7 +532,7 @@ struct embreeStreamParallelTrace {
 
   void generateShadowRays(const gvt::render::actor::Ray &r, const glm::vec3 &normal,
                           gvt::render::data::primitives::Material *material, unsigned int *randSeed,
-                          gvt::render::actor::RayVector &shadowRays) {
+                          gvt::render::actor::RayStream &shadowRays) {
 
     for (std::shared_ptr<gvt::render::data::scene::Light>light : lights) {
       GVT_ASSERT(light, "generateShadowRays: light is null for some reason");
@@ -434,16 +557,20 @@ struct embreeStreamParallelTrace {
 
       const glm::vec3 origin = r.mice.origin + r.mice.direction * t_shadow;
       const glm::vec3 dir = lightPos - origin;
-      const float t_max = dir.length();
-
-      // note: ray copy constructor is too heavy, so going to build it manually
-      shadowRays.push_back(Ray(r.mice.origin + r.mice.direction * t_shadow, dir, r.mice.w, Ray::SHADOW, r.mice.depth));
-
-      Ray &shadow_ray = shadowRays.back();
-      shadow_ray.mice.t = r.mice.t;
-      shadow_ray.mice.id = r.mice.id;
-      shadow_ray.mice.t_max = t_max;
-      shadow_ray.mice.color = glm::vec3(c[0], c[1], c[2]);
+      const float t_max = glm::length(dir);
+
+      // write the shadow ray straight into the stream columns
+      const size_t si = shadowRays.emplace();
+      shadowRays.setOrigin(si, origin);
+      shadowRays.setDirection(si, glm::normalize(dir));
+      shadowRays.setColor(si, glm::vec3(c[0], c[1], c[2]));
+      shadowRays.t_min[si] = gvt::render::actor::Ray::RAY_EPSILON;
+      shadowRays.t_max[si] = t_max;
+      shadowRays.t[si] = r.mice.t;
+      shadowRays.w[si] = r.mice.w;
+      shadowRays.id[si] = r.mice.id;
+      shadowRays.depth[si] = r.mice.depth;
+      shadowRays.type[si] = Ray::SHADOW;
     }
   }
 
@@ -464,11 +591,12 @@ struct embreeStreamParallelTrace {
       // create a shadow packet and trace with rtcOccluded
       prepGVT_EMBREE_PACKET_TYPE(ray4, valid, true, localPacketSize, shadowRays, idx);
       GVT_EMBREE_OCCULUSION(valid, scene, ray4);
+      occludeLanes.add(GVT_EMBREE_PACKET_SIZE, localPacketSize);
 
       for (size_t pi = 0; pi < localPacketSize; pi++) {
         if (valid[pi] && ray4.geomID[pi] == (int)RTC_INVALID_GEOMETRY_ID) {
           // ray is valid, but did not hit anything, so add to dispatch queue
-          localDispatch.push_back(shadowRays[idx + pi]);
+          localDispatch.push_back(shadowRays.get(idx + pi));
         }
       }
     }
@@ -495,12 +623,13 @@ struct embreeStreamParallelTrace {
       // create a shadow packet and trace with rtcOccluded
       prepGVT_EMBREE_STREAM_1M(ray1M, valid, true, localStreamSize, shadowRays, idx);
       rtcOccluded1M(scene, &rtc_context, ray1M, localStreamSize, sizeof(RTCRay));
+      occludeLanes.add(GVT_EMBREE_STREAM_SIZE_M, localStreamSize);
       // GVT_EMBREE_OCCULUSION(valid, scene, ray4);
 
       for (size_t pi = 0; pi < localStreamSize; pi++) {
         if (valid[pi] && ray1M[pi].geomID == (int)RTC_INVALID_GEOMETRY_ID) {
           // ray is valid, but did not hit anything, so add to dispatch queue
-          localDispatch.push_back(shadowRays[idx + pi]);
+          localDispatch.push_back(shadowRays.get(idx + pi));
         }
       }
     }
@@ -525,6 +654,7 @@ struct embreeStreamParallelTrace {
 
       std::size_t stride = sizeof(RTCRayNt<GVT_EMBREE_PACKET_SIZE_N>);
       rtcOccludedNM(scene, &rtc_context, rayNM, GVT_EMBREE_PACKET_SIZE_N, GVT_EMBREE_STREAM_SIZE_M, stride);
+      occludeLanes.add(GVT_EMBREE_STREAM_SIZE_NM, localRayCount);
 
       int pi = 0;
       for (int m = 0; m < GVT_EMBREE_STREAM_SIZE_M; ++m) {
@@ -533,7 +663,7 @@ struct embreeStreamParallelTrace {
           unsigned geomID = RTCRayN_geomID(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n);
           if (valid[pi] && geomID == (int)RTC_INVALID_GEOMETRY_ID) {
             // ray is valid, but did not hit anything, so add to dispatch queue
-            localDispatch.push_back(shadowRays[idx + pi]);
+            localDispatch.push_back(shadowRays.get(idx + pi));
           }
           ++pi;
         }
@@ -542,6 +672,129 @@ struct embreeStreamParallelTrace {
     shadowRays.clear();
   }
 
+  /**
+   * Shade a primary or secondary ray that hit the mesh.
+   *
+   * Records the hit distance, queues the shadow rays of the hit point in `shadowRays` and, if the
+   * ray survives russian roulette, replaces it in place with its secondary ray.
+   *
+   * \param r             ray that hit the mesh
+   * \param t             hit distance
+   * \param Ng            geometric normal reported by Embree [object space, not normalized]
+   * \param primID        triangle that was hit
+   * \param u             barycentric u of the hit
+   * \param v             barycentric v of the hit
+   * \param randEngine    random engine of the tracing thread
+   * \return true if `r` is now a secondary ray that needs to be traced
+   */
+  bool shade(gvt::render::actor::Ray &r, float t, const glm::vec3 &Ng, const int primID, const float u, const float v,
+             gvt::core::math::RandEngine &randEngine) {
+    r.mice.t = t;
+
+    // FIXME: embree does not take vertex normal information, the
+    // examples have the application calculate the normal using
+    // math similar to the bottom.  this means we have to keep
+    // around a 'faces_to_normals' list along with a 'normals' list
+    // for the embree adapter
+    //
+    // old fixme: fix embree normal calculation to remove dependency
+    // from gvt mesh
+
+    glm::vec3 manualNormal;
+    glm::vec3 normalflat = glm::normalize((*normi) * -Ng);
+    {
+      const int triangle_id = primID;
+#ifndef FLAT_SHADING
+      const Mesh::FaceToNormals normals = mesh->faceNormals(triangle_id); // FIXME: need to
+                                                                          // figure out
+                                                                          // to store
+                                                                          // `faces_to_normals`
+                                                                          // list
+      const glm::vec3 &a = mesh->normals[std::get<1>(normals)];
+      const glm::vec3 &b = mesh->normals[std::get<2>(normals)];
+      const glm::vec3 &c = mesh->normals[std::get<0>(normals)];
+      manualNormal = a * u + b * v + c * (1.0f - u - v);
+      manualNormal = glm::normalize((*normi) * manualNormal);
+#else
+
+      manualNormal = normalflat;
+
+#endif
+    }
+
+    // backface check, requires flat normal
+    if (glm::dot(-r.mice.direction, normalflat) <= 0.f) {
+      manualNormal = -manualNormal;
+    }
+
+    const glm::vec3 &normal = manualNormal;
+
+    Material *mat;
+
+    if (!mesh->vertex_colors.empty()) { // per-vertex color available, create material here
+      // Get vertex indexes
+      gvt::render::data::primitives::Mesh::Face face = mesh->face(primID);
+
+      int v0 = std::get<0>(face);
+      int v1 = std::get<1>(face);
+      int v2 = std::get<2>(face);
+
+      // Get color at each vertex
+      glm::vec3 c0 = mesh->vertex_colors[v0];
+      glm::vec3 c1 = mesh->vertex_colors[v1];
+      glm::vec3 c2 = mesh->vertex_colors[v2];
+      
+      // Interpolate colors
+      // given vertices v0, v1, v2, u and v are defined as
+      // u: v1-v0
+      // v: v2-v0
+      glm::vec3 ci = (c0 * (1.f - u - v)) + (c1 * u) + (c2 * v);
+
+      // Create Material
+      mat = new gvt::render::data::primitives::Material;
+      mat->type = LAMBERT;
+      mat->kd = ci;
+
+    } else if (mesh->faces_to_materials.size() && mesh->faces_to_materials[primID]) {
+      mat = mesh->faces_to_materials[primID];
+    } else {
+      mat = mesh->getMaterial();
+    }
+
+    // reduce contribution of the color that the shadow rays get
+    if (r.mice.type == gvt::render::actor::Ray::SECONDARY) {
+      t = (t > 1) ? 1.f / t : t;
+      r.mice.w = r.mice.w * t;
+    }
+
+    generateShadowRays(r, normal, mat, randEngine.ReturnSeed(), shadowRays);
+
+    // In case we have per-vertex color information, destruct the material temporarily created
+    if (!mesh->vertex_colors.empty()) {
+      delete mat;
+    }
+
+    int ndepth = r.mice.depth - 1;
+
+    float p = 1.f - randEngine.fastrand(0, 1); //(float(rand()) / RAND_MAX);
+    // replace current ray with generated secondary ray
+    if (ndepth > 0 && r.mice.w > p) {
+      r.mice.type = gvt::render::actor::Ray::SECONDARY;
+      const float multiplier =
+          1.0f - 16.0f * std::numeric_limits<float>::epsilon(); // TODO: move out somewhere / make static
+      const float t_secondary = multiplier * r.mice.t;
+      r.mice.origin = r.mice.origin + r.mice.direction * t_secondary;
+      r.mice.direction = CosWeightedRandomHemisphereDirection2(normal, randEngine);
+
+      r.mice.w = r.mice.w * glm::dot(r.mice.direction, normal);
+      r.mice.depth = ndepth;
+      return true;
+    }
+
+    // secondary ray is terminated
+    return false;
+  }
+
 /**
  * Trace function.
  *
@@ -712,14 +965,14 @@ struct embreeStreamParallelTrace {
                   const float v = RTCRayN_v(&rayNM[m], GVT_EMBREE_PACKET_SIZE_N, n);
                   // const float u = ray1M[pi].u;
                   // const float v = ray1M[pi].v;
-                  const Mesh::FaceToNormals &normals = mesh->faces_to_normals[triangle_id]; // FIXME: need to
-                                                                                            // figure out
-                                                                                            // to store
-                                                                                            // `faces_to_normals`
-                                                                                            // list
-                  const glm::vec3 &a = mesh->normals[normals.get<1>()];
-                  const glm::vec3 &b = mesh->normals[normals.get<2>()];
-                  const glm::vec3 &c = mesh->normals[normals.get<0>()];
+                  const Mesh::FaceToNormals normals = mesh->faceNormals(triangle_id); // FIXME: need to
+                                                                                      // figure out
+                                                                                      // to store
+                                                                                      // `faces_to_normals`
+                                                                                      // list
+                  const glm::vec3 &a = mesh->normals[std::get<1>(normals)];
+                  const glm::vec3 &b = mesh->normals[std::get<2>(normals)];
+                  const glm::vec3 &c = mesh->normals[std::get<0>(normals)];
                   manualNormal = a * u + b * v + c * (1.0f - u - v);
                   manualNormal = glm::normalize((*normi) * manualNormal);
 #else
@@ -743,7 +996,7 @@ struct embreeStreamParallelTrace {
 
                 if (!mesh->vertex_colors.empty()) { // per-vertex color available, create material here
                   // Get vertex indexes
-                  gvt::render::data::primitives::Mesh::Face face = mesh->faces[primID];
+                  gvt::render::data::primitives::Mesh::Face face = mesh->face(primID);
 
                   int v0 = face.get<0>();
                   int v1 = face.get<1>();
@@ -827,10 +1080,7 @@ struct embreeStreamParallelTrace {
       }
     }
 
-    // copy localDispatch rays to outgoing rays queue
-    std::unique_lock<std::mutex> moved(adapter->_outqueue);
-    moved_rays.insert(moved_rays.end(), localDispatch.begin(), localDispatch.end());
-    moved.unlock();
+    dispatch();
   }
 
 #elif defined(GVT_EMBREE_STREAM_1M)
@@ -888,6 +1138,10 @@ struct embreeStreamParallelTrace {
         prepGVT_EMBREE_STREAM_1M(ray1M, valid, resetValid, localStreamSize, rayList, localIdx);
         rtcIntersect1M(scene, &rtc_context, ray1M, localStreamSize, sizeof(RTCRay));
 
+        size_t activeLanes = 0;
+        for (size_t pi = 0; pi < localStreamSize; pi++) activeLanes += (valid[pi] != 0);
+        intersectLanes.add(GVT_EMBREE_STREAM_SIZE_M, activeLanes);
+
         resetValid = false;
 
         // for (int m = 0; m < GVT_EMBREE_STREAM_SIZE_M; ++m) {
@@ -904,125 +1158,12 @@ struct embreeStreamParallelTrace {
               // ray has hit something
               // shadow ray hit something, so it should be dropped
               if (r.mice.type == gvt::render::actor::Ray::SHADOW) {
+                valid[pi] = 0;
                 continue;
               }
 
-              // float t = rayNM[m].tfar[n];
-              float t = ray1M[pi].tfar;
-              r.mice.t = t;
-
-              // FIXME: embree does not take vertex normal information, the
-              // examples have the application calculate the normal using
-              // math similar to the bottom.  this means we have to keep
-              // around a 'faces_to_normals' list along with a 'normals' list
-              // for the embree adapter
-              //
-              // old fixme: fix embree normal calculation to remove dependency
-              // from gvt mesh
-
-              glm::vec3 manualNormal;
-              // glm::vec3 normalflat =
-              //     glm::normalize((*normi) * -glm::vec3(rayNM[m].Ngx[n], rayNM[m].Ngy[n], rayNM[m].Ngz[n]));
-              glm::vec3 normalflat =
-                  glm::normalize((*normi) * -glm::vec3(ray1M[pi].Ng[0], ray1M[pi].Ng[1], ray1M[pi].Ng[2]));
-              {
-                // const int triangle_id = rayNM[m].primID[n];
-                const int triangle_id = ray1M[pi].primID;
-#ifndef FLAT_SHADING
-                // const float u = rayNM[m].u[n];
-                // const float v = rayNM[m].v[n];
-                const float u = ray1M[pi].u;
-                const float v = ray1M[pi].v;
-                const Mesh::FaceToNormals &normals = mesh->faces_to_normals[triangle_id]; // FIXME: need to
-                                                                                          // figure out
-                                                                                          // to store
-                                                                                          // `faces_to_normals`
-                                                                                          // list
-                const glm::vec3 &a = mesh->normals[std::get<1>(normals)];
-                const glm::vec3 &b = mesh->normals[std::get<2>(normals)];
-                const glm::vec3 &c = mesh->normals[std::get<0>(normals)];
-                manualNormal = a * u + b * v + c * (1.0f - u - v);
-                manualNormal = glm::normalize((*normi) * manualNormal);
-#else
-
-                manualNormal = normalflat;
-
-#endif
-              }
-
-              // backface check, requires flat normal
-              if (glm::dot(-r.mice.direction, normalflat) <= 0.f) {
-                manualNormal = -manualNormal;
-              }
-
-              const glm::vec3 &normal = manualNormal;
-
-              Material *mat;
-
-              if (!mesh->vertex_colors.empty()) { // per-vertex color available, create material here
-                // Get vertex indexes
-                gvt::render::data::primitives::Mesh::Face face = mesh->faces[ray1M[pi].primID];
-
-                int v0 = std::get<0>(face);
-                int v1 = std::get<1>(face);
-                int v2 = std::get<2>(face);
-
-                // Get U V Coordinates
-
-                float u = ray1M[pi].u;
-                float v = ray1M[pi].v;
-
-                // Get color at each vertex
-                glm::vec3 c0 = mesh->vertex_colors[v0];
-                glm::vec3 c1 = mesh->vertex_colors[v1];
-                glm::vec3 c2 = mesh->vertex_colors[v2];
-
-                // Interpolate colors
-                // given vertices v0, v1, v2, u and v are defined as
-                // u: v1-v0
-                // v: v2-v0
-                glm::vec3 ci = (c0 * (1.f - u - v)) + (c1 * u) + (c2 * v);
-
-                // Create Material
-                mat = new gvt::render::data::primitives::Material;
-                mat->type = LAMBERT;
-                mat->kd = ci;
-
-                // if (mesh->faces_to_materials.size() && mesh->faces_to_materials[rayNM[m].primID[n]])
-              } else if (mesh->faces_to_materials.size() && mesh->faces_to_materials[ray1M[pi].primID]) {
-                // mat = mesh->faces_to_materials[rayNM[m].primID[n]];
-                mat = mesh->faces_to_materials[ray1M[pi].primID];
-              } else {
-                mat = mesh->getMaterial();
-              }
-
-              // reduce contribution of the color that the shadow rays get
-              if (r.mice.type == gvt::render::actor::Ray::SECONDARY) {
-                t = (t > 1) ? 1.f / t : t;
-                r.mice.w = r.mice.w * t;
-              }
-
-              generateShadowRays(r, normal, mat, randEngine.ReturnSeed(), shadowRays);
-
-              // In case we have per-vertex color information, destruct the material temporarily created
-              if (!mesh->vertex_colors.empty()) {
-                delete mat;
-              }
-
-              int ndepth = r.mice.depth - 1;
-
-              float p = 1.f - randEngine.fastrand(0, 1); //(float(rand()) / RAND_MAX);
-              // replace current ray with generated secondary ray
-              if (ndepth > 0 && r.mice.w > p) {
-                r.mice.type = gvt::render::actor::Ray::SECONDARY;
-                const float multiplier =
-                    1.0f - 16.0f * std::numeric_limits<float>::epsilon(); // TODO: move out somewhere / make static
-                const float t_secondary = multiplier * r.mice.t;
-                r.mice.origin = r.mice.origin + r.mice.direction * t_secondary;
-                r.mice.direction = CosWeightedRandomHemisphereDirection2(normal, randEngine);
-
-                r.mice.w = r.mice.w * glm::dot(r.mice.direction, normal);
-                r.mice.depth = ndepth;
+              if (shade(r, ray1M[pi].tfar, glm::vec3(ray1M[pi].Ng[0], ray1M[pi].Ng[1], ray1M[pi].Ng[2]), ray1M[pi].primID,
+                        ray1M[pi].u, ray1M[pi].v, randEngine)) {
                 validRayLeft = true; // we still have a valid ray in the packet to trace
               } else {
                 // secondary ray is terminated, so disable its valid bit
@@ -1045,12 +1186,121 @@ struct embreeStreamParallelTrace {
       }
     }
 
-    // copy localDispatch rays to outgoing rays queue
+    dispatch();
+  }
+#endif // GVT_EMBREE_STREAM_1M
+
+  /**
+   * Wavefront trace function.
+   *
+   * Same rays and shading as operator(), but the chunk advances one bounce at a time: every live
+   * ray is traced and shaded before any ray takes its next bounce. Rays that continue as secondary
+   * rays are compacted to the front of the chunk, so every stream of the next bounce is full
+   * instead of carrying the terminated rays of a stream that is followed to completion. The shadow
+   * rays of a bounce are traced together once the bounce is shaded.
+   */
+  void wavefront() {
+
+    RTCScene scene = adapter->scene;
+    localDispatch.reserve((end - begin) * 2);
+    shadowRays.reserve((end - begin) * lights.size());
+
+    gvt::core::math::RandEngine randEngine;
+    randEngine.SetSeed(begin);
+
+#if defined(GVT_EMBREE_STREAM_NM)
+    RTCORE_ALIGN(16) RTCRayNt<GVT_EMBREE_PACKET_SIZE_N> rayNM[GVT_EMBREE_STREAM_SIZE_M];
+    RTCORE_ALIGN(16) int valid[GVT_EMBREE_STREAM_SIZE_NM] = { 0 };
+    const size_t streamSize = GVT_EMBREE_STREAM_SIZE_NM;
+#else
+    RTCORE_ALIGN(16) RTCRay ray1M[GVT_EMBREE_STREAM_SIZE_M];
+    RTCORE_ALIGN(16) int valid[GVT_EMBREE_STREAM_SIZE_M] = { 0 };
+    const size_t streamSize = GVT_EMBREE_STREAM_SIZE_M;
+#endif
+
+    RTCIntersectContext rtc_context;
+    rtc_context.flags = RTC_INTERSECT_INCOHERENT;
+    rtc_context.userRayExt = nullptr;
+
+    // rays in [begin, liveEnd) still have to be traced
+    size_t liveEnd = end;
+    while (liveEnd > begin) {
+      size_t live = begin;
+
+      for (size_t localIdx = begin; localIdx < liveEnd; localIdx += streamSize) {
+        const size_t localRayCount = (localIdx + streamSize > liveEnd) ? (liveEnd - localIdx) : streamSize;
+
+#if defined(GVT_EMBREE_STREAM_NM)
+        prepGVT_EMBREE_STREAM_NM(rayNM, valid, true, localRayCount, rayList, localIdx);
+        rtcIntersectNM(scene, &rtc_context, rayNM, GVT_EMBREE_PACKET_SIZE_N, GVT_EMBREE_STREAM_SIZE_M,
+                       sizeof(RTCRayNt<GVT_EMBREE_PACKET_SIZE_N>));
+#else
+        prepGVT_EMBREE_STREAM_1M(ray1M, valid, true, localRayCount, rayList, localIdx);
+        rtcIntersect1M(scene, &rtc_context, ray1M, localRayCount, sizeof(RTCRay));
+#endif
+        intersectLanes.add(streamSize, localRayCount);
+
+        for (size_t pi = 0; pi < localRayCount; pi++) {
+#if defined(GVT_EMBREE_STREAM_NM)
+          RTCRayNt<GVT_EMBREE_PACKET_SIZE_N> *ray = &rayNM[pi / GVT_EMBREE_PACKET_SIZE_N];
+          const size_t n = pi % GVT_EMBREE_PACKET_SIZE_N;
+          const unsigned geomID = RTCRayN_geomID(ray, GVT_EMBREE_PACKET_SIZE_N, n);
+#else
+          const RTCRay &ray = ray1M[pi];
+          const unsigned geomID = ray.geomID;
+#endif
+          auto &r = rayList[localIdx + pi];
+          if (geomID != RTC_INVALID_GEOMETRY_ID) {
+            // shadow ray hit something, so it should be dropped
+            if (r.mice.type == gvt::render::actor::Ray::SHADOW) continue;
+
+#if defined(GVT_EMBREE_STREAM_NM)
+            const bool secondary =
+                shade(r, RTCRayN_tfar(ray, GVT_EMBREE_PACKET_SIZE_N, n),
+                      glm::vec3(RTCRayN_Ng_x(ray, GVT_EMBREE_PACKET_SIZE_N, n), RTCRayN_Ng_y(ray, GVT_EMBREE_PACKET_SIZE_N, n),
+                                RTCRayN_Ng_z(ray, GVT_EMBREE_PACKET_SIZE_N, n)),
+                      RTCRayN_primID(ray, GVT_EMBREE_PACKET_SIZE_N, n), RTCRayN_u(ray, GVT_EMBREE_PACKET_SIZE_N, n),
+                      RTCRayN_v(ray, GVT_EMBREE_PACKET_SIZE_N, n), randEngine);
+#else
+            const bool secondary =
+                shade(r, ray.tfar, glm::vec3(ray.Ng[0], ray.Ng[1], ray.Ng[2]), ray.primID, ray.u, ray.v, randEngine);
+#endif
+            if (secondary) {
+              // slots below localIdx + pi have been consumed, so the survivor can move down
+              if (live != localIdx + pi) rayList[live] = r;
+              live++;
+            }
+          } else {
+            // ray did not hit anything, pass it on
+            localDispatch.push_back(r);
+          }
+        }
+      }
+
+      // trace the shadow rays of the whole bounce
+#if defined(GVT_EMBREE_STREAM_NM)
+      traceShadowRaysNM();
+#else
+      traceShadowRays1M();
+#endif
+      liveEnd = live;
+    }
+
+    dispatch();
+  }
+
+  /**
+   * Copy the rays that left the mesh to the outgoing queue and publish the lane tallies.
+   */
+  void dispatch() {
     std::unique_lock<std::mutex> moved(adapter->_outqueue);
     moved_rays.insert(moved_rays.end(), localDispatch.begin(), localDispatch.end());
     moved.unlock();
+
+    gvt::render::adapter::embree::LaneCounters &lanes = gvt::render::adapter::embree::LaneCounters::instance();
+    intersectLanes.flush(lanes.intersect);
+    occludeLanes.flush(lanes.occlude);
   }
-#endif // GVT_EMBREE_STREAM_1M
 };
 
 void EmbreeStreamMeshAdapter::trace(gvt::render::actor::RayVector &rayList, gvt::render::actor::RayVector &moved_rays,
@@ -1060,19 +1310,7 @@ void EmbreeStreamMeshAdapter::trace(gvt::render::actor::RayVector &rayList, gvt:
 
   cntx::rcontext& db = cntx::rcontext::instance();
 
-  // // TODO if I don't apply rtcSetTrasform, I get correct images
-  // // disabling instancing for now
-
-  // global_scene = rtcDeviceNewScene(device, RTC_SCENE_STATIC, RTC_INTERSECT_STREAM);
-  // unsigned instID = rtcNewInstance(global_scene, scene);
-  // glm::mat4 tt = glm::transpose(*m);
-  // float *n = glm::value_ptr(tt);
-
-  // float mm[] = { n[0], n[4], n[8], n[1], n[5], n[9], n[2], n[6], n[10], n[3], n[7], n[11] };
-
-  // rtcSetTransform(global_scene, instID, RTC_MATRIX_COLUMN_MAJOR, mm);
-  // rtcUpdate(global_scene, instID);
-  // rtcCommit(global_scene);
+  // no embree instance, the streams are moved into the instance's object space, see ObjectSpace
   if (_end == 0) _end = rayList.size();
 
   this->begin = _begin;
@@ -1087,9 +1325,14 @@ void EmbreeStreamMeshAdapter::trace(gvt::render::actor::RayVector &rayList, gvt:
   static tbb::auto_partitioner ap;
   tbb::parallel_for(tbb::blocked_range<size_t>(begin, end, workSize),
                     [&](tbb::blocked_range<size_t> chunk) {
-                      embreeStreamParallelTrace(this, rayList, moved_rays, chunk.end() - chunk.begin(), m, minv, normi,
-                                                lights,std::static_pointer_cast<gvt::render::data::primitives::Mesh>(data), counter, chunk.begin(), chunk.end())();
+                      embreeStreamParallelTrace tracer(this, rayList, moved_rays, chunk.end() - chunk.begin(), m, minv,
+                                                       normi, lights,
+                                                       std::static_pointer_cast<gvt::render::data::primitives::Mesh>(data),
+                                                       counter, chunk.begin(), chunk.end());
+                      if (wavefront)
+                        tracer.wavefront();
+                      else
+                        tracer();
                     },
                     ap);
-  // rtcDeleteScene(global_scene);
 }
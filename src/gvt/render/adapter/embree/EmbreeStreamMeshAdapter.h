@@ -26,6 +26,7 @@
 #define GVT_RENDER_ADAPTER_EMBREE_DATA_EMBREE_STREAM_MESH_ADAPTER_H
 
 #include "gvt/render/Adapter.h"
+#include "gvt/render/adapter/embree/LaneCounters.h"
 
 #include <embree2/rtcore.h>
 #include <embree2/rtcore_ray.h>
@@ -47,14 +48,18 @@ public:
    * at the given node to Embree's format.
    *
    * Initializes Embree the first time it is called.
+   *
+   * \param wavefront trace in wavefront mode, see `wavefront`
    */
-  EmbreeStreamMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> mesh);
+  EmbreeStreamMeshAdapter(std::shared_ptr<gvt::render::data::primitives::Data> mesh, bool wavefront = false);
 
   /**
    * Release Embree copy of the mesh.
    */
   virtual ~EmbreeStreamMeshAdapter();
 
+  RTCDevice getDevice() const { return device; }
+
   virtual void trace(gvt::render::actor::RayVector &rayList, gvt::render::actor::RayVector &moved_rays, glm::mat4 *m,
                      glm::mat4 *minv, glm::mat3 *normi, gvt::core::Vector<std::shared_ptr<gvt::render::data::scene::Light> > &lights,
                      size_t begin = 0, size_t end = 0);
@@ -65,8 +70,17 @@ public:
   RTCScene global_scene;
   RTCScene scene;
 
+  /**
+   * Trace chunks a bounce at a time and compact the surviving rays between bounces instead of
+   * following each stream to completion. Lane utilization of either mode is reported in
+   * LaneCounters.
+   */
+  bool wavefront;
 
 protected:
+  /**
+   * Process wide device shared by all Embree adapters, see EmbreeDevice.
+   */
   RTCDevice device;
 
   /**
@@ -0,0 +1,104 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#ifndef GVT_RENDER_ADAPTER_EMBREE_LANE_COUNTERS_H
+#define GVT_RENDER_ADAPTER_EMBREE_LANE_COUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace gvt {
+namespace render {
+namespace adapter {
+namespace embree {
+/// SIMD lane utilization of the Embree adapters
+/** Counts the lanes handed to Embree (packet width, or stream size for the stream adapter, times
+the packets or streams traced) against the lanes that carried a live ray. Tracing threads tally
+locally (see LaneTally) and fold their totals in once per chunk. The counters are process wide and
+shared by both Embree adapters.
+*/
+class LaneCounters {
+public:
+  struct Lanes {
+    std::atomic<size_t> packets;
+    std::atomic<size_t> issued;
+    std::atomic<size_t> active;
+
+    Lanes() : packets(0), issued(0), active(0) {}
+
+    /**
+     * Fraction of the issued lanes that traced a live ray.
+     */
+    double utilization() const {
+      const size_t i = issued.load();
+      return i ? double(active.load()) / double(i) : 0.0;
+    }
+
+    void reset() {
+      packets = 0;
+      issued = 0;
+      active = 0;
+    }
+  };
+
+  Lanes intersect; /**< closest hit queries (primary and secondary rays) */
+  Lanes occlude;   /**< occlusion queries (shadow rays) */
+
+  static LaneCounters &instance() {
+    static LaneCounters counters;
+    return counters;
+  }
+
+  void reset() {
+    intersect.reset();
+    occlude.reset();
+  }
+};
+
+/// per thread lane tally, folded into a LaneCounters::Lanes when tracing is done
+struct LaneTally {
+  size_t packets = 0;
+  size_t issued = 0;
+  size_t active = 0;
+
+  void add(const size_t width, const size_t live) {
+    packets++;
+    issued += width;
+    active += live;
+  }
+
+  void flush(LaneCounters::Lanes &lanes) {
+    if (!packets) return;
+    lanes.packets += packets;
+    lanes.issued += issued;
+    lanes.active += active;
+    packets = issued = active = 0;
+  }
+};
+}
+}
+}
+}
+
+#endif // GVT_RENDER_ADAPTER_EMBREE_LANE_COUNTERS_H
@@ -0,0 +1,129 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#ifndef GVT_RENDER_ADAPTER_EMBREE_OBJECT_SPACE_H
+#define GVT_RENDER_ADAPTER_EMBREE_OBJECT_SPACE_H
+
+#include <cstddef>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+namespace gvt {
+namespace render {
+namespace adapter {
+namespace embree {
+/// moves structure-of-arrays rays into the object space of an instance
+/** The Embree adapters trace the bare mesh scene and transform the rays with the inverse instance
+matrix before each query instead of building an Embree instance for the matrix. Origins are
+transformed as points and directions as vectors, without renormalizing, so Embree's hit distances
+stay distances along the world space ray and hit points are origin + t * direction in either space.
+Embree reports geometric normals in object space, shade() takes them back with normi as it did for
+Embree instances.
+*/
+class ObjectSpace {
+public:
+  ObjectSpace(const glm::mat4 &minv) : identity(minv == glm::mat4(1.f)) {
+    for (int r = 0; r < 3; ++r)
+      for (int c = 0; c < 4; ++c) m[r][c] = minv[c][r];
+  }
+
+  /**
+   * True if the instance is not transformed, the rays are copied as they are.
+   */
+  bool isIdentity() const { return identity; }
+
+  /**
+   * Transform \p n rays from the world space columns (ox .. dz) into the object space columns
+   * (tox .. tdz). Input and output columns may be the same arrays.
+   */
+  void operator()(const float *ox, const float *oy, const float *oz, const float *dx, const float *dy, const float *dz,
+                  float *tox, float *toy, float *toz, float *tdx, float *tdy, float *tdz, const size_t n) const {
+    if (identity) {
+      copy(ox, tox, n);
+      copy(oy, toy, n);
+      copy(oz, toz, n);
+      copy(dx, tdx, n);
+      copy(dy, tdy, n);
+      copy(dz, tdz, n);
+      return;
+    }
+    size_t i = 0;
+#ifdef __AVX__
+    __m256 v[3][4];
+    for (int r = 0; r < 3; ++r)
+      for (int c = 0; c < 4; ++c) v[r][c] = _mm256_set1_ps(m[r][c]);
+    for (; i + 8 <= n; i += 8) {
+      const __m256 x = _mm256_loadu_ps(ox + i), y = _mm256_loadu_ps(oy + i), z = _mm256_loadu_ps(oz + i);
+      const __m256 a = _mm256_loadu_ps(dx + i), b = _mm256_loadu_ps(dy + i), c = _mm256_loadu_ps(dz + i);
+      float *const o[3] = { tox + i, toy + i, toz + i };
+      float *const d[3] = { tdx + i, tdy + i, tdz + i };
+      for (int r = 0; r < 3; ++r) {
+        const __m256 dr =
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v[r][0], a), _mm256_mul_ps(v[r][1], b)), _mm256_mul_ps(v[r][2], c));
+        const __m256 or_ =
+            _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v[r][0], x), _mm256_mul_ps(v[r][1], y)),
+                                        _mm256_mul_ps(v[r][2], z)),
+                          v[r][3]);
+        _mm256_storeu_ps(o[r], or_);
+        _mm256_storeu_ps(d[r], dr);
+      }
+    }
+#endif
+    for (; i < n; i++) {
+      const float x = ox[i], y = oy[i], z = oz[i], a = dx[i], b = dy[i], c = dz[i];
+      tox[i] = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+      toy[i] = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+      toz[i] = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+      tdx[i] = m[0][0] * a + m[0][1] * b + m[0][2] * c;
+      tdy[i] = m[1][0] * a + m[1][1] * b + m[1][2] * c;
+      tdz[i] = m[2][0] * a + m[2][1] * b + m[2][2] * c;
+    }
+  }
+
+  /**
+   * Transform \p n rays in place.
+   */
+  void operator()(float *ox, float *oy, float *oz, float *dx, float *dy, float *dz, const size_t n) const {
+    if (!identity) (*this)(ox, oy, oz, dx, dy, dz, ox, oy, oz, dx, dy, dz, n);
+  }
+
+private:
+  static void copy(const float *from, float *to, const size_t n) {
+    if (from != to) std::memcpy(to, from, n * sizeof(float));
+  }
+
+  bool identity;
+  float m[3][4]; /**< Upper 3x4 of the inverse instance matrix, row major */
+};
+}
+}
+}
+}
+
+#endif // GVT_RENDER_ADAPTER_EMBREE_OBJECT_SPACE_H
@@ -61,7 +61,9 @@
 #endif
 
 
+#include <gvt/core/comm/termination.h>
 #include <gvt/core/utils/global_counter.h>
+#include <gvt/render/actor/RayCodec.h>
 
 #include <set>
 
@@ -96,10 +98,15 @@ public:
 
   gvt::core::Map<int, int> mpiInstanceMap;
 
+  gvt::render::actor::RayCodec::Format rayFormat = gvt::render::actor::RayCodec::COMPACT; /**< Ray wire encoding */
+
+  std::shared_ptr<gvt::comm::TerminationDetector> termination; /**< Frame end detection */
+
   Tracer(std::shared_ptr<gvt::render::data::scene::gvtCameraBase> camera,
          std::shared_ptr<gvt::render::composite::ImageComposite> image, std::string const &camname = "Camera",
          std::string const &filmname = "Film", std::string const &schedulername = "Scheduler")
-      : AbstractTrace(camera, image, camname, filmname, schedulername) {
+      : AbstractTrace(camera, image, camname, filmname, schedulername),
+        termination(std::make_shared<gvt::comm::TerminationDetector>()) {
 
           //std::cerr << "initialize domain tracer " << std::endl;
     Initialize();
@@ -194,6 +201,7 @@ public:
     gvt::core::time::timer t_sort(false, "domain tracer: select :");
     gvt::core::time::timer t_adapter(false, "domain tracer: adapter :");
     gvt::core::time::timer t_filter(false, "domain tracer: filter :");
+    gvt::core::time::timer t_raysort(false, "domain tracer: ray sort :");
 
     gvt::util::global_counter gc_rays("Number of rays traced :");
     gvt::util::global_counter gc_filter("Number of rays filtered :");
@@ -203,6 +211,10 @@ public:
     clearBuffer();
     //int adapterType = db.getChild(db.getUnique(schedulername), "adapter");
     adapterType = db.getChild(db.getUnique(schedulername), "adapter");
+    wavefront = db.getChild(db.getUnique(schedulername), "wavefront");
+    raySort = db.getChild(db.getUnique(schedulername), "raySort");
+    const bool lossless = db.getChild(db.getUnique(schedulername), "losslessRays");
+    rayFormat = lossless ? gvt::render::actor::RayCodec::RAW : gvt::render::actor::RayCodec::COMPACT;
 
     t_filter.resume();
     gc_filter.add(rays.size());
@@ -211,6 +223,7 @@ public:
 
     // process domains until all rays are terminated
     bool all_done = false;
+    termination->reset();
     int nqueue = 0;
     std::set<int> doms_to_send;
     int lastInstance = -1;
@@ -261,12 +274,12 @@ public:
             switch (adapterType) {
 #ifdef GVT_RENDER_ADAPTER_EMBREE
             case gvt::render::adapter::Embree:
-              adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(mesh);
+              adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(mesh, wavefront);
               break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_EMBREE_STREAM
             case gvt::render::adapter::EmbreeStream:
-              adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter>(mesh);
+              adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter>(mesh, wavefront);
               break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_MANTA
@@ -305,6 +318,13 @@ public:
           GVT_ASSERT(adapter != nullptr, "domain scheduler: adapter not set");
           // end getAdapterFromCache concept
 
+          if (raySort) {
+            t_raysort.resume();
+            const gvt::render::data::primitives::Box3D &box = *instBox[instTarget];
+            gvt::render::actor::RaySort::sort(this->queue[instTarget], box.bounds_min, box.bounds_max);
+            t_raysort.stop();
+          }
+
           {
             t_trace.resume();
 
@@ -329,26 +349,13 @@ public:
         t_send.resume();
         // done with current domain, send off rays to their proper processors.
         SendRays(gc_sent);
-        // are we done?
-
-        // root proc takes empty flag from all procs
-        int not_done = 0;
-
-        for (auto &q : queue) not_done += q.second.size();
-
-        int *empties = (mpi.rank == 0) ? new int[mpi.world_size] : NULL;
-        MPI_Gather(&not_done, 1, MPI_INT, empties, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        if (mpi.rank == 0) {
-          not_done = 0;
-          for (size_t i = 0; i < mpi.world_size; ++i) not_done += empties[i];
-          for (size_t i = 0; i < mpi.world_size; ++i) empties[i] = not_done;
-        }
-
-        MPI_Scatter(empties, 1, MPI_INT, &not_done, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-        all_done = (not_done == 0);
+        // are we done? the wave started after the previous exchange completes here, the next one runs while
+        // the domains are traced
+        bool idle = true;
+        for (auto &q : queue) idle = idle && q.second.empty();
+        all_done = termination->pending() && termination->wait();
+        if (!all_done) termination->start(idle);
         t_send.stop();
-        delete[] empties;
       }
     } while (!all_done);
 
@@ -394,9 +401,7 @@ public:
 
         outbound[n_ptr] += q.second.size(); // outbound[n_ptr] has number of rays going
 
-        for (size_t r = 0; r < q.second.size(); ++r) {
-          buf_size += (q.second)[r].packedSize(); // rays can have diff packed sizes
-        }
+        buf_size = gvt::render::actor::RayCodec::encodedSize(rayFormat, q.second.size());
         outbound[n_ptr + 1] += buf_size;    // size of buffer needed to hold rays
         outbound[n_ptr + 1] += sizeof(int); // bds add space for the queue number
         outbound[n_ptr + 1] += sizeof(int); // bds add space for the number of rays in queue
@@ -445,10 +450,10 @@ public:
         send_buf_ptr[n] += sizeof(int);                              // bds advance pointer
         *((int *)(send_buf[n] + send_buf_ptr[n])) = q.second.size(); // bds load number of rays into send buffer
         send_buf_ptr[n] += sizeof(int);                              // bds advance pointer
-        for (size_t r = 0; r < q.second.size(); ++r) {               // load the rays in this queue
-          gvt::render::actor::Ray ray = (q.second)[r];
-          send_buf_ptr[n] += ray.pack(send_buf[n] + send_buf_ptr[n]);
-        }
+        // load the rays in this queue
+        gvt::render::actor::RayCodec::encode(rayFormat, q.second.data(), q.second.size(),
+                                             send_buf[n] + send_buf_ptr[n]);
+        send_buf_ptr[n] += gvt::render::actor::RayCodec::encodedSize(rayFormat, q.second.size());
         // to_del.push_back(q->first);
         q.second.clear();
       }
@@ -457,6 +462,7 @@ public:
       counter.add(outbound[2 * n + 1]);
       if (outbound[2 * n] > 0) {
         MPI_Isend(send_buf[n], outbound[2 * n + 1], MPI_UNSIGNED_CHAR, n, tag, MPI_COMM_WORLD, &reqs[2 * n + 1]);
+        termination->sent(outbound[2 * n]);
       }
     }
 
@@ -471,12 +477,13 @@ public:
           ptr += sizeof(int);
           int raysinqueue = *((int *)(recv_buf[n] + ptr)); // bds get rays in this queue
           ptr += sizeof(int);
-          for (int c = 0; c < raysinqueue; ++c) {
-            gvt::render::actor::Ray r(recv_buf[n] + ptr);
-            queue[q_number].push_back(r);
-            ptr += r.packedSize();
-          }
+          gvt::render::actor::RayVector &q = queue[q_number];
+          const size_t first = q.size();
+          q.resize(first + raysinqueue);
+          gvt::render::actor::RayCodec::decode(rayFormat, recv_buf[n] + ptr, raysinqueue, q.data() + first);
+          ptr += gvt::render::actor::RayCodec::encodedSize(rayFormat, raysinqueue);
         }
+        termination->received(inbound[2 * n]);
       }
     }
 
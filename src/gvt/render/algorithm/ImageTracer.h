@@ -135,7 +135,10 @@ public:
     gvt::core::time::timer t_sort(false, "image tracer: select :");
     gvt::core::time::timer t_adapter(false, "image tracer: adapter :");
     gvt::core::time::timer t_filter(false, "image tracer: filter :");
+    gvt::core::time::timer t_raysort(false, "image tracer: ray sort :");
     adapterType = db.getChild(db.getUnique(schedulername),"adapter");
+    wavefront = db.getChild(db.getUnique(schedulername), "wavefront");
+    raySort = db.getChild(db.getUnique(schedulername), "raySort");
         //root["Schedule"]["adapter"].value().toInteger();
 
     clearBuffer();
@@ -192,12 +195,12 @@ public:
           switch (adapterType) {
 #ifdef GVT_RENDER_ADAPTER_EMBREE
           case gvt::render::adapter::Embree:
-            adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(mesh);
+            adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(mesh, wavefront);
             break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_EMBREE_STREAM
           case gvt::render::adapter::EmbreeStream:
-            adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter>(mesh);
+            adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter>(mesh, wavefront);
             break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_MANTA
@@ -235,6 +238,13 @@ public:
         GVT_ASSERT(adapter != nullptr, "image scheduler: adapter not set");
         // end getAdapterFromCache concept
 
+        if (raySort) {
+          t_raysort.resume();
+          const gvt::render::data::primitives::Box3D &box = *instBox[instTarget];
+          gvt::render::actor::RaySort::sort(this->queue[instTarget], box.bounds_min, box.bounds_max);
+          t_raysort.stop();
+        }
+
         {
           t_trace.resume();
           moved_rays.reserve(this->queue[instTarget].size() * 10);
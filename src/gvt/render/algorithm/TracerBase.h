@@ -34,6 +34,7 @@
 #include <gvt/core/Debug.h>
 #include <gvt/core/utils/timer.h>
 #include <gvt/render/Adapter.h>
+#include <gvt/render/actor/RaySort.h>
 #ifdef GVT_RENDER_ADAPTER_EMBREE
 #include <gvt/render/actor/ORays.h>
 #endif
@@ -173,6 +174,7 @@ public:
   gvt::core::Map<size_t, std::shared_ptr<glm::mat4> > instM;
   gvt::core::Map<size_t, std::shared_ptr<glm::mat4> > instMinv;
   gvt::core::Map<size_t, std::shared_ptr<glm::mat3> > instMinvN;
+  gvt::core::Map<size_t, std::shared_ptr<gvt::render::data::primitives::Box3D> > instBox;
   gvt::core::Vector<std::shared_ptr<gvt::render::data::scene::Light> > lights;
 
   std::shared_ptr<gvt::render::data::accel::AbstractAccel> acceleration;
@@ -180,6 +182,8 @@ public:
   int width;
   int height;
   int adapterType;
+  bool wavefront; /**< Embree adapters trace a bounce at a time with ray compaction */
+  bool raySort;   /**< Coherence sort instance queues before tracing them, see RaySort */
 
   float sample_ratio;
 
@@ -239,6 +243,7 @@ public:
     instM.clear();
     instMinv.clear();
     instMinvN.clear();
+    instBox.clear();
     lights.clear();
 
     Initialize();
@@ -283,6 +288,7 @@ public:
       instM[id] = db.getChild(n, "mat");
       instMinv[id] = db.getChild(n, "matinv");
       instMinvN[id] = db.getChild(n, "normi");
+      instBox[id] = db.getChild(n, "bbox").to<std::shared_ptr<gvt::render::data::primitives::Box3D> >();
     }
 
     auto lightNodes = db.getChildren(db.getUnique("Lights"));
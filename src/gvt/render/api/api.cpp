@@ -36,7 +36,9 @@ ACI-1339881 and ACI-1339840
 #include <gvt/render/Schedulers.h>
 #include <gvt/render/Types.h>
 #include <gvt/render/data/Domains.h>
+#include <gvt/render/data/reader/GvtmFile.h>
 
+#include <stdexcept>
 #include <string>
 
 #include <tbb/task_scheduler_init.h>
@@ -115,6 +117,7 @@ void printChildName(const cntx::node &node) {
 
 void createMesh(const std::string name) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   cntx::node &root = cntx::rcontext::instance().root();
   db.createnode("Mesh", name, true, db.getUnique("Data").getid());
   db.getChild(db.getUnique(name), "file") = name;
@@ -130,11 +133,10 @@ void addMeshVertices(const std::string name, const unsigned &n, const float *ver
   Qhull qhull;
   std::string control(qhullargs);
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
 
-  // qhull expects double  verticies and gvt uses float so make a temp array to
-  // hold the doubles and delete it after the routines are done. What a waste.
-  double *dverts = new double[3*n];
+  m->vertices.reserve(m->vertices.size() + n);
   for (int i = 0; i < n * 3; i += 3) {
     m->addVertex(glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
     //std::cerr << dverts[i] << " " << dverts[i+1] << " " << dverts[i+2] << std::endl;
@@ -142,6 +144,9 @@ void addMeshVertices(const std::string name, const unsigned &n, const float *ver
   if(tesselate) { // call qhull to tesselate the vertices and create the triangle mesh
       if(control.empty())
           control = "d Qz";
+      // qhull expects double  verticies and gvt uses float so make a temp array to
+      // hold the doubles and delete it after the routines are done. What a waste.
+      double *dverts = new double[3*n];
       for(int i=0;i<n*3;i+=3){
         dverts[i] = vertices[i];
         dverts[i+1] = vertices[i+1];
@@ -149,7 +154,7 @@ void addMeshVertices(const std::string name, const unsigned &n, const float *ver
       }
       // call qhull to tesselate
       qhull.runQhull("",dimension,n,dverts,control.c_str());
-      delete dverts;
+      delete[] dverts;
       // pull the tessellation data out of qhull and load it into gravit
       QhullFacetList facets = qhull.facetList();
       for(QhullFacetList::const_iterator i = facets.begin();i!=facets.end();++i){
@@ -173,14 +178,35 @@ void addMeshVertices(const std::string name, const unsigned &n, const float *ver
 void addMeshTriangles(const std::string name, const unsigned &n, const unsigned int *triangles) {
 
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
+  m->faces.reserve(m->faces.size() + n);
   for (int i = 0; i < n * 3; i += 3) {
     m->addFace(triangles[i + 0], triangles[i + 1], triangles[i + 2]);
   }
 }
 
+void addMeshBuffers(const std::string name, const unsigned &nverts, std::shared_ptr<const float> vertices,
+                    const unsigned &ntris, std::shared_ptr<const uint32_t> triangles) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
+  std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
+  if (!m->vertices.empty() || !m->faces.empty())
+    throw std::runtime_error("addMeshBuffers: mesh " + name + " already has vertices or triangles");
+  m->setPackedVertices(vertices, nverts);
+  m->setPackedTriangles(triangles, ntris);
+}
+
+void addMeshBuffers(const std::string name, const unsigned &nverts, const float *vertices, const unsigned &ntris,
+                    const uint32_t *triangles) {
+  // caller owned, nothing to release
+  addMeshBuffers(name, nverts, std::shared_ptr<const float>(vertices, [](const float *) {}), ntris,
+                 std::shared_ptr<const uint32_t>(triangles, [](const uint32_t *) {}));
+}
+
 void finishMesh(const std::string name, const bool compute_normal) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
   m->computeBoundingBox();
   if (compute_normal) m->generateNormals();
@@ -191,6 +217,19 @@ void finishMesh(const std::string name, const bool compute_normal) {
   db.getChild(db.getUnique(name), "Locations") = v; // db.cntx_comm.rank;
 }
 
+void createMeshFromFile(const std::string name, const std::string filename) {
+  gvt::render::data::domain::reader::GvtmReader reader(filename);
+  createMesh(name);
+  cntx::rcontext &db = cntx::rcontext::instance();
+  db.getChild(db.getUnique(name), "file") = filename;
+  db.getChild(db.getUnique(name), "ptr") = reader.getMesh();
+  db.getChild(db.getUnique(name), "bbox") =
+      std::make_shared<gvt::render::data::primitives::Box3D>(*reader.getMesh()->getBoundingBox());
+  std::shared_ptr<std::vector<int> > v = std::make_shared<std::vector<int> >();
+  v->push_back(db.cntx_comm.rank);
+  db.getChild(db.getUnique(name), "Locations") = v;
+}
+
 /**
  * Add triangles face normals array to the mesh
  * \param name : mesh unique identifier
@@ -199,6 +238,7 @@ void finishMesh(const std::string name, const bool compute_normal) {
  */
 void addMeshFaceNormals(const std::string name, const unsigned &n, const float *normals) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
 
   for (int i = 0; i < n * 3; i += 3) {
@@ -214,6 +254,7 @@ void addMeshFaceNormals(const std::string name, const unsigned &n, const float *
  */
 void addMeshVertexNormals(const std::string name, const unsigned &n, const float *normals) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
 
   for (int i = 0; i < n * 3; i += 3) {
@@ -227,6 +268,7 @@ void addMeshVertexNormals(const std::string name, const unsigned &n, const float
  */
 void addMeshMaterial(const std::string name, const unsigned mattype, const float *kd, const float alpha) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
   m->mat = new gvt::render::data::primitives::Material();
   m->mat->type = mattype;
@@ -241,6 +283,7 @@ void addMeshMaterial(const std::string name, const unsigned mattype, const float
 void addMeshMaterial(const std::string name, const unsigned mattype, const float *kd, const float *ks,
                      const float alpha) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
   m->mat = new gvt::render::data::primitives::Material();
   m->mat->type = mattype;
@@ -257,6 +300,7 @@ void addMeshMaterial(const std::string name, const unsigned mattype, const float
 void addMeshMaterials(const std::string name, const unsigned n, const unsigned *mattype, const float *kd,
                       const float *ks, const float *alpha) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
 
   for (int i = 0; i < n; i++) {
@@ -273,6 +317,7 @@ void addMeshMaterials(const std::string name, const unsigned n, const unsigned *
 void addMeshVertexColor(const std::string name, const unsigned n, const float *kd) {
 
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Mesh> m = getChildByName(db.getUnique(name), "ptr");
 
   for(int i=0; i <n ; i++) {
@@ -292,6 +337,7 @@ void addMeshVertexColor(const std::string name, const unsigned n, const float *k
 void addInstance(std::string instancename, std::string meshname, const float *am) {
 
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
 
   cntx::node &ameshnode = db.getUnique(meshname);
 
@@ -329,6 +375,7 @@ void addInstance(std::string instancename, std::string meshname, const float *am
  */
 void addPointLight(string name, const float *pos, const float *color) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   auto& l = db.createnode("PointLight",name,true,db.getUnique("Lights"));
   db.getChild(l,"position") = glm::make_vec3(pos);
   db.getChild(l,"color") = glm::make_vec3(color);
@@ -345,6 +392,7 @@ void addPointLight(string name, const float *pos, const float *color) {
  */
 void addAreaLight(string name, const float *pos, const float *color, const float *n, float w, float h) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   auto& l = db.createnode("AreaLight",name,true,db.getUnique("Lights"));
   db.getChild(l,"position") = glm::make_vec3(pos);
   db.getChild(l,"color") = glm::make_vec3(color);
@@ -360,6 +408,7 @@ void addAreaLight(string name, const float *pos, const float *color, const float
  */
 void modifyLight(string name, const float *pos, const float *color) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   auto& l = db.getUnique(name);
   if(l.getid().isInvalid()) {
     return;
@@ -376,6 +425,7 @@ void modifyLight(string name, const float *pos, const float *color) {
  */
 void modifyLight(string name, const float *pos, const float *color, const float *n, float w, float h) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   auto& l = db.getUnique(name);
   if(l.getid().isInvalid()) {
     return;
@@ -464,13 +514,15 @@ void modifyCamera(string name, const float *pos, const float *focus, const float
  * \param w the image width
  * \param h the image height
  * \param path the path for the image file
+ * \param sparseComposite composite by exchanging only the image tiles each rank touched
  */
-void addFilm(string name, int w, int h, string path) {
+void addFilm(string name, int w, int h, string path, bool sparseComposite) {
   cntx::rcontext &db = cntx::rcontext::instance();
   auto& f = db.createnode("Film",name,true,db.getUnique("Films"));
   db.getChild(f,"width") = w;
   db.getChild(f,"height") = h;
   db.getChild(f,"outputPath") = path;
+  db.getChild(f,"sparseComposite") = sparseComposite;
 }
 
 /* modify film object, if it exists
@@ -539,10 +591,60 @@ void writeimage(std::string name, std::string output) {
     ren->WriteImage(output);
 }
 
+void setProgressive(std::string name, bool progressive, int passSamples) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &s = db.getUnique(name);
+  if (s.getid().isInvalid()) return;
+  db.getChild(s, "progressive") = progressive;
+  db.getChild(s, "passSamples") = passSamples;
+}
+
+void setNodeScene(std::string name, bool nodeScene) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &s = db.getUnique(name);
+  if (s.getid().isInvalid()) return;
+  db.getChild(s, "nodeScene") = nodeScene;
+}
+
+void setReplicaRouting(std::string name, bool replicaRouting) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &s = db.getUnique(name);
+  if (s.getid().isInvalid()) return;
+  db.getChild(s, "replicaRouting") = replicaRouting;
+}
+
+void setRaySort(std::string name, bool raySort) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &s = db.getUnique(name);
+  if (s.getid().isInvalid()) return;
+  db.getChild(s, "raySort") = raySort;
+}
+
+void setWavefront(std::string name, bool wavefront) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &s = db.getUnique(name);
+  if (s.getid().isInvalid()) return;
+  db.getChild(s, "wavefront") = wavefront;
+}
+
+void setEagerAdapters(std::string name, bool eagerAdapters) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  auto &s = db.getUnique(name);
+  if (s.getid().isInvalid()) return;
+  db.getChild(s, "eagerAdapters") = eagerAdapters;
+}
+
+void resetAccumulation() { gvt::render::gvtRenderer::instance()->resetAccumulation(); }
+
+float accumulatedSamples() { return gvt::render::gvtRenderer::instance()->accumulatedSamples(); }
+
+const float *imagebuffer() { return gvt::render::gvtRenderer::instance()->image(); }
+
 #ifdef GVT_BUILD_VOLUME
 void createVolume(const std::string name, const bool amr) {
 
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   cntx::node &root = cntx::rcontext::instance().root();
   db.createnode("Volume", name, true, db.getUnique("Data").getid());
   db.getChild(db.getUnique(name), "file") = name;
@@ -559,6 +661,7 @@ void createVolume(const std::string name, const bool amr) {
 
 void addVolumeTransferFunctions(const std::string name, const std::string colortfname, const std::string opacitytfname,float low,float high) {
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Volume> v = getChildByName(db.getUnique(name), "ptr");
   gvt::render::data::primitives::TransferFunction* tf = new gvt::render::data::primitives::TransferFunction();
   tf->load(colortfname,opacitytfname);
@@ -569,6 +672,7 @@ void addVolumeTransferFunctions(const std::string name, const std::string colort
 void addVolumeSamples(const std::string name,  float *samples,  int *counts,  float *origin,  float *deltas, float samplingrate, double *bounds ) {
     float dx,dy,dz;
   cntx::rcontext &db = cntx::rcontext::instance();
+  db.sceneChanged();
   std::shared_ptr<gvt::render::data::primitives::Volume> v = getChildByName(db.getUnique(name), "ptr");
   v->SetVoxelType(gvt::render::data::primitives::Volume::FLOAT);
   v->SetSamples(samples);
@@ -606,6 +710,7 @@ void addVolumeSamples(const std::string name,  float *samples,  int *counts,  fl
 
 void addAmrSubgrid(const std::string name, int gridid, int level, float *samples, int *counts, float *origin, float *deltas) {
     cntx::rcontext &db = cntx::rcontext::instance();
+    db.sceneChanged();
     std::shared_ptr<gvt::render::data::primitives::Volume> v = getChildByName(db.getUnique(name), "ptr");
     // now set subgrid
     //std::cerr << "gvt:api:addAmrSubgrid floats " << samples[0] << " " << samples[1] << std::endl;
@@ -20,6 +20,8 @@
 #ifndef GVT_RENDER_API_H
 #define GVT_RENDER_API_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <thread>
 
@@ -50,6 +52,31 @@ void addMeshVertices(const std::string name, const unsigned &n, const float *ver
  */
 void addMeshTriangles(const std::string name, const unsigned &n, const unsigned *triangles);
 
+/* Set the mesh geometry from arrays without copying them (packed mesh storage). Replaces
+ * addMeshVertices / addMeshTriangles, the Embree adapters trace the arrays in place.
+ * \param name : mesh unique identifier
+ * \param nverts : number of vertices
+ * \param vertices : mesh vertices with a 16 byte stride <x,y,z,unused>
+ * \param ntris : number of triangles
+ * \param triangles : ccw triangle vertex indices <a,b,c>, 0 based (addMeshTriangles is 1 based)
+ *
+ * The mesh keeps a reference to the shared arrays, their content must not change while it exists.
+ */
+void addMeshBuffers(const std::string name, const unsigned &nverts, std::shared_ptr<const float> vertices,
+                    const unsigned &ntris, std::shared_ptr<const uint32_t> triangles);
+
+/* Caller owned variant of addMeshBuffers, the arrays must outlive the mesh
+ */
+void addMeshBuffers(const std::string name, const unsigned &nverts, const float *vertices, const unsigned &ntris,
+                    const uint32_t *triangles);
+
+/* Creates a mesh from a .gvtm file (see gvtConvert). The file is memory mapped and traced in
+ * place, its bounding box and normals are stored, so no finishMesh is needed.
+ * \param name : mesh unique name
+ * \param filename : .gvtm file
+ */
+void createMeshFromFile(const std::string name, const std::string filename);
+
 /* Add triangles face normals array to the mesh
  * \param name : mesh unique identifier
  * \param n : number of triangles
@@ -225,8 +252,9 @@ void modifyCamera(std::string name, const float *pos, const float *focus, const
  * \param w the image width
  * \param h the image height
  * \param path the path for the image file
+ * \param sparseComposite composite by exchanging only the image tiles each rank touched (default IceT)
  */
-void addFilm(std::string name, int w, int h, std::string path);
+void addFilm(std::string name, int w, int h, std::string path, bool sparseComposite = false);
 
 /**
  * modify film object, if it exists
@@ -251,6 +279,77 @@ void gvtsync();
 
 void writeimage(std::string name, std::string output = "");
 
+/**
+ * switch progressive rendering on or off for a renderer. In progressive mode each render call
+ * traces passSamples x passSamples samples per pixel at a new sub-pixel offset and adds them to an
+ * HDR accumulation buffer. Any change to the camera, film, renderer or scene through this api starts
+ * a new image; call resetAccumulation after editing the context directly.
+ * \param name the renderer name
+ * \param progressive accumulate successive render calls
+ * \param passSamples samples per pixel per axis of each pass
+ */
+void setProgressive(std::string name, bool progressive, int passSamples = 1);
+
+/**
+ * switch the node scene on or off for a renderer. The Embree adapter then traces the rays of all
+ * instances resident on a rank in one two-level scene, and rays only return to the scheduler once
+ * they leave every one of them (async image and domain schedulers)
+ * \param name the renderer name
+ * \param nodeScene trace local instances together
+ */
+void setNodeScene(std::string name, bool nodeScene);
+
+/**
+ * switch replica routing on or off for a renderer. The async domain scheduler then lets every rank
+ * holding a replicated mesh trace its instances: camera rays are split among the holders by pixel
+ * and rays are forwarded to the least loaded holder (off by default)
+ * \param name the renderer name
+ * \param replicaRouting route rays among the holders of replicated meshes
+ */
+void setReplicaRouting(std::string name, bool replicaRouting);
+
+/**
+ * switch the coherence sort of instance queues on or off for a renderer. Each queue is sorted by
+ * direction octant and origin before it is traced (queues with fewer than RaySort::THRESHOLD rays
+ * are traced as they are)
+ * \param name the renderer name
+ * \param raySort sort instance queues before tracing them
+ */
+void setRaySort(std::string name, bool raySort);
+
+/**
+ * switch wavefront tracing on or off for a renderer. The Embree adapters then trace a bounce of
+ * every ray in a chunk at a time and compact the surviving rays between bounces
+ * \param name the renderer name
+ * \param wavefront trace a bounce at a time
+ */
+void setWavefront(std::string name, bool wavefront);
+
+/**
+ * switch eager adapter construction on or off for a renderer. The adapters of all local meshes are
+ * then built (concurrently when the engine allows it) when the scene BVH is built instead of on
+ * first use in the trace loop
+ * \param name the renderer name
+ * \param eagerAdapters build the adapters up front
+ */
+void setEagerAdapters(std::string name, bool eagerAdapters);
+
+/**
+ * drop the accumulated passes, the next render call starts a new image
+ */
+void resetAccumulation();
+
+/**
+ * samples per pixel accumulated in the current progressive image (0 when not progressive)
+ */
+float accumulatedSamples();
+
+/**
+ * RGBA float image of the last render, the accumulated mean in progressive mode (rank 0 only,
+ * nullptr elsewhere or before the first render)
+ */
+const float *imagebuffer();
+
 void addRenderer(std::string name, int adapter, int schedule,  std::string const& Camera = "Camera", std::string const& Film = "Film", bool volume = false);
 
 /**
@@ -39,7 +39,14 @@ using node = cntx::anode<Variant>;
 struct rcontext : public cntx::context<Variant, rcontext> {
 
 public:
-  rcontext() : context<Variant, rcontext>() {}
+  rcontext() : context<Variant, rcontext>(), _scene_version(0) {}
+
+  /**
+   * Scene edits made through the api (meshes, instances, lights, volumes) bump the scene version.
+   * Progressive rendering restarts its accumulation when the version changes.
+   */
+  void sceneChanged() { ++_scene_version; }
+  unsigned sceneVersion() const { return _scene_version; }
 
   anode<Variant> &create_children(anode<Variant> const &n, const std::string &type) {
 
@@ -47,100 +54,130 @@ public:
 
     if (type == std::string("Camera")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("focus"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("focus"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("eyePoint"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("eyePoint"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("upVector"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("upVector"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("fov"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("fov"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("cam2wrld"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("cam2wrld"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("rayMaxDepth"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("rayMaxDepth"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("raySamples"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("raySamples"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("jitterWindowSize"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("jitterWindowSize"), identifier(), n.getid()));
     } else if (type == std::string("Film")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("width"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("width"), identifier(), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("height"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("height"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("outputPath"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("outputPath"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("sparseComposite"), false, n.getid()));
     } else if (type == std::string("Mesh")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("file"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("file"), nullptr, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("type"), std::string("MESH"), n.getid());
+      insertnode(anode<Variant>(tid, std::string("type"), std::string("MESH"), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("ptr"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("ptr"), nullptr, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("bbox"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("bbox"), nullptr, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("Locations"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("Locations"), nullptr, n.getid()));
     }  else if (type == std::string("Volume")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("file"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("file"), nullptr, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("type"), std::string("VOLUME"), n.getid());
+      insertnode(anode<Variant>(tid, std::string("type"), std::string("VOLUME"), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("ptr"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("ptr"), nullptr, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("bbox"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("bbox"), nullptr, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("Locations"), nullptr, n.getid());
+      insertnode(anode<Variant>(tid, std::string("Locations"), nullptr, n.getid()));
     } else if (type == std::string("Instance")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("id"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("id"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("meshRef"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("meshRef"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("bbox"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("bbox"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("centroid"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("centroid"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("mat"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("mat"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("matinv"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("matinv"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("normi"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("normi"), identifier(), n.getid()));
     } else if (type == std::string("PointLight")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("position"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("position"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("color"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("color"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("type"), identifier(), n.getid());
-      _map[tid] = type;
+      insertnode(anode<Variant>(tid, std::string("type"), identifier(), n.getid()));
+      _map.find(tid)->second = type;
     } else if (type == std::string("AreaLight")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("position"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("position"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("color"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("color"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("normal"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("normal"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("height"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("height"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("width"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("width"), identifier(), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("type"), identifier(), n.getid());
-      _map[tid] = type;
+      insertnode(anode<Variant>(tid, std::string("type"), identifier(), n.getid()));
+      _map.find(tid)->second = type;
     } else if (type == std::string("Scheduler")) {
       identifier tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("type"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("type"), identifier(), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("volume"), identifier(), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("adapter"), identifier(), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("camera"), identifier(), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("film"), identifier(), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("eagerAdapters"), false, n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("wavefront"), false, n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("raySort"), false, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("volume"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("sendBytes"), unsigned(1 << 20), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("adapter"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("sendMaxBytes"), unsigned(8 << 20), n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("camera"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("sendDelay"), 1.f, n.getid()));
       tid = identifier(rank, _identifier_counter++);
-      _map[tid] = anode<Variant>(tid, std::string("film"), identifier(), n.getid());
+      insertnode(anode<Variant>(tid, std::string("losslessRays"), false, n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("replicaRouting"), false, n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("shareRays"), unsigned(4096), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("loadInterval"), 5.f, n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("rayBudget"), unsigned(0), n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("progressive"), false, n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("passSamples"), 1, n.getid()));
+      tid = identifier(rank, _identifier_counter++);
+      insertnode(anode<Variant>(tid, std::string("nodeScene"), false, n.getid()));
     }
-    return _map[n.getid()];
+    return _map.find(n.getid())->second;
   }
 #if 0
     void printtree(std::ostream &os, children_vector const &v = children_vector(), const unsigned depth = 0) {
@@ -185,6 +222,9 @@ public:
 #endif
 
   void addLocation(const cntx::node &n) {}
+
+private:
+  std::atomic<unsigned> _scene_version;
 };
 
 } // namespace cntx
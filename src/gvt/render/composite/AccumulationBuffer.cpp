@@ -0,0 +1,189 @@
+/* =======================================================================================
+ This file is released as part of GraviT - scalable, platform independent ray tracing
+ tacc.github.io/GraviT
+
+ Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+ All rights reserved.
+
+ Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+ except in compliance with the License.
+ A copy of the License is included with this software in the file LICENSE.
+ If your copy does not contain the License, you may obtain a copy of the License at:
+
+     http://opensource.org/licenses/BSD-3-Clause
+
+ Unless required by applicable law or agreed to in writing, software distributed under
+ the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND, either express or implied.
+ See the License for the specific language governing permissions and limitations under
+ limitations under the License.
+
+ GraviT is funded in part by the US National Science Foundation under awards
+ ACI-1339863,
+ ACI-1339881 and ACI-1339840
+ =======================================================================================
+ */
+
+#include <gvt/render/composite/AccumulationBuffer.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace gvt {
+namespace render {
+namespace composite {
+
+const std::size_t AccumulationBuffer::TILE;
+const std::size_t AccumulationBuffer::LOCAL_TILES;
+
+AccumulationBuffer::Local::~Local() {
+  for (std::size_t tile : touched) tbb::cache_aligned_allocator<float>().deallocate(tiles[tile], TILE * TILE * 4);
+  for (float *t : pool) tbb::cache_aligned_allocator<float>().deallocate(t, TILE * TILE * 4);
+}
+
+AccumulationBuffer::AccumulationBuffer(std::size_t width, std::size_t height) : tilesX(0), tilesY(0) {
+  resize(width, height);
+}
+
+AccumulationBuffer::~AccumulationBuffer() { releaseShared(); }
+
+void AccumulationBuffer::resize(std::size_t w, std::size_t h) {
+  releaseShared();
+  width = w;
+  height = h;
+  tilesX = (width + TILE - 1) / TILE;
+  tilesY = (height + TILE - 1) / TILE;
+  locals.clear();
+  shared.reset(new std::atomic<SharedTile *>[tiles()]);
+  for (std::size_t tile = 0; tile < tiles(); ++tile) shared[tile].store(nullptr, std::memory_order_relaxed);
+}
+
+void AccumulationBuffer::releaseShared() {
+  if (!shared) return;
+  for (std::size_t tile = 0; tile < tiles(); ++tile) delete shared[tile].load(std::memory_order_relaxed);
+  shared.reset();
+}
+
+float *AccumulationBuffer::allocate(Local &l, std::size_t tile) {
+  float *t;
+  if (!l.pool.empty()) {
+    t = l.pool.back();
+    l.pool.pop_back();
+  } else {
+    t = tbb::cache_aligned_allocator<float>().allocate(TILE * TILE * 4);
+    std::memset(t, 0, TILE * TILE * 4 * sizeof(float));
+  }
+  l.tiles[tile] = t;
+  l.touched.push_back(tile);
+  return t;
+}
+
+AccumulationBuffer::SharedTile *AccumulationBuffer::allocateShared(std::size_t tile) {
+  SharedTile *s = new SharedTile();
+  SharedTile *expected = nullptr;
+  // another thread may have overflowed into the same tile first
+  if (!shared[tile].compare_exchange_strong(expected, s, std::memory_order_acq_rel)) {
+    delete s;
+    return expected;
+  }
+  return s;
+}
+
+void AccumulationBuffer::reset() {
+  std::vector<Local *> all;
+  for (Local &l : locals) all.push_back(&l);
+  tbb::parallel_for(std::size_t(0), all.size(), [&](std::size_t i) {
+    Local &l = *all[i];
+    for (std::size_t tile : l.touched) {
+      std::memset(l.tiles[tile], 0, TILE * TILE * 4 * sizeof(float));
+      l.pool.push_back(l.tiles[tile]);
+      l.tiles[tile] = nullptr;
+    }
+    l.touched.clear();
+  });
+  tbb::parallel_for(std::size_t(0), tiles(), [&](std::size_t tile) {
+    SharedTile *s = shared[tile].load(std::memory_order_relaxed);
+    if (!s || !s->dirty.load(std::memory_order_relaxed)) return;
+    for (std::atomic<float> &v : s->rgba) v.store(0.f, std::memory_order_relaxed);
+    s->dirty.store(false, std::memory_order_relaxed);
+  });
+}
+
+void AccumulationBuffer::reduce(float *rgba) {
+  std::vector<Local *> all;
+  for (Local &l : locals)
+    if (!l.touched.empty()) all.push_back(&l);
+
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, tiles()), [&](const tbb::blocked_range<std::size_t> &r) {
+    for (std::size_t tile = r.begin(); tile < r.end(); ++tile) {
+      const std::size_t x0 = tileX(tile), y0 = tileY(tile);
+      const std::size_t tw = tileWidth(tile), th = tileHeight(tile);
+
+      for (std::size_t y = 0; y < th; ++y) std::memset(rgba + ((y0 + y) * width + x0) * 4, 0, tw * 4 * sizeof(float));
+
+      for (Local *l : all) {
+        const float *t = l->tiles[tile];
+        if (!t) continue;
+        for (std::size_t y = 0; y < th; ++y) {
+          float *dst = rgba + ((y0 + y) * width + x0) * 4;
+          const float *src = t + y * TILE * 4;
+          for (std::size_t i = 0; i < tw * 4; ++i) dst[i] += src[i];
+        }
+      }
+
+      const SharedTile *s = shared[tile].load(std::memory_order_acquire);
+      if (!s || !s->dirty.load(std::memory_order_relaxed)) continue;
+      for (std::size_t y = 0; y < th; ++y) {
+        float *dst = rgba + ((y0 + y) * width + x0) * 4;
+        const std::atomic<float> *src = s->rgba + y * TILE * 4;
+        for (std::size_t i = 0; i < tw * 4; ++i) dst[i] += src[i].load(std::memory_order_relaxed);
+      }
+    }
+  });
+}
+
+void AccumulationBuffer::reduceTile(std::size_t tile, float *rgba) {
+  const std::size_t tw = tileWidth(tile), th = tileHeight(tile);
+  std::memset(rgba, 0, tw * th * 4 * sizeof(float));
+  for (Local &l : locals) {
+    if (l.tiles.empty() || !l.tiles[tile]) continue;
+    const float *t = l.tiles[tile];
+    for (std::size_t y = 0; y < th; ++y) {
+      float *dst = rgba + y * tw * 4;
+      const float *src = t + y * TILE * 4;
+      for (std::size_t i = 0; i < tw * 4; ++i) dst[i] += src[i];
+    }
+  }
+  const SharedTile *s = shared[tile].load(std::memory_order_acquire);
+  if (!s || !s->dirty.load(std::memory_order_relaxed)) return;
+  for (std::size_t y = 0; y < th; ++y) {
+    float *dst = rgba + y * tw * 4;
+    const std::atomic<float> *src = s->rgba + y * TILE * 4;
+    for (std::size_t i = 0; i < tw * 4; ++i) dst[i] += src[i].load(std::memory_order_relaxed);
+  }
+}
+
+std::vector<char> AccumulationBuffer::dirty() {
+  std::vector<char> mask(tiles(), 0);
+  for (Local &l : locals)
+    for (std::size_t tile : l.touched) mask[tile] = 1;
+  for (std::size_t tile = 0; tile < tiles(); ++tile) {
+    const SharedTile *s = shared[tile].load(std::memory_order_acquire);
+    if (s && s->dirty.load(std::memory_order_relaxed)) mask[tile] = 1;
+  }
+  return mask;
+}
+
+std::size_t AccumulationBuffer::bytes() {
+  std::size_t n = 0;
+  for (Local &l : locals) n += (l.touched.size() + l.pool.size()) * TILE * TILE * 4 * sizeof(float);
+  for (std::size_t tile = 0; tile < tiles(); ++tile)
+    if (shared[tile].load(std::memory_order_relaxed)) n += sizeof(SharedTile);
+  return n;
+}
+}
+}
+}
@@ -0,0 +1,161 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards
+   ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   =======================================================================================
+   */
+
+#ifndef GVT_ACCUMULATION_BUFFER_H
+#define GVT_ACCUMULATION_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/enumerable_thread_specific.h>
+
+namespace gvt {
+namespace render {
+namespace composite {
+
+/**
+ * @brief HDR RGBA accumulation buffer safe for concurrent adds
+ *
+ * Each thread accumulates into its own tiles (TILE x TILE pixels of RGBA floats), allocated the first time the thread
+ * touches them, so adds to those never race and need no atomics. A thread holds at most LOCAL_TILES such tiles; its
+ * adds to any other tile go to a shared tile with atomic adds. Memory is therefore bounded by one shared framebuffer
+ * plus LOCAL_TILES tiles per thread, whatever the thread count. reduce() sums the thread and shared tiles into a
+ * single RGBA buffer, in parallel over tiles. Values are never clamped, tonemapping is left to the output stage.
+ */
+class AccumulationBuffer {
+public:
+  static const std::size_t TILE = 32;
+  static const std::size_t LOCAL_TILES = 64; /**< Thread tiles per thread, 1 MB */
+
+  AccumulationBuffer(std::size_t width = 0, std::size_t height = 0);
+  ~AccumulationBuffer();
+
+  /**
+   * Change the buffer size, drops all thread and shared tiles
+   */
+  void resize(std::size_t width, std::size_t height);
+
+  /**
+   * Add a contribution to pixel \p idx (idx = y * width + x) from the calling thread
+   */
+  inline void add(std::size_t idx, const glm::vec3 &color, float alpha) {
+    const std::size_t x = idx % width, y = idx / width;
+    const std::size_t tile = (y / TILE) * tilesX + (x / TILE);
+    const std::size_t offset = ((y % TILE) * TILE + (x % TILE)) * 4;
+    Local &l = locals.local();
+    if (l.tiles.empty()) l.tiles.resize(tilesX * tilesY, nullptr);
+    float *t = l.tiles[tile];
+    if (!t && l.touched.size() < LOCAL_TILES) t = allocate(l, tile);
+    if (t) {
+      float *p = t + offset;
+      p[0] += color[0];
+      p[1] += color[1];
+      p[2] += color[2];
+      p[3] += alpha;
+      return;
+    }
+    SharedTile *s = shared[tile].load(std::memory_order_acquire);
+    if (!s) s = allocateShared(tile);
+    if (!s->dirty.load(std::memory_order_relaxed)) s->dirty.store(true, std::memory_order_relaxed);
+    std::atomic<float> *p = s->rgba + offset;
+    atomicAdd(p[0], color[0]);
+    atomicAdd(p[1], color[1]);
+    atomicAdd(p[2], color[2]);
+    atomicAdd(p[3], alpha);
+  }
+
+  /**
+   * Clear every thread tile (allocations are kept for the next frame)
+   */
+  void reset();
+
+  /**
+   * Sum all thread contributions into \p rgba (width * height * 4 floats, overwritten).
+   * Must not run concurrently with add().
+   */
+  void reduce(float *rgba);
+
+  /**
+   * Sum all thread contributions to \p tile into \p rgba, packed as tileWidth * tileHeight RGBA rows
+   */
+  void reduceTile(std::size_t tile, float *rgba);
+
+  /**
+   * Tiles touched by any thread since the last reset (1 if dirty), indexed by tile
+   */
+  std::vector<char> dirty();
+
+  std::size_t tiles() const { return tilesX * tilesY; }
+  std::size_t tileX(std::size_t tile) const { return (tile % tilesX) * TILE; }
+  std::size_t tileY(std::size_t tile) const { return (tile / tilesX) * TILE; }
+  std::size_t tileWidth(std::size_t tile) const { return std::min(TILE, width - tileX(tile)); }
+  std::size_t tileHeight(std::size_t tile) const { return std::min(TILE, height - tileY(tile)); }
+
+  /**
+   * Bytes held by thread and shared tiles
+   */
+  std::size_t bytes();
+
+private:
+  struct Local {
+    std::vector<float *> tiles;        /**< Tile index -> thread tile (nullptr if never touched) */
+    std::vector<std::size_t> touched;  /**< Tiles touched since the last reset */
+    std::vector<float *> pool;         /**< Zeroed tiles released by reset, reused by allocate */
+    Local() = default;
+    Local(const Local &) = delete;
+    Local &operator=(const Local &) = delete;
+    ~Local();
+  };
+
+  struct SharedTile {
+    std::atomic<float> rgba[TILE * TILE * 4];
+    std::atomic<bool> dirty; /**< Added to since the last reset */
+  };
+
+  static inline void atomicAdd(std::atomic<float> &a, float v) {
+    float old = a.load(std::memory_order_relaxed);
+    while (!a.compare_exchange_weak(old, old + v, std::memory_order_relaxed)) {
+    }
+  }
+
+  float *allocate(Local &l, std::size_t tile);
+  SharedTile *allocateShared(std::size_t tile);
+  void releaseShared();
+
+  std::size_t width, height, tilesX, tilesY;
+  tbb::enumerable_thread_specific<Local, tbb::cache_aligned_allocator<Local>, tbb::ets_key_per_instance> locals;
+  std::unique_ptr<std::atomic<SharedTile *>[]> shared; /**< Tile index -> shared tile (nullptr if never touched) */
+};
+}
+}
+}
+
+#endif
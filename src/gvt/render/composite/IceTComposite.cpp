@@ -64,6 +64,7 @@ IceTComposite::IceTComposite(std::size_t width, std::size_t height)
 
   color_buffer = static_cast<IceTFloat *>(malloc(width * height * 4 * sizeof(IceTFloat)));
   depth_buffer = static_cast<IceTFloat *>(malloc(width * height * sizeof(IceTFloat)));
+  color_buffer_final = nullptr;
 
   reset();
 
@@ -77,11 +78,13 @@ IceTComposite::~IceTComposite() {
 }
 
 void IceTComposite::reset() {
+  ImageComposite::reset();
   memset(color_buffer, 0, (width * height * 4 * sizeof(IceTFloat)));
   memset(depth_buffer, 0, (width * height * sizeof(IceTFloat)));
 }
 
 float *IceTComposite::composite() {
+  accum.reduce(color_buffer);
   IceTSizeType num_pixels;
   IceTSizeType i;
   icetResetTiles();
@@ -100,61 +103,15 @@ float *IceTComposite::composite() {
   return color_buffer_final;
 }
 
-void IceTComposite::localAdd(size_t x, size_t y, const glm::vec3 &color, float alpha, float t) {
-  for (int i = 0; i < 3; i++) {
-    color_buffer[(y * width + x) * 4 + i] += color[i];
-    if (color_buffer[(y * width + x) * 4 + i] > 1.f) color_buffer[(y * width + x) * 4 + i] = 1.f;
-  }
-  color_buffer[(y * width + x) * 4 + 3] += alpha;
-};
-
-void IceTComposite::localAdd(size_t idx, const glm::vec3 &color, float alpha, float t) {
-  for (int i = 0; i < 3; i++) {
-    color_buffer[idx * 4 + i] += color[i];
-    if (color_buffer[idx * 4 + i] > 1.f) color_buffer[idx * 4 + i] = 1.f;
-  }
-  color_buffer[idx * 4 + 3] += alpha;
-};
-
-void IceTComposite::write(std::string filename) {
-
-  if (MPI::COMM_WORLD.Get_rank() != 0) return;
-
-  std::string ext = ".ppm";
-  // switch (format) {
-  // case PPM:
-  //   ext = ".ppm";
-  //   break;
-  // default:
-  //   GVT_DEBUG(DBG_ALWAYS, "ERROR: unknown image format '" << format << "'");
-  //   return;
-  // }
-
-  std::stringstream header;
-  header << "P6" << std::endl << std::flush;
-  header << width << " " << height << std::endl << std::flush;
-  header << "255" << std::endl << std::flush;
-
-  std::fstream file;
-  file.open((filename + ext).c_str(), std::fstream::out | std::fstream::trunc | std::fstream::binary);
-  file << header.str();
-
-  std::cout << "Image write " << width << " x " << height << std::endl << std::flush;
-  // reverse row order so image is correctly oriented
-  for (int j = height - 1; j >= 0; j--) {
-    int offset = j * width;
-    for (int i = 0; i < width; ++i) {
-      int index = 4 * (offset + i);
-      // if (rgb[index + 0] == 0 || rgb[index + 1] == 0 || rgb[index + 2] == 0) std::cout
-      // << ".";
-      file << (unsigned char)(color_buffer_final[index + 0] * 255)
-           << (unsigned char)(color_buffer_final[index + 1] * 255)
-           << (unsigned char)(color_buffer_final[index + 2] * 255);
-    }
-  }
-  std::cout << std::endl << std::flush;
-  file.close();
-};
+size_t IceTComposite::bytesSent() {
+#ifdef ICET_BYTES_SENT
+  IceTInt bytes = 0;
+  icetGetIntegerv(ICET_BYTES_SENT, &bytes);
+  return bytes;
+#else
+  return 0;
+#endif
+}
 }
 }
 }
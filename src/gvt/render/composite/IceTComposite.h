@@ -44,7 +44,7 @@ struct IceTComposite : gvt::render::composite::ImageComposite {
 
   // glm::vec4 *buffer;
   IceTInt num_proc;              /**< IceT number of mpi processes */
-  IceTFloat *color_buffer;       /**< IceT compute node local color buffer */
+  IceTFloat *color_buffer;       /**< IceT compute node local color buffer (reduced from accum on composite) */
   IceTFloat *color_buffer_final; /**< IceT final (composited) buffer */
   IceTFloat *depth_buffer;       /**< IceT depth buffer */
 
@@ -73,30 +73,10 @@ struct IceTComposite : gvt::render::composite::ImageComposite {
    */
   virtual float *composite();
   /**
-   * Add contribution to the buffer
-   * @method localAdd
-   * @param  x        x coordinate
-   * @param  y        y coordinate
-   * @param  color    color contribution
-   * @param  alpha    alpha value
-   * @param  t        depth value
+   * Bytes IceT reports sent by this process during the last composite
+   * @method bytesSent
    */
-  virtual void localAdd(size_t x, size_t y, const glm::vec3 &color, float alpha = 1.f, float t = 0.f);
-  /**
-   * Add contribution to the buffer
-   * @method localAdd
-   * @param  i buffer index  = floor (y / width) + (x mod width)
-   * @param  color    color contribution
-   * @param  alpha    alpha value
-   * @param  t        depth value
-   */
-  virtual void localAdd(size_t i, const glm::vec3 &color, float alpha = 1.f, float t = 0.f);
-  /**
-   * Write final color buffer to disk as a ppm image
-   * @method write
-   * @param  filename Filename to use
-   */
-  virtual void write(std::string filename);
+  virtual size_t bytesSent();
 
   /**
    * Returns final buffer after @composite
@@ -26,26 +26,77 @@
 
 #include <gvt/render/composite/ImageComposite.h>
 
+#include <fstream>
+#include <iostream>
+#include <mpi.h>
+#include <sstream>
+
 namespace gvt {
 namespace render {
 namespace composite {
 
 ImageComposite::ImageComposite(std::size_t width, std::size_t height)
-    : gvt::core::composite::Buffer<float>(width, height) {
+    : gvt::core::composite::Buffer<float>(width, height), accum(width, height) {
   // if (MPI::COMM_WORLD.Get_size() < 2) return false;
 }
 
 ImageComposite::~ImageComposite() {}
 
-void ImageComposite::reset() {}
+void ImageComposite::reset() { accum.reset(); }
 
 float *ImageComposite::composite() { return nullptr; }
 
-void ImageComposite::localAdd(size_t x, size_t y, const glm::vec3 &color, float alpha, float t){};
+void ImageComposite::localAdd(size_t x, size_t y, const glm::vec3 &color, float alpha, float t) {
+  accum.add(y * width + x, color, alpha);
+}
+
+void ImageComposite::localAdd(size_t idx, const glm::vec3 &color, float alpha, float t) {
+  accum.add(idx, color, alpha);
+}
+
+void ImageComposite::write(std::string filename) { write(filename, colorbf()); }
 
-void ImageComposite::localAdd(size_t idx, const glm::vec3 &color, float alpha, float t){
+void ImageComposite::write(std::string filename, const float *color_buffer_final) {
+  if (MPI::COMM_WORLD.Get_rank() != 0) return;
 
-};
+  if (!color_buffer_final) return;
+
+  std::string ext = ".ppm";
+  // switch (format) {
+  // case PPM:
+  //   ext = ".ppm";
+  //   break;
+  // default:
+  //   GVT_DEBUG(DBG_ALWAYS, "ERROR: unknown image format '" << format << "'");
+  //   return;
+  // }
+
+  std::stringstream header;
+  header << "P6" << std::endl << std::flush;
+  header << width << " " << height << std::endl << std::flush;
+  header << "255" << std::endl << std::flush;
+
+  std::fstream file;
+  file.open((filename + ext).c_str(), std::fstream::out | std::fstream::trunc | std::fstream::binary);
+  file << header.str();
+
+  std::cout << "Image write " << width << " x " << height << std::endl << std::flush;
+  // reverse row order so image is correctly oriented
+  for (int j = height - 1; j >= 0; j--) {
+    int offset = j * width;
+    for (int i = 0; i < width; ++i) {
+      int index = 4 * (offset + i);
+      // if (rgb[index + 0] == 0 || rgb[index + 1] == 0 || rgb[index + 2] == 0) std::cout
+      // << ".";
+      // accumulation is HDR, clamp only on output
+      file << (unsigned char)(glm::clamp(color_buffer_final[index + 0], 0.f, 1.f) * 255)
+           << (unsigned char)(glm::clamp(color_buffer_final[index + 1], 0.f, 1.f) * 255)
+           << (unsigned char)(glm::clamp(color_buffer_final[index + 2], 0.f, 1.f) * 255);
+    }
+  }
+  std::cout << std::endl << std::flush;
+  file.close();
+}
 }
 }
 }
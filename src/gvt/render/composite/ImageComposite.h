@@ -30,6 +30,7 @@
 #include <string>
 
 #include <gvt/core/composite/Composite.h>
+#include <gvt/render/composite/AccumulationBuffer.h>
 
 namespace gvt {
 namespace render {
@@ -45,9 +46,24 @@ struct ImageComposite : gvt::core::composite::Buffer<float> {
   virtual float *composite();
   virtual void localAdd(size_t x, size_t y, const glm::vec3 &color, float alpha = 1.f, float t = 0.f);
   virtual void localAdd(size_t i, const glm::vec3 &color, float alpha = 1.f, float t = 0.f);
-  virtual void write(std::string filename) {}
+  /**
+   * Write the final (composited) color buffer to disk as a ppm image, on rank 0 only.
+   * Accumulation is HDR, colors are clamped to [0,1] here.
+   */
+  virtual void write(std::string filename);
+  /**
+   * Same as write(filename) for an external RGBA buffer of the image size (e.g. a progressive mean)
+   */
+  virtual void write(std::string filename, const float *rgba);
+  /**
+   * Bytes this process sent over the network during the last composite (0 if unknown)
+   */
+  virtual size_t bytesSent() { return 0; }
   virtual float *colorbf() { return nullptr; }
   virtual float *depthbf() { return nullptr; }
+
+protected:
+  AccumulationBuffer accum; /**< Thread safe HDR accumulation of local contributions */
 };
 }
 }
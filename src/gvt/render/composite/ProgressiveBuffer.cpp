@@ -0,0 +1,90 @@
+/* =======================================================================================
+ This file is released as part of GraviT - scalable, platform independent ray tracing
+ tacc.github.io/GraviT
+
+ Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+ All rights reserved.
+
+ Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+ except in compliance with the License.
+ A copy of the License is included with this software in the file LICENSE.
+ If your copy does not contain the License, you may obtain a copy of the License at:
+
+     http://opensource.org/licenses/BSD-3-Clause
+
+ Unless required by applicable law or agreed to in writing, software distributed under
+ the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND, either express or implied.
+ See the License for the specific language governing permissions and limitations under
+ limitations under the License.
+
+ GraviT is funded in part by the US National Science Foundation under awards
+ ACI-1339863,
+ ACI-1339881 and ACI-1339840
+ =======================================================================================
+ */
+
+#include <gvt/render/composite/ProgressiveBuffer.h>
+
+#include <algorithm>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace gvt {
+namespace render {
+namespace composite {
+
+ProgressiveBuffer::ProgressiveBuffer(std::size_t width, std::size_t height) { resize(width, height); }
+
+void ProgressiveBuffer::resize(std::size_t w, std::size_t h) {
+  width = w;
+  height = h;
+  sum.clear();
+  count.clear();
+  mean.clear();
+  reset();
+}
+
+void ProgressiveBuffer::reset() {
+  npasses = 0;
+  stale = false;
+  // storage is allocated by the first pass and kept, a reset only zeroes it
+  std::fill(sum.begin(), sum.end(), 0.f);
+  std::fill(count.begin(), count.end(), 0.f);
+}
+
+void ProgressiveBuffer::add(const float *rgba, float samples) {
+  const std::size_t pixels = width * height;
+  if (sum.size() != pixels * 4) {
+    sum.assign(pixels * 4, 0.f);
+    count.assign(pixels, 0.f);
+  }
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, pixels), [&](const tbb::blocked_range<std::size_t> &r) {
+    for (std::size_t i = r.begin(); i < r.end(); ++i) {
+      for (std::size_t c = 0; c < 4; ++c) sum[i * 4 + c] += rgba[i * 4 + c] * samples;
+      count[i] += samples;
+    }
+  });
+  npasses++;
+  stale = true;
+}
+
+const float *ProgressiveBuffer::image() {
+  if (npasses == 0) return nullptr;
+  if (stale) {
+    const std::size_t pixels = width * height;
+    mean.resize(pixels * 4);
+    tbb::parallel_for(tbb::blocked_range<std::size_t>(0, pixels), [&](const tbb::blocked_range<std::size_t> &r) {
+      for (std::size_t i = r.begin(); i < r.end(); ++i) {
+        const float inv = (count[i] > 0.f) ? 1.f / count[i] : 0.f;
+        for (std::size_t c = 0; c < 4; ++c) mean[i * 4 + c] = sum[i * 4 + c] * inv;
+      }
+    });
+    stale = false;
+  }
+  return mean.data();
+}
+}
+}
+}
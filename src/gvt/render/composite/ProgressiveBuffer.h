@@ -0,0 +1,89 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards
+   ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   =======================================================================================
+   */
+
+#ifndef GVT_PROGRESSIVE_BUFFER_H
+#define GVT_PROGRESSIVE_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+namespace gvt {
+namespace render {
+namespace composite {
+
+/**
+ * @brief HDR running mean of composited frames for progressive rendering
+ *
+ * Every pass is a composited RGBA image whose pixels are means over the pass samples (camera rays carry a
+ * 1 / samples weight). The buffer keeps the sample weighted sum and the number of samples of every pixel,
+ * image() is their ratio. Values are never clamped.
+ */
+class ProgressiveBuffer {
+public:
+  ProgressiveBuffer(std::size_t width = 0, std::size_t height = 0);
+
+  /**
+   * Change the buffer size, drops every pass
+   */
+  void resize(std::size_t width, std::size_t height);
+
+  /**
+   * Drop every pass, the next add starts a new image
+   */
+  void reset();
+
+  /**
+   * Add a pass (width * height RGBA floats) that traced \p samples samples in every pixel
+   */
+  void add(const float *rgba, float samples);
+
+  /**
+   * Mean of all passes (width * height RGBA floats), nullptr before the first pass
+   */
+  const float *image();
+
+  /**
+   * Samples accumulated in pixel \p idx
+   */
+  float samples(std::size_t idx) const { return count.empty() ? 0.f : count[idx]; }
+
+  /**
+   * Passes added since the last reset
+   */
+  std::size_t passes() const { return npasses; }
+
+private:
+  std::size_t width, height, npasses;
+  bool stale;               /**< mean is out of date */
+  std::vector<float> sum;   /**< Sample weighted RGBA sum */
+  std::vector<float> count; /**< Samples per pixel */
+  std::vector<float> mean;  /**< sum / count, rebuilt on demand */
+};
+}
+}
+}
+
+#endif
@@ -0,0 +1,218 @@
+/* =======================================================================================
+ This file is released as part of GraviT - scalable, platform independent ray tracing
+ tacc.github.io/GraviT
+
+ Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+ All rights reserved.
+
+ Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+ except in compliance with the License.
+ A copy of the License is included with this software in the file LICENSE.
+ If your copy does not contain the License, you may obtain a copy of the License at:
+
+     http://opensource.org/licenses/BSD-3-Clause
+
+ Unless required by applicable law or agreed to in writing, software distributed under
+ the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND, either express or implied.
+ See the License for the specific language governing permissions and limitations under
+ limitations under the License.
+
+ GraviT is funded in part by the US National Science Foundation under awards
+ ACI-1339863,
+ ACI-1339881 and ACI-1339840
+ =======================================================================================
+ */
+
+#include <gvt/render/composite/SparseComposite.h>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <mpi.h>
+#include <stdexcept>
+
+#include <tbb/parallel_for.h>
+
+namespace gvt {
+namespace render {
+namespace composite {
+
+SparseComposite::SparseComposite(std::size_t width, std::size_t height)
+    : gvt::render::composite::ImageComposite(width, height), bytes_sent(0), tiles_sent(0) {
+  color_buffer = static_cast<float *>(malloc(width * height * 4 * sizeof(float)));
+  reset();
+}
+
+SparseComposite::~SparseComposite() { free(color_buffer); }
+
+void SparseComposite::reset() {
+  ImageComposite::reset();
+  memset(color_buffer, 0, width * height * 4 * sizeof(float));
+}
+
+void SparseComposite::unpack(size_t tile, const float *rgba) {
+  const size_t x0 = accum.tileX(tile), y0 = accum.tileY(tile);
+  const size_t tw = accum.tileWidth(tile), th = accum.tileHeight(tile);
+  for (size_t y = 0; y < th; ++y) memcpy(color_buffer + ((y0 + y) * width + x0) * 4, rgba + y * tw * 4, tw * 4 * sizeof(float));
+}
+
+// MPI counts are ints. Every rank has to take the same path through the collectives, so a count
+// that would not fit on any rank makes all of them throw before the exchange that needs it.
+static void agreeCounts(bool overflow) {
+  int local = overflow, any = 0;
+  MPI_Allreduce(&local, &any, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+  if (any) throw std::runtime_error("SparseComposite: message exceeds MPI count range");
+}
+
+float *SparseComposite::composite() {
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  bytes_sent = 0;
+  tiles_sent = 0;
+
+  if (size == 1) {
+    accum.reduce(color_buffer);
+    return color_buffer;
+  }
+
+  // reduce-scatter: dirty tiles go to their owner rank
+  const std::vector<char> dirty = accum.dirty();
+  std::vector<std::vector<int> > out(size);
+  for (size_t tile = 0; tile < dirty.size(); ++tile)
+    if (dirty[tile]) out[tile % size].push_back(tile);
+
+  std::vector<int> scount(size), sdispl(size), sfcount(size), sfdispl(size);
+  std::vector<int> sids;
+  std::vector<size_t> soffset;
+  size_t nfloats = 0;
+  for (int d = 0; d < size; ++d) {
+    scount[d] = out[d].size();
+    sdispl[d] = sids.size();
+    sfdispl[d] = nfloats;
+    for (int tile : out[d]) {
+      sids.push_back(tile);
+      soffset.push_back(nfloats);
+      nfloats += tileFloats(tile);
+    }
+    sfcount[d] = nfloats - sfdispl[d];
+  }
+  // rank 0 gathers every tile at most once, so the full image bounds its receive count
+  agreeCounts(nfloats > INT_MAX || width * height * 4 > INT_MAX);
+
+  std::vector<float> sbuf(nfloats);
+  tbb::parallel_for(size_t(0), sids.size(), [&](size_t i) { accum.reduceTile(sids[i], &sbuf[soffset[i]]); });
+
+  std::vector<int> rcount(size), rdispl(size), rfcount(size), rfdispl(size);
+  MPI_Alltoall(&scount[0], 1, MPI_INT, &rcount[0], 1, MPI_INT, MPI_COMM_WORLD);
+
+  size_t nrecv = 0;
+  for (int s = 0; s < size; ++s) {
+    rdispl[s] = nrecv;
+    nrecv += rcount[s];
+  }
+  std::vector<int> rids(nrecv);
+  MPI_Alltoallv(sids.data(), &scount[0], &sdispl[0], MPI_INT, rids.data(), &rcount[0], &rdispl[0], MPI_INT,
+                MPI_COMM_WORLD);
+
+  // payload sizes follow from the tile ids, no extra exchange needed
+  size_t nrfloats = 0;
+  std::vector<size_t> roffset(nrecv);
+  for (int s = 0; s < size; ++s) {
+    rfdispl[s] = nrfloats;
+    for (int i = rdispl[s]; i < rdispl[s] + rcount[s]; ++i) {
+      roffset[i] = nrfloats;
+      nrfloats += tileFloats(rids[i]);
+    }
+    rfcount[s] = nrfloats - rfdispl[s];
+  }
+
+  // owners add the contributions of every rank (in rank order) into one tile each, laid out before the payload
+  // exchange so its sizes can be agreed on first
+  std::vector<int> owned;
+  std::vector<std::vector<size_t> > contributions;
+  {
+    std::vector<int> slot(accum.tiles(), -1);
+    for (size_t i = 0; i < nrecv; ++i) {
+      if (slot[rids[i]] < 0) {
+        slot[rids[i]] = owned.size();
+        owned.push_back(rids[i]);
+        contributions.push_back(std::vector<size_t>());
+      }
+      contributions[slot[rids[i]]].push_back(i);
+    }
+  }
+
+  std::vector<size_t> ooffset(owned.size());
+  size_t nofloats = 0;
+  for (size_t i = 0; i < owned.size(); ++i) {
+    ooffset[i] = nofloats;
+    nofloats += tileFloats(owned[i]);
+  }
+  const int nowned = owned.size();
+  agreeCounts(nrfloats > INT_MAX || nofloats > INT_MAX);
+
+  std::vector<float> rbuf(nrfloats);
+  MPI_Alltoallv(sbuf.data(), &sfcount[0], &sfdispl[0], MPI_FLOAT, rbuf.data(), &rfcount[0], &rfdispl[0], MPI_FLOAT,
+                MPI_COMM_WORLD);
+
+  for (int d = 0; d < size; ++d) {
+    if (d == rank) continue;
+    bytes_sent += sizeof(int) + scount[d] * sizeof(int) + sfcount[d] * sizeof(float);
+    tiles_sent += scount[d];
+  }
+
+  std::vector<float> obuf(nofloats);
+  tbb::parallel_for(size_t(0), owned.size(), [&](size_t i) {
+    float *dst = &obuf[ooffset[i]];
+    const size_t n = tileFloats(owned[i]);
+    memcpy(dst, &rbuf[roffset[contributions[i][0]]], n * sizeof(float));
+    for (size_t c = 1; c < contributions[i].size(); ++c) {
+      const float *src = &rbuf[roffset[contributions[i][c]]];
+      for (size_t k = 0; k < n; ++k) dst[k] += src[k];
+    }
+  });
+
+  // gather the non-empty owned tiles on rank 0
+  std::vector<int> gcount(rank == 0 ? size : 0), gdispl(rank == 0 ? size : 0);
+  MPI_Gather(&nowned, 1, MPI_INT, gcount.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  size_t ngather = 0;
+  for (size_t s = 0; s < gcount.size(); ++s) {
+    gdispl[s] = ngather;
+    ngather += gcount[s];
+  }
+  std::vector<int> gids(ngather);
+  MPI_Gatherv(owned.data(), nowned, MPI_INT, gids.data(), gcount.data(), gdispl.data(), MPI_INT, 0, MPI_COMM_WORLD);
+
+  std::vector<int> gfcount(gcount.size()), gfdispl(gcount.size());
+  std::vector<size_t> goffset(ngather);
+  size_t ngfloats = 0;
+  for (size_t s = 0; s < gcount.size(); ++s) {
+    gfdispl[s] = ngfloats;
+    for (int i = gdispl[s]; i < gdispl[s] + gcount[s]; ++i) {
+      goffset[i] = ngfloats;
+      ngfloats += tileFloats(gids[i]);
+    }
+    gfcount[s] = ngfloats - gfdispl[s];
+  }
+
+  std::vector<float> gbuf(ngfloats);
+  MPI_Gatherv(obuf.data(), nofloats, MPI_FLOAT, gbuf.data(), gfcount.data(), gfdispl.data(), MPI_FLOAT, 0,
+              MPI_COMM_WORLD);
+
+  if (rank != 0) {
+    bytes_sent += sizeof(int) + nowned * sizeof(int) + nofloats * sizeof(float);
+    tiles_sent += nowned;
+    return color_buffer;
+  }
+
+  memset(color_buffer, 0, width * height * 4 * sizeof(float));
+  tbb::parallel_for(size_t(0), ngather, [&](size_t i) { unpack(gids[i], &gbuf[goffset[i]]); });
+  return color_buffer;
+}
+}
+}
+}
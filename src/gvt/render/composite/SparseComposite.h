@@ -0,0 +1,86 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards
+   ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   =======================================================================================
+   */
+
+#ifndef GVT_SPARSE_COMPOSITE_H
+#define GVT_SPARSE_COMPOSITE_H
+
+#include <gvt/render/composite/ImageComposite.h>
+
+#include <vector>
+
+namespace gvt {
+namespace render {
+namespace composite {
+
+/**
+ * @brief buffer composite that only exchanges touched tiles
+ *
+ * Each rank tracks the AccumulationBuffer tiles it touched. On composite the dirty tiles
+ * are sent to their owner rank (tile % ranks) with a single MPI_Alltoallv, owners add the
+ * contributions (an additive reduce-scatter over non-empty tiles only) and the non-empty
+ * owned tiles are gathered on rank 0. Ranks whose screen footprint is small send little.
+ *
+ * Contributions are added, so every pixel sample must be accumulated on exactly one rank.
+ */
+struct SparseComposite : gvt::render::composite::ImageComposite {
+
+  float *color_buffer; /**< Final (composited) color buffer, valid on rank 0 */
+  size_t bytes_sent;   /**< Bytes sent by this rank during the last composite */
+  size_t tiles_sent;   /**< Tiles sent by this rank during the last composite */
+
+  /**
+   * @brief constructor
+   * @param width Buffer width
+   * @param height Buffer height
+   */
+  SparseComposite(std::size_t width = 0, std::size_t height = 0);
+
+  ~SparseComposite();
+
+  /**
+   * Reset the buffer (e.g. set all values to 0)
+   * @method reset
+   */
+  virtual void reset();
+  /**
+   * Exchange the dirty tiles and assemble the final image on rank 0
+   * @method composite
+   * @return pointer to the final color buffer
+   */
+  virtual float *composite();
+
+  virtual float *colorbf() { return color_buffer; }
+  virtual float *depthbf() { return nullptr; }
+  virtual size_t bytesSent() { return bytes_sent; }
+
+protected:
+  size_t tileFloats(size_t tile) const { return accum.tileWidth(tile) * accum.tileHeight(tile) * 4; }
+  void unpack(size_t tile, const float *rgba);
+};
+}
+}
+}
+#endif /* GVT_SPARSE_COMPOSITE_H */
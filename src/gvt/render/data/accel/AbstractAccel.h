@@ -44,6 +44,7 @@ namespace accel {
 /// abstract base class for acceleration structures
 class AbstractAccel {
 public:
+  AbstractAccel() {}
   AbstractAccel(cntx::rcontext::children_vector &instanceSet) : instanceSet(instanceSet) {}
 
   virtual ~AbstractAccel() {}
@@ -31,186 +31,270 @@
 
 #include <string>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#include <tbb/parallel_reduce.h>
+
 using namespace gvt::render::data::accel;
 using namespace gvt::render::data::primitives;
 
-
-
 #define TRAVERSAL_COST 0.5 // TODO: best value?
-#define LEAF_SIZE 1        // TODO: best value?
+#define LEAF_SIZE 1        // ranges this small always become leaves
+#define MAX_LEAF_SIZE 4    // ranges up to this size become leaves when SAH says it is cheaper
+#define SAH_BINS 16
+#define PARALLEL_BUILD_THRESHOLD 4096 // ranges larger than this are reduced and recursed with TBB
 
 // #define DEBUG_ACCEL
 
-BVH::BVH(cntx::rcontext::children_vector &instanceSet) : AbstractAccel(instanceSet), root(NULL) {
+struct BVH::Bins {
+  int count[SAH_BINS];
+  Bounds bounds[SAH_BINS];
+  Bins() { std::fill(count, count + SAH_BINS, 0); }
+  void merge(const Bins &other) {
+    for (int i = 0; i < SAH_BINS; ++i) {
+      count[i] += other.count[i];
+      bounds[i].merge(other.bounds[i]);
+    }
+  }
+};
 
-  cntx::rcontext& db = cntx::rcontext::instance();
+BVH::Bounds::Bounds()
+    : lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max()),
+      clo(std::numeric_limits<float>::max()), chi(-std::numeric_limits<float>::max()) {}
+
+void BVH::Bounds::merge(const Bounds &other) {
+  lo = glm::min(lo, other.lo);
+  hi = glm::max(hi, other.hi);
+  clo = glm::min(clo, other.clo);
+  chi = glm::max(chi, other.chi);
+}
+
+float BVH::Bounds::surfaceArea() const {
+  const glm::vec3 d = hi - lo;
+  if (d.x < 0 || d.y < 0 || d.z < 0) return 0.f;
+  return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
 
+BVH::BVH(cntx::rcontext::children_vector &instanceSet) : AbstractAccel(instanceSet), maxDepth(0) {
+
+  cntx::rcontext &db = cntx::rcontext::instance();
+
+  // snapshot the instance boxes once, the build never goes back to the database
+  gvt::core::Vector<Box3D> boxes;
+  boxes.reserve(this->instanceSet.size());
   size_t count = 0;
   for (auto &node : this->instanceSet) {
-    db.getChild(node.get(),"id") = count++;
+    db.getChild(node.get(), "id") = count++;
+    boxes.push_back(*(db.getChild(node.get(), "bbox").to<std::shared_ptr<Box3D> >().get()));
   }
 
+  build(boxes);
+
+  // keep instanceSet in leaf order, instanceSetID[i] is the original position of the instance
   cntx::rcontext::children_vector sortedInstanceSet;
-  root = build(sortedInstanceSet, 0, instanceSet.size(), 0);
+  sortedInstanceSet.reserve(instanceSetID.size());
+  for (int id : instanceSetID) sortedInstanceSet.push_back(this->instanceSet[id]);
 
 #ifdef DEBUG_ACCEL
   assert(this->instanceSet.size() == sortedInstanceSet.size());
 #endif
 
-  // this->instanceSet.swap(sortedInstanceSet);
   std::swap(this->instanceSet, sortedInstanceSet);
-  for (auto &node : this->instanceSet) {
-    instanceSetBB.push_back(db.getChild(node.get(),"bbox"));
-    size_t id = db.getChild(node.get(),"id");
-    instanceSetID.push_back(id);
-  }
 }
 
-BVH::~BVH() {
-  // TODO: better way to manage memory allocation?
-  for (int i = 0; i < nodes.size(); ++i) {
-    delete nodes[i];
-    nodes[i] = NULL;
-  }
-}
+BVH::BVH(const gvt::core::Vector<Box3D> &boxes) : AbstractAccel(), maxDepth(0) { build(boxes); }
 
-BVH::Node *BVH::build(cntx::rcontext::children_vector &sortedInstanceSet, int start, int end, int level) {
-  cntx::rcontext& db = cntx::rcontext::instance();
+BVH::~BVH() {}
 
-  Node *node = new Node();
+void BVH::setLocal(const gvt::core::Vector<int> &ids) {
+  gvt::core::Vector<char> local(instanceSetID.size(), 0);
+  for (int id : ids) local[id] = 1;
+  for (size_t i = 0; i < instanceSetID.size(); ++i) instanceSetLocal[i] = local[instanceSetID[i]];
+}
 
-  // TODO: better way to manange memory allocation?
-  nodes.push_back(node);
+void BVH::build(const gvt::core::Vector<Box3D> &boxes) {
+  const int n = boxes.size();
 
-  // evaluate bounds
-  Box3D bbox;
-  for (int i = start; i < end; ++i) {
-    Box3D *tmpbb = (db.getChild(instanceSet[i].get(),"bbox")).to<std::shared_ptr<Box3D>>().get();
-    bbox.merge(*tmpbb);
-  }
+  buildBoxes = boxes;
+  buildCentroids.resize(n);
+  buildIdx.resize(n);
+  tbb::parallel_for(tbb::blocked_range<int>(0, n, PARALLEL_BUILD_THRESHOLD), [&](const tbb::blocked_range<int> &r) {
+    for (int i = r.begin(); i < r.end(); ++i) {
+      buildCentroids[i] = buildBoxes[i].centroid();
+      buildIdx[i] = i;
+    }
+  });
+
+  nodes.clear();
+  instanceSetBB.clear();
+  instanceSetID.clear();
+  instanceSetLocal.clear();
+  maxDepth = 0;
+  if (n == 0) return;
+
+  // every leaf holds at least one instance, so a binary tree needs at most 2n - 1 nodes
+  nodes.resize(2 * n - 1);
+  nodeCount = 1;
+  buildDepth = 0;
+  build(0, 0, n, 0);
+  nodes.resize(nodeCount);
+  maxDepth = buildDepth;
+  assert(maxDepth <= MAX_DEPTH);
+
+  instanceSetBB.resize(n);
+  instanceSetID.resize(n);
+  instanceSetLocal.assign(n, 0);
+  tbb::parallel_for(tbb::blocked_range<int>(0, n, PARALLEL_BUILD_THRESHOLD), [&](const tbb::blocked_range<int> &r) {
+    for (int i = r.begin(); i < r.end(); ++i) {
+      instanceSetBB[i] = buildBoxes[buildIdx[i]];
+      instanceSetID[i] = buildIdx[i];
+    }
+  });
+
+  gvt::core::Vector<Box3D>().swap(buildBoxes);
+  gvt::core::Vector<glm::vec3>().swap(buildCentroids);
+  gvt::core::Vector<int>().swap(buildIdx);
+}
 
-  int instanceCount = end - start;
+BVH::Bounds BVH::computeBounds(int start, int end) const {
+  auto body = [&](const tbb::blocked_range<int> &r, Bounds b) {
+    for (int i = r.begin(); i < r.end(); ++i) {
+      const int idx = buildIdx[i];
+      b.merge(buildBoxes[idx], buildCentroids[idx]);
+    }
+    return b;
+  };
+  if (end - start <= PARALLEL_BUILD_THRESHOLD) return body(tbb::blocked_range<int>(start, end), Bounds());
+  return tbb::parallel_reduce(tbb::blocked_range<int>(start, end, PARALLEL_BUILD_THRESHOLD / 4), Bounds(), body,
+                              [](Bounds a, const Bounds &b) {
+                                a.merge(b);
+                                return a;
+                              });
+}
 
-  // base case
-  if (instanceCount <= LEAF_SIZE) {
+void BVH::makeLeaf(Node &node, int start, int end, int level) {
 #ifdef DEBUG_ACCEL
-    std::cout << "creating leaf node.."
-              << "[LVL:" << level << "][offset: " << sortedInstanceSet.size() << "][#domains:" << instanceCount
-              << "]\n";
+  std::cout << "creating leaf node.."
+            << "[LVL:" << level << "][offset: " << start << "][#domains:" << (end - start) << "]\n";
 #endif
-    // create leaf node
-    node->bbox = bbox;
-    node->instanceSetIdx = sortedInstanceSet.size();
-    node->numInstances = instanceCount;
-    for (int i = start; i < end; ++i) {
-      sortedInstanceSet.push_back(instanceSet[i]);
-    }
-    return node;
+  node.offset = start;
+  node.count = end - start;
+  int depth = buildDepth.load();
+  while (level > depth && !buildDepth.compare_exchange_weak(depth, level)) {
   }
+}
 
-  // choose partition axis based on largest variation of centroids
-  int splitAxis = bbox.wideRangingBoxDir();
+void BVH::build(int nodeIdx, int start, int end, int level) {
+  const int instanceCount = end - start;
+  const Bounds bounds = computeBounds(start, end);
 
-  // choose split point based on SAH
-  float splitPoint = findSplitPoint(splitAxis, start, end);
+  // nodes is sized up front, the reference stays valid while other subtrees are built
+  Node &node = nodes[nodeIdx];
+  node.bmin = bounds.lo;
+  node.bmax = bounds.hi;
 
-#ifdef DEBUG_ACCEL
-#ifdef DEBUG_ACCEL_DOMAIN_SET
-  for (int i = start; i < end; ++i) {
-    glm::vec3 centroid = instanceSet[i]->worldCentroid();
-    bool lessThan = (centroid[splitAxis] < splitPoint);
-    std::cout << "[Lvl" << level << "][SP:" << splitPoint << "][" << i << "][id:" << instanceSet[i]->getDomainID()
-              << "][centroid: " << centroid[splitAxis] << "][isLess: " << lessThan << "]\t";
-  }
-  std::cout << "\n";
-#else
-  for (int i = start; i < end; ++i) {
-    glm::vec3 centroid = instanceSet[i]["centroid"].value().tovec3();
-    bool lessThan = (centroid[splitAxis] < splitPoint);
-    int id = instanceSet[i]["id"].value().toInteger();
-    std::cout << "[Lvl" << level << "][SP:" << splitPoint << "][" << i << "][id:" << id
-              << "][centroid: " << centroid[splitAxis] << "][isLess: " << lessThan << "]\t";
+  // base case
+  if (instanceCount <= LEAF_SIZE || level == MAX_DEPTH) {
+    makeLeaf(node, start, end, level);
+    return;
   }
-  std::cout << "\n";
-#endif
-#endif
 
-  // partition domains into two subsets
-  auto* instanceBound =
-      std::partition(&instanceSet[start], &instanceSet[end - 1] + 1, CentroidLessThan(splitPoint, splitAxis));
-
-  int splitIdx = instanceBound - &instanceSet[0];
+  // choose partition axis based on largest variation of centroids
+  const glm::vec3 extent = bounds.chi - bounds.clo;
+  const int splitAxis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z) ? 1 : 2;
+  if (extent[splitAxis] <= 0.f) { // all centroids coincide, nothing to split on
+    makeLeaf(node, start, end, level);
+    return;
+  }
 
-  if (splitIdx == start || splitIdx == end) {
-#ifdef DEBUG_ACCEL
-    std::cout << "creating leaf node.."
-              << "[LVL:" << level << "][offset: " << sortedInstanceSet.size() << "][#domains:" << instanceCount
-              << "]\n";
-#endif
-    // create leaf node
-    node->bbox = bbox;
-    node->instanceSetIdx = sortedInstanceSet.size();
-    node->numInstances = instanceCount;
-    for (int i = start; i < end; ++i) {
-      sortedInstanceSet.push_back(instanceSet[i]);
+  // bin centroids along the split axis
+  const float cmin = bounds.clo[splitAxis];
+  const float scale = (SAH_BINS * (1.f - 1e-5f)) / extent[splitAxis];
+  auto binOf = [&](int idx) {
+    const int b = int((buildCentroids[idx][splitAxis] - cmin) * scale);
+    return std::min(std::max(b, 0), SAH_BINS - 1);
+  };
+  auto body = [&](const tbb::blocked_range<int> &r, Bins bins) {
+    for (int i = r.begin(); i < r.end(); ++i) {
+      const int idx = buildIdx[i];
+      const int b = binOf(idx);
+      bins.count[b]++;
+      bins.bounds[b].merge(buildBoxes[idx], buildCentroids[idx]);
+    }
+    return bins;
+  };
+  Bins bins;
+  if (instanceCount <= PARALLEL_BUILD_THRESHOLD)
+    bins = body(tbb::blocked_range<int>(start, end), Bins());
+  else
+    bins = tbb::parallel_reduce(tbb::blocked_range<int>(start, end, PARALLEL_BUILD_THRESHOLD / 4), Bins(), body,
+                                [](Bins a, const Bins &b) {
+                                  a.merge(b);
+                                  return a;
+                                });
+
+  // SAH cost = c_t + (p_l * c_l) + (p_r * c_r), evaluated on the SAH_BINS - 1 bin boundaries
+  float rightArea[SAH_BINS];
+  int rightCount[SAH_BINS];
+  {
+    Bounds acc;
+    int cnt = 0;
+    for (int i = SAH_BINS - 1; i > 0; --i) {
+      acc.merge(bins.bounds[i]);
+      cnt += bins.count[i];
+      rightArea[i] = acc.surfaceArea();
+      rightCount[i] = cnt;
     }
-    return node;
   }
 
-  // recursively build internal nodes
-  int nextLevel = level + 1;
-  Node *nodeL = build(sortedInstanceSet, start, splitIdx, nextLevel);
-  Node *nodeR = build(sortedInstanceSet, splitIdx, end, nextLevel);
-
-  node->leftChild = nodeL;
-  node->rightChild = nodeR;
-  node->bbox = bbox;
-  node->numInstances = 0;
-
-  return node;
-}
-
-float BVH::findSplitPoint(int splitAxis, int start, int end) {
-  // choose split point based on SAH
-  // SAH cost = c_t + (p_l * c_l) + (p_r * c_r)
-  // for now, do exhaustive searches on both edges of all bounding boxes
-  auto& db = cntx::rcontext::instance();
-
+  const float nodeArea = bounds.surfaceArea();
+  const float invArea = (nodeArea > 0.f) ? 1.f / nodeArea : 0.f;
   float minCost = std::numeric_limits<float>::max();
-  float splitPoint;
-
-  for (int i = start; i < end; ++i) {
-
-    Box3D &refBbox = *(db.getChild(instanceSet[i].get(),"bbox").to<std::shared_ptr<Box3D>>().get());
-
-    for (int e = 0; e < 2; ++e) {
+  int splitBin = -1;
+  {
+    Bounds acc;
+    int leftCount = 0;
+    for (int i = 1; i < SAH_BINS; ++i) {
+      acc.merge(bins.bounds[i - 1]);
+      leftCount += bins.count[i - 1];
+      if (leftCount == 0 || rightCount[i] == 0) continue;
+      const float cost =
+          TRAVERSAL_COST + (acc.surfaceArea() * leftCount + rightArea[i] * rightCount[i]) * invArea;
+      if (cost < minCost) {
+        minCost = cost;
+        splitBin = i;
+      }
+    }
+  }
 
-      float edge;
-      if (e == 0) edge = refBbox.bounds_min[splitAxis];
-      if (e == 1) edge = refBbox.bounds_max[splitAxis];
+  if (splitBin == -1 || (instanceCount <= MAX_LEAF_SIZE && minCost >= float(instanceCount))) {
+    makeLeaf(node, start, end, level);
+    return;
+  }
 
-      Box3D leftBox, rightBox;
-      int leftCount = 0;
+  // partition domains into two subsets
+  int *first = buildIdx.data() + start;
+  int *bound = std::partition(first, buildIdx.data() + end, [&](int idx) { return binOf(idx) < splitBin; });
+  int splitIdx = bound - buildIdx.data();
 
-      for (int j = start; j < end; ++j) {
-        Box3D &bbox = *(db.getChild(instanceSet[j].get(),"bbox").to<std::shared_ptr<Box3D>>().get());
+  if (splitIdx == start || splitIdx == end) {
+    makeLeaf(node, start, end, level);
+    return;
+  }
 
-        if (bbox.centroid()[splitAxis] < edge) {
-          ++leftCount;
-          leftBox.merge(bbox);
-        } else {
-          rightBox.merge(bbox);
-        }
-      }
-      // compute SAH
-      int rightCount = end - start - leftCount;
-      float cost = TRAVERSAL_COST + (leftBox.surfaceArea() * leftCount) + (rightBox.surfaceArea() * rightCount);
+  // children are allocated as a pair, the right child is always left + 1
+  const int left = nodeCount.fetch_add(2);
+  node.offset = left;
+  node.count = 0;
 
-      if (cost < minCost) {
-        minCost = cost;
-        splitPoint = edge;
-      }
-    }
+  // recursively build internal nodes
+  const int nextLevel = level + 1;
+  if (instanceCount > PARALLEL_BUILD_THRESHOLD) {
+    tbb::parallel_invoke([&]() { build(left, start, splitIdx, nextLevel); },
+                         [&]() { build(left + 1, splitIdx, end, nextLevel); });
+  } else {
+    build(left, start, splitIdx, nextLevel);
+    build(left + 1, splitIdx, end, nextLevel);
   }
-  return splitPoint;
 }
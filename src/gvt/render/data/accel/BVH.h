@@ -28,6 +28,7 @@
 #ifndef GVT_RENDER_DATA_ACCEL_BVH_H
 #define GVT_RENDER_DATA_ACCEL_BVH_H
 
+#include <atomic>
 #include <mutex>
 #include <stack>
 
@@ -46,11 +47,26 @@ used to organize high-level data domains within GraviT. GraviT
 intersects rays against the BVH to determine traversal order through
 the data domains and the work scheduler uses this information as
 part of its evaluation process.
+
+The tree is stored as a flat array of 32 byte nodes in depth first order.
+The two children of an inner node are stored next to each other and the node
+only keeps the offset of the first one. Instance boxes and ids are copied once
+into contiguous arrays before the build, so neither the build nor the traversal
+touch the context database. The builder uses binned SAH and builds large
+subtrees in parallel with TBB.
 */
 
 class BVH : public AbstractAccel {
 public:
   BVH(cntx::rcontext::children_vector &instanceSet);
+
+  /**
+   * Build the BVH directly over a set of boxes, instance i gets id i.
+   *
+   * Used when there is no scene database behind the instances (e.g. benchmarks).
+   * @param boxes Instance world space bounding boxes
+   */
+  BVH(const gvt::core::Vector<gvt::render::data::primitives::Box3D> &boxes);
   ~BVH();
 
   struct hit {
@@ -58,117 +74,201 @@ public:
     float t = FLT_MAX;
   };
 
-  template <size_t simd_width>
-  gvt::core::Vector<hit> intersect(const gvt::render::actor::RayVector::iterator &ray_begin,
-                                   const gvt::render::actor::RayVector::iterator &ray_end, const int from) {
-
+  /**
+   * `from` value of rays leaving a node scene, they skip every instance marked with setLocal
+   */
+  static const int LOCAL = -2;
+
+  /**
+   * Depth limit of the tree, deeper ranges become leaves. Sizes the traversal stack.
+   */
+  static constexpr int MAX_DEPTH = 64;
+
+  /**
+   * Mark the instances traced together in a node scene, all others are unmarked
+   * @param ids Instance ids
+   */
+  void setLocal(const gvt::core::Vector<int> &ids);
+
+  /**
+   * Distance at which each ray enters the first instance not marked with setLocal, FLT_MAX if it
+   * enters none. A node scene must not accept hits past it, the data of that instance may be in front.
+   * @param tfar One distance per ray in [ray_begin, ray_end)
+   */
+  template <size_t simd_width, typename RayIterator>
+  void clip(const RayIterator &ray_begin, const RayIterator &ray_end, float *tfar) {
+    const gvt::core::Vector<hit> hits = intersect<simd_width>(ray_begin, ray_end, LOCAL);
+    for (size_t i = 0; i < hits.size(); ++i) tfar[i] = hits[i].t;
+  }
 
+  template <size_t simd_width, typename RayIterator>
+  gvt::core::Vector<hit> intersect(const RayIterator &ray_begin, const RayIterator &ray_end, const int from) {
 
     gvt::core::Vector<hit> ret((ray_end - ray_begin));
     size_t offset = 0;
 
+    int stack[MAX_DEPTH + 2];
 
-#ifndef GVT_BRUTEFORCE
-    Node *stack[instanceSet.size() * 2];
-    Node **stackptr = stack;
-#endif
+    for (; offset < ret.size(); offset += simd_width) {
+      gvt::render::actor::RayPacketIntersection<simd_width> rp(ray_begin + offset, ray_end);
+      traverse<simd_width>(rp, &ret[offset], from, stack);
+    }
+    return ret;
+  }
+
+  /**
+   * Intersect rays [begin, end) of a structure-of-arrays ray stream with the BVH
+   * @method intersect
+   * @param  rays  Ray stream
+   * @param  begin First stream index
+   * @param  end   Last stream index
+   * @param  from  Instance id the rays are leaving (skipped), LOCAL for the node scene, -1 for none
+   * @return       One hit record per ray
+   */
+  template <size_t simd_width>
+  gvt::core::Vector<hit> intersect(const gvt::render::actor::RayStream &rays, const size_t begin, const size_t end,
+                                   const int from) {
 
-    gvt::render::actor::RayVector::iterator chead = ray_begin;
-    for (; offset < ret.size(); offset += simd_width, chead += simd_width) {
-      gvt::render::actor::RayPacketIntersection<simd_width> rp(chead, ray_end);
+    gvt::core::Vector<hit> ret(end - begin);
+
+    int stack[MAX_DEPTH + 2];
+
+    for (size_t offset = 0; offset < ret.size(); offset += simd_width) {
+      gvt::render::actor::RayPacketIntersection<simd_width> rp(rays, begin + offset, end);
+      traverse<simd_width>(rp, &ret[offset], from, stack);
+    }
+    return ret;
+  }
+
+  /**
+   * Number of nodes in the flattened tree
+   */
+  size_t numNodes() const { return nodes.size(); }
+
+  /**
+   * Depth of the deepest leaf, root is depth 0
+   */
+  int depth() const { return maxDepth; }
+
+private:
+  inline bool skip(const int from, const int i) const {
+    return from == instanceSetID[i] || (from == LOCAL && instanceSetLocal[i]);
+  }
 
+  template <size_t simd_width>
+  inline void traverse(gvt::render::actor::RayPacketIntersection<simd_width> &rp, hit *ret, const int from,
+                       int *stack) {
 #ifdef GVT_BRUTEFORCE
-      for (int i = 0; i < instanceSet.size(); i++) {
-        if (from == instanceSetID[i]) continue;
-        int hit[simd_width];
-        const primitives::Box3D &ibbox = *instanceSetBB[i];
-        rp.intersect(ibbox, hit, true);
-        {
-          for (int o = 0; o < simd_width; ++o) {
-            if (hit[o] == 1 && rp.mask[o] == 1) {
-              ret[offset + o].next = instanceSetID[i];
-              ret[offset + o].t = rp.t[o];
-            }
+    for (int i = 0; i < instanceSetID.size(); i++) {
+      if (skip(from, i)) continue;
+      int hit[simd_width];
+      const primitives::Box3D &ibbox = instanceSetBB[i];
+      rp.intersect(ibbox, hit, true);
+      {
+        for (int o = 0; o < simd_width; ++o) {
+          if (hit[o] == 1 && rp.mask[o] == 1) {
+            ret[o].next = instanceSetID[i];
+            ret[o].t = rp.t[o];
           }
         }
       }
+    }
 #else
+    if (nodes.empty()) return;
+    const Node *base = nodes.data();
+    int *stackptr = stack;
+    *(stackptr++) = -1;
+    int cur = 0;
+    int hit[simd_width];
+    while (cur != -1) {
+
+      const Node &node = base[cur];
+      if (!rp.intersect(node.bmin, node.bmax, hit)) {
+        cur = *(--stackptr);
+        continue;
+      }
 
-      *(stackptr++) = nullptr;
-      Node *cur = root;
-      int hit[simd_width];
-      while (cur) {
-
-        const gvt::render::data::primitives::Box3D &bb = cur->bbox;
-        if (!rp.intersect(bb, hit)) {
-          cur = *(--stackptr);
-          continue;
-        }
-
-        if (cur->numInstances > 0) { // leaf node
-          int start = cur->instanceSetIdx;
-          int end = start + cur->numInstances;
-          for (int i = start; i < end; ++i) {
-            if (from == instanceSetID[i]) continue;
-            const primitives::Box3D &ibbox = *instanceSetBB[i];
-            int hit[simd_width];
-            if (rp.intersect(ibbox, hit, true)) {
-              for (int o = 0; o < simd_width; ++o) {
-                if (hit[o] == 1 && rp.mask[o] == 1 && ret[offset + o].t > rp.t[o]) {
-                  ret[offset + o].next = instanceSetID[i];
-                  ret[offset + o].t = rp.t[o];
-                }
+      if (node.count > 0) { // leaf node
+        const int start = node.offset;
+        const int end = start + node.count;
+        for (int i = start; i < end; ++i) {
+          if (skip(from, i)) continue;
+          const primitives::Box3D &ibbox = instanceSetBB[i];
+          int hit[simd_width];
+          if (rp.intersect(ibbox, hit, true)) {
+            for (int o = 0; o < simd_width; ++o) {
+              if (hit[o] == 1 && rp.mask[o] == 1 && ret[o].t > rp.t[o]) {
+                ret[o].next = instanceSetID[i];
+                ret[o].t = rp.t[o];
               }
             }
           }
+        }
 
-          cur = *(--stackptr);
+        cur = *(--stackptr);
 
-        } else {
-          *(stackptr++) = cur->rightChild;
-          cur = cur->leftChild;
-        }
+      } else {
+        *(stackptr++) = node.offset + 1;
+        cur = node.offset;
       }
-#endif
     }
-    return ret;
+#endif
   }
 
-private:
+  /**
+   * Flat BVH node (32 bytes)
+   *
+   * Inner node: offset is the index of the left child, the right child is offset + 1, count is 0.
+   * Leaf node: offset is the first entry in instanceSetBB / instanceSetID, count is the number of instances.
+   */
   struct Node {
-    Node() : leftChild(NULL), rightChild(NULL), numInstances(0) {}
-    Node *leftChild;  /// null for leaf nodes
-    Node *rightChild; /// null for leaf nodes
-    gvt::render::data::primitives::Box3D bbox;
-    int instanceSetIdx; /// base, valid when numInstances>0
-    int numInstances;   /// 0 means an internal node
+    glm::vec3 bmin;
+    int offset;
+    glm::vec3 bmax;
+    int count;
   };
 
-  struct CentroidLessThan {
-    CentroidLessThan(float splitPoint, int splitAxis) : splitPoint(splitPoint), splitAxis(splitAxis) {}
-    bool operator()(const cntx::rcontext::cnode& inst) const {
-//      gvt::core::DBNodeH i2 = inst;
-      glm::vec3 centroid = cntx::rcontext::instance().getChild(inst,"centroid");
-
-          //i2["centroid"].value().tovec3();
-      return (centroid[splitAxis] < splitPoint);
+  /**
+   * Per build range data, bounds of the instance boxes and of their centroids
+   */
+  struct Bounds {
+    glm::vec3 lo, hi;   /// box bounds
+    glm::vec3 clo, chi; /// centroid bounds
+    Bounds();
+    inline void merge(const gvt::render::data::primitives::Box3D &box, const glm::vec3 &centroid) {
+      lo = glm::min(lo, box.bounds_min);
+      hi = glm::max(hi, box.bounds_max);
+      clo = glm::min(clo, centroid);
+      chi = glm::max(chi, centroid);
     }
-
-    float splitPoint;
-    int splitAxis;
+    void merge(const Bounds &other);
+    float surfaceArea() const;
   };
 
-private:
-  Node *build(cntx::rcontext::children_vector &sortedDomainSet, int start, int end, int level);
-
-  float findSplitPoint(int splitAxis, int start, int end);
-
-  gvt::core::Vector<std::shared_ptr<gvt::render::data::primitives::Box3D>> instanceSetBB;
+  /**
+   * SAH bin counts and bounds along the split axis
+   */
+  struct Bins;
+
+  void build(const gvt::core::Vector<gvt::render::data::primitives::Box3D> &boxes);
+  void build(int nodeIdx, int start, int end, int level);
+  Bounds computeBounds(int start, int end) const;
+  void makeLeaf(Node &node, int start, int end, int level);
+
+  /// build-time snapshot, indexed by the permutation in buildIdx
+  gvt::core::Vector<gvt::render::data::primitives::Box3D> buildBoxes;
+  gvt::core::Vector<glm::vec3> buildCentroids;
+  gvt::core::Vector<int> buildIdx;
+  std::atomic<int> nodeCount;
+  std::atomic<int> buildDepth;
+
+  /// traversal data, leaves reference ranges of these arrays
+  gvt::core::Vector<gvt::render::data::primitives::Box3D> instanceSetBB;
   gvt::core::Vector<int> instanceSetID;
+  gvt::core::Vector<char> instanceSetLocal; /// node scene members, see setLocal
 
-private:
-  gvt::core::Vector<Node *> nodes;
-  Node *root;
+  gvt::core::Vector<Node> nodes;
+  int maxDepth;
   static std::mutex c_out;
 };
 }
@@ -30,12 +30,14 @@
 #include <gvt/render/data/Primitives.h>
 #include <gvt/render/data/primitives/Mesh.h>
 
+#include <stdexcept>
+
 using namespace gvt::render::actor;
 using namespace gvt::render::data;
 using namespace gvt::render::data::primitives;
 using namespace gvt::render::data::scene;
 
-Mesh::Mesh(Material *mat) : mat(mat), haveNormals(false) {}
+Mesh::Mesh(Material *mat) : mat(mat), haveNormals(false), packed_nvertices(0), packed_ntriangles(0) {}
 
 Mesh::Mesh(const Mesh &orig) {
   mat = orig.mat;
@@ -44,6 +46,10 @@ Mesh::Mesh(const Mesh &orig) {
   normals = orig.normals;
   faces = orig.faces;
   boundingBox = orig.boundingBox;
+  packed_vertices = orig.packed_vertices;
+  packed_triangles = orig.packed_triangles;
+  packed_nvertices = orig.packed_nvertices;
+  packed_ntriangles = orig.packed_ntriangles;
 }
 
 Mesh::~Mesh() {
@@ -113,23 +119,46 @@ void Mesh::addFace(int v0, int v1, int v2) {
 
 void Mesh::addFaceToNormals(Mesh::FaceToNormals face) { faces_to_normals.push_back(face); }
 
+void Mesh::setPackedVertices(std::shared_ptr<const float> xyzw, std::size_t n) {
+  if (!xyzw && n) throw std::runtime_error("Mesh: null packed vertex array");
+  vertices.clear();
+  packed_vertices = xyzw;
+  packed_nvertices = n;
+  haveNormals = false;
+}
+
+void Mesh::setPackedTriangles(std::shared_ptr<const uint32_t> indices, std::size_t n) {
+  if (!packed()) throw std::runtime_error("Mesh: packed triangles need packed vertices");
+  if (!indices && n) throw std::runtime_error("Mesh: null packed triangle array");
+  faces.clear();
+  faces_to_normals.clear();
+  packed_triangles = indices;
+  packed_ntriangles = n;
+  haveNormals = false;
+}
+
 void Mesh::generateNormals() {
   if (haveNormals) return;
+  const std::size_t nverts = numVertices(), nfaces = numFaces();
   normals.clear();
   face_normals.clear();
   faces_to_normals.clear();
-  normals.resize(vertices.size());
-  face_normals.resize(faces.size());
-  faces_to_normals.resize(faces.size());
+  normals.resize(nverts);
+  // packed meshes index the vertex normals through the triangles themselves (see faceNormals)
+  if (!packed()) {
+    face_normals.resize(nfaces);
+    faces_to_normals.resize(nfaces);
+  }
   for (int i = 0; i < normals.size(); ++i) normals[i] = glm::vec3(0.0f, 0.0f, 0.0f);
 
-  for (int i = 0; i < faces.size(); ++i) {
-    int I = std::get<0>(faces[i]);
-    int J = std::get<1>(faces[i]);
-    int K = std::get<2>(faces[i]);
-    glm::vec3 const &a = vertices[I];
-    glm::vec3 const &b = vertices[J];
-    glm::vec3 const &c = vertices[K];
+  for (std::size_t i = 0; i < nfaces; ++i) {
+    const Face f = face(i);
+    int I = std::get<0>(f);
+    int J = std::get<1>(f);
+    int K = std::get<2>(f);
+    glm::vec3 const a = vertex(I);
+    glm::vec3 const b = vertex(J);
+    glm::vec3 const c = vertex(K);
     glm::vec3 u = b - a;
     glm::vec3 v = c - a;
     glm::vec3 normal;
@@ -143,11 +172,13 @@ void Mesh::generateNormals() {
     // glm::vec3 const &c = Triangle.Position[2];
     // Triangle.Normal = glm::normalize(glm::cross(c - a, b - a));
 
-    face_normals[i] = normal;
     normals[I] += normal;
     normals[J] += normal;
     normals[K] += normal;
-    faces_to_normals[i] = FaceToNormals(I, J, K);
+    if (!packed()) {
+      face_normals[i] = normal;
+      faces_to_normals[i] = FaceToNormals(I, J, K);
+    }
   }
   for (int i = 0; i < normals.size(); ++i) normals[i] = glm::normalize(normals[i]);
   haveNormals = true;
@@ -186,9 +217,9 @@ void Mesh::generateNormals() {
 Box3D Mesh::computeBoundingBox() {
 
   Box3D box;
-  for (int i = 0; i < vertices.size(); i++) {
+  for (std::size_t i = 0; i < numVertices(); i++) {
 
-    glm::vec3 p = vertices[i];
+    glm::vec3 p = vertex(i);
 
     box.expand(p);
   }
@@ -203,14 +234,20 @@ void Mesh::writeobj(std::string filename) {
   std::ofstream file;
   file.open(filename);
   {
-    file << "#vertices " << vertices.size() << std::endl;
-    for (auto &v : vertices) file << "v " << v[0] << " " << v[1] << " " << v[2] << std::endl;
+    file << "#vertices " << numVertices() << std::endl;
+    for (std::size_t i = 0; i < numVertices(); i++) {
+      const glm::vec3 v = vertex(i);
+      file << "v " << v[0] << " " << v[1] << " " << v[2] << std::endl;
+    }
 
     file << "#vertices normal " << normals.size() << std::endl;
     for (auto &vn : normals) file << "vn " << vn[0] << " " << vn[1] << " " << vn[2] << std::endl;
 
-    file << "#vertices " << faces.size() << std::endl;
-    for (auto &f : faces) file << "f " << std::get<0>(f) + 1 << " " << std::get<1>(f) + 1 << " " << std::get<2>(f) + 1 << std::endl;
+    file << "#vertices " << numFaces() << std::endl;
+    for (std::size_t i = 0; i < numFaces(); i++) {
+      const Face f = face(i);
+      file << "f " << std::get<0>(f) + 1 << " " << std::get<1>(f) + 1 << " " << std::get<2>(f) + 1 << std::endl;
+    }
     file.close();
   }
 }
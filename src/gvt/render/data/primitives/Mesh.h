@@ -34,6 +34,8 @@
 #include <gvt/render/data/primitives/Data.h>
 #include <gvt/render/data/primitives/Material.h>
 #include <gvt/render/data/scene/Light.h>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 
@@ -71,6 +73,44 @@ public:
   virtual void addTetrahedralCell(int v0, int v1, int v2, int v3);
   virtual void addFaceToNormals(FaceToNormals);
 
+  /**
+   * Switch the mesh to packed storage: \p n vertices with a 16 byte stride (x, y, z, unused).
+   * The array is shared, not copied, and must stay unchanged while the mesh is in use.
+   */
+  void setPackedVertices(std::shared_ptr<const float> xyzw, std::size_t n);
+  /**
+   * Packed storage triangles: \p n triangles as three 0 based uint32 vertex indices each.
+   * The array is shared, not copied.
+   */
+  void setPackedTriangles(std::shared_ptr<const uint32_t> indices, std::size_t n);
+  /** True if the geometry lives in the packed arrays instead of vertices / faces */
+  bool packed() const { return packed_vertices != nullptr; }
+  /** Packed vertex array (16 byte stride), nullptr in the default storage mode */
+  const float *packedVertices() const { return packed_vertices.get(); }
+  /** Packed triangle index array, nullptr in the default storage mode */
+  const uint32_t *packedTriangles() const { return packed_triangles.get(); }
+
+  /** Vertex count in either storage mode */
+  std::size_t numVertices() const { return packed() ? packed_nvertices : vertices.size(); }
+  /** Triangle count in either storage mode */
+  std::size_t numFaces() const { return packed() ? packed_ntriangles : faces.size(); }
+  /** Vertex \p i in either storage mode */
+  glm::vec3 vertex(std::size_t i) const {
+    if (!packed()) return vertices[i];
+    const float *v = packed_vertices.get() + 4 * i;
+    return glm::vec3(v[0], v[1], v[2]);
+  }
+  /** Vertex indices of triangle \p i in either storage mode */
+  Face face(std::size_t i) const {
+    if (!packed()) return faces[i];
+    const uint32_t *f = packed_triangles.get() + 3 * i;
+    return Face(f[0], f[1], f[2]);
+  }
+  /** Vertex normal indices of triangle \p i, the triangle itself unless the mesh has a separate normal list */
+  FaceToNormals faceNormals(std::size_t i) const {
+    return faces_to_normals.size() > i ? faces_to_normals[i] : FaceToNormals(face(i));
+  }
+
   virtual gvt::render::data::primitives::Box3D computeBoundingBox();
   virtual gvt::render::data::primitives::Box3D *getBoundingBox() { return &boundingBox; }
   virtual void generateNormals();
@@ -98,6 +138,11 @@ public:
   std::vector<Material *> materials;
   gvt::render::data::primitives::Box3D boundingBox;
   bool haveNormals;
+
+protected:
+  std::shared_ptr<const float> packed_vertices;     /**< Packed storage vertices, 16 byte stride */
+  std::shared_ptr<const uint32_t> packed_triangles; /**< Packed storage triangle indices */
+  std::size_t packed_nvertices, packed_ntriangles;
 };
 }
 }
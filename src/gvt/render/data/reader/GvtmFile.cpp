@@ -0,0 +1,303 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#include <gvt/render/data/reader/GvtmFile.h>
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace gvt::render::data::domain::reader;
+using namespace gvt::render::data::primitives;
+
+const uint32_t GvtmHeader::VERSION;
+const uint32_t GvtmHeader::NONE;
+const uint64_t GvtmHeader::ALIGN;
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "gvtm normals and colors are copied as float triples");
+static_assert(sizeof(GvtmHeader) % 8 == 0, "gvtm header layout");
+
+namespace {
+uint64_t aligned(uint64_t offset) { return (offset + GvtmHeader::ALIGN - 1) & ~(GvtmHeader::ALIGN - 1); }
+
+uint32_t byteswap(uint32_t v) {
+  return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+void toMaterial(const GvtmMaterial &r, Material &m) {
+  m.type = r.type;
+  m.ka = glm::vec3(r.ka[0], r.ka[1], r.ka[2]);
+  m.ks = glm::vec3(r.ks[0], r.ks[1], r.ks[2]);
+  m.kd = glm::vec3(r.kd[0], r.kd[1], r.kd[2]);
+  m.alpha = r.alpha;
+  m.eta = glm::vec3(r.eta[0], r.eta[1], r.eta[2]);
+  m.k = glm::vec3(r.k[0], r.k[1], r.k[2]);
+  m.roughness = r.roughness;
+  m.horizonScatteringColor =
+      glm::vec3(r.horizonScatteringColor[0], r.horizonScatteringColor[1], r.horizonScatteringColor[2]);
+  m.backScattering = r.backScattering;
+  m.horizonScatteringFallOff = r.horizonScatteringFallOff;
+}
+
+GvtmMaterial fromMaterial(const Material &m) {
+  GvtmMaterial r;
+  std::memset(&r, 0, sizeof(r));
+  r.type = m.type;
+  for (int i = 0; i < 3; ++i) {
+    r.ka[i] = m.ka[i];
+    r.ks[i] = m.ks[i];
+    r.kd[i] = m.kd[i];
+    r.eta[i] = m.eta[i];
+    r.k[i] = m.k[i];
+    r.horizonScatteringColor[i] = m.horizonScatteringColor[i];
+  }
+  r.alpha = m.alpha;
+  r.roughness = m.roughness;
+  r.backScattering = m.backScattering;
+  r.horizonScatteringFallOff = m.horizonScatteringFallOff;
+  return r;
+}
+}
+
+bool GvtmReader::isGvtm(const std::string &filename) {
+  const std::string ext = ".gvtm";
+  return filename.size() > ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+GvtmReader::GvtmReader(const std::string filename, Mesh *into) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("GvtmReader: cannot open " + filename);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || uint64_t(st.st_size) < sizeof(GvtmHeader)) {
+    close(fd);
+    throw std::runtime_error("GvtmReader: " + filename + " is not a gvtm file");
+  }
+  const std::size_t length = st.st_size;
+  void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) throw std::runtime_error("GvtmReader: cannot map " + filename);
+  std::shared_ptr<const char> map(static_cast<const char *>(addr),
+                                  [length](const char *p) { munmap(const_cast<char *>(p), length); });
+  const char *base = map.get();
+
+  std::memcpy(&header, base, sizeof(header));
+  if (std::strncmp(header.magic, "GVTM", 4) != 0)
+    throw std::runtime_error("GvtmReader: " + filename + " is not a gvtm file");
+  if (byteswap(header.version) == GvtmHeader::VERSION)
+    throw std::runtime_error("GvtmReader: " + filename + " was written with a different byte order");
+  if (header.version != GvtmHeader::VERSION)
+    throw std::runtime_error("GvtmReader: " + filename + " has unsupported version " +
+                             std::to_string(header.version));
+  if (header.size != length) throw std::runtime_error("GvtmReader: " + filename + " is truncated");
+
+  const uint64_t nverts = header.nvertices, ntris = header.ntriangles;
+  if (nverts == 0 || nverts > length / (4 * sizeof(float)) || ntris > length / (3 * sizeof(uint32_t)) ||
+      header.nmaterials > length / sizeof(GvtmMaterial))
+    throw std::runtime_error("GvtmReader: " + filename + " has invalid element counts");
+  const auto section = [&](uint64_t offset, uint64_t bytes, bool required) -> const char * {
+    if (!offset) {
+      if (required && bytes) throw std::runtime_error("GvtmReader: " + filename + " is missing a section");
+      return nullptr;
+    }
+    if (offset % GvtmHeader::ALIGN || offset < sizeof(GvtmHeader) || offset > length || bytes > length - offset)
+      throw std::runtime_error("GvtmReader: " + filename + " has a section out of bounds");
+    return base + offset;
+  };
+  const float *vertices = reinterpret_cast<const float *>(section(header.vertices, nverts * 16, true));
+  const uint32_t *triangles =
+      reinterpret_cast<const uint32_t *>(section(header.triangles, ntris * 3 * sizeof(uint32_t), true));
+  const char *normals = section(header.normals, nverts * sizeof(glm::vec3), false);
+  const char *colors = section(header.colors, nverts * sizeof(glm::vec3), false);
+  const char *materials = section(header.materials, header.nmaterials * sizeof(GvtmMaterial), true);
+  const uint32_t *faceMaterials =
+      reinterpret_cast<const uint32_t *>(section(header.faceMaterials, ntris * sizeof(uint32_t), false));
+
+  for (uint64_t i = 0; i < 3 * ntris; ++i)
+    if (triangles[i] >= nverts) throw std::runtime_error("GvtmReader: " + filename + " has a vertex index out of range");
+  const auto validMaterial = [&](uint32_t m) { return m == GvtmHeader::NONE || m < header.nmaterials; };
+  if (!validMaterial(header.meshMaterial))
+    throw std::runtime_error("GvtmReader: " + filename + " has a material index out of range");
+  if (faceMaterials)
+    for (uint64_t i = 0; i < ntris; ++i)
+      if (!validMaterial(faceMaterials[i]))
+        throw std::runtime_error("GvtmReader: " + filename + " has a material index out of range");
+
+  mesh = into ? std::shared_ptr<Mesh>(into, [](Mesh *) {}) : std::make_shared<Mesh>(nullptr);
+  // aliasing pointers, the mesh arrays keep the mapping alive
+  mesh->setPackedVertices(std::shared_ptr<const float>(map, vertices), nverts);
+  mesh->setPackedTriangles(std::shared_ptr<const uint32_t>(map, triangles), ntris);
+  mesh->boundingBox = Box3D(glm::vec3(header.bmin[0], header.bmin[1], header.bmin[2]),
+                            glm::vec3(header.bmax[0], header.bmax[1], header.bmax[2]));
+  if (normals) {
+    mesh->normals.resize(nverts);
+    std::memcpy(&mesh->normals[0], normals, nverts * sizeof(glm::vec3));
+    mesh->haveNormals = true;
+  }
+  if (colors) {
+    mesh->vertex_colors.resize(nverts);
+    std::memcpy(&mesh->vertex_colors[0], colors, nverts * sizeof(glm::vec3));
+  }
+
+  // the mesh material is owned through mat, every other one through materials
+  std::vector<Material *> table(header.nmaterials);
+  for (uint32_t i = 0; i < header.nmaterials; ++i) {
+    GvtmMaterial record;
+    std::memcpy(&record, materials + i * sizeof(GvtmMaterial), sizeof(record));
+    table[i] = new Material;
+    toMaterial(record, *table[i]);
+    if (i == header.meshMaterial)
+      mesh->mat = table[i];
+    else
+      mesh->materials.push_back(table[i]);
+  }
+  if (faceMaterials) {
+    mesh->faces_to_materials.resize(ntris);
+    for (uint64_t i = 0; i < ntris; ++i)
+      mesh->faces_to_materials[i] = faceMaterials[i] == GvtmHeader::NONE ? nullptr : table[faceMaterials[i]];
+  }
+}
+
+GvtmReader::~GvtmReader() {}
+
+void GvtmWriter::write(const std::string filename, const Mesh &mesh) {
+  const std::size_t nverts = mesh.numVertices(), ntris = mesh.numFaces();
+  if (!nverts) throw std::runtime_error("GvtmWriter: " + filename + ": mesh has no vertices");
+
+  GvtmHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "GVTM", 4);
+  header.version = GvtmHeader::VERSION;
+  header.nvertices = nverts;
+  header.ntriangles = ntris;
+
+  // vertex normals are only meaningful here if the triangles index them directly
+  bool normals = mesh.normals.size() == nverts;
+  for (std::size_t i = 0; normals && i < mesh.faces_to_normals.size() && i < ntris; ++i)
+    normals = mesh.faceNormals(i) == Mesh::FaceToNormals(mesh.face(i));
+  const bool colors = mesh.vertex_colors.size() == nverts;
+  const bool faceMaterials = mesh.faces_to_materials.size() == ntris && ntris > 0;
+
+  std::vector<const Material *> table;
+  std::map<const Material *, uint32_t> index;
+  const auto materialIndex = [&](const Material *m) {
+    if (!m) return GvtmHeader::NONE;
+    auto it = index.find(m);
+    if (it != index.end()) return it->second;
+    index[m] = table.size();
+    table.push_back(m);
+    return uint32_t(table.size() - 1);
+  };
+  header.meshMaterial = materialIndex(mesh.mat);
+  std::vector<uint32_t> faceMaterial;
+  if (faceMaterials) {
+    faceMaterial.resize(ntris);
+    for (std::size_t i = 0; i < ntris; ++i) faceMaterial[i] = materialIndex(mesh.faces_to_materials[i]);
+  }
+  header.nmaterials = table.size();
+
+  glm::vec3 bmin = mesh.vertex(0), bmax = bmin;
+  for (std::size_t i = 1; i < nverts; ++i) {
+    bmin = glm::min(bmin, mesh.vertex(i));
+    bmax = glm::max(bmax, mesh.vertex(i));
+  }
+  for (int i = 0; i < 3; ++i) {
+    header.bmin[i] = bmin[i];
+    header.bmax[i] = bmax[i];
+  }
+
+  uint64_t offset = aligned(sizeof(header));
+  const auto place = [&](uint64_t &field, uint64_t bytes) {
+    field = offset;
+    offset = aligned(offset + bytes);
+  };
+  place(header.vertices, nverts * 16);
+  place(header.triangles, ntris * 3 * sizeof(uint32_t));
+  if (normals) place(header.normals, nverts * sizeof(glm::vec3));
+  if (colors) place(header.colors, nverts * sizeof(glm::vec3));
+  if (!table.empty()) place(header.materials, table.size() * sizeof(GvtmMaterial));
+  if (faceMaterials) place(header.faceMaterials, ntris * sizeof(uint32_t));
+  header.size = offset;
+
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file) throw std::runtime_error("GvtmWriter: cannot create " + filename);
+  uint64_t written = 0;
+  const auto put = [&](const void *data, uint64_t bytes) {
+    file.write(static_cast<const char *>(data), bytes);
+    written += bytes;
+  };
+  const auto pad = [&](uint64_t to) {
+    static const char zeros[GvtmHeader::ALIGN] = {};
+    while (written < to) put(zeros, std::min<uint64_t>(to - written, GvtmHeader::ALIGN));
+  };
+
+  put(&header, sizeof(header));
+  pad(header.vertices);
+  if (mesh.packed()) {
+    put(mesh.packedVertices(), nverts * 16);
+  } else {
+    std::vector<float> xyzw(4 * nverts, 0.f);
+    for (std::size_t i = 0; i < nverts; ++i) std::memcpy(&xyzw[4 * i], &mesh.vertices[i], sizeof(glm::vec3));
+    put(xyzw.data(), xyzw.size() * sizeof(float));
+  }
+  pad(header.triangles);
+  if (mesh.packed()) {
+    put(mesh.packedTriangles(), ntris * 3 * sizeof(uint32_t));
+  } else {
+    std::vector<uint32_t> indices(3 * ntris);
+    for (std::size_t i = 0; i < ntris; ++i) {
+      indices[3 * i + 0] = std::get<0>(mesh.faces[i]);
+      indices[3 * i + 1] = std::get<1>(mesh.faces[i]);
+      indices[3 * i + 2] = std::get<2>(mesh.faces[i]);
+    }
+    put(indices.data(), indices.size() * sizeof(uint32_t));
+  }
+  if (normals) {
+    pad(header.normals);
+    put(&mesh.normals[0], nverts * sizeof(glm::vec3));
+  }
+  if (colors) {
+    pad(header.colors);
+    put(&mesh.vertex_colors[0], nverts * sizeof(glm::vec3));
+  }
+  if (!table.empty()) {
+    pad(header.materials);
+    for (const Material *m : table) {
+      const GvtmMaterial record = fromMaterial(*m);
+      put(&record, sizeof(record));
+    }
+  }
+  if (faceMaterials) {
+    pad(header.faceMaterials);
+    put(faceMaterial.data(), ntris * sizeof(uint32_t));
+  }
+  pad(header.size);
+  if (!file) throw std::runtime_error("GvtmWriter: cannot write " + filename);
+}
@@ -0,0 +1,118 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#ifndef GVT_RENDER_DATA_DOMAIN_READER_GVTM_FILE_H
+#define GVT_RENDER_DATA_DOMAIN_READER_GVTM_FILE_H
+
+#include <gvt/render/data/Primitives.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace gvt {
+namespace render {
+namespace data {
+namespace domain {
+namespace reader {
+
+/// .gvtm binary mesh file header
+/** A .gvtm file is the header followed by 64 byte aligned sections, stored in the byte order
+ * of the machine that wrote it. Section offsets are from the start of the file, 0 if absent:
+ *  - vertices: nvertices x (x, y, z, unused) float, the Mesh packed storage layout
+ *  - triangles: ntriangles x 3 uint32, 0 based vertex indices
+ *  - normals, colors: nvertices x 3 float, per vertex
+ *  - materials: nmaterials x GvtmMaterial
+ *  - faceMaterials: ntriangles x uint32 index into materials, NONE for the mesh material
+ */
+struct GvtmHeader {
+  static const uint32_t VERSION = 1;
+  static const uint32_t NONE = 0xffffffff;
+  static const uint64_t ALIGN = 64;
+
+  char magic[4];         /**< "GVTM" */
+  uint32_t version;      /**< VERSION */
+  uint64_t size;         /**< file size in bytes */
+  uint64_t nvertices;    /**< vertex count */
+  uint64_t ntriangles;   /**< triangle count */
+  uint32_t nmaterials;   /**< material table size */
+  uint32_t meshMaterial; /**< material table index of the mesh material, NONE if the mesh has none */
+  float bmin[3];         /**< bounding box */
+  float bmax[3];
+  uint64_t vertices, triangles, normals, colors, materials, faceMaterials; /**< section offsets */
+};
+
+/// .gvtm material record, the fields of primitives::Material
+struct GvtmMaterial {
+  int32_t type;
+  float ka[3], ks[3], kd[3];
+  float alpha;
+  float eta[3], k[3];
+  float roughness;
+  float horizonScatteringColor[3];
+  float backScattering;
+  float horizonScatteringFallOff;
+};
+
+/// map a .gvtm file into a packed Mesh
+/** The file is memory mapped read only and the mesh vertex and triangle arrays point into the
+ * mapping (Mesh::setPackedVertices / setPackedTriangles), so loading is a page-in and an index
+ * range check instead of a parse. Normals, colors and materials are copied into the mesh. The
+ * mapping lives as long as the mesh. Throws std::runtime_error on a malformed file.
+ */
+class GvtmReader {
+public:
+  /** map \p filename into a new mesh, or into the empty caller owned mesh \p into */
+  GvtmReader(const std::string filename, gvt::render::data::primitives::Mesh *into = nullptr);
+  virtual ~GvtmReader();
+
+  /** mapped mesh, with bounding box and (if stored) vertex normals set */
+  std::shared_ptr<gvt::render::data::primitives::Mesh> getMesh() { return mesh; }
+  /** header of the mapped file */
+  const GvtmHeader &getHeader() const { return header; }
+
+  /** true if \p filename has the .gvtm extension */
+  static bool isGvtm(const std::string &filename);
+
+private:
+  GvtmHeader header;
+  std::shared_ptr<gvt::render::data::primitives::Mesh> mesh;
+};
+
+/// write a Mesh as a .gvtm file
+/** Writes either storage mode. Vertex normals are stored if the mesh has one per vertex indexed
+ * through the triangles (as generateNormals leaves them), colors if it has one per vertex.
+ * Throws std::runtime_error if the file cannot be written.
+ */
+class GvtmWriter {
+public:
+  static void write(const std::string filename, const gvt::render::data::primitives::Mesh &mesh);
+};
+}
+}
+}
+}
+}
+
+#endif /* GVT_RENDER_DATA_DOMAIN_READER_GVTM_FILE_H */
@@ -28,6 +28,7 @@
  * Created on January 22, 2015, 1:36 PM
  */
 
+#include <gvt/render/data/reader/GvtmFile.h>
 #include <gvt/render/data/reader/ObjReader.h>
 
 #include <gvt/core/Debug.h>
@@ -64,6 +65,13 @@ gvt::core::Vector<std::string> split(const std::string &s, char delim, gvt::core
 
 ObjReader::ObjReader(const std::string filename, int material_type) : computeNormals(false) {
 
+  // converted meshes (gvtConvert) are mapped, they carry their own materials and normals
+  if (GvtmReader::isGvtm(filename)) {
+    objMesh = new Mesh(nullptr);
+    GvtmReader reader(filename, objMesh);
+    return;
+  }
+
   // GVT_ASSERT(filename.size() > 0, "Invalid filename");
   // std::fstream file;
   // file.open(filename.c_str());
@@ -51,7 +51,7 @@ namespace reader {
 class ObjReader {
 public:
   /** Constructor opens the given file and parses it line by line placing data in the mesh
-  *   object.
+  *   object. A .gvtm file (see gvtConvert) is mapped instead, material_type is then unused.
   */
   ObjReader(const std::string filename = "", int material_type = gvt::render::data::primitives::LAMBERT);
   virtual ~ObjReader();
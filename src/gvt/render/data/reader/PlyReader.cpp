@@ -25,10 +25,12 @@
 #include <gvt/render/api/api.h>
 #include <gvt/render/cntx/rcontext.h>
 #include <gvt/render/data/reader/PlyReader.h>
+#include <gvt/render/data/reader/SceneLoader.h>
 
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 
 using namespace gvt::render::data::domain::reader;
@@ -53,20 +55,6 @@ PlyProperty face_props[] = {
 
 PlyReader::PlyReader(std::string rootdir, bool dist) {
   // gvt::comm::communicator &comm = gvt::comm::communicator::instance();
-  // mess I use to open and read the ply file with the c utils I found.
-  PlyFile *in_ply;
-  Vertex *vert;
-  Face *face;
-  int elem_count, nfaces, nverts;
-  int i, j, k;
-  float xmin, ymin, zmin, xmax, ymax, zmax;
-  char *elem_name;
-  ;
-  FILE *myfile;
-  char txt[16];
-  std::string temp;
-  std::string filename, filepath;
-
   auto &db = cntx::rcontext::instance();
 
   //  gvt::core::DBNodeH root = cntxt->getRootNode();
@@ -86,96 +74,92 @@ PlyReader::PlyReader(std::string rootdir, bool dist) {
     cout << "File \"" << rootdir << "\" is not a directory. Exiting." << endl;
     exit(0);
   }
-  vector<string> files = findply(rootdir);
+  // converted meshes (gvtConvert) are mapped instead of parsed
+  vector<string> files = findply(rootdir, "gvtm");
+  const bool mapped = !files.empty();
+  if (!mapped) files = findply(rootdir);
   if (files.empty()) {
-    cout << "Directory \"" << rootdir << "\" contains no .ply files. Exiting." << endl;
+    cout << "Directory \"" << rootdir << "\" contains no .ply or .gvtm files. Exiting." << endl;
     exit(0);
   }
-  // read 'em
-  vector<string>::const_iterator file;
-  // for (k = 0; k < 8; k++) {
-  for (file = files.begin(), k = 0; file != files.end(); file++, k++) {
-// if defined, ply blocks load are divided across available mpi ranks
-// Each block will be loaded by a single mpi rank and a mpi rank can read multiple blocks
-#ifdef DOMAIN_PER_NODE
-    if (!((k >= MPI::COMM_WORLD.Get_rank() * DOMAIN_PER_NODE) &&
-          (k < MPI::COMM_WORLD.Get_rank() * DOMAIN_PER_NODE + DOMAIN_PER_NODE)))
-      continue;
-#endif
-
-    std::string meshname = "Mesh" + std::to_string(k);
-
-    api::createMesh(meshname);
-
-    filepath = *file;
-    myfile = fopen(filepath.c_str(), "r");
-    in_ply = read_ply(myfile);
-    bool has_color = false;
-    for (i = 0; i < in_ply->num_elem_types; i++) {
-      elem_name = setup_element_read_ply(in_ply, i, &elem_count);
-      temp = elem_name;
-      if (temp == "vertex") {
-        vlist = (Vertex **)malloc(sizeof(Vertex *) * elem_count);
-        nverts = elem_count;
-        setup_property_ply(in_ply, &vert_props[0]);
-        setup_property_ply(in_ply, &vert_props[1]);
-        setup_property_ply(in_ply, &vert_props[2]);
-        if (in_ply->elems[i]->nprops > 5) {
-          has_color = true;
-          setup_property_ply(in_ply, &vert_props[3]);
-          setup_property_ply(in_ply, &vert_props[4]);
-          setup_property_ply(in_ply, &vert_props[5]);
-        }
-        for (j = 0; j < elem_count; j++) {
-          vlist[j] = (Vertex *)malloc(sizeof(Vertex));
-          get_element_ply(in_ply, (void *)vlist[j]);
-        }
-      } else if (temp == "face") {
-        flist = (Face **)malloc(sizeof(Face *) * elem_count);
-        nfaces = elem_count;
-        setup_property_ply(in_ply, &face_props[0]);
-        for (j = 0; j < elem_count; j++) {
-          flist[j] = (Face *)malloc(sizeof(Face));
-          get_element_ply(in_ply, (void *)flist[j]);
-        }
-      }
-    }
-    close_ply(in_ply);
-
-    Material *m = has_color ? nullptr : new Material();
-    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(m);
-
-    std::shared_ptr<float> vtx(new float[nverts * 3], std::default_delete<float[]>());
-    std::shared_ptr<float> color(new float[nverts * 3], std::default_delete<float[]>());
-    std::shared_ptr<unsigned> fc(new unsigned[nverts * 3], std::default_delete<unsigned[]>());
-
-    float *avtx = vtx.get();
-    float *acolor = color.get();
-    unsigned *afc = fc.get();
+  // read 'em, in parallel and (if dist) divided across the mpi ranks by file size
+  SceneLoader loader(files, dist);
+  loader.load();
+  for (auto &mesh : loader.getMeshes()) meshes.push_back(mesh.get());
+}
 
-    for (int i = 0; i < nverts; i++) {
-      avtx[i * 3 + 0] = vlist[i]->x;
-      avtx[i * 3 + 1] = vlist[i]->y;
-      avtx[i * 3 + 2] = vlist[i]->z;
+std::shared_ptr<Mesh> PlyReader::readMesh(const std::string filename) {
+  // mess I use to open and read the ply file with the c utils I found.
+  FILE *myfile = fopen(filename.c_str(), "r");
+  if (!myfile) throw std::runtime_error("PlyReader: cannot open " + filename);
+  PlyFile *in_ply = read_ply(myfile);
+  if (!in_ply) {
+    fclose(myfile);
+    throw std::runtime_error("PlyReader: " + filename + " is not a ply file");
+  }
 
+  int elem_count;
+  std::size_t nverts = 0;
+  bool has_color = false;
+  std::shared_ptr<float> vtx;
+  std::vector<glm::vec3> color;
+  auto idx = std::make_shared<std::vector<uint32_t> >();
+  for (int i = 0; i < in_ply->num_elem_types; i++) {
+    std::string elem_name = setup_element_read_ply(in_ply, i, &elem_count);
+    if (elem_name == "vertex") {
+      nverts = elem_count;
+      setup_property_ply(in_ply, &vert_props[0]);
+      setup_property_ply(in_ply, &vert_props[1]);
+      setup_property_ply(in_ply, &vert_props[2]);
+      for (int p = 0; p < in_ply->elems[i]->nprops; p++)
+        if (std::string(in_ply->elems[i]->props[p]->name) == "red") has_color = true;
       if (has_color) {
-        acolor[i * 3 + 0] = float(vlist[i]->cx) / 255.f;
-        acolor[i * 3 + 0] = float(vlist[i]->cy) / 255.f;
-        acolor[i * 3 + 0] = float(vlist[i]->cz) / 255.f;
+        setup_property_ply(in_ply, &vert_props[3]);
+        setup_property_ply(in_ply, &vert_props[4]);
+        setup_property_ply(in_ply, &vert_props[5]);
+        color.resize(nverts);
+      }
+      // packed storage layout, 16 byte stride
+      vtx.reset(new float[nverts * 4], std::default_delete<float[]>());
+      float *avtx = vtx.get();
+      Vertex vert;
+      for (std::size_t j = 0; j < nverts; j++) {
+        get_element_ply(in_ply, (void *)&vert);
+        avtx[j * 4 + 0] = vert.x;
+        avtx[j * 4 + 1] = vert.y;
+        avtx[j * 4 + 2] = vert.z;
+        avtx[j * 4 + 3] = 0.f;
+        if (has_color) color[j] = glm::vec3(vert.cx, vert.cy, vert.cz) / 255.f;
+      }
+    } else if (elem_name == "face") {
+      setup_property_ply(in_ply, &face_props[0]);
+      idx->reserve(3 * std::size_t(elem_count));
+      Face face;
+      for (int j = 0; j < elem_count; j++) {
+        get_element_ply(in_ply, (void *)&face);
+        for (int v = 2; v < face.nverts; v++) {
+          idx->push_back(face.verts[0]);
+          idx->push_back(face.verts[v - 1]);
+          idx->push_back(face.verts[v]);
+        }
+        free(face.verts);
       }
     }
-
-    for (int f = 0; f < nverts; f++) {
-      afc[i * 3 + 0] = flist[i]->verts[0];
-      afc[i * 3 + 1] = flist[i]->verts[1];
-      afc[i * 3 + 2] = flist[i]->verts[2];
-    }
-
-    api::addMeshVertices(meshname, nverts, avtx);
-    api::addMeshTriangles(meshname, nfaces, afc);
-    if (has_color) api::addMeshVertexColor(meshname, nverts, acolor);
-    api::finishMesh(meshname);
   }
+  close_ply(in_ply);
+  free_ply(in_ply);
+
+  if (!vtx) throw std::runtime_error("PlyReader: " + filename + " has no vertices");
+  for (uint32_t v : *idx)
+    if (v >= nverts) throw std::runtime_error("PlyReader: " + filename + " has a vertex index out of range");
+
+  Material *m = has_color ? nullptr : new Material();
+  std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(m);
+  mesh->setPackedVertices(vtx, nverts);
+  // aliasing pointer, the mesh keeps the index vector alive
+  mesh->setPackedTriangles(std::shared_ptr<const uint32_t>(idx, idx->data()), idx->size() / 3);
+  if (has_color) mesh->vertex_colors = color;
+  return mesh;
 }
 
 PlyReader::~PlyReader() {}
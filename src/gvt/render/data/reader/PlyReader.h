@@ -37,7 +37,9 @@ namespace data {
 namespace domain {
 namespace reader {
 /// read ply formatted geometry data
-/** read ply format files and return a Mesh object
+/** read a directory of ply format files into context meshes, one per file, with SceneLoader
+ * (distributed across the ranks if dist). If the directory holds .gvtm files (see gvtConvert)
+ * those are mapped instead of parsing the ply files.
 */
 class PlyReader {
 public:
@@ -67,9 +69,9 @@ public:
     return S_ISDIR(buf.st_mode);
   }
 
-  gvt::core::Vector<std::string> findply(const std::string dirname) {
+  gvt::core::Vector<std::string> findply(const std::string dirname, const std::string ext = "ply") {
     glob_t result;
-    std::string exp = dirname + "/*.ply";
+    std::string exp = dirname + "/*." + ext;
     glob(exp.c_str(), GLOB_TILDE, NULL, &result);
     gvt::core::Vector<std::string> ret;
     for (int i = 0; i < result.gl_pathc; i++) {
@@ -81,10 +83,13 @@ public:
 
   gvt::core::Vector<gvt::render::data::primitives::Mesh *> &getMeshes() { return meshes; }
 
-private:
-  Vertex **vlist;
-  Face **flist;
+  /** parse one ply file into a packed storage mesh, polygons are fan triangulated. Vertex colors
+   * are read if the file has red, green and blue vertex properties. Thread safe. Throws
+   * std::runtime_error if the file cannot be read.
+   */
+  static std::shared_ptr<gvt::render::data::primitives::Mesh> readMesh(const std::string filename);
 
+private:
   gvt::core::Vector<gvt::render::data::primitives::Mesh *> meshes;
 };
 }
@@ -0,0 +1,197 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#include <gvt/render/cntx/rcontext.h>
+#include <gvt/render/data/reader/SceneLoader.h>
+
+// before ply.h, its type macros clash with tbb template parameters
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <gvt/render/data/reader/GvtmFile.h>
+#include <gvt/render/data/reader/ObjReader.h>
+#include <gvt/render/data/reader/PlyReader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+using namespace gvt::render::data::domain::reader;
+using namespace gvt::render::data::primitives;
+
+namespace {
+typedef std::chrono::high_resolution_clock clock_type;
+
+double since(const clock_type::time_point &t) {
+  return std::chrono::duration<double, std::milli>(clock_type::now() - t).count();
+}
+
+bool hasExtension(const std::string &s, const std::string &ext) {
+  return s.size() > ext.size() && s.compare(s.size() - ext.size(), ext.size(), ext) == 0;
+}
+}
+
+SceneLoader::SceneLoader(const std::vector<std::string> &files, bool distribute, const std::string prefix)
+    : files(files), distribute(distribute), prefix(prefix), timings() {}
+
+SceneLoader::~SceneLoader() {}
+
+std::vector<int> SceneLoader::assign(const std::vector<uint64_t> &sizes, int nranks) {
+  std::vector<std::size_t> order(sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+  // (bytes, rank), least loaded rank on top, lowest rank on ties
+  typedef std::pair<uint64_t, int> load;
+  std::priority_queue<load, std::vector<load>, std::greater<load> > ranks;
+  for (int r = 0; r < nranks; ++r) ranks.push(load(0, r));
+
+  std::vector<int> owners(sizes.size());
+  for (std::size_t f : order) {
+    load l = ranks.top();
+    ranks.pop();
+    owners[f] = l.second;
+    l.first += sizes[f] + 1; // empty files still spread
+    ranks.push(l);
+  }
+  return owners;
+}
+
+std::shared_ptr<Mesh> SceneLoader::read(const std::string &filename) {
+  if (GvtmReader::isGvtm(filename)) return GvtmReader(filename).getMesh();
+  if (hasExtension(filename, ".ply")) return PlyReader::readMesh(filename);
+  if (hasExtension(filename, ".obj")) {
+    ObjReader reader(filename);
+    return std::shared_ptr<Mesh>(reader.getMesh());
+  }
+  throw std::runtime_error("SceneLoader: unknown mesh format " + filename);
+}
+
+void SceneLoader::load(bool instances, const glm::mat4 &m) {
+  cntx::rcontext &db = cntx::rcontext::instance();
+  const int rank = db.cntx_comm.rank;
+  Timings local;
+
+  // assign, rank 0 reads the file sizes once for everybody
+  clock_type::time_point t = clock_type::now();
+  if (distribute) {
+    std::vector<uint64_t> sizes(files.size(), 0);
+    if (rank == 0)
+      for (std::size_t i = 0; i < files.size(); ++i) {
+        struct stat buf;
+        if (stat(files[i].c_str(), &buf) == 0) sizes[i] = buf.st_size;
+      }
+    MPI_Bcast(sizes.data(), sizes.size(), MPI_UINT64_T, 0, db.cntx_comm.comm);
+    owners = assign(sizes, db.cntx_comm.size);
+  } else {
+    owners.assign(files.size(), -1);
+  }
+  std::vector<std::size_t> mine;
+  for (std::size_t i = 0; i < files.size(); ++i)
+    if (owners[i] == -1 || owners[i] == rank) mine.push_back(i);
+  local.assign = since(t);
+
+  // parse, one file per task
+  t = clock_type::now();
+  meshes.assign(mine.size(), nullptr);
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, mine.size(), 1),
+                    [&](const tbb::blocked_range<std::size_t> &range) {
+                      for (std::size_t i = range.begin(); i != range.end(); ++i) meshes[i] = read(files[mine[i]]);
+                    });
+  local.parse = since(t);
+
+  // finish, mapped meshes carry their bounding box and normals
+  t = clock_type::now();
+  const glm::mat4 minv = glm::inverse(m);
+  const glm::mat3 normi = glm::transpose(glm::inverse(glm::mat3(m)));
+  std::vector<Box3D> ibox(instances ? mine.size() : 0);
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, mine.size(), 1),
+                    [&](const tbb::blocked_range<std::size_t> &range) {
+                      for (std::size_t i = range.begin(); i != range.end(); ++i) {
+                        Mesh &mesh = *meshes[i];
+                        if (!GvtmReader::isGvtm(files[mine[i]])) mesh.computeBoundingBox();
+                        mesh.generateNormals();
+                        if (instances) {
+                          const Box3D *mbox = mesh.getBoundingBox();
+                          ibox[i] = Box3D(glm::vec3(m * glm::vec4(mbox->bounds_min, 1.f)),
+                                          glm::vec3(m * glm::vec4(mbox->bounds_max, 1.f)));
+                        }
+                      }
+                    });
+  local.finish = since(t);
+
+  // register, the context is not thread safe
+  t = clock_type::now();
+  db.sceneChanged();
+  names.resize(mine.size());
+  for (std::size_t i = 0; i < mine.size(); ++i) {
+    const std::string &name = names[i] = prefix + std::to_string(mine[i]);
+    cntx::node &meshnode = db.createnode("Mesh", name, true, db.getUnique("Data").getid());
+    db.getChild(meshnode, "file") = files[mine[i]];
+    db.getChild(meshnode, "ptr") = meshes[i];
+    db.getChild(meshnode, "bbox") = std::make_shared<Box3D>(*meshes[i]->getBoundingBox());
+    std::shared_ptr<std::vector<int> > v = std::make_shared<std::vector<int> >();
+    v->push_back(rank);
+    db.getChild(meshnode, "Locations") = v;
+  }
+  local.registration = since(t);
+
+  t = clock_type::now();
+  db.sync();
+  local.sync = since(t);
+
+  if (instances) {
+    // the sync relabels unique nodes with global ids, meshRef must be taken after it
+    t = clock_type::now();
+    for (std::size_t i = 0; i < mine.size(); ++i) {
+      if (owners[mine[i]] == -1 && rank != 0) continue;
+      const std::string &name = names[i];
+      cntx::node &inode = db.createnode("Instance", name + "_inst", true, db.getUnique("Instances").getid());
+      db.getChild(inode, "id") = inode.name;
+      db.getChild(inode, "meshRef") = db.getUnique(name).getid();
+      db.getChild(inode, "mat") = std::make_shared<glm::mat4>(m);
+      db.getChild(inode, "matinv") = std::make_shared<glm::mat4>(minv);
+      db.getChild(inode, "normi") = std::make_shared<glm::mat3>(normi);
+      db.getChild(inode, "bbox") = std::make_shared<Box3D>(ibox[i]);
+      db.getChild(inode, "centroid") = ibox[i].centroid();
+    }
+    local.registration += since(t);
+
+    t = clock_type::now();
+    db.sync();
+    local.sync += since(t);
+  }
+
+  MPI_Allreduce(&local, &timings, sizeof(Timings) / sizeof(double), MPI_DOUBLE, MPI_MAX, db.cntx_comm.comm);
+  if (rank == 0)
+    std::cout << "scene loader: " << files.size() << " files on " << db.cntx_comm.size << " ranks, assign "
+              << timings.assign << " ms, parse " << timings.parse << " ms, finish " << timings.finish
+              << " ms, register " << timings.registration << " ms, sync " << timings.sync << " ms" << std::endl;
+}
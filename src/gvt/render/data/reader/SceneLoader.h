@@ -0,0 +1,103 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#ifndef GVT_RENDER_DATA_DOMAIN_READER_SCENE_LOADER_H
+#define GVT_RENDER_DATA_DOMAIN_READER_SCENE_LOADER_H
+
+#include <gvt/render/data/Primitives.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace gvt {
+namespace render {
+namespace data {
+namespace domain {
+namespace reader {
+
+/// parallel, rank distributed loader for multi-file mesh datasets
+/** Loads a list of mesh files (.gvtm, .ply, .obj) into context meshes named <prefix><file index>
+ * in stages:
+ *  - assign: files go to ranks by size, largest first to the rank with the fewest bytes so far
+ *    (every rank loads every file if the load is not distributed)
+ *  - parse: the rank's files are parsed or mapped concurrently on the TBB workers
+ *  - finish: bounding boxes, normals and instance transforms are computed concurrently
+ *  - register: meshes are added to the context on the calling thread and the context is
+ *    synchronized (batched), then the instances, which refer to the meshes by their global
+ *    ids, are added and synchronized the same way
+ *
+ * load() is collective over the context communicator. Rank 0 prints the stage times, the
+ * slowest rank for each stage.
+ */
+class SceneLoader {
+public:
+  /// per stage wall clock times in ms, the maximum over the ranks
+  struct Timings {
+    double assign, parse, finish, registration, sync;
+  };
+
+  SceneLoader(const std::vector<std::string> &files, bool distribute = true, const std::string prefix = "Mesh");
+  virtual ~SceneLoader();
+
+  /** load and register the files. If \p instances, every mesh gets one instance named
+   * <mesh name>_inst with transform \p m, added by the rank that loaded the mesh (rank 0 if the
+   * load is not distributed).
+   */
+  void load(bool instances = false, const glm::mat4 &m = glm::mat4(1.f));
+
+  /** rank that loads each file, -1 for every rank */
+  const std::vector<int> &getOwners() const { return owners; }
+  /** meshes loaded by this rank */
+  std::vector<std::shared_ptr<gvt::render::data::primitives::Mesh> > &getMeshes() { return meshes; }
+  /** context names of the meshes loaded by this rank */
+  const std::vector<std::string> &getMeshNames() const { return names; }
+  const Timings &getTimings() const { return timings; }
+
+  /** size balanced file to rank assignment (longest processing time first). Deterministic, so
+   * every rank computes the same one.
+   */
+  static std::vector<int> assign(const std::vector<uint64_t> &sizes, int nranks);
+  /** read one mesh file, the format is picked by the extension. Throws std::runtime_error */
+  static std::shared_ptr<gvt::render::data::primitives::Mesh> read(const std::string &filename);
+
+private:
+  std::vector<std::string> files;
+  bool distribute;
+  std::string prefix;
+  std::vector<int> owners;
+  std::vector<std::shared_ptr<gvt::render::data::primitives::Mesh> > meshes;
+  std::vector<std::string> names;
+  Timings timings;
+};
+}
+}
+}
+}
+}
+
+#endif /* GVT_RENDER_DATA_DOMAIN_READER_SCENE_LOADER_H */
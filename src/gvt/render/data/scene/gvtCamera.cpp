@@ -41,7 +41,14 @@
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 #include <tbb/partitioner.h>
+#include <algorithm>
+#include <cmath>
 #include <thread>
+#include <vector>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 
 
 using namespace gvt::render::data::scene;
@@ -68,6 +75,9 @@ gvtCameraBase::gvtCameraBase() {
   jitterWindowSize = 0.000;
   samples = 1;
   depth = 1;
+  pixel_jitter[0] = pixel_jitter[1] = 0.f;
+  wave_rays = 0;
+  wave_next = wave_end = 0;
 }
 
 gvtCameraBase::gvtCameraBase(const gvtCameraBase &cam) {
@@ -80,6 +90,10 @@ gvtCameraBase::gvtCameraBase(const gvtCameraBase &cam) {
   jitterWindowSize = cam.jitterWindowSize;
   samples = cam.samples;
   depth = cam.depth;
+  pixel_jitter[0] = cam.pixel_jitter[0];
+  pixel_jitter[1] = cam.pixel_jitter[1];
+  wave_rays = cam.wave_rays;
+  wave_next = wave_end = 0;
 }
 
 float gvtCameraBase::frand() { return ((float)rand()) * INVRAND_MAX; }
@@ -201,6 +215,23 @@ void gvtCameraBase::setMaxDepth(int maxRayDepth) { depth = maxRayDepth; }
 
 void gvtCameraBase::setJitterWindowSize(int windowSize) { jitterWindowSize = windowSize; }
 
+void gvtCameraBase::setPixelJitter(float dx, float dy) {
+  pixel_jitter[0] = dx;
+  pixel_jitter[1] = dy;
+}
+
+void gvtCameraBase::setPassJitter(size_t pass) {
+  const auto offset = [](size_t i, unsigned base) {
+    float f = 1.f, r = 0.5f;
+    for (; i > 0; i /= base) {
+      f /= base;
+      r += f * (i % base);
+    }
+    return r - std::floor(r) - 0.5f;
+  };
+  setPixelJitter(offset(pass, 2), offset(pass, 3));
+}
+
 void gvtCameraBase::AllocateCameraRays() {
   size_t nrays = filmsize[0] * filmsize[1] * samples * samples;
   rays.clear();
@@ -208,6 +239,31 @@ void gvtCameraBase::AllocateCameraRays() {
   // return rays;
 }
 
+void gvtCameraBase::AllocateCameraRayStream() {
+  size_t nrays = filmsize[0] * filmsize[1] * samples * samples;
+  stream.resize(nrays);
+}
+
+void gvtCameraBase::generateRayStream(bool volume) {
+  AllocateCameraRays();
+  generateRays(volume);
+  stream.load(rays.begin(), rays.end());
+  rays.clear();
+}
+
+void gvtCameraBase::beginWaves(size_t max_rays) {
+  wave_rays = max_rays;
+  wave_next = 0;
+  wave_end = 1;
+}
+
+bool gvtCameraBase::nextWave(bool volume) {
+  if (!wavesPending()) return false;
+  generateRayStream(volume);
+  wave_next = wave_end;
+  return true;
+}
+
 void gvtCameraBase::dumpraystostdout() {
   int numrays = rays.size();
   std::cout << " gvtCamera: rays x,y,origin,direction,rays.t_max,id,type" << std::endl;
@@ -221,11 +277,80 @@ void gvtCameraBase::dumpraystostdout() {
 
 gvtCameraBase::~gvtCameraBase() {}
 
+namespace {
+/** Edge of the square pixel tiles primary rays are generated in */
+const int CAMERA_TILE = 16;
+
+/** Interleave the low 16 bits of v with zeros */
+inline unsigned spreadBits(unsigned v) {
+  v &= 0xffff;
+  v = (v | (v << 8)) & 0x00ff00ff;
+  v = (v | (v << 4)) & 0x0f0f0f0f;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+
+/** Row major tile index of every film tile, in Morton order of the tile coordinates */
+std::vector<int> mortonTiles(int tiles_x, int tiles_y) {
+  std::vector<std::pair<unsigned, int> > keys(size_t(tiles_x) * tiles_y);
+  for (int ty = 0; ty < tiles_y; ty++)
+    for (int tx = 0; tx < tiles_x; tx++)
+      keys[ty * tiles_x + tx] = std::make_pair(spreadBits(tx) | (spreadBits(ty) << 1), ty * tiles_x + tx);
+  std::sort(keys.begin(), keys.end());
+  std::vector<int> order(keys.size());
+  for (size_t t = 0; t < keys.size(); t++) order[t] = keys[t].second;
+  return order;
+}
+
+/**
+ * World space direction of the camera space samples (x[i], y[i], 1), normalized.
+ * Rows of m hold the camera basis as set up by buildTransform.
+ */
+void cameraDirections(const glm::mat4 &m, const float *x, const float *y, size_t n, float *dx, float *dy,
+                      float *dz) {
+  size_t i = 0;
+#ifdef __AVX__
+  const __m256 m00 = _mm256_set1_ps(m[0][0]), m01 = _mm256_set1_ps(m[0][1]), m02 = _mm256_set1_ps(m[0][2]);
+  const __m256 m10 = _mm256_set1_ps(m[1][0]), m11 = _mm256_set1_ps(m[1][1]), m12 = _mm256_set1_ps(m[1][2]);
+  const __m256 m20 = _mm256_set1_ps(m[2][0]), m21 = _mm256_set1_ps(m[2][1]), m22 = _mm256_set1_ps(m[2][2]);
+  const __m256 one = _mm256_set1_ps(1.f);
+  for (; i + 8 <= n; i += 8) {
+    const __m256 vx = _mm256_loadu_ps(x + i);
+    const __m256 vy = _mm256_loadu_ps(y + i);
+    const __m256 ddx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, vx), _mm256_mul_ps(m01, vy)), m02);
+    const __m256 ddy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, vx), _mm256_mul_ps(m11, vy)), m12);
+    const __m256 ddz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, vx), _mm256_mul_ps(m21, vy)), m22);
+    const __m256 len2 =
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ddx, ddx), _mm256_mul_ps(ddy, ddy)), _mm256_mul_ps(ddz, ddz));
+    // sqrt and divide rather than rsqrt, so the result matches glm::normalize
+    const __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(len2));
+    _mm256_storeu_ps(dx + i, _mm256_mul_ps(ddx, inv));
+    _mm256_storeu_ps(dy + i, _mm256_mul_ps(ddy, inv));
+    _mm256_storeu_ps(dz + i, _mm256_mul_ps(ddz, inv));
+  }
+#endif
+  for (; i < n; i++) {
+    const glm::vec3 d = glm::normalize(glm::vec3(m[0][0] * x[i] + m[0][1] * y[i] + m[0][2],
+                                                 m[1][0] * x[i] + m[1][1] * y[i] + m[1][2],
+                                                 m[2][0] * x[i] + m[2][1] * y[i] + m[2][2]));
+    dx[i] = d[0];
+    dy[i] = d[1];
+    dz[i] = d[2];
+  }
+}
+
+}
+
 // Perspective camera methods
-gvtPerspectiveCamera::gvtPerspectiveCamera() { field_of_view = 30.0; }
+gvtPerspectiveCamera::gvtPerspectiveCamera() : tiles_x(0) {
+  field_of_view = 30.0;
+  tiled[0] = tiled[1] = tiled[2] = 0;
+}
 
-gvtPerspectiveCamera::gvtPerspectiveCamera(const gvtPerspectiveCamera &cam) : gvtCameraBase(cam) {
+gvtPerspectiveCamera::gvtPerspectiveCamera(const gvtPerspectiveCamera &cam) : gvtCameraBase(cam), tiles_x(0) {
   field_of_view = cam.field_of_view;
+  tiled[0] = tiled[1] = tiled[2] = 0;
 }
 
 gvtPerspectiveCamera::~gvtPerspectiveCamera() {}
@@ -244,70 +369,182 @@ void gvtPerspectiveCamera::generateRays(bool volume) {
   const float vert = tanf(field_of_view * 0.5);
   const float horz = tanf(field_of_view * 0.5) * aspectRatio;
 
-  const glm::vec4 camera_normal_basis_vector(0, 0, 1, 0);
+  const float divider = samples;
+  const float offset = (1.0 / divider) * jitterWindowSize;
+
+  const float wmult = 2.f / float(buffer_width - 1);
+  const float hmult = 2.f / float(buffer_height - 1);
+  const float half_sample = samples * 0.5f;
+  const size_t samples2 = samples * samples;
+  const float contri = 1.f / (samples * samples);
+
+  // rays come out tile by tile in Morton order, so neighbouring rays share a
+  // pixel neighbourhood and traverse the same part of the top level BVH
+  buildTiles();
+  tbb::parallel_for(size_t(0), tile_order.size(), [&](size_t tile) {
+    int i0, i1, j0, j1;
+    tileBounds(tile, i0, i1, j0, j1);
+    const size_t n = (i1 - i0) * samples2;
+    std::vector<float> scratch(5 * n);
+    float *x = &scratch[0], *y = x + n, *dx = y + n, *dy = dx + n, *dz = dy + n;
+    size_t ridx = tile_first[tile];
+    for (int j = j0; j < j1; j++) {
+      const float y0 = (float(j) + pixel_jitter[1]) * hmult - 1.0;
+      size_t s = 0;
+      for (int i = i0; i < i1; i++) {
+        const float x0 = (float(i) + pixel_jitter[0]) * wmult - 1.0;
+        for (int k = 0; k < samples; k++) {
+          for (int w = 0; w < samples; w++, s++) {
+            // calculate scale factors -1.0 < x,y < 1.0
+            x[s] = (x0 + (w - half_sample) * offset) * horz;
+            y[s] = (y0 + (k - half_sample) * offset) * vert;
+          }
+        }
+      }
+      cameraDirections(cam2wrld, x, y, n, dx, dy, dz);
+      for (s = 0; s < n; s++, ridx++) {
+        Ray &ray = rays[ridx];
+        ray.mice.id = j * buffer_width + i0 + s / samples2;
+        ray.mice.t_min = gvt::render::actor::Ray::RAY_EPSILON;
+        ray.mice.origin = eye_point;
+        ray.mice.direction = glm::vec3(dx[s], dy[s], dz[s]);
+        ray.mice.t_max = FLT_MAX;
+        ray.mice.color = glm::vec3(0., 0., 0.);
+        if (volume) {
+          ray.mice.w = 0.0; // volume rendering opacity variable
+          ray.mice.t = ray.mice.t_max;
+          ray.mice.type = RAY_PRIMARY;
+          ray.mice.depth = 0;
+        } else {
+          ray.mice.t = ray.mice.t_max = FLT_MAX;
+          ray.mice.w = contri;
+          ray.mice.type = Ray::PRIMARY;
+          ray.mice.depth = depth;
+        }
+      }
+    }
+  });
+}
+
+void gvtPerspectiveCamera::generateRayStream(bool volume) {
+  gvt::core::time::timer t(true, "generate camera ray stream");
+  buildTiles();
+  generateTiles(0, tile_order.size(), volume);
+}
+
+void gvtPerspectiveCamera::beginWaves(size_t max_rays) {
+  buildTiles();
+  wave_rays = max_rays;
+  wave_next = 0;
+  wave_end = tile_order.size();
+  // drop a stream left over from a larger frame or budget, the budget bounds what is kept between waves
+  const size_t largest = std::max(max_rays, size_t(CAMERA_TILE * CAMERA_TILE) * samples * samples);
+  if (max_rays != 0 && stream.capacity() > largest + RayStream::ALIGNMENT) stream = RayStream();
+}
+
+bool gvtPerspectiveCamera::nextWave(bool volume) {
+  if (!wavesPending()) return false;
+  // whole tiles up to the budget, at least one so a tiny budget still makes progress
+  size_t last = wave_next + 1;
+  if (wave_rays == 0)
+    last = wave_end;
+  else
+    while (last < wave_end && tile_first[last + 1] - tile_first[wave_next] <= wave_rays) last++;
+  generateTiles(wave_next, last, volume);
+  wave_next = last;
+  return true;
+}
+
+void gvtPerspectiveCamera::buildTiles() {
+  if (tiled[0] == filmsize[0] && tiled[1] == filmsize[1] && tiled[2] == samples) return;
+  const size_t samples2 = samples * samples;
+  tiles_x = (filmsize[0] + CAMERA_TILE - 1) / CAMERA_TILE;
+  tile_order = mortonTiles(tiles_x, (filmsize[1] + CAMERA_TILE - 1) / CAMERA_TILE);
+  tile_first.assign(tile_order.size() + 1, 0);
+  for (size_t t = 0; t < tile_order.size(); t++) {
+    int i0, i1, j0, j1;
+    tileBounds(t, i0, i1, j0, j1);
+    tile_first[t + 1] = tile_first[t] + size_t(i1 - i0) * (j1 - j0) * samples2;
+  }
+  tiled[0] = filmsize[0];
+  tiled[1] = filmsize[1];
+  tiled[2] = samples;
+}
+
+void gvtPerspectiveCamera::tileBounds(size_t t, int &i0, int &i1, int &j0, int &j1) const {
+  i0 = (tile_order[t] % tiles_x) * CAMERA_TILE;
+  j0 = (tile_order[t] / tiles_x) * CAMERA_TILE;
+  i1 = std::min(filmsize[0], i0 + CAMERA_TILE);
+  j1 = std::min(filmsize[1], j0 + CAMERA_TILE);
+}
+
+void gvtPerspectiveCamera::generateTiles(size_t first, size_t last, bool volume) {
+  // Same sampling and tile order as generateRays, but each ray field is written to its own column.
+  int buffer_width = filmsize[0];
+  int buffer_height = filmsize[1];
+
+  float aspectRatio = float(buffer_width) / float(buffer_height);
+
+  const float vert = tanf(field_of_view * 0.5);
+  const float horz = tanf(field_of_view * 0.5) * aspectRatio;
 
   const float divider = samples;
   const float offset = (1.0 / divider) * jitterWindowSize;
-  const glm::vec3 z(cam2wrld[0][2], cam2wrld[1][2], cam2wrld[2][2]);
 
   const float wmult = 2.f / float(buffer_width - 1);
   const float hmult = 2.f / float(buffer_height - 1);
   const float half_sample = samples * 0.5f;
   const size_t samples2 = samples * samples;
   const float contri = 1.f / (samples * samples);
-//  size_t chunksize = std::max(
-//      1, buffer_height / (gvt::core::CoreContext::instance()->getRootNode()["threads"].value().toInteger() * 4));
-  const size_t chunksize = MAX(4096, rays.size() / (cntx::rcontext::instance().getUnique("threads").to<unsigned>() * 4));
-  static tbb::auto_partitioner ap;
-  tbb::parallel_for(tbb::blocked_range<size_t>(0, buffer_height, chunksize),
-                    [&](tbb::blocked_range<size_t> &chunk) {
-                      gvt::core::math::RandEngine randEngine;
-                      randEngine.SetSeed(chunk.begin());
-                      for (size_t j = chunk.begin(); j < chunk.end(); j++) {
-                        // multi - jittered samples
-                        // int i = idx;
-                        int idx = j * buffer_width;
-                        for (size_t i = 0; i < buffer_width; i++) {
-                          const float x0 = float(i) * wmult - 1.0, y0 = float(j) * hmult - 1.0;
-                          float x, y;
-                          // glm::vec4 camera_space_ray_direction;
-                          for (int k = 0; k < samples; k++) {
-                            for (int w = 0; w < samples; w++) {
-                              // calculate scale factors -1.0 < x,y < 1.0
-                              int ridx = idx * samples2 + k * samples + w;
-                              x = x0 + (w - half_sample) * offset;
-                              x *= horz;
-                              y = y0 + (k - half_sample) * offset;
-                              y *= vert;
-                              glm::vec3 camera_space_ray_direction;
-                              camera_space_ray_direction[0] = cam2wrld[0][0] * x + cam2wrld[0][1] * y + z[0];
-                              camera_space_ray_direction[1] = cam2wrld[1][0] * x + cam2wrld[1][1] * y + z[1];
-                              camera_space_ray_direction[2] = cam2wrld[2][0] * x + cam2wrld[2][1] * y + z[2];
-                              Ray &ray = rays[ridx];
-                              ray.mice.id = idx;
-                              ray.mice.t_min = gvt::render::actor::Ray::RAY_EPSILON;
-                              ray.mice.origin = eye_point;
-                              ray.mice.direction = glm::normalize(camera_space_ray_direction);
-                              ray.mice.t_max = FLT_MAX;
-                              ray.mice.color = glm::vec3(0.,0.,0.);
-                              if (volume) {
-                                ray.mice.w = 0.0; // volume rendering opacity variable
-                                // ray.t = 0.0;
-                                ray.mice.t = ray.mice.t_max;
-                                ray.mice.type = RAY_PRIMARY;
-                                ray.mice.depth = 0;
-                              } else {
-                                ray.mice.t = ray.mice.t_max = FLT_MAX;
-                                ray.mice.w = contri;
-                                ray.mice.type = Ray::PRIMARY;
-                                ray.mice.depth = depth;
-                              }
-                            }
-                          }
-                          idx++;
-                        }
-                      }
-                    },
-                    ap);
+
+  // the stream holds tiles [first, last) only, its capacity is kept between waves
+  const size_t base = tile_first[first];
+  stream.resize(tile_first[last] - base);
+
+  const float ray_w = (volume) ? 0.f : contri;
+  const int ray_type = (volume) ? RAY_PRIMARY : Ray::PRIMARY;
+  const int ray_depth = (volume) ? 0 : depth;
+
+  RayStream &rs = stream;
+  tbb::parallel_for(first, last, [&](size_t tile) {
+    int i0, i1, j0, j1;
+    tileBounds(tile, i0, i1, j0, j1);
+    const size_t n = (i1 - i0) * samples2;
+    std::vector<float> scratch(2 * n);
+    float *x = &scratch[0], *y = x + n;
+    const size_t begin = tile_first[tile] - base, end = tile_first[tile + 1] - base;
+    size_t row = begin;
+    for (int j = j0; j < j1; j++, row += n) {
+      const float y0 = (float(j) + pixel_jitter[1]) * hmult - 1.0;
+      size_t s = 0;
+      for (int i = i0; i < i1; i++) {
+        const float x0 = (float(i) + pixel_jitter[0]) * wmult - 1.0;
+        for (int k = 0; k < samples; k++) {
+          const float yk = (y0 + (k - half_sample) * offset) * vert;
+          for (int w = 0; w < samples; w++, s++) {
+            x[s] = (x0 + (w - half_sample) * offset) * horz;
+            y[s] = yk;
+          }
+        }
+        std::fill(rs.id + row + (i - i0) * samples2, rs.id + row + (i - i0 + 1) * samples2, j * buffer_width + i);
+      }
+      // directions land straight in the stream columns
+      cameraDirections(cam2wrld, x, y, n, rs.dx + row, rs.dy + row, rs.dz + row);
+    }
+    // constant columns, plain fills the compiler turns into vector stores
+    std::fill(rs.ox + begin, rs.ox + end, eye_point[0]);
+    std::fill(rs.oy + begin, rs.oy + end, eye_point[1]);
+    std::fill(rs.oz + begin, rs.oz + end, eye_point[2]);
+    std::fill(rs.t_min + begin, rs.t_min + end, gvt::render::actor::Ray::RAY_EPSILON);
+    std::fill(rs.t_max + begin, rs.t_max + end, FLT_MAX);
+    std::fill(rs.t + begin, rs.t + end, FLT_MAX);
+    std::fill(rs.cr + begin, rs.cr + end, 0.f);
+    std::fill(rs.cg + begin, rs.cg + end, 0.f);
+    std::fill(rs.cb + begin, rs.cb + end, 0.f);
+    std::fill(rs.w + begin, rs.w + end, ray_w);
+    std::fill(rs.type + begin, rs.type + end, ray_type);
+    std::fill(rs.depth + begin, rs.depth + end, ray_depth);
+  });
 }
+
 void gvtPerspectiveCamera::setFOV(const float fov) { field_of_view = fov; }
@@ -35,8 +35,10 @@
 #endif
 #include <gvt/core/Math.h>
 #include <gvt/core/math/RandEngine.h>
+#include <gvt/render/actor/RayStream.h>
 #include <gvt/render/data/Primitives.h>
 #include <stdlib.h>
+#include <vector>
 
 namespace gvt {
 namespace render {
@@ -93,6 +95,8 @@ public:
   /** Fill up the ray vector with correct rays. Base class just initializes the vector.
    *  Derived classes insert the rays themselves. */
   virtual void AllocateCameraRays();
+  /** Size the structure-of-arrays primary ray stream. */
+  virtual void AllocateCameraRayStream();
 
   /** given a new eye point, focal point, and up vector modify all the other dependant vars.
    *  in particular rebuild the transformation matrix. The new camera position is passed in as
@@ -106,10 +110,17 @@ public:
   void setMaxDepth(int depth);
 
   void setJitterWindowSize(int windowSize);
+  /** Shift every sample by (dx, dy) pixels, progressive passes use a new offset each pass */
+  void setPixelJitter(float dx, float dy);
+  /** Pixel jitter of progressive pass number pass: Halton (2, 3) points rotated by half a pixel, so
+   *  pass 0 samples the pixel centers and later passes fill the pixel evenly */
+  void setPassJitter(size_t pass);
   void dumpraystostdout();
 
   /** Bunch-o-rays */
   gvt::render::actor::RayVector rays;
+  /** Bunch-o-rays, structure-of-arrays layout */
+  gvt::render::actor::RayStream stream;
 
   // clang-format off
   glm::vec3 getEyePoint() {
@@ -126,6 +137,16 @@ public:
 
   /** Fill the ray data structure */
   virtual void generateRays(bool volume = false) = 0;
+  /** Fill the ray stream. Base class generates the ray vector and converts it. */
+  virtual void generateRayStream(bool volume = false);
+
+  /** Rewind the frame and split its primary rays into waves of at most max_rays rays
+   *  (0 for a single wave). Base class always uses a single wave. */
+  virtual void beginWaves(size_t max_rays = 0);
+  /** Fill the ray stream with the next wave. Returns false once the whole frame was generated. */
+  virtual bool nextWave(bool volume = false);
+  /** True while nextWave has rays left to generate */
+  bool wavesPending() const { return wave_next < wave_end; }
 
   /** Set the field of view angle in degrees*/
   virtual void setFOV(const float fov) = 0;
@@ -134,6 +155,7 @@ public:
 public:
   int samples;
   int jitterWindowSize;
+  float pixel_jitter[2];    //!< sub-pixel offset of all samples, in pixels
   glm::mat4 cam2wrld;       //!< transform from camera to world coords
   glm::mat4 wrld2cam;       //!< transform from world to camera coords
   glm::vec3 eye_point;      //!< camera location in world coordinates
@@ -145,6 +167,9 @@ public:
   glm::vec3 u, v, w;        //!< unit basis vectors for camera space in world coords.
   float INVRAND_MAX;
   gvt::core::math::RandEngine randEngine;
+  size_t wave_rays;         //!< ray budget of a wave, 0 for the whole frame
+  size_t wave_next;         //!< next wave unit (tile) to generate
+  size_t wave_end;          //!< number of wave units (tiles) in the frame
   //
   void buildTransform(); //!< Build the transformation matrix and inverse
 };
@@ -169,11 +194,30 @@ public:
   /** Set the field of view angle in degrees*/
   void setFOV(const float fov);
 
-  /** Fill the ray data structure */
+  /** Fill the ray data structure. Rays are laid out in 16x16 pixel tiles visited in
+   *  Morton order, with the samples of a pixel adjacent. */
   virtual void generateRays(bool volume = false);
+  /** Fill the ray stream directly in the same tile order, no intermediate ray vector */
+  virtual void generateRayStream(bool volume = false);
+
+  /** Waves are runs of whole tiles in the generateRays order */
+  virtual void beginWaves(size_t max_rays = 0);
+  virtual bool nextWave(bool volume = false);
 
 protected:
   float field_of_view; //!< Angle subtended by the film plane height from eye_point
+
+  int tiled[3];                   //!< width, height and samples the tiles were built for
+  int tiles_x;                    //!< tiles per film row
+  std::vector<int> tile_order;    //!< row major tile index of every tile, in Morton order
+  std::vector<size_t> tile_first; //!< first frame ray of each tile in tile_order, plus the ray count
+
+  /** (Re)build the tile order if the film or sample count changed */
+  void buildTiles();
+  /** Pixel range [i0, i1) x [j0, j1) of the t-th tile in tile_order */
+  void tileBounds(size_t t, int &i0, int &i1, int &j0, int &j1) const;
+  /** Fill the stream with the rays of tiles [first, last) of tile_order */
+  void generateTiles(size_t first, size_t last, bool volume);
 };
 
 } // scene
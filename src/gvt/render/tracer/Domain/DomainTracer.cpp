@@ -25,6 +25,8 @@
 #include <algorithm>
 
 #include "DomainTracer.h"
+#include "Messages/SendLoad.h"
+#include "Messages/SendRayBatch.h"
 #include "Messages/SendRayList.h"
 #include <gvt/core/comm/communicator.h>
 #include <gvt/core/utils/global_counter.h>
@@ -34,39 +36,35 @@
 namespace gvt {
 namespace render {
 
-bool DomainTracer::areWeDone() {
-  std::shared_ptr<gvt::comm::communicator> comm = gvt::comm::communicator::singleton();
-  std::shared_ptr<DomainTracer> tracer = std::dynamic_pointer_cast<DomainTracer>(cntx::rcontext::instance().tracer);
-  if (!tracer || tracer->getGlobalFrameFinished()) return false;
-  bool ret = tracer->isDone();
-  return ret;
-}
-
-void DomainTracer::Done(bool T) {
-  std::shared_ptr<gvt::comm::communicator> comm = gvt::comm::communicator::singleton();
-  //  gvt::render::RenderContext &cntxt = *gvt::render::RenderContext::instance();
-  std::shared_ptr<DomainTracer> tracer = std::dynamic_pointer_cast<DomainTracer>(cntx::rcontext::instance().tracer);
-  if (!tracer) return;
-  if (T) {
-    tracer->setGlobalFrameFinished(true);
-  }
-}
-
 DomainTracer::DomainTracer(const std::string &name, std::shared_ptr<gvt::render::data::scene::gvtCameraBase> cam,
                            std::shared_ptr<gvt::render::composite::ImageComposite> img)
     : gvt::render::RayTracer(name, cam, img) {
   RegisterMessage<gvt::comm::EmptyMessage>();
   RegisterMessage<gvt::comm::SendRayList>();
+  RegisterMessage<gvt::comm::SendRayBatch>();
+  RegisterMessage<gvt::comm::SendLoad>();
   gvt::comm::communicator &comm = gvt::comm::communicator::instance();
-  v = std::make_shared<comm::vote::vote>(DomainTracer::areWeDone, DomainTracer::Done);
-  comm.setVote(v);
+  termination = std::make_shared<gvt::comm::TerminationDetector>();
 
   auto &db = cntx::rcontext::instance();
 
-  queue_mutex = new std::mutex[meshRef.size()];
-  for (auto &m : meshRef) {
-    queue[m.first] = gvt::render::actor::RayVector();
-  }
+  rank = comm.id();
+  routing = db.getChild(db.getUnique(name), "replicaRouting");
+  shareRays = db.getChild(db.getUnique(name), "shareRays").to<unsigned>();
+  loadInterval = std::chrono::microseconds((long long)(db.getChild(db.getUnique(name), "loadInterval").to<float>() * 1e3));
+  load.reset(new std::atomic<std::size_t>[comm.lastid()]);
+  for (int i = 0; i < comm.lastid(); ++i) load[i] = 0;
+
+  const bool lossless = db.getChild(db.getUnique(name), "losslessRays");
+  coalescer = std::make_shared<RayCoalescer>(
+      comm.id(), db.getChild(db.getUnique(name), "sendBytes").to<unsigned>(),
+      db.getChild(db.getUnique(name), "sendMaxBytes").to<unsigned>(),
+      db.getChild(db.getUnique(name), "sendDelay").to<float>(),
+      lossless ? gvt::render::actor::RayCodec::RAW : gvt::render::actor::RayCodec::COMPACT,
+      [this](std::shared_ptr<gvt::comm::Message> msg, int dst) {
+        termination->sent();
+        gvt::comm::communicator::instance().send(msg, dst);
+      });
 
   instances_in_node.clear();
 
@@ -86,29 +84,38 @@ DomainTracer::DomainTracer(const std::string &name, std::shared_ptr<gvt::render:
     size_t id = db.getChild(i, "id");
     std::vector<int> &loc = *(db.getChild(m, "Locations").to<std::shared_ptr<std::vector<int> > >().get());
     remote[id] = loc[lastAssigned[m.getid()] % loc.size()];
-    instances_in_node[id] = (remote[id] == db.cntx_comm.rank);
+    holders[id] = loc;
+    replicated = replicated || (loc.size() > 1);
+    instances_in_node[id] = routing ? (std::find(loc.begin(), loc.end(), rank) != loc.end())
+                                    : (remote[id] == db.cntx_comm.rank);
     lastAssigned[m.getid()]++;
   }
+  for (auto &i : instances_in_node) queue.setLocal(i.first, i.second);
+  resetNodeScene();
 }
 
-DomainTracer::~DomainTracer() {
-  if (queue_mutex != nullptr) delete[] queue_mutex;
-  queue.clear();
-}
+DomainTracer::~DomainTracer() { queue.clear(); }
 
 void DomainTracer::resetBVH() {
   RayTracer::resetBVH();
-  //  if (queue_mutex != nullptr) delete[] queue_mutex;
+  // remote instance queues are drained to the coalescer instead of being scheduled
+  for (auto &i : instances_in_node) queue.setLocal(i.first, i.second);
+  resetNodeScene();
+}
 
-  for (auto &m : meshRef) {
-    queue[m.first] = gvt::render::actor::RayVector();
-    queue[m.first].reserve(8192);
-  }
+void DomainTracer::resetNodeScene() {
+  gvt::core::Vector<int> local;
+  for (auto &i : instances_in_node)
+    if (i.second) local.push_back(i.first);
+  RayTracer::buildNodeScene(local);
 }
 
 void DomainTracer::operator()() {
   gvt::comm::communicator &comm = gvt::comm::communicator::instance();
   _GlobalFrameFinished = false;
+  termination->reset();
+  // the image outlives the frame when the renderer accumulates progressive passes
+  img->reset();
 
   gvt::core::time::timer t_frame(true, "domain tracer: frame :");
   gvt::core::time::timer t_all(false, "domain tracer: all timers :");
@@ -124,71 +131,180 @@ void DomainTracer::operator()() {
   gvt::util::global_counter gc_filter("Number of rays filtered :");
   gvt::util::global_counter gc_shuffle("Number of rays shuffled :");
   gvt::util::global_counter gc_sent("Number of rays sent :");
+  gvt::util::global_counter gc_messages("Number of ray messages sent :");
+  gvt::util::global_counter gc_message_bytes("Mean ray message size (bytes) :");
+  gvt::util::global_counter gc_shared("Number of rays shared with replica holders :");
+
+  coalescer->resetCounters();
+  for (int i = 0; i < comm.lastid(); ++i) load[i] = 0;
+  advertised = 0;
+  advertisedAt = std::chrono::steady_clock::time_point();
 
-  t_filter.resume();
-  gc_filter.add(cam->rays.size());
-  processRaysAndDrop(cam->rays);
-  t_filter.stop();
-  gvt::render::actor::RayVector returned_rays;
+  t_camera.resume();
+  cam->beginWaves(waveRays);
+  t_camera.stop();
+  gvt::render::actor::RayVector toprocess, returned_rays;
 
   do {
-    int target = -1;
-    int amount = 0;
-    t_select.resume();
-    for (auto &q : queue) {
-      if (isInNode(q.first) && q.second.size() > amount) {
-        amount = q.second.size();
-        target = q.first;
-      }
+    std::shared_ptr<gvt::comm::Message> msg;
+    while (comm.poll(msg)) MessageManager(msg);
+
+    // the next wave of camera rays is generated once the local queues ran dry, a rank with waves left is never
+    // idle so termination cannot fire before every rank generated its last wave
+    if (queue.empty() && cam->wavesPending()) {
+      t_camera.resume();
+      cam->nextWave(volume);
+      t_camera.stop();
+      t_filter.resume();
+      gc_filter.add(cam->stream.size());
+      processRaysAndDrop(cam->stream);
+      t_filter.stop();
     }
+
+    t_select.resume();
+    const int target = queue.top();
     t_select.stop();
 
-    if (target != -1) {
-      gvt::render::actor::RayVector tmp;
+    if (target != -1 && inNodeScene(target)) {
+      // one trace for every local instance, the rays that come back left the node's data
+      t_send.resume();
+      takeNodeQueues(toprocess, [&](int instance, gvt::render::actor::RayVector &rays) {
+        gc_shared.add(shareQueue(instance, rays));
+      });
+      t_send.stop();
+
+      t_tracer.resume();
+      gc_rays.add(toprocess.size());
+      RayTracer::callNodeScene(toprocess, returned_rays);
+      t_tracer.stop();
+
+      t_shuffle.resume();
+      gc_shuffle.add(returned_rays.size());
+      processRays(returned_rays, gvt::render::data::accel::BVH::LOCAL);
+      t_shuffle.stop();
+
+      t_send.resume();
+      gc_sent.add(sendRemoteQueues());
+      coalescer->flushExpired();
+      t_send.stop();
+    } else if (target != -1) {
+      queue.take(target, toprocess);
+      t_send.resume();
+      gc_shared.add(shareQueue(target, toprocess));
+      t_send.stop();
 
-      queue_mutex[target].lock();
       t_tracer.resume();
-      gc_rays.add(queue[target].size());
-      std::swap(queue[target], tmp);
-      queue[target].reserve(4096);
-      queue_mutex[target].unlock();
-      RayTracer::calladapter(target, tmp, returned_rays);
+      gc_rays.add(toprocess.size());
+      RayTracer::calladapter(target, toprocess, returned_rays);
       t_tracer.stop();
 
       t_shuffle.resume();
       gc_shuffle.add(returned_rays.size());
       processRays(returned_rays, target);
       t_shuffle.stop();
+
+      t_send.resume();
+      gc_sent.add(sendRemoteQueues());
+      coalescer->flushExpired();
+      t_send.stop();
     } else {
+      // out of local work, nothing is worth holding back
       t_send.resume();
-      for (auto &q : queue) {
-        if (isInNode(q.first) || q.second.empty()) continue;
-        queue_mutex[q.first].lock();
-        gc_sent.add(q.second.size());
-        int sendto = pickNode(q.first);
-        std::shared_ptr<gvt::comm::Message> msg = std::make_shared<gvt::comm::SendRayList>(comm.id(), sendto, q.second);
-        comm.send(msg, sendto);
-
-        q.second.clear();
-        queue_mutex[q.first].unlock();
-      }
+      gc_sent.add(sendRemoteQueues());
+      coalescer->flushAll();
       t_send.stop();
     }
 
-    if (isDone()) {
-      v->PorposeVoting();
-    }
+    advertiseLoad();
+
+    // termination waves run in the background, one more is started whenever the last one completed
+    if (termination->poll(isDone())) setGlobalFrameFinished(true);
 
   } while (hasWork());
   t_gather.resume();
   img->composite();
   t_gather.stop();
   t_frame.stop();
-  t_all = t_gather + t_send + t_shuffle + t_tracer + t_filter + t_select;
+  t_all = t_gather + t_send + t_shuffle + t_tracer + t_filter + t_select + t_camera;
+  gc_messages.add(coalescer->counters().messages);
+  gc_message_bytes.add(coalescer->counters().bytes);
   gc_filter.print();
   gc_shuffle.print();
   gc_rays.print();
   gc_sent.print();
+  if (replicated && routing) gc_shared.print();
+  gc_messages.print();
+  gc_message_bytes.print_mean(gc_messages);
+}
+
+std::size_t DomainTracer::sendRemoteQueues() {
+  // the coalescer takes over the queue storage
+  return queue.drainRemote([&](int instance, gvt::render::actor::RayVector &&rays) {
+    const int dst = pickNode(instance);
+    // count the rays against the holder until it advertises again, so the next queues spread out
+    if (routing) load[dst] += rays.size();
+    coalescer->add(dst, instance, std::move(rays));
+  });
+}
+
+int DomainTracer::pickNode(const int &i) {
+  if (!routing) return remote[i];
+  const std::vector<int> &h = holders[i];
+  // start the scan at a different holder for each instance so that equal depths do not all pick the same node
+  int best = -1;
+  std::size_t least = 0;
+  for (std::size_t k = 0, first = std::size_t(i) % h.size(); k < h.size(); ++k) {
+    const int node = h[(first + k) % h.size()];
+    if (node == rank) continue;
+    const std::size_t depth = load[node];
+    if (best == -1 || depth < least) {
+      best = node;
+      least = depth;
+    }
+  }
+  return (best == -1) ? remote[i] : best;
+}
+
+std::size_t DomainTracer::shareQueue(const int instance, gvt::render::actor::RayVector &rays) {
+  if (!routing || !replicated || rays.size() < 2 * shareRays) return 0;
+  const std::vector<int> &h = holders[instance];
+  if (h.size() < 2) return 0;
+
+  const std::size_t own = queue.rays() + rays.size();
+  int best = -1;
+  std::size_t least = own;
+  for (int node : h) {
+    const std::size_t depth = load[node];
+    if (node != rank && depth < least) {
+      best = node;
+      least = depth;
+    }
+  }
+  if (best == -1) return 0;
+
+  // move half the difference at most, so the two holders end up level instead of trading places
+  const std::size_t n = std::min(rays.size() / 2, (own - least) / 2);
+  if (n < shareRays) return 0;
+  gvt::render::actor::RayVector share(std::make_move_iterator(rays.end() - n), std::make_move_iterator(rays.end()));
+  rays.resize(rays.size() - n);
+  load[best] += n;
+  coalescer->add(best, instance, std::move(share));
+  return n;
+}
+
+void DomainTracer::advertiseLoad() {
+  const std::size_t depth = queue.rays();
+  coalescer->advertise(depth);
+  if (!routing || !replicated) return;
+
+  // broadcast only when the depth changed enough to change routing decisions
+  const bool changed = (depth == 0) != (advertised == 0) || depth > 2 * advertised + shareRays ||
+                       2 * depth + shareRays < advertised;
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (!changed || now - advertisedAt < loadInterval) return;
+  advertised = depth;
+  advertisedAt = now;
+  gvt::comm::communicator::instance().broadcast(std::make_shared<gvt::comm::SendLoad>(rank, depth));
 }
 
 inline void DomainTracer::processRaysAndDrop(gvt::render::actor::RayVector &rays) {
@@ -196,49 +312,60 @@ inline void DomainTracer::processRaysAndDrop(gvt::render::actor::RayVector &rays
   gvt::comm::communicator &comm = gvt::comm::communicator::instance();
   const int chunksize = MAX(4096, rays.size() / (db.getUnique("threads").to<unsigned>() * 4));
   gvt::render::data::accel::BVH &acc = *bvh.get();
-  static tbb::auto_partitioner ap;
-  tbb::parallel_for(tbb::blocked_range<gvt::render::actor::RayVector::iterator>(rays.begin(), rays.end(), chunksize),
-                    [&](tbb::blocked_range<gvt::render::actor::RayVector::iterator> raysit) {
-
-                      gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
-                          acc.intersect<GVT_SIMD_WIDTH>(raysit.begin(), raysit.end(), -1);
-
-                      gvt::core::Map<int, gvt::render::actor::RayVector> local_queue;
-                      for (size_t i = 0; i < hits.size(); i++) {
-                        gvt::render::actor::Ray &r = *(raysit.begin() + i);
-                        if (hits[i].next != -1)
-                          if (instances_in_node[hits[i].next]) local_queue[hits[i].next].push_back(r);
-                      }
-                      for (auto &q : local_queue) {
-                        queue_mutex[q.first].lock();
-                        queue[q.first].insert(queue[q.first].end(),
-                                              std::make_move_iterator(local_queue[q.first].begin()),
-                                              std::make_move_iterator(local_queue[q.first].end()));
-                        queue_mutex[q.first].unlock();
-                      }
-                    },
-                    ap);
+  queue.partition(rays.size(), chunksize,
+                  [&](size_t begin, size_t end, int *target) {
+                    gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
+                        acc.intersect<GVT_SIMD_WIDTH>(rays.begin() + begin, rays.begin() + end, -1);
+                    for (size_t i = 0; i < hits.size(); i++)
+                      target[i] = (hits[i].next != -1 && ownsCameraRay(hits[i].next, rays[begin + i].mice.id))
+                                      ? hits[i].next
+                                      : -1;
+                  },
+                  [&](size_t i, gvt::render::actor::Ray &r) { r = rays[i]; });
+
+  rays.clear();
+}
+
+inline void DomainTracer::processRaysAndDrop(gvt::render::actor::RayStream &rays) {
+  auto &db = cntx::rcontext::instance();
+  const size_t chunksize = MAX(4096, rays.size() / (db.getUnique("threads").to<unsigned>() * 4));
+  gvt::render::data::accel::BVH &acc = *bvh.get();
+  queue.partition(rays.size(), chunksize,
+                  [&](size_t begin, size_t end, int *target) {
+                    gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
+                        acc.intersect<GVT_SIMD_WIDTH>(rays, begin, end, -1);
+                    for (size_t i = 0; i < hits.size(); i++)
+                      target[i] = (hits[i].next != -1 && ownsCameraRay(hits[i].next, rays.id[begin + i]))
+                                      ? hits[i].next
+                                      : -1;
+                  },
+                  [&](size_t i, gvt::render::actor::Ray &r) { rays.get(i, r); });
 
   rays.clear();
 }
 
 inline void DomainTracer::processRays(gvt::render::actor::RayVector &rays, const int src, const int dst) {
+  if (!rays.empty()) processRays(rays.data(), rays.data() + rays.size(), src, dst);
+  rays.clear();
+}
+
+inline void DomainTracer::processRays(gvt::render::actor::Ray *first, gvt::render::actor::Ray *last, const int src,
+                                      const int dst) {
 
   auto &db = cntx::rcontext::instance();
 
-  const int chunksize = MAX(4096, rays.size() / (db.getUnique("threads").to<unsigned>() * 4));
+  const int chunksize = MAX(4096, (last - first) / (db.getUnique("threads").to<unsigned>() * 4));
   gvt::render::data::accel::BVH &acc = *bvh.get();
-  static tbb::auto_partitioner ap;
-  tbb::parallel_for(
-      tbb::blocked_range<gvt::render::actor::RayVector::iterator>(rays.begin(), rays.end(), chunksize),
-      [&](tbb::blocked_range<gvt::render::actor::RayVector::iterator> raysit) {
+  queue.partition(
+      last - first, chunksize,
+      [&](size_t begin, size_t end, int *target) {
 
         gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
-            acc.intersect<GVT_SIMD_WIDTH>(raysit.begin(), raysit.end(), src);
+            acc.intersect<GVT_SIMD_WIDTH>(first + begin, first + end, src);
 
-        gvt::core::Map<int, gvt::render::actor::RayVector> local_queue;
         for (size_t i = 0; i < hits.size(); i++) {
-          gvt::render::actor::Ray &r = *(raysit.begin() + i);
+          gvt::render::actor::Ray &r = first[begin + i];
+          target[i] = -1;
           //                        if (hits[i].next != -1) {
           //                          r.origin = r.origin + r.direction * (hits[i].t * 0.95f);
           //                          local_queue[hits[i].next].push_back(r);
@@ -281,7 +408,7 @@ inline void DomainTracer::processRays(gvt::render::actor::RayVector &rays, const
                 img->localAdd(r.mice.id, r.mice.color * r.mice.w, 1.f, r.mice.t);
               } else if (r.mice.depth & RAY_BOUNDARY) {
                 r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 1.00f);
-                local_queue[hits[i].next].push_back(r);
+                target[i] = hits[i].next;
               }
             } else if (r.mice.type == RAY_AO) {
               if (r.mice.depth & (RAY_EXTERNAL_BOUNDARY | RAY_TIMEOUT)) {
@@ -290,7 +417,7 @@ inline void DomainTracer::processRays(gvt::render::actor::RayVector &rays, const
                 img->localAdd(r.mice.id, r.mice.color * r.mice.w, 1.f, r.mice.t);
               } else if (r.mice.depth & RAY_BOUNDARY) {
                 r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 1.00f);
-                local_queue[hits[i].next].push_back(r);
+                target[i] = hits[i].next;
               }
             }
             if (write_to_fb) {
@@ -300,12 +427,15 @@ inline void DomainTracer::processRays(gvt::render::actor::RayVector &rays, const
               img->localAdd(r.mice.id, r.mice.color * r.mice.w, 1.f, r.mice.t);
             }
             if (target_queue != -1) {
-              local_queue[target_queue].push_back(r);
+              target[i] = target_queue;
             }
           } else {
             if (hits[i].next != -1) {
-              r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 0.95f);
-              local_queue[hits[i].next].push_back(r);
+              // t_max is measured from the origin, so a shadow ray keeps stopping at its light
+              const float advance = hits[i].t * 0.95f;
+              r.mice.origin = r.mice.origin + r.mice.direction * advance;
+              r.mice.t_max -= advance;
+              target[i] = hits[i].next;
             } else if (r.mice.type == gvt::render::actor::Ray::SHADOW && glm::length(r.mice.color) > 0) {
               //                            tbb::mutex::scoped_lock fbloc(colorBuf_mutex[r.id % width]);
               // colorBuf[r.id] += glm::vec4(r.color, r.w);
@@ -313,32 +443,48 @@ inline void DomainTracer::processRays(gvt::render::actor::RayVector &rays, const
             }
           }
         }
-        for (auto &q : local_queue) {
-          queue_mutex[q.first].lock();
-          queue[q.first].insert(queue[q.first].end(), std::make_move_iterator(local_queue[q.first].begin()),
-                                std::make_move_iterator(local_queue[q.first].end()));
-          queue_mutex[q.first].unlock();
-        }
       },
-      ap);
-
-  rays.clear();
+      [&](size_t i, gvt::render::actor::Ray &r) { r = first[i]; });
 }
 
 bool DomainTracer::MessageManager(std::shared_ptr<gvt::comm::Message> msg) {
-  std::shared_ptr<gvt::comm::communicator> comm = gvt::comm::communicator::singleton();
-  gvt::render::actor::RayVector rays;
-  rays.resize(msg->size() / sizeof(gvt::render::actor::Ray));
-  std::memcpy(&rays[0], msg->getMessage<void>(), msg->size());
-  processRays(rays);
+  if (auto update = gvt::comm::communicator::SAFE_DOWN_CAST<gvt::comm::SendLoad>(msg)) {
+    // no work attached, not counted for termination
+    load[update->src()] = update->rays();
+    return true;
+  }
+  if (auto batch = gvt::comm::communicator::SAFE_DOWN_CAST<gvt::comm::SendRayBatch>(msg)) {
+    load[batch->src()] = batch->load();
+    // the sender already knows the instance, decode the rays straight into its queue
+    const gvt::render::actor::RayCodec::Format format = batch->format();
+    const unsigned char *rays = batch->payload();
+    gvt::comm::SendRayBatch::Entry *table = batch->table();
+    for (std::size_t i = 0, n = batch->entries(); i < n; ++i) {
+      const int instance = table[i].instance;
+      const std::size_t count = table[i].count;
+      if (!isInNode(instance)) {
+        gvt::render::actor::RayVector tmp(count);
+        gvt::render::actor::RayCodec::decode(format, rays, count, tmp.data());
+        processRays(tmp);
+      } else {
+        queue.append(instance, count, [&](gvt::render::actor::Ray *dst) {
+          gvt::render::actor::RayCodec::decode(format, rays, count, dst);
+        });
+      }
+      rays += gvt::render::actor::RayCodec::encodedSize(format, count);
+    }
+    termination->received();
+    return true;
+  }
+  // rays are traced in place from the (pooled) receive buffer
+  gvt::render::actor::Ray *rays = msg->getMessage<gvt::render::actor::Ray>();
+  processRays(rays, rays + msg->sizehas<gvt::render::actor::Ray>());
+  termination->received();
   return true;
 }
 
 bool DomainTracer::isDone() {
-  if (queue.empty()) return true;
-  for (auto &q : queue)
-    if (!q.second.empty()) return false;
-  return true;
+  return coalescer->empty() && queue.empty() && !cam->wavesPending();
 }
 bool DomainTracer::hasWork() { return !_GlobalFrameFinished; }
 } // namespace render
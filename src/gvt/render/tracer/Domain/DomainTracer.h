@@ -25,9 +25,15 @@
 #ifndef GVT_RENDER_DOMAINTRACER
 #define GVT_RENDER_DOMAINTRACER
 
+#include <gvt/core/comm/termination.h>
+#include <gvt/render/tracer/Domain/RayCoalescer.h>
 #include <gvt/render/tracer/RayTracer.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <vector>
 
 namespace gvt {
 namespace render {
@@ -42,15 +48,33 @@ namespace render {
  * The scheduler requires a user defined message type call SendRayList to encapsulate the rays sent among the nodes.
  * @see SendRayList
  *
+ * When a mesh is replicated (its Locations list several nodes) and replicaRouting is set (api::setReplicaRouting, off
+ * by default), every holder traces the instance. Camera rays are split among the holders by pixel, rays for a remote
+ * instance go to the holder with the shallowest queues and a holder whose queues are much deeper than another holder's
+ * hands it part of the queue it is about to trace (shareRays). Queue depths travel on every ray batch and in SendLoad
+ * broadcasts (loadInterval).
+ *
  */
 class DomainTracer : public gvt::render::RayTracer {
 private:
 protected:
   gvt::core::Map<int, unsigned> remote;        /**< Maps instances ids to their remote nodes */
   gvt::core::Map<int, bool> instances_in_node; /**< Determines if an instance (mesh) is available in the current node */
-
-  std::shared_ptr<comm::vote::vote> v;        /**< Voting procedure */
-  volatile bool _GlobalFrameFinished = false; /**< Communicates the result of the voting to the scheduler */
+  gvt::core::Map<int, std::vector<int> > holders; /**< Nodes holding the data of each instance */
+
+  // Replica routing
+  int rank;                                          /**< This compute node */
+  bool routing;                                      /**< Any holder of an instance may trace it */
+  bool replicated = false;                           /**< At least one instance has several holders */
+  std::size_t shareRays;                             /**< Fewest rays handed to a less loaded holder */
+  std::chrono::microseconds loadInterval;            /**< Shortest time between two load broadcasts */
+  std::unique_ptr<std::atomic<std::size_t>[]> load;  /**< Last known queue depth of every node */
+  std::size_t advertised = 0;                        /**< Queue depth last broadcast */
+  std::chrono::steady_clock::time_point advertisedAt; /**< Time of the last broadcast */
+
+  std::shared_ptr<gvt::comm::TerminationDetector> termination; /**< Frame end detection */
+  std::shared_ptr<RayCoalescer> coalescer;                      /**< Merges the queues sent to the same node */
+  volatile bool _GlobalFrameFinished = false; /**< Set once termination was detected, ends the frame */
 
 public:
   DomainTracer(const std::string& name,std::shared_ptr<gvt::render::data::scene::gvtCameraBase> cam,
@@ -59,9 +83,9 @@ public:
   /**
    * \brief Domain decomposition implementatiom
    *
-   * Determines the highest queue (highest ray count) and schedules it. If there are rays in instance queues that are
-   * only available in remote nodes, it encapsulates the queue in a send ray list message and delivers the message to
-   * the communicator to be sent.
+   * Determines the highest queue (highest ray count) and schedules it. Rays in instance queues that are only
+   * available in remote nodes are handed to the coalescer, which merges the queues bound for the same node into
+   * batch messages (@see RayCoalescer). Received messages are drained from the communicator inbox every iteration.
    *
    * At the end invokes the Image Composition procedure that computes the final image buffer.
    *
@@ -78,6 +102,14 @@ public:
    * @param  rays               [description]
    */
   void processRaysAndDrop(gvt::render::actor::RayVector &rays);
+  /**
+   * \brief Filters the camera ray stream, same as @see processRaysAndDrop but reading the structure-of-arrays
+   * layout directly.
+   *
+   * @method processRaysAndDrop
+   * @param  rays               Ray stream, cleared on return
+   */
+  void processRaysAndDrop(gvt::render::actor::RayStream &rays);
   /**
    * \brief Processes the ray returned by the adapter
    *
@@ -88,8 +120,30 @@ public:
    */
   void processRays(gvt::render::actor::RayVector &rays, const int src = -1, const int dst = -1);
   /**
-   * Process incomming user messages, in this case SendRayList. After extracting the ray queue invokes processRays to
-   * place them in the correct instance queue.
+   * \brief Same as @see processRays on the rays [begin, end) in place (e.g. a received message buffer), the rays
+   * are modified but not released
+   */
+  void processRays(gvt::render::actor::Ray *begin, gvt::render::actor::Ray *end, const int src = -1,
+                   const int dst = -1);
+  /**
+   * \brief Hand the non empty remote instance queues to the coalescer
+   * @return Number of rays handed over
+   */
+  std::size_t sendRemoteQueues();
+  /**
+   * \brief Hand part of a local queue to another holder of the instance if its queues are much shallower
+   * @param  instance Instance the rays are queued for
+   * @param  rays     Rays about to be traced, the shared ones are removed from the back
+   * @return Number of rays handed over
+   */
+  std::size_t shareQueue(const int instance, gvt::render::actor::RayVector &rays);
+  /**
+   * \brief Publish the local queue depth, on the next batches and, if it changed enough, in a SendLoad broadcast
+   */
+  void advertiseLoad();
+  /**
+   * Process incomming user messages, in this case SendRayBatch or SendRayList. Batch rays go straight to the instance
+   * queue named in the batch table, SendRayList rays are placed with processRays.
    *
    * Any other user message is passed to the parents method, to allow easy extension.
    *
@@ -118,6 +172,13 @@ public:
    */
   void resetBVH();
 
+  /**
+   * Build the node scene over the instances held by this node, see RayTracer::buildNodeScene
+   *
+   * @method resetNodeScene
+   */
+  void resetNodeScene();
+
   /**
    * \brief Check if an instance data is available in node
    * @method isInNode
@@ -128,33 +189,36 @@ public:
 
   /**
    * \brief Pick a remote node that contains the data for a given instance
+   *
+   * The holder with the shallowest known queues when routing across replicas, the assigned node otherwise.
+   *
    * @method pickNode
    * @param  i        Instance internal id
    * @return          Remote node id
    */
-  inline int pickNode(const int &i) { return remote[i]; }
+  int pickNode(const int &i);
 
   /**
-   * \brief Static method that allows the voting procedure to invoke the schedule isDone
-   * @method areWeDone
-   * @return true if no more work available
-   */
-  static bool areWeDone();
-
-  /**
-   * Static method used by the voting procedure to set the agreement value in the scheduler
-   * @method Done
-   * @param  bool [description]
+   * \brief Check if a camera ray that first enters instance i is traced in this node
+   *
+   * Replicated instances split their camera rays among the holders by pixel.
+   *
+   * @param  i        Instance internal id
+   * @param  id       Ray (pixel) id
    */
-  static void Done(bool);
+  inline bool ownsCameraRay(const int i, const int id) {
+    if (!routing) return isInNode(i);
+    const std::vector<int> &h = holders.find(i)->second;
+    return h[(unsigned(id) * 2654435761u >> 8) % h.size()] == rank;
+  }
 
   /**
-   * \brief Allows the static voting procedure to set the communication flag to the scheduler
-   * \param v Value of the voting result (true if all agree that the work is finished)
+   * \brief Set the frame finished flag
+   * \param v True once all nodes are out of work
    */
   void inline setGlobalFrameFinished(bool v) { _GlobalFrameFinished = v; }
   /**
-   * Get the current agreement value for all the nodes
+   * Get the frame finished flag
    * @method getGlobalFrameFinished
    * @return Current agreement value
    */
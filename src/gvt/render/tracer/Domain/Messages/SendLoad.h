@@ -0,0 +1,68 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards
+   ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   =======================================================================================
+   */
+
+#ifndef GVT_DOMAIN_SEND_LOAD_H
+#define GVT_DOMAIN_SEND_LOAD_H
+
+#include <gvt/core/comm/message.h>
+
+#include <cstdint>
+
+namespace gvt {
+namespace comm {
+/**
+ * @brief Queue depth of the sender, in rays
+ *
+ * Lets ranks that hold replicas of the same data route rays to the least loaded holder. Carries no work, so it is
+ * not counted by the termination detection.
+ */
+struct SendLoad : public gvt::comm::Message {
+  REGISTERABLE_MESSAGE(SendLoad);
+
+  /**
+   * @brief Default constructor
+   */
+  SendLoad() : gvt::comm::Message(){};
+  /**
+   * @brief Create a message with a buffer of n size(bytes)
+   */
+  SendLoad(const size_t &n) : gvt::comm::Message(n){};
+  /**
+   * @brief Create a message with the sender queue depth
+   * @param src The origin compute node id
+   * @param rays Rays queued in the origin node
+   */
+  SendLoad(const long src, const std::uint64_t rays);
+
+  /**
+   * @brief Rays queued in the sender
+   */
+  std::uint64_t rays() { return *getMessage<std::uint64_t>(); }
+};
+}
+}
+
+#endif /*GVT_DOMAIN_SEND_LOAD_H*/
@@ -0,0 +1,74 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards
+   ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   =======================================================================================
+   */
+
+#include "SendRayBatch.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace gvt {
+namespace comm {
+
+REGISTER_INIT_MESSAGE(SendRayBatch);
+
+static std::size_t countRays(const std::vector<SendRayBatch::Segment> &segments) {
+  std::size_t nrays = 0;
+  for (auto &s : segments) nrays += s.count;
+  return nrays;
+}
+
+SendRayBatch::SendRayBatch(const long _src, const long _dst, const std::vector<Segment> &segments,
+                           const gvt::render::actor::RayCodec::Format format, const std::size_t load)
+    : gvt::comm::Message(bytes(format, countRays(segments), segments.size())) {
+  tag(COMMUNICATOR_MESSAGE_TAG);
+  src(_src);
+  dst(_dst);
+
+  const std::size_t nrays = countRays(segments);
+  Byte *ptr = getMessage<Byte>();
+  Entry *entry = reinterpret_cast<Entry *>(ptr + gvt::render::actor::RayCodec::encodedSize(format, nrays));
+  for (auto &s : segments) {
+    gvt::render::actor::RayCodec::encode(format, s.rays, s.count, ptr);
+    ptr += gvt::render::actor::RayCodec::encodedSize(format, s.count);
+    entry->instance = s.instance;
+    entry->count = s.count;
+    entry++;
+  }
+  Trailer &t = *reinterpret_cast<Trailer *>(entry);
+  t.entries = segments.size();
+  t.version = gvt::render::actor::RayCodec::VERSION;
+  t.format = format;
+  t.load = std::uint32_t(std::min<std::size_t>(load, UINT32_MAX));
+}
+
+gvt::render::actor::RayCodec::Format SendRayBatch::format() {
+  if (trailer().version != gvt::render::actor::RayCodec::VERSION)
+    throw std::runtime_error("SendRayBatch: ray codec version " + std::to_string(trailer().version) +
+                             " does not match " + std::to_string(gvt::render::actor::RayCodec::VERSION));
+  return gvt::render::actor::RayCodec::Format(trailer().format);
+}
+}
+}
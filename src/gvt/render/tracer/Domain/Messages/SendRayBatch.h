@@ -0,0 +1,136 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards
+   ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   =======================================================================================
+   */
+
+#ifndef GVT_DOMAIN_SEND_RAY_BATCH_H
+#define GVT_DOMAIN_SEND_RAY_BATCH_H
+
+#include <gvt/core/comm/message.h>
+#include <gvt/render/actor/Ray.h>
+#include <gvt/render/actor/RayCodec.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace gvt {
+namespace comm {
+/**
+ * @brief Several instance ray queues bound for the same node in one message
+ *
+ * Content layout: the encoded rays of all queues back to back (@see RayCodec), followed by the instance table (one
+ * Entry per queue, in the same order as the rays) and a Trailer with the number of entries, the ray encoding and the
+ * queue depth of the sender (@see SendLoad).
+ *
+ * @see RayCoalescer
+ */
+struct SendRayBatch : public gvt::comm::Message {
+  REGISTERABLE_MESSAGE(SendRayBatch);
+
+  /**
+   * @brief Instance table entry
+   */
+  struct Entry {
+    int instance;   /**< Instance id the rays are queued for */
+    unsigned count; /**< Number of rays */
+  };
+
+  /**
+   * @brief Last bytes of the content
+   */
+  struct Trailer {
+    std::uint32_t entries; /**< Instance table entries */
+    std::uint16_t version; /**< RayCodec::VERSION of the sender */
+    std::uint16_t format;  /**< RayCodec::Format of the rays */
+    std::uint32_t load;    /**< Rays queued in the sender when the batch was packed (saturated) */
+  };
+
+  /**
+   * @brief Rays to pack, [rays, rays + count) are encoded into the message
+   */
+  struct Segment {
+    int instance;
+    const gvt::render::actor::Ray *rays;
+    std::size_t count;
+  };
+
+  /**
+   * @brief Default constructor
+   */
+  SendRayBatch() : gvt::comm::Message(){};
+  /**
+   * @brief Create a message with a buffer of n size(bytes)
+   */
+  SendRayBatch(const size_t &n) : gvt::comm::Message(n){};
+  /**
+   * @brief Create a message and pack the segments into the message buffer
+   * @param src The origin compute node id
+   * @param dst The destination compute node id
+   * @param segments Ray segments to send
+   * @param format Ray encoding
+   * @param load Rays queued in the sender
+   */
+  SendRayBatch(const long src, const long dst, const std::vector<Segment> &segments,
+               const gvt::render::actor::RayCodec::Format format = gvt::render::actor::RayCodec::COMPACT,
+               const std::size_t load = 0);
+
+  /**
+   * @brief Content size in bytes of a batch with \p rays rays in \p entries table entries
+   */
+  static std::size_t bytes(const gvt::render::actor::RayCodec::Format format, const std::size_t rays,
+                           const std::size_t entries) {
+    return gvt::render::actor::RayCodec::encodedSize(format, rays) + entries * sizeof(Entry) + sizeof(Trailer);
+  }
+
+  /**
+   * @brief Content trailer
+   */
+  Trailer &trailer() { return *reinterpret_cast<Trailer *>(getMessage<Byte>() + size() - sizeof(Trailer)); }
+  /**
+   * @brief Number of instance table entries
+   */
+  std::size_t entries() { return trailer().entries; }
+  /**
+   * @brief Rays queued in the sender
+   */
+  std::size_t load() { return trailer().load; }
+  /**
+   * @brief Ray encoding, throws if the sender used a different codec version
+   */
+  gvt::render::actor::RayCodec::Format format();
+  /**
+   * @brief Instance table
+   */
+  Entry *table() {
+    return reinterpret_cast<Entry *>(getMessage<Byte>() + size() - sizeof(Trailer) - entries() * sizeof(Entry));
+  }
+  /**
+   * @brief Encoded rays of the first entry, the rays of entry i follow the rays of entry i - 1
+   */
+  const unsigned char *payload() { return getMessage<unsigned char>(); }
+};
+}
+}
+
+#endif /*GVT_DOMAIN_SEND_RAY_BATCH_H*/
@@ -50,5 +50,13 @@ SendRayList::SendRayList(const long _src, const long _dst, gvt::render::actor::R
   // s = src;
   // d = dst;
 }
+
+SendRayList::SendRayList(const long _src, const long _dst, gvt::render::actor::RayVector &&raylist)
+    : gvt::comm::Message() {
+  tag(COMMUNICATOR_MESSAGE_TAG);
+  src(_src);
+  dst(_dst);
+  setMessage(std::make_shared<gvt::render::actor::RayVector>(std::move(raylist)));
+}
 }
 }
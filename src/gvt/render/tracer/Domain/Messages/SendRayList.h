@@ -62,6 +62,13 @@ public:
    * @param raylist The list of rays to send
    */
   SendRayList(const long src, const long dst, gvt::render::actor::RayVector &raylist);
+  /**
+   * @brief Create a message that takes over the ray list storage (no copy), raylist is left empty
+   * @param src The origin compute node id
+   * @param dst The destination compute node id
+   * @param raylist The list of rays to send
+   */
+  SendRayList(const long src, const long dst, gvt::render::actor::RayVector &&raylist);
 };
 }
 }
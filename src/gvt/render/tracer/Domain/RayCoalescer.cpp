@@ -0,0 +1,132 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#include "RayCoalescer.h"
+#include "Messages/SendRayBatch.h"
+#include <gvt/core/comm/communicator.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace gvt {
+namespace render {
+
+RayCoalescer::RayCoalescer(const long rank, const std::size_t flush_bytes, const std::size_t max_bytes,
+                           const double delay_ms, const gvt::render::actor::RayCodec::Format format, Sender send)
+    : flush_bytes(flush_bytes), max_bytes(max_bytes), delay(std::chrono::microseconds((long long)(delay_ms * 1e3))),
+      format(format), _rank(rank), _send(send) {
+  if (!_send) {
+    _send = [](std::shared_ptr<gvt::comm::Message> msg, int dst) {
+      gvt::comm::communicator::instance().send(msg, dst);
+    };
+  }
+}
+
+void RayCoalescer::add(const int dst, const int instance, gvt::render::actor::RayVector &&rays) {
+  if (rays.empty()) return;
+  Outbound &out = _out[dst];
+  if (out.rays == 0) out.since = clock::now();
+  out.rays += rays.size();
+
+  gvt::render::actor::RayVector &q = out.queues[instance];
+  if (q.empty()) {
+    std::swap(q, rays);
+  } else {
+    q.insert(q.end(), std::make_move_iterator(rays.begin()), std::make_move_iterator(rays.end()));
+  }
+  rays.clear();
+
+  if (gvt::render::actor::RayCodec::encodedSize(format, out.rays) >= flush_bytes) {
+    _counters.threshold++;
+    flush(dst);
+  }
+}
+
+void RayCoalescer::flushExpired() {
+  if (_out.empty()) return;
+  const clock::time_point now = clock::now();
+  std::vector<int> expired;
+  for (auto &o : _out)
+    if (now - o.second.since >= delay) expired.push_back(o.first);
+  for (int dst : expired) {
+    _counters.deadline++;
+    flush(dst);
+  }
+}
+
+void RayCoalescer::flushAll() {
+  while (!_out.empty()) {
+    _counters.idle++;
+    flush(_out.begin()->first);
+  }
+}
+
+std::size_t RayCoalescer::pending(const int dst) const {
+  auto it = _out.find(dst);
+  return (it == _out.end()) ? 0 : gvt::render::actor::RayCodec::encodedSize(format, it->second.rays);
+}
+
+void RayCoalescer::flush(const int dst) {
+  typedef gvt::comm::SendRayBatch Batch;
+  auto it = _out.find(dst);
+  if (it == _out.end()) return;
+
+  const std::size_t ray_bytes = gvt::render::actor::RayCodec::rayBytes(format);
+  std::vector<Batch::Segment> segments;
+  std::size_t bytes = Batch::bytes(format, 0, 0);
+
+  auto emit = [&]() {
+    std::shared_ptr<gvt::comm::Message> msg = std::make_shared<Batch>(_rank, dst, segments, format, _load);
+    _counters.messages++;
+    _counters.bytes += msg->size();
+    _counters.segments += segments.size();
+    _send(msg, dst);
+    segments.clear();
+    bytes = Batch::bytes(format, 0, 0);
+  };
+
+  // fill each message up to max_bytes, a queue that does not fit is split across messages
+  for (auto &q : it->second.queues) {
+    std::size_t first = 0;
+    while (first < q.second.size()) {
+      const std::size_t used = bytes + sizeof(Batch::Entry);
+      const std::size_t room = (max_bytes > used) ? (max_bytes - used) / ray_bytes : 0;
+      if (room == 0 && !segments.empty()) {
+        emit();
+        continue;
+      }
+      const std::size_t count = std::min(q.second.size() - first, std::max<std::size_t>(room, 1));
+      segments.push_back({ q.first, q.second.data() + first, count });
+      bytes += sizeof(Batch::Entry) + count * ray_bytes;
+      _counters.rays += count;
+      first += count;
+    }
+  }
+  if (!segments.empty()) emit();
+
+  _out.erase(it);
+}
+}
+}
@@ -0,0 +1,151 @@
+/* =======================================================================================
+   This file is released as part of GraviT - scalable, platform independent ray tracing
+   tacc.github.io/GraviT
+
+   Copyright 2013-2015 Texas Advanced Computing Center, The University of Texas at Austin
+   All rights reserved.
+
+   Licensed under the BSD 3-Clause License, (the "License"); you may not use this file
+   except in compliance with the License.
+   A copy of the License is included with this software in the file LICENSE.
+   If your copy does not contain the License, you may obtain a copy of the License at:
+
+       http://opensource.org/licenses/BSD-3-Clause
+
+   Unless required by applicable law or agreed to in writing, software distributed under
+   the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+   KIND, either express or implied.
+   See the License for the specific language governing permissions and limitations under
+   limitations under the License.
+
+   GraviT is funded in part by the US National Science Foundation under awards ACI-1339863,
+   ACI-1339881 and ACI-1339840
+   ======================================================================================= */
+
+#ifndef GVT_RENDER_RAYCOALESCER
+#define GVT_RENDER_RAYCOALESCER
+
+#include <gvt/core/Types.h>
+#include <gvt/core/comm/message.h>
+#include <gvt/render/actor/Ray.h>
+#include <gvt/render/actor/RayCodec.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace gvt {
+namespace render {
+
+/**
+ * \brief Outbound ray message aggregation
+ *
+ * Instance queues bound for the same compute node are held back and merged into one SendRayBatch message. The
+ * pending rays of a node are sent when they reach flush_bytes, when the oldest of them has waited more than delay
+ * (@see flushExpired) or when the scheduler runs out of local work (@see flushAll). Batches are split so that no
+ * message is larger than max_bytes, letting the receiver start on the first part while the rest is in flight. Sizes
+ * are wire sizes, rays are encoded with the coalescer format.
+ *
+ * Not thread safe, meant to be driven by the scheduler thread.
+ */
+class RayCoalescer {
+public:
+  /**
+   * \brief Send function, defaults to the communicator send
+   */
+  typedef std::function<void(std::shared_ptr<gvt::comm::Message>, int)> Sender;
+
+  /**
+   * \brief Message counters since the last resetCounters
+   */
+  struct Counters {
+    std::size_t messages = 0;  /**< Messages sent */
+    std::size_t bytes = 0;     /**< Message content bytes sent */
+    std::size_t rays = 0;      /**< Rays sent */
+    std::size_t segments = 0;  /**< Instance table entries sent */
+    std::size_t threshold = 0; /**< Flushes triggered by flush_bytes */
+    std::size_t deadline = 0;  /**< Flushes triggered by the delay */
+    std::size_t idle = 0;      /**< Flushes triggered by flushAll */
+  };
+
+  /**
+   * @param rank        Compute node id of the sender
+   * @param flush_bytes Pending bytes for a node that trigger a send
+   * @param max_bytes   Largest message content, larger batches are split
+   * @param delay_ms    Longest time rays are held back, in milliseconds
+   * @param format      Ray encoding on the wire
+   * @param send        Send function
+   */
+  RayCoalescer(const long rank, const std::size_t flush_bytes = 1 << 20, const std::size_t max_bytes = 8 << 20,
+               const double delay_ms = 1.0,
+               const gvt::render::actor::RayCodec::Format format = gvt::render::actor::RayCodec::COMPACT,
+               Sender send = Sender());
+
+  /**
+   * \brief Queue rays for instance on compute node dst, takes over the ray storage
+   *
+   * Sends the pending rays of dst if they reach flush_bytes.
+   */
+  void add(const int dst, const int instance, gvt::render::actor::RayVector &&rays);
+
+  /**
+   * \brief Send the pending rays of every node whose oldest rays waited longer than the delay
+   */
+  void flushExpired();
+
+  /**
+   * \brief Send everything pending
+   */
+  void flushAll();
+
+  /**
+   * \brief Queue depth stamped on the batches sent from now on (@see SendRayBatch::load)
+   */
+  void advertise(const std::size_t load) { _load = load; }
+
+  /**
+   * \brief True if no rays are pending
+   */
+  bool empty() const { return _out.empty(); }
+
+  /**
+   * \brief Wire bytes pending for compute node dst
+   */
+  std::size_t pending(const int dst) const;
+
+  const Counters &counters() const { return _counters; }
+  void resetCounters() { _counters = Counters(); }
+
+  std::size_t flush_bytes;                     /**< Pending bytes for a node that trigger a send */
+  std::size_t max_bytes;                       /**< Largest message content */
+  std::chrono::microseconds delay;             /**< Longest time rays are held back */
+  gvt::render::actor::RayCodec::Format format; /**< Ray encoding on the wire */
+
+protected:
+  typedef std::chrono::steady_clock clock;
+
+  /**
+   * \brief Pending rays for one compute node
+   */
+  struct Outbound {
+    gvt::core::Map<int, gvt::render::actor::RayVector> queues; /**< Instance queues */
+    std::size_t rays = 0;                                        /**< Pending rays */
+    clock::time_point since;                                     /**< Arrival of the oldest pending rays */
+  };
+
+  /**
+   * \brief Pack the pending rays of dst into messages of at most max_bytes and send them
+   */
+  void flush(const int dst);
+
+  long _rank;
+  std::size_t _load = 0;
+  Sender _send;
+  gvt::core::Map<int, Outbound> _out;
+  Counters _counters;
+};
+}
+}
+
+#endif /* GVT_RENDER_RAYCOALESCER */
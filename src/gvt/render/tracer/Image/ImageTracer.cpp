@@ -32,22 +32,20 @@ namespace render {
 ImageTracer::ImageTracer(const std::string &name, std::shared_ptr<gvt::render::data::scene::gvtCameraBase> cam,
                          std::shared_ptr<gvt::render::composite::ImageComposite> img)
     : gvt::render::RayTracer(name, cam, img) {
-  queue_mutex = new std::mutex[meshRef.size()];
-  for (auto &m : meshRef) {
-    queue[m.first] = gvt::render::actor::RayVector();
-  }
-}
-ImageTracer::~ImageTracer() {
-  if (queue_mutex != nullptr) delete[] queue_mutex;
-  queue.clear();
+  resetNodeScene();
 }
+ImageTracer::~ImageTracer() { queue.clear(); }
 
 void ImageTracer::resetBVH() {
   RayTracer::resetBVH();
-  if (queue_mutex != nullptr) delete[] queue_mutex;
-  for (auto &m : meshRef) {
-    queue[m.first] = gvt::render::actor::RayVector();
-  }
+  resetNodeScene();
+}
+
+void ImageTracer::resetNodeScene() {
+  // every rank holds the whole scene
+  gvt::core::Vector<int> local;
+  for (auto &m : meshRef) local.push_back(m.first);
+  RayTracer::buildNodeScene(local);
 }
 
 void ImageTracer::operator()() {
@@ -63,35 +61,38 @@ void ImageTracer::operator()() {
   gvt::core::time::timer t_filter(false, "image tracer: filter : ");
   gvt::core::time::timer t_camera(false, "image tracer: gen rays : ");
   t_camera.resume();
-  cam->AllocateCameraRays();
-  cam->generateRays();
+  cam->beginWaves(waveRays);
   t_camera.stop();
-
-  std::cout << "Generated rays" << std::endl;
-
-  t_filter.resume();
-  processRaysAndDrop(cam->rays);
-  t_filter.stop();
-  gvt::render::actor::RayVector returned_rays;
-
-  std::cout << "Procesed rays" << std::endl;
+  gvt::render::actor::RayVector toprocess, returned_rays;
 
   do {
-    int target = -1;
-    int amount = 0;
-    t_select.resume();
-    for (auto &q : queue) {
-      if (q.second.size() > amount) {
-        amount = q.second.size();
-        target = q.first;
-      }
+    // the next wave of camera rays is generated once the previous one is traced out of the queues
+    if (queue.empty() && cam->wavesPending()) {
+      t_camera.resume();
+      cam->nextWave(volume);
+      t_camera.stop();
+      t_filter.resume();
+      processRaysAndDrop(cam->stream);
+      t_filter.stop();
     }
+
+    t_select.resume();
+    const int target = queue.top();
     t_select.stop();
-    if (target != -1) {
+    if (target != -1 && inNodeScene(target)) {
+      // rays only come back once they leave the scene, so they are either done or hit nothing
       t_tracer.resume();
-      returned_rays.reserve(queue[target].size() * 10);
-      RayTracer::calladapter(target, queue[target], returned_rays);
-      queue[target].clear();
+      takeNodeQueues(toprocess, [](int, gvt::render::actor::RayVector &) {});
+      RayTracer::callNodeScene(toprocess, returned_rays);
+      t_tracer.stop();
+      t_shuffle.resume();
+      processRays(returned_rays, gvt::render::data::accel::BVH::LOCAL);
+      t_shuffle.stop();
+    } else if (target != -1) {
+      t_tracer.resume();
+      queue.take(target, toprocess);
+      returned_rays.reserve(toprocess.size() * 10);
+      RayTracer::calladapter(target, toprocess, returned_rays);
       t_tracer.stop();
       t_shuffle.resume();
       processRays(returned_rays, target);
@@ -101,13 +102,11 @@ void ImageTracer::operator()() {
   t_gather.resume();
   img->composite();
   t_gather.stop();
-  t_all = t_gather + t_shuffle + t_tracer + t_select + t_filter;
+  t_all = t_gather + t_shuffle + t_tracer + t_select + t_filter + t_camera;
 }
 
 void ImageTracer::processRaysAndDrop(gvt::render::actor::RayVector &rays) {
 
-  std::cout << "Yeap" << std::endl;
-
   gvt::comm::communicator &comm = gvt::comm::communicator::instance();
 
   const unsigned ray_chunk = rays.size() / comm.lastid();
@@ -118,31 +117,49 @@ void ImageTracer::processRaysAndDrop(gvt::render::actor::RayVector &rays) {
       MAX(GVT_SIMD_WIDTH, ray_chunk / (cntx::rcontext::instance().getUnique("threads").to<unsigned>() * 4));
   gvt::render::data::accel::BVH &acc = *bvh.get();
 
-  static tbb::simple_partitioner ap;
-  tbb::parallel_for(tbb::blocked_range<gvt::render::actor::RayVector::iterator>(rays.begin() + ray_start,
-                                                                                rays.begin() + ray_end, chunksize),
-                    [&](tbb::blocked_range<gvt::render::actor::RayVector::iterator> raysit) {
-
-                      gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
-                          acc.intersect<GVT_SIMD_WIDTH>(raysit.begin(), raysit.end(), -1);
-
-                      gvt::core::Map<int, gvt::render::actor::RayVector> local_queue;
-                      for (size_t i = 0; i < hits.size(); i++) {
-                        gvt::render::actor::Ray &r = *(raysit.begin() + i);
-                        if (hits[i].next != -1) {
-                          r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 0.95f);
-                          local_queue[hits[i].next].push_back(r);
-                        }
-                      }
-                      for (auto &q : local_queue) {
-                        queue_mutex[q.first].lock();
-                        queue[q.first].insert(queue[q.first].end(),
-                                              std::make_move_iterator(local_queue[q.first].begin()),
-                                              std::make_move_iterator(local_queue[q.first].end()));
-                        queue_mutex[q.first].unlock();
-                      }
-                    },
-                    ap);
+  gvt::render::actor::RayVector::iterator first = rays.begin() + ray_start;
+  queue.partition(ray_end - ray_start, chunksize,
+                  [&](size_t begin, size_t end, int *target) {
+                    gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
+                        acc.intersect<GVT_SIMD_WIDTH>(first + begin, first + end, -1);
+                    for (size_t i = 0; i < hits.size(); i++) {
+                      gvt::render::actor::Ray &r = *(first + begin + i);
+                      target[i] = hits[i].next;
+                      if (hits[i].next != -1) r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 0.95f);
+                    }
+                  },
+                  [&](size_t i, gvt::render::actor::Ray &r) { r = *(first + i); });
+
+  rays.clear();
+}
+
+void ImageTracer::processRaysAndDrop(gvt::render::actor::RayStream &rays) {
+
+  gvt::comm::communicator &comm = gvt::comm::communicator::instance();
+
+  // every rank takes a slice of each wave, the last one the remainder
+  const size_t ray_chunk = rays.size() / comm.lastid();
+  const size_t ray_start = ray_chunk * comm.id();
+  const size_t ray_end = (comm.id() == comm.lastid() - 1) ? rays.size() : ray_chunk * (comm.id() + 1);
+
+  const size_t chunksize =
+      MAX(GVT_SIMD_WIDTH, ray_chunk / (cntx::rcontext::instance().getUnique("threads").to<unsigned>() * 4));
+  gvt::render::data::accel::BVH &acc = *bvh.get();
+
+  std::vector<float> t(ray_end - ray_start);
+  queue.partition(ray_end - ray_start, chunksize,
+                  [&](size_t begin, size_t end, int *target) {
+                    gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
+                        acc.intersect<GVT_SIMD_WIDTH>(rays, ray_start + begin, ray_start + end, -1);
+                    for (size_t i = 0; i < hits.size(); i++) {
+                      target[i] = hits[i].next;
+                      t[begin + i] = hits[i].t;
+                    }
+                  },
+                  [&](size_t i, gvt::render::actor::Ray &r) {
+                    rays.get(ray_start + i, r);
+                    r.mice.origin = r.mice.origin + r.mice.direction * (t[i] * 0.95f);
+                  });
 
   rays.clear();
 }
@@ -151,17 +168,16 @@ void ImageTracer::processRays(gvt::render::actor::RayVector &rays, const int src
 
   const int chunksize = MAX(4096, rays.size() / (cntx::rcontext::instance().getUnique("threads").to<unsigned>() * 4));
   gvt::render::data::accel::BVH &acc = *bvh.get();
-  static tbb::simple_partitioner ap;
-  tbb::parallel_for(
-      tbb::blocked_range<gvt::render::actor::RayVector::iterator>(rays.begin(), rays.end(), chunksize),
-      [&](tbb::blocked_range<gvt::render::actor::RayVector::iterator> raysit) {
+  queue.partition(
+      rays.size(), chunksize,
+      [&](size_t begin, size_t end, int *target) {
 
         gvt::core::Vector<gvt::render::data::accel::BVH::hit> hits =
-            acc.intersect<GVT_SIMD_WIDTH>(raysit.begin(), raysit.end(), src);
+            acc.intersect<GVT_SIMD_WIDTH>(rays.begin() + begin, rays.begin() + end, src);
 
-        gvt::core::Map<int, gvt::render::actor::RayVector> local_queue;
         for (size_t i = 0; i < hits.size(); i++) {
-          gvt::render::actor::Ray &r = *(raysit.begin() + i);
+          gvt::render::actor::Ray &r = rays[begin + i];
+          target[i] = -1;
           //                        if (hits[i].next != -1) {
           //                          r.origin = r.origin + r.direction * (hits[i].t * 0.95f);
           //                          local_queue[hits[i].next].push_back(r);
@@ -204,7 +220,7 @@ void ImageTracer::processRays(gvt::render::actor::RayVector &rays, const int src
                 img->localAdd(r.mice.id, r.mice.color * r.mice.w, 1.f, r.mice.t);
               } else if (r.mice.depth & RAY_BOUNDARY) {
                 r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 1.00f);
-                local_queue[hits[i].next].push_back(r);
+                target[i] = hits[i].next;
               }
             } else if (r.mice.type == RAY_AO) {
               if (r.mice.depth & (RAY_EXTERNAL_BOUNDARY | RAY_TIMEOUT)) {
@@ -213,7 +229,7 @@ void ImageTracer::processRays(gvt::render::actor::RayVector &rays, const int src
                 img->localAdd(r.mice.id, r.mice.color * r.mice.w, 1.f, r.mice.t);
               } else if (r.mice.depth & RAY_BOUNDARY) {
                 r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 1.00f);
-                local_queue[hits[i].next].push_back(r);
+                target[i] = hits[i].next;
               }
             }
             if (write_to_fb) {
@@ -223,12 +239,15 @@ void ImageTracer::processRays(gvt::render::actor::RayVector &rays, const int src
               img->localAdd(r.mice.id, r.mice.color * r.mice.w, 1.f, r.mice.t);
             }
             if (target_queue != -1) {
-              local_queue[target_queue].push_back(r);
+              target[i] = target_queue;
             }
           } else {
             if (hits[i].next != -1) {
-              r.mice.origin = r.mice.origin + r.mice.direction * (hits[i].t * 0.95f);
-              local_queue[hits[i].next].push_back(r);
+              // t_max is measured from the origin, so a shadow ray keeps stopping at its light
+              const float advance = hits[i].t * 0.95f;
+              r.mice.origin = r.mice.origin + r.mice.direction * advance;
+              r.mice.t_max -= advance;
+              target[i] = hits[i].next;
             } else if (r.mice.type == gvt::render::actor::Ray::SHADOW && glm::length(r.mice.color) > 0) {
               //                            tbb::mutex::scoped_lock fbloc(colorBuf_mutex[r.id % width]);
               // colorBuf[r.id] += glm::vec4(r.color, r.w);
@@ -236,26 +255,15 @@ void ImageTracer::processRays(gvt::render::actor::RayVector &rays, const int src
             }
           }
         }
-        for (auto &q : local_queue) {
-          queue_mutex[q.first].lock();
-          queue[q.first].insert(queue[q.first].end(), std::make_move_iterator(local_queue[q.first].begin()),
-                                std::make_move_iterator(local_queue[q.first].end()));
-          queue_mutex[q.first].unlock();
-        }
       },
-      ap);
+      [&](size_t i, gvt::render::actor::Ray &r) { r = rays[i]; });
 
   rays.clear();
 }
 
 bool ImageTracer::MessageManager(std::shared_ptr<gvt::comm::Message> msg) { return RayTracer::MessageManager(msg); }
 
-bool ImageTracer::isDone() {
-  if (queue.empty()) return true;
-  for (auto &q : queue)
-    if (!q.second.empty()) return false;
-  return true;
-}
+bool ImageTracer::isDone() { return queue.empty() && !cam->wavesPending(); }
 bool ImageTracer::hasWork() { return !isDone(); }
 } // namespace render
 } // namespace gvt
@@ -60,6 +60,13 @@ public:
    * @param  rays               [description]
    */
   virtual void processRaysAndDrop(gvt::render::actor::RayVector &rays);
+  /**
+   * Structure-of-arrays variant of @see processRaysAndDrop used for the camera rays. Only rays that hit an
+   * instance are converted to @see gvt::render::actor::Ray and queued.
+   * @method processRaysAndDrop
+   * @param  rays               Ray stream, cleared on return
+   */
+  virtual void processRaysAndDrop(gvt::render::actor::RayStream &rays);
   /**
    * Process rays returned by the adpater
    * @method processRays
@@ -95,6 +102,12 @@ public:
    * @method resetBVH
    */
   virtual void resetBVH();
+
+  /**
+   * Build the node scene over every instance, see RayTracer::buildNodeScene
+   * @method resetNodeScene
+   */
+  void resetNodeScene();
 };
 }; // namespace render
 }; // namespace gvt
@@ -22,7 +22,9 @@
    ACI-1339881 and ACI-1339840
    ======================================================================================= */
 
+#include <algorithm>
 #include <cassert>
+#include <set>
 #include <gvt/render/cntx/rcontext.h>
 #include <gvt/render/tracer/RayTracer.h>
 
@@ -35,6 +37,15 @@ RayTracer::RayTracer(const std::string &name, std::shared_ptr<gvt::render::data:
     : cam(cam), img(img) {
   auto &db = cntx::rcontext::instance();
   adapterType = db.getChild(db.getUnique(name), "adapter");
+  eagerAdapters = db.getChild(db.getUnique(name), "eagerAdapters");
+  wavefront = db.getChild(db.getUnique(name), "wavefront");
+  raySort = db.getChild(db.getUnique(name), "raySort");
+  volume = db.getChild(db.getUnique(name), "volume");
+  // a queued camera ray costs its stream slot plus its queue copy until it is traced
+  const std::size_t budget = std::size_t(db.getChild(db.getUnique(name), "rayBudget").to<unsigned>()) << 20;
+  waveRays = budget / (gvt::render::actor::RayStream::COLUMNS * sizeof(float) + sizeof(gvt::render::actor::Ray));
+  if (budget != 0 && waveRays == 0) waveRays = 1;
+  nodeScene = db.getChild(db.getUnique(name), "nodeScene");
   std::string filmname = db.getChild(db.getUnique(name), "film");
   width = db.getChild(db.getUnique(filmname), "width");
   height = db.getChild(db.getUnique(filmname), "height");
@@ -79,55 +90,140 @@ void RayTracer::calladapter(const int instTarget, gvt::render::actor::RayVector
   }
 
   if (!adapter) {
-    switch (adapterType) {
+    adapter = createAdapter(mesh);
+    adapterCache[mesh.get()] = adapter;
+  }
+  GVT_ASSERT(adapter != nullptr, "image scheduler: adapter not set");
+  if (raySort) {
+    const gvt::render::data::primitives::Box3D &box = *instBox[instTarget];
+    gvt::render::actor::RaySort::sort(toprocess, box.bounds_min, box.bounds_max);
+  }
+  {
+    moved_rays.reserve(toprocess.size() * 10);
+    adapter->trace(toprocess, moved_rays, instM[instTarget].get(), instMinv[instTarget].get(),
+                   instMinvN[instTarget].get(), lights);
+    toprocess.clear();
+  }
+}
+
+void RayTracer::callNodeScene(gvt::render::actor::RayVector &toprocess, gvt::render::actor::RayVector &moved_rays) {
+  GVT_ASSERT(nodeAdapter != nullptr, "scheduler: node scene not built");
+  if (raySort) gvt::render::actor::RaySort::sort(toprocess, nodeBox.bounds_min, nodeBox.bounds_max);
+  moved_rays.reserve(toprocess.size() * 10);
+  // the adapter applies the transform of each instance itself
+  nodeAdapter->trace(toprocess, moved_rays, nullptr, nullptr, nullptr, lights);
+  toprocess.clear();
+}
+
+void RayTracer::buildNodeScene(const gvt::core::Vector<int> &local) {
+  nodeAdapter = nullptr;
+  nodeInstances.clear();
+  nodeMember.assign(queue.size(), false);
+  if (!nodeScene) return;
+
+#ifdef GVT_RENDER_ADAPTER_EMBREE
+  if (adapterType == gvt::render::adapter::Embree) {
+    buildAdapters();
+    std::vector<gvt::render::adapter::embree::data::EmbreeMeshAdapter::NodeInstance> instances;
+    for (int id : local) {
+      std::shared_ptr<gvt::render::data::primitives::Data> mesh = meshRef[id];
+      if (!mesh) continue;
+      instances.push_back({ std::static_pointer_cast<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(
+                                adapterCache[mesh.get()]),
+                            instM[id].get(), instMinvN[id].get(), nullptr });
+      if (nodeInstances.empty()) nodeBox = *instBox[id];
+      nodeBox.merge(*instBox[id]);
+      nodeInstances.push_back(id);
+      nodeMember[id] = true;
+    }
+    if (!nodeInstances.empty()) {
+      auto adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(instances, wavefront);
+      // a local hit behind the box of a remote instance may be hidden by its data
+      if (nodeInstances.size() < queue.size()) {
+        std::shared_ptr<gvt::render::data::accel::BVH> acc = bvh;
+        adapter->clip = [acc](gvt::render::actor::Ray *begin, gvt::render::actor::Ray *end, float *tfar) {
+          acc->clip<GVT_SIMD_WIDTH>(begin, end, tfar);
+        };
+      }
+      nodeAdapter = adapter;
+    }
+  }
+#endif
+
+  bvh->setLocal(nodeInstances);
+}
+
+std::shared_ptr<gvt::render::Adapter>
+RayTracer::createAdapter(std::shared_ptr<gvt::render::data::primitives::Data> mesh) {
+  std::shared_ptr<gvt::render::Adapter> adapter;
+  switch (adapterType) {
 #ifdef GVT_RENDER_ADAPTER_EMBREE
-    case gvt::render::adapter::Embree:
-      adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(mesh);
-      break;
+  case gvt::render::adapter::Embree:
+    adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeMeshAdapter>(mesh, wavefront);
+    break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_EMBREE_STREAM
-    case gvt::render::adapter::EmbreeStream:
-      adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter>(mesh);
-      break;
+  case gvt::render::adapter::EmbreeStream:
+    adapter = std::make_shared<gvt::render::adapter::embree::data::EmbreeStreamMeshAdapter>(mesh, wavefront);
+    break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_OSPRAY
-    case gvt::render::adapter::Ospray:
-      adapter = std::make_shared<gvt::render::adapter::ospray::data::OSPRayAdapter>(mesh, width, height);
-      break;
+  case gvt::render::adapter::Ospray:
+    adapter = std::make_shared<gvt::render::adapter::ospray::data::OSPRayAdapter>(mesh, width, height);
+    break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_GALAXY
-    case gvt::render::adapter::Pvol:
-      adapter = std::make_shared<gvt::render::adapter::galaxy::data::PVolAdapter>(mesh, width, height);
-      break;
+  case gvt::render::adapter::Pvol:
+    adapter = std::make_shared<gvt::render::adapter::galaxy::data::PVolAdapter>(mesh, width, height);
+    break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_MANTA
-    case gvt::render::adapter::Manta:
-      adapter = new gvt::render::adapter::manta::data::MantaMeshAdapter(mesh);
-      break;
+  case gvt::render::adapter::Manta:
+    adapter = new gvt::render::adapter::manta::data::MantaMeshAdapter(mesh);
+    break;
 #endif
 #ifdef GVT_RENDER_ADAPTER_OPTIX
-    case gvt::render::adapter::Optix:
-      adapter = new gvt::render::adapter::optix::data::OptixMeshAdapter(mesh);
-      break;
+  case gvt::render::adapter::Optix:
+    adapter = new gvt::render::adapter::optix::data::OptixMeshAdapter(mesh);
+    break;
 #endif
 
 #if defined(GVT_RENDER_ADAPTER_OPTIX) && defined(GVT_RENDER_ADAPTER_EMBREE)
-    case gvt::render::adapter::Heterogeneous:
-      adapter = new gvt::render::adapter::heterogeneous::data::HeterogeneousMeshAdapter(mesh);
-      break;
+  case gvt::render::adapter::Heterogeneous:
+    adapter = new gvt::render::adapter::heterogeneous::data::HeterogeneousMeshAdapter(mesh);
+    break;
 #endif
-    default:
-      GVT_ERR_MESSAGE("Image scheduler: unknown adapter type: " << adapterType);
-    }
-    adapterCache[mesh.get()] = adapter;
+  default:
+    GVT_ERR_MESSAGE("Image scheduler: unknown adapter type: " << adapterType);
   }
-  GVT_ASSERT(adapter != nullptr, "image scheduler: adapter not set");
-  {
-    moved_rays.reserve(toprocess.size() * 10);
-    adapter->trace(toprocess, moved_rays, instM[instTarget].get(), instMinv[instTarget].get(),
-                   instMinvN[instTarget].get(), lights);
-    toprocess.clear();
+  return adapter;
+}
+
+void RayTracer::buildAdapters() {
+  std::vector<std::shared_ptr<gvt::render::data::primitives::Data> > pending;
+  std::set<gvt::render::data::primitives::Data *> seen;
+  for (auto &m : meshRef) {
+    if (!m.second || adapterCache.find(m.second.get()) != adapterCache.end()) continue;
+    if (seen.insert(m.second.get()).second) pending.push_back(m.second);
   }
+
+  std::vector<std::shared_ptr<gvt::render::Adapter> > built(pending.size());
+
+  bool concurrent = false;
+#ifdef GVT_RENDER_ADAPTER_EMBREE
+  concurrent = concurrent || (adapterType == gvt::render::adapter::Embree);
+#endif
+#ifdef GVT_RENDER_ADAPTER_EMBREE_STREAM
+  concurrent = concurrent || (adapterType == gvt::render::adapter::EmbreeStream);
+#endif
+
+  if (concurrent) {
+    tbb::parallel_for(size_t(0), pending.size(), [&](size_t i) { built[i] = createAdapter(pending[i]); });
+  } else {
+    for (size_t i = 0; i < pending.size(); ++i) built[i] = createAdapter(pending[i]);
+  }
+
+  for (size_t i = 0; i < pending.size(); ++i) adapterCache[pending[i].get()] = built[i];
 }
 
 float *RayTracer::getImageBuffer() { return img->composite(); };
@@ -183,15 +279,16 @@ void RayTracer::resetBVH() {
   instM.clear();
   instMinv.clear();
   instMinvN.clear();
+  instBox.clear();
   lights.clear();
 
   bvh = std::make_shared<gvt::render::data::accel::BVH>(instancenodes);
 
-  queue_mutex = new std::mutex[bvh->instanceSet.size()];
-
+  size_t numQueues = 0;
   for (auto &nref : bvh->instanceSet) {
     auto &n = nref.get();
     size_t id = db.getChild(n, "id");
+    numQueues = std::max(numQueues, id + 1);
     //meshRef[id] = db.getChild(db.deRef(db.getChild(n, "meshRef")), "ptr");
     if (db.getChild(db.deRef(db.getChild(n, "meshRef")), "ptr")
         .v.is<std::shared_ptr<gvt::render::data::primitives::Mesh> >()) {
@@ -211,7 +308,9 @@ void RayTracer::resetBVH() {
     instM[id] = db.getChild(n, "mat");
     instMinv[id] = db.getChild(n, "matinv");
     instMinvN[id] = db.getChild(n, "normi");
+    instBox[id] = db.getChild(n, "bbox").to<std::shared_ptr<gvt::render::data::primitives::Box3D> >();
   }
+  queue.reset(numQueues);
 
   auto lightNodes = db.getChildren(db.getUnique("Lights"));
 
@@ -233,6 +332,8 @@ void RayTracer::resetBVH() {
       lights.push_back(std::make_shared<gvt::render::data::scene::AreaLight>(pos, color, normal, width, height));
     }
   }
+
+  if (eagerAdapters) buildAdapters();
 }
 } // namespace render
 } // namespace gvt
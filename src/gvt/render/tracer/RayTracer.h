@@ -28,6 +28,8 @@
 #include <gvt/core/tracer/tracer.h>
 #include <gvt/render/Adapter.h>
 #include <gvt/render/Types.h>
+#include <gvt/render/actor/RayQueues.h>
+#include <gvt/render/actor/RaySort.h>
 #include <gvt/render/composite/IceTComposite.h>
 #include <gvt/render/composite/ImageComposite.h>
 #include <gvt/render/data/accel/BVH.h>
@@ -93,8 +95,7 @@ protected:
   // gvt::render::RenderContext *cntxt;                            /**< Current render context */
 
   // Scheduling
-  std::mutex *queue_mutex = nullptr;                        /**< Multi thread queue protectiob */
-  gvt::core::Map<int, gvt::render::actor::RayVector> queue; /**< Ray queue for each instance in the scene */
+  gvt::render::actor::RayQueues queue; /**< Ray queue for each instance in the scene, indexed by instance id */
 
   // Caching
   gvt::core::Map<int, std::shared_ptr<gvt::render::data::primitives::Data> > meshRef; /**< Map mesh internal id to
@@ -102,10 +103,21 @@ protected:
   gvt::core::Map<int, std::shared_ptr<glm::mat4> > instM;     /**< Mesh instance matrix model map */
   gvt::core::Map<int, std::shared_ptr<glm::mat4> > instMinv;  /**< Mesh instance inverse matrix model map */
   gvt::core::Map<int, std::shared_ptr<glm::mat3> > instMinvN; /**< Mesh instance inverse matrix model map (3x3)*/
+  gvt::core::Map<int, std::shared_ptr<gvt::render::data::primitives::Box3D> > instBox; /**< Mesh instance world box */
   gvt::core::Vector<std::shared_ptr<gvt::render::data::scene::Light> > lights; /**< Scene lights */
   gvt::core::Map<gvt::render::data::primitives::Data *, std::shared_ptr<gvt::render::Adapter> >
       adapterCache /**< Tracer adapter cache */;
   int adapterType; /**< Current adapter type */
+  bool eagerAdapters; /**< Build all local adapters in resetBVH instead of on first use */
+  bool wavefront;     /**< Embree adapters trace a bounce at a time with ray compaction */
+  bool raySort;       /**< Coherence sort instance queues before tracing them, see RaySort */
+  bool volume;        /**< Camera rays are volume rendering rays */
+  std::size_t waveRays; /**< Camera rays generated per wave, 0 for the whole frame at once */
+  bool nodeScene;       /**< Trace all local instances in one node scene adapter, see buildNodeScene */
+  std::shared_ptr<gvt::render::Adapter> nodeAdapter;   /**< Node scene adapter, null if there is none */
+  gvt::core::Vector<int> nodeInstances;                /**< Instances traced by the node scene adapter */
+  gvt::core::Vector<bool> nodeMember;                  /**< Node scene membership indexed by instance id */
+  gvt::render::data::primitives::Box3D nodeBox;        /**< World box of the node scene instances */
 
   int width, height;
 
@@ -137,6 +149,72 @@ public:
   void calladapter(const int instTarget, gvt::render::actor::RayVector &toprocess,
                    gvt::render::actor::RayVector &moved_rays);
 
+  /**
+   * \brief Create the adapter for a mesh
+   *
+   * Creates a new adapter of the current adapter type, it does not touch the adapter cache.
+   *
+   * @method createAdapter
+   * @param  mesh        Mesh (data) to convert to the engine format
+   * @return             The new adapter
+   */
+  std::shared_ptr<gvt::render::Adapter> createAdapter(std::shared_ptr<gvt::render::data::primitives::Data> mesh);
+
+  /**
+   * \brief Build the adapters of every local mesh that is not cached yet
+   *
+   * Embree adapters are built concurrently (scene builds are TBB tasks on the shared device), other engines one
+   * at a time.
+   *
+   * @method buildAdapters
+   */
+  void buildAdapters();
+
+  /**
+   * \brief Build the node scene adapter over the instances resident on this node
+   *
+   * With the nodeScene scheduler option the queues of all these instances are traced together in one adapter call
+   * and rays only come back to the scheduler once they leave every one of them (they are then routed from
+   * BVH::LOCAL). When other nodes hold instances, a ray is not traced past the first of their boxes it enters
+   * (BVH::clip) and comes back if it hits nothing before it. Only the Embree adapter has a node scene, with other
+   * adapters instances are traced one at a time.
+   *
+   * @method buildNodeScene
+   * @param  local       Instance ids resident on this node
+   */
+  void buildNodeScene(const gvt::core::Vector<int> &local);
+
+  /**
+   * \brief True if the instance is traced by the node scene adapter
+   */
+  bool inNodeScene(const int instance) const { return nodeAdapter && nodeMember[instance]; }
+
+  /**
+   * \brief Move the queues of every node scene instance into one ray list
+   *
+   * @method takeNodeQueues
+   * @param  toprocess   Rays of all node scene instances, appended to
+   * @param  filter      Called with each instance queue before it is appended (e.g. to hand rays to replicas)
+   */
+  template <typename Filter> void takeNodeQueues(gvt::render::actor::RayVector &toprocess, Filter filter) {
+    gvt::render::actor::RayVector rays;
+    for (int id : nodeInstances) {
+      if (queue.count(id) == 0) continue;
+      queue.take(id, rays);
+      filter(id, rays);
+      toprocess.insert(toprocess.end(), rays.begin(), rays.end());
+    }
+  }
+
+  /**
+   * \brief Trace rays through the node scene adapter
+   *
+   * @method callNodeScene
+   * @param  toprocess   Rays to processed by the adapter, see takeNodeQueues
+   * @param  moved_rays  Rays that left every node scene instance
+   */
+  void callNodeScene(gvt::render::actor::RayVector &toprocess, gvt::render::actor::RayVector &moved_rays);
+
   /**
    * Abstract method to process rays that where returned by the adapter call or a ray list list received from another
    * node
@@ -1698,8 +1698,9 @@ char **get_words(FILE *fp, int *nwords, char **orig_line)
 {
 #define BIG_STRING 4096
   int i,j;
-  static char str[BIG_STRING];
-  static char str_copy[BIG_STRING];
+  /* per thread, so files can be read concurrently */
+  static __thread char str[BIG_STRING];
+  static __thread char str_copy[BIG_STRING];
   char **words;
   int max_words = 10;
   int num_words = 0;